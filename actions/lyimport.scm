@@ -41,13 +41,13 @@
 (define lyimport::blocklexer #f)
 (define lyimport::incllexer #f)
 
-;; Libs
-(load "lalr.scm")
-(load "silex.scm")
-(load "multilex.scm")
-(load "lyimport-lexer.scm") ; Helper functions for the lexer
-(load "lyimport-parser.scm") ; Helper functions and parser rules
-(load "lyimport-todenemo.scm") ; conversion of parse tree to Denemo script
+;; Libs, compiled once into the user's .denemo directory where Guile allows
+(d-LoadCompiled (string-append DENEMO_ACTIONS_DIR "lalr.scm"))
+(d-LoadCompiled (string-append DENEMO_ACTIONS_DIR "silex.scm"))
+(d-LoadCompiled (string-append DENEMO_ACTIONS_DIR "multilex.scm"))
+(d-LoadCompiled (string-append DENEMO_ACTIONS_DIR "lyimport-lexer.scm")) ; Helper functions for the lexer
+(d-LoadCompiled (string-append DENEMO_ACTIONS_DIR "lyimport-parser.scm")) ; Helper functions and parser rules
+(d-LoadCompiled (string-append DENEMO_ACTIONS_DIR "lyimport-todenemo.scm")) ; conversion of parse tree to Denemo script
 
 (define (lyimport::multilexer)
 ;;; the lexing procedure itself
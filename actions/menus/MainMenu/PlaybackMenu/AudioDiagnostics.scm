@@ -0,0 +1,2 @@
+;;;AudioDiagnostics
+(d-AudioDiagnostics)
\ No newline at end of file
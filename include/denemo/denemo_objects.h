@@ -101,6 +101,7 @@ typedef enum ornament {
 
 
 
+#define DENEMO_INLINE_NOTES (3) /**< number of notes a chord holds without further allocation */
 
 /**
  * Structure describing a chord
@@ -163,6 +164,8 @@ typedef struct chord
 
   GList *directives;/**< list of DenemoDirective to apply to the chord */
 
+  note inline_notes[DENEMO_INLINE_NOTES];/**< storage for the first notes of the chord, the notes list points into here before using the heap */
+  guint inline_notes_used;/**< bit mask of the inline_notes in use */
 }
 chord;
 
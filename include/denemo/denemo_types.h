@@ -227,6 +227,7 @@ typedef struct
 {
   DenemoObjType type; /**< The type of object pointed to by the gpointer object field below */
   gchar *lilypond;/**< Holds lilypond generated to represent this object, empty until typesetting is called and out of date if the object has been modified since typesetting */
+  gpointer lilycache;/**< The output of generate_lily_for_obj () for a chord, recorded with what it depends on so that it can be replayed while they are unchanged. A single block, freed with g_free () */
   gint basic_durinticks; /**< Duration of object including dotting but not tuplet/grace note effects. */
   gint durinticks; /**< Duration of object where 384 (PPQN) is a quarter note, includes any tuplet/grace note effects */
   gint starttick; /**< When the object occurs */
@@ -292,6 +293,7 @@ typedef struct
   GtkMenu *voicemenu; /**< a menu to popup up with the voice directives attached */
   GList *sources;/**< List of source pixbufs, one for each measure staff-view */
   measurenode *themeasures; /**< This is a GList of DenemoMeasure objects */
+  GPtrArray *measure_index; /**< the measurenodes of themeasures by position, built on demand by staff_nth_measure_node(), NULL when out of date */
   clef clef; /**< The initial clef see denemo_objects.h clefs */
   keysig keysig;
   timesig timesig;
@@ -334,6 +336,8 @@ typedef struct
   GList *verse_views;/**< a list of text editor widgets each containing a verse */
   GList *current_verse_view;/**< verse to be displayed */
   GList *verses;/**< gchar of the verses, synchronized with GtkTextView buffers */
+  GArray *syllable_marks;/**< syllable count and slur state at the start of each measure, built on demand by staff_syllables_before(), valid only as far as its length */
+  guint syllable_marks_changecount;/**< the changecount of the movement when syllable_marks were counted, they are discarded once it has moved on */
   gboolean hide_lyrics; /**< true if lyrics should not be typeset */
   gboolean hasfigures; /**<TRUE if the staff has had figures attached. Only one staff should have this set */
   gboolean hasfakechords; /**<TRUE if the staff has had chord symbols attached. Only one staff should have this set */
@@ -423,6 +427,10 @@ typedef struct command_row
   gchar* fallback;
   gchar* menupath;
   gchar* scheme;
+  gchar* scheme_file;/**< the file scheme was loaded from */
+  gint64 scheme_mtime;/**< modification times of scheme_file and of the init.scm beside it when scheme was loaded */
+  gint64 init_mtime;
+  gpointer procedure;/**< scheme compiled into a Guile procedure, the unpacked SCM value, NULL if not yet compiled */
 } command_row;
 
 typedef enum{
@@ -504,6 +512,7 @@ typedef struct DenemoPrefs
   gboolean hide_windows; /**< whether to hide windows when a modal dialog is active */
   gboolean enable_thumbnails;
   gboolean opensources; /**< whether to search and open source files in the first measure of newly opened scores */
+  gboolean project_cache; /**< whether to keep a binary cache of each score opened beside it, to open it faster next time, see projectcache.c */
   gboolean ignorescripts; /**< whether to execute Scheme embedded in files and initializations on file load*/
   gboolean disable_undo; /**< Do not collect undo information */
   gboolean saveparts; /**< Automatically save parts*/
@@ -787,6 +796,7 @@ typedef struct DenemoUndoData
 
   gpointer object;    /* pointer to object to be undone/redone */
   DenemoPosition position; /* position where delete/insert took place */
+  struct DenemoArena *arena; /* for ACTION_SNAPSHOT the arena holding object if it is a frozen movement, else NULL, see freeze_movement () */
 
 } DenemoUndoData;
 
@@ -817,7 +827,7 @@ typedef struct DenemoScoreblock {
   GString *lilypond;/**< text of the scoreblock */
   gboolean visible;/**< Whether the scoreblock should be used by default */
   gboolean layout_sync;/**< Value of project->layout_sync when the scoreblock was created */
-  GtkWidget *widget;/**< Widget to be placed in the Score Layout window for this scoreblock */
+  GtkWidget *widget;/**< Widget to be placed in the Score Layout window for this scoreblock, for standard scoreblocks its contents are only created when viewed */
   GList *staff_list;/**< List of staff frames contained in widget */
   gchar *name;/**< name for this scoreblock */
   gchar *uri;/**< uri for the output from printing this scoreblock */
@@ -1041,6 +1051,8 @@ typedef struct DenemoMovement
   GList *Instruments;
   GtkWidget *buttonbox;/*< box for buttons accessing DenemoDirectives attached to the this movement*/
   GtkWidget *lyricsbox;/*< box for notebooks containing verses of lyrics for the movement */
+  gboolean widgets_deferred;/*< TRUE while the verse views of this movement are not built, the verses being held only as text in staff->verses, see realize_movement() */
+  guint last_visit;/*< stamp of the last time this movement was displayed, used to evict the widgets of idle movements */
 } DenemoMovement;
 
 /**
@@ -1178,6 +1190,8 @@ struct cs_callback
 struct DenemoRoot
 {
   gboolean non_interactive; /* if TRUE denemo should not display project, receive or send sounds etc*/
+  gboolean batch; /* if TRUE denemo runs conversion jobs read from standard input, see run_batch_jobs() */
+  gint batch_workers; /* the number of processes to run batch jobs on, 0 for one per processor */
   gchar *scheme_file;/* filename for scheme code to run on startup */
   gchar *scheme_commands;/* scheme code to run on startup after scheme_file */
   /* Fields used fairly directly for drawing */
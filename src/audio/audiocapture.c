@@ -45,6 +45,7 @@
 #include <glib.h>
 #include "audio/audiocapture.h"
 #include "audio/audio.h"
+#include "audio/pitchtracker.h"
 #ifndef paNonInterleaved
 #undef PA_VERSION_19
 #else
@@ -406,18 +407,6 @@ error:
 
 /********************** code from accordeur ****************************/
 
-static int Autocorrelation (float mData[],      // In
-                            int mDataLen,       // In
-                            // int mWindowSize,    In
-                            float *processed[]  // Out
-                            //, int* mProcessedSize Out
-  );
-
-static float bestPeak2 (float *mProcessed,      // IN
-                        int mProcessedSize,     // IN
-                        float mRate     // IN
-  );
-
 static float Freq2Pitch (float freq);
 
 
@@ -498,7 +487,7 @@ determine_frequency (void)
       *average_abs += val;
     }
   *average_abs /= numSamples;
-  int gotSound = (numSamples > 0) && (*average_abs > 0) && Autocorrelation (data.recordedSamples, numSamples, &autocorr);
+  int gotSound = (numSamples > 0) && (*average_abs > 0) && pitch_tracker_autocorrelation (data.recordedSamples, numSamples, WindowSize, autocorr);
   /* Reset the frame index to 0, so we keep going with only new sound */
   data.frameIndex = 0;
   /* smooth the autocorrelation */
@@ -521,7 +510,7 @@ determine_frequency (void)
       double m_sample_rate = 44100.0;
       int lower = lround (m_sample_rate / PitchToFreq (Pitch - INTERVAL));      /* lowest allowed value of Pitch is 12 */
       int upper = lround (m_sample_rate / PitchToFreq (Pitch + INTERVAL));
-      double bestpeak_x = upper + bestPeak2 (&autocorr2[upper], lower - upper, m_sample_rate);
+      double bestpeak_x = upper + pitch_tracker_best_peak (&autocorr2[upper], lower - upper);
       double psd;
       for (psd = 0.0, i = upper; i < lower; i++)
         psd += autocorr[i];
@@ -549,332 +538,6 @@ determine_frequency (void)
 
 
 
-/**********************************************************************
-
-  from FFT.cpp  Dominic Mazzoni  September 2000
-**********************************************************************/
-#define	M_PI		3.14159265358979323846  /* pi */
-#define false 0
-#define true 1
-#define bool int
-static int **gFFTBitTable = NULL;
-static const int MaxFastBits = 16;
-
-static int
-IsPowerOfTwo (int x)
-{
-  if (x < 2)
-    return false;
-
-  if (x & (x - 1))              /* Thanks to 'byang' for this cute trick! */
-    return false;
-
-  return true;
-}
-
-static int
-NumberOfBitsNeeded (int PowerOfTwo)
-{
-  int i;
-
-  if (PowerOfTwo < 2)
-    {
-      fprintf (stderr, "Error: FFT called with size %d\n", PowerOfTwo);
-      exit (1);
-    }
-
-  for (i = 0;; i++)
-    if (PowerOfTwo & (1 << i))
-      return i;
-}
-
-static int
-ReverseBits (int index, int NumBits)
-{
-  int i, rev;
-
-  for (i = rev = 0; i < NumBits; i++)
-    {
-      rev = (rev << 1) | (index & 1);
-      index >>= 1;
-    }
-
-  return rev;
-}
-
-static void
-InitFFT ()
-{
-  gFFTBitTable = malloc (sizeof (int *) * MaxFastBits);
-
-  int len = 2;
-  int b;
-  for (b = 1; b <= MaxFastBits; b++)
-    {
-
-      gFFTBitTable[b - 1] = malloc (sizeof (int) * len);
-      int i;
-      for (i = 0; i < len; i++)
-        gFFTBitTable[b - 1][i] = ReverseBits (i, b);
-
-      len <<= 1;
-    }
-}
-
-static inline int
-FastReverseBits (int i, int NumBits)
-{
-  if (NumBits <= MaxFastBits)
-    return gFFTBitTable[NumBits - 1][i];
-  else
-    return ReverseBits (i, NumBits);
-}
-
-/*
- * Complex Fast Fourier Transform
- */
-
-static void
-FFT (int NumSamples, bool InverseTransform, float *RealIn, float *ImagIn, float *RealOut, float *ImagOut)
-{
-  int NumBits;                  /* Number of bits needed to store indices */
-  int i, j, k, n;
-  int BlockSize, BlockEnd;
-
-  double angle_numerator = 2.0 * M_PI;
-  float tr, ti;                 /* temp real, temp imaginary */
-
-  if (!IsPowerOfTwo (NumSamples))
-    {
-      fprintf (stderr, "%d is not a power of two\n", NumSamples);
-      exit (1);
-    }
-
-  if (!gFFTBitTable)
-    InitFFT ();
-
-  if (InverseTransform)
-    angle_numerator = -angle_numerator;
-
-  NumBits = NumberOfBitsNeeded (NumSamples);
-
-  /*
-   **   Do simultaneous data copy and bit-reversal ordering into outputs...
-   */
-
-  for (i = 0; i < NumSamples; i++)
-    {
-      j = FastReverseBits (i, NumBits);
-      RealOut[j] = RealIn[i];
-      ImagOut[j] = (ImagIn == NULL) ? 0.0 : ImagIn[i];
-    }
-
-  /*
-   **   Do the FFT itself...
-   */
-
-  BlockEnd = 1;
-  for (BlockSize = 2; BlockSize <= NumSamples; BlockSize <<= 1)
-    {
-
-      double delta_angle = angle_numerator / (double) BlockSize;
-
-      float sm2 = sin (-2 * delta_angle);
-      float sm1 = sin (-delta_angle);
-      float cm2 = cos (-2 * delta_angle);
-      float cm1 = cos (-delta_angle);
-      float w = 2 * cm1;
-      float ar0, ar1, ar2, ai0, ai1, ai2;
-
-      for (i = 0; i < NumSamples; i += BlockSize)
-        {
-          ar2 = cm2;
-          ar1 = cm1;
-
-          ai2 = sm2;
-          ai1 = sm1;
-
-          for (j = i, n = 0; n < BlockEnd; j++, n++)
-            {
-              ar0 = w * ar1 - ar2;
-              ar2 = ar1;
-              ar1 = ar0;
-
-              ai0 = w * ai1 - ai2;
-              ai2 = ai1;
-              ai1 = ai0;
-
-              k = j + BlockEnd;
-              tr = ar0 * RealOut[k] - ai0 * ImagOut[k];
-              ti = ar0 * ImagOut[k] + ai0 * RealOut[k];
-
-              RealOut[k] = RealOut[j] - tr;
-              ImagOut[k] = ImagOut[j] - ti;
-
-              RealOut[j] += tr;
-              ImagOut[j] += ti;
-            }
-        }
-
-      BlockEnd = BlockSize;
-    }
-
-  /*
-   **   Need to normalize if inverse transform...
-   */
-
-  if (InverseTransform)
-    {
-      float denom = (float) NumSamples;
-
-      for (i = 0; i < NumSamples; i++)
-        {
-          RealOut[i] /= denom;
-          ImagOut[i] /= denom;
-        }
-    }
-}
-
-/*
- * Windowing Functions
- */
-
-static void
-WindowFunc (int whichFunction, int NumSamples, float *in)
-{
-  int i;
-
-  if (whichFunction == 1)
-    {
-      // Bartlett (triangular) window
-      for (i = 0; i < NumSamples / 2; i++)
-        {
-          in[i] *= (i / (float) (NumSamples / 2));
-          in[i + (NumSamples / 2)] *= (1.0 - (i / (float) (NumSamples / 2)));
-        }
-    }
-
-  if (whichFunction == 2)
-    {
-      // Hamming
-      for (i = 0; i < NumSamples; i++)
-        in[i] *= 0.54 - 0.46 * cos (2 * M_PI * i / (NumSamples - 1));
-    }
-
-  if (whichFunction == 3)
-    {
-      // Hanning
-      for (i = 0; i < NumSamples; i++)
-        in[i] *= 0.50 - 0.50 * cos (2 * M_PI * i / (NumSamples - 1));
-    }
-}
-
-
-// This is Audacity's FreqWindow::Recalc(), but shaved down to
-//   1) be enhanced auto-correlation only
-//   2) take parameters, and return values.
-static bool
-Autocorrelation (float mData[], // In
-                 int mDataLen,  // In
-                 float *processed[]     // Out
-  )
-{
-  if (mDataLen < WindowSize)
-    {
-      // Not enough data to get even one window
-      return false;
-    }
-
-//   float *mProcessed = NULL;
-  float *mProcessed = *processed;
-
-//   mProcessed = new float[WindowSize];
-
-  int i;
-  for (i = 0; i < WindowSize; i++)
-    mProcessed[i] = 0.0;
-  int half = WindowSize / 2;
-
-  float *in = malloc (sizeof (float) * WindowSize);
-  float *out = malloc (sizeof (float) * WindowSize);
-  float *out2 = malloc (sizeof (float) * WindowSize);
-
-  int start = 0;
-  int windows = 0;
-  while (start + WindowSize <= mDataLen)
-    {
-      // Copy stuff into in
-      for (i = 0; i < WindowSize; i++)
-        in[i] = mData[start + i];
-
-      // Window the data to lose crazy artifacts
-      // due to finite-length window
-      WindowFunc (2 /* Hamming */ , WindowSize, in);
-
-      // Enhanced AC
-
-      // Take FFT
-      FFT (WindowSize, false, in, NULL, out, out2);
-
-      // Compute power
-      for (i = 0; i < WindowSize; i++)
-        in[i] = (out[i] * out[i]) + (out2[i] * out2[i]);
-
-      // Tolonen and Karjalainen recommend taking the cube root
-      // of the power, instead of the square root
-
-      for (i = 0; i < WindowSize; i++)
-        in[i] = pow (in[i], 1.0 / 3.0);
-
-      // Take FFT
-      FFT (WindowSize, false, in, NULL, out, out2);
-
-      // Take real part of result
-      for (i = 0; i < half; i++)
-        mProcessed[i] += out[i];
-
-      start += half;
-      windows++;
-    }
-
-  // Enhanced Autocorrelation
-  for (i = 0; i < half; i++)
-    mProcessed[i] = mProcessed[i] / windows;
-
-  // Peak Pruning as described by Tolonen and Karjalainen, 2000
-
-  // Clip at zero, copy to temp array
-  for (i = 0; i < half; i++)
-    {
-      if (mProcessed[i] < 0.0)
-        mProcessed[i] = 0.0;
-      out[i] = mProcessed[i];
-    }
-
-  // Subtract a time-doubled signal (linearly interp.) from the original
-  // (clipped) signal
-  for (i = 0; i < half; i++)
-    if ((i % 2) == 0)
-      mProcessed[i] -= out[i / 2];
-    else
-      mProcessed[i] -= ((out[i / 2] + out[i / 2 + 1]) / 2);
-
-  // Clip at zero again
-  for (i = 0; i < half; i++)
-    if (mProcessed[i] < 0.0)
-      mProcessed[i] = 0.0;
-
-  /*  *mProcessedSize = half; */
-
-  free (in);
-  free (out);
-  free (out2);
-
-//   *processed = mProcessed;
-
-  return true;
-}
-
 static float
 Freq2Pitch (float freq)
 {
@@ -928,74 +591,4 @@ CubicMaximize (float y0, float y1, float y2, float y3, float *maxyVal)
 
 #undef CUBIC
 }
-
-
-
-
-static float
-Parabole (float *y, int nb, float *maxyVal)
-{
-  int i;
-  float mx4 = 0, mx3 = 0, mx2 = 0, mx = 0;
-  float mx2y = 0, mxy = 0, my = 0;
-  float a, b, c;
-  float highX;
-  for (i = 0; i < nb; i++)
-    {
-      mx += i;
-      mx2 += i * i;
-      mx3 += i * i * i;
-      mx4 += i * i * i * i;
-      mxy += i * y[i];
-      mx2y += i * i * y[i];
-      my += y[i];
-    }
-  mx /= nb;
-  mx2 /= nb;
-  mx3 /= nb;
-  mx4 /= nb;
-  my /= nb;
-  mxy /= nb;
-  mx2y /= nb;
-  a = ((mx2y - mx2 * my) * (mx2 - mx * mx) - (mxy - mx * my) * (mx3 - mx2 * mx)) / ((mx4 - mx2 * mx2) * (mx2 - mx * mx) - (mx3 - mx * mx2) * (mx3 - mx * mx2));
-  b = (mxy - mx * my - a * (mx3 - mx * mx2)) / (mx2 - mx * mx);
-  c = my - a * mx2 - b * mx;
-  highX = (-b / (2 * a));
-  *maxyVal = a * highX * highX + b * highX + c;
-  return (-b / (2 * a));
-}
-
-static float
-bestPeak2 (float *mProcessed,   // IN
-           int mProcessedSize,  // IN
-           float mRate          // IN
-  )
-{
-  float highestpeak_y = 0;
-  int iMaxX = 0;
-  int bin;
-
-  bool up = (mProcessed[1] > mProcessed[0]);
-  for (bin = 2; bin < mProcessedSize; bin++)
-    {
-      bool nowUp = mProcessed[bin] > mProcessed[bin - 1];
-      if (!nowUp && up)
-        {
-          if (mProcessed[bin - 1] > highestpeak_y)
-            {
-              highestpeak_y = mProcessed[bin - 1];
-              iMaxX = bin - 1;
-            }
-        }
-      up = nowUp;
-    }
-  // cherche le pic par recherche de la parabole la plus proche.
-  int leftbin = iMaxX - 1;
-  while (leftbin > 1 && leftbin > (iMaxX - 20) && mProcessed[leftbin - 1] > mProcessed[iMaxX] / 2)
-    leftbin--;
-  int nb = (iMaxX - leftbin) * 2 + 1;
-  float thispeak_y;
-  float max = leftbin + Parabole (&mProcessed[leftbin], nb, &thispeak_y);
-  return max;
-}
 #endif
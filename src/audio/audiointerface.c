@@ -13,6 +13,8 @@
 
 #include "audio/audiointerface.h"
 #include "audio/eventqueue.h"
+#include "audio/audiotelemetry.h"
+#include "core/profile.h"
 #include "audio/dummybackend.h"
 #include "source/sourceaudio.h"
 #ifdef _HAVE_JACK_
@@ -235,6 +237,7 @@ audio_initialize (DenemoPrefs * config)
   queue_thread = NULL;
   quit_thread = FALSE;
   redraw_event = NULL;
+  audio_telemetry_reset ();
 
   //&queue_cond = g_cond_new (); since GLib 2.32 no longer needed, static declaration is enough
   //&queue_mutex = g_mutex_new (); since GLib 2.32 no longer needed, static declaration is enough
@@ -424,7 +427,20 @@ read_event_from_queue (backend_type_t backend, unsigned char *event_buffer, size
 gboolean
 read_event_from_mixer_queue (backend_type_t backend, unsigned char *event_buffer, size_t * event_length)
 {
-  return mixer_queue_read_output (get_event_queue (backend), event_buffer, event_length);
+  if (mixer_queue_read_output (get_event_queue (backend), event_buffer, event_length))
+    return TRUE;
+  if (audio_is_playing ())
+    audio_telemetry_mixer_underrun (backend);
+  return FALSE;
+}
+
+gint
+playback_queue_fill (backend_type_t backend)
+{
+  event_queue_t *queue = get_event_queue (backend);
+  if (queue == NULL || queue->playback == NULL)
+    return -1;
+  return jack_ringbuffer_read_space (queue->playback) / sizeof (smf_event_t *);
 }
 #ifdef _HAVE_RUBBERBAND_
 
@@ -483,6 +499,9 @@ queue_thread_func (gpointer data)
           g_mutex_unlock (&smfmutex);
         }
 
+      audio_telemetry_drain ();
+      profile_drain ();
+
       if (audio_is_playing ())
         {
           float sample[2];      //two channels assumed FIXME
@@ -675,7 +694,10 @@ play_midi_event (backend_type_t backend, int port, unsigned char *buffer)
   *ev = i;
   memcpy (ev + 1, buffer, i);//g_print (" midibytes 0x%hhX 0x%hhX 0x%hhX\n", *(buffer+0), *(buffer+1), *(buffer+2));
 
-  return event_queue_write_immediate (get_event_queue (backend), ev, i + 1);
+  if (event_queue_write_immediate (get_event_queue (backend), ev, i + 1))
+    return TRUE;
+  audio_telemetry_immediate_dropped (backend == DEFAULT_BACKEND ? AUDIO_BACKEND : backend);
+  return FALSE;
 }
 
 
@@ -230,6 +230,11 @@ int panic_all ();
  */
 gboolean read_event_from_queue (backend_type_t backend, unsigned char *event_buffer, size_t * event_length, double *event_time, double until_time);
 gboolean read_event_from_mixer_queue (backend_type_t backend, unsigned char *event_buffer, size_t * event_length);
+/**
+ * Called by a backend to find how many events are waiting in the playback
+ * queue, for the telemetry.
+ */
+gint playback_queue_fill (backend_type_t backend);
 #ifdef _HAVE_RUBBERBAND_
 gboolean read_event_from_rubberband_queue (backend_type_t backend, unsigned char *event_buffer, size_t * event_length);
 gboolean write_samples_to_rubberband_queue (backend_type_t backend, float *sample, gint len);
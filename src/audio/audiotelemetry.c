@@ -0,0 +1,413 @@
+/*
+ * audiotelemetry.c
+ * timing the audio callbacks of the backends and watching their queues: for
+ * each driver how long its callbacks take against the period they have, the
+ * xruns it reports, the events it dispatches and how full the playback queue
+ * is, the rubberband backlog, and the events and source audio the queues could
+ * not deliver. The callbacks only update counters atomically, and while a
+ * recording is made push a record of each call onto a ring buffer which the
+ * queue thread writes to the file.
+ *
+ * for Denemo, a gtk+ frontend to GNU Lilypond
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ */
+
+#include <stdio.h>
+#include <denemo/denemo.h>
+#include "audio/audiotelemetry.h"
+#include "audio/midi.h"
+#ifdef _HAVE_JACK_
+#include <jack/ringbuffer.h>
+#else
+#include "audio/ringbuffer.h"
+#endif
+
+/* histogram bucket n counts callbacks taking less than 2^n microseconds (and at least half that), the last any longer */
+#define TELEMETRY_BUCKETS (24)
+/* the callbacks that can be recorded between two wakings of the queue thread */
+#define TELEMETRY_RECORDS (1024)
+/* milliseconds between refreshes of the dialog */
+#define TELEMETRY_REFRESH (500)
+
+typedef struct TelemetryRecord
+{
+  gint64 start;                 /* microseconds since the recording started */
+  gint duration;                /* microseconds */
+  gint budget;                  /* microseconds of audio the callback was asked for */
+  gint frames;
+  gint events;
+  gint playback_fill;
+  gint rubberband_backlog;
+  gint xrun;
+} TelemetryRecord;
+
+/* everything here is written by the driver's callback and read by the other threads with g_atomic_int_get */
+typedef struct DriverTelemetry
+{
+  gint callbacks;
+  gint histogram[TELEMETRY_BUCKETS];
+  gint max_duration;            /* microseconds */
+  gint frames;                  /* of the last callback */
+  gint sample_rate;
+  gint overruns;                /* callbacks taking longer than the audio they produced */
+  gint xruns;
+  gint events;
+  gint playback_fill;           /* at the last callback, -1 if not known */
+  gint playback_low;            /* the lowest while playing, G_MAXINT if not playing */
+  gint ran_dry;                 /* callbacks finding the playback queue empty while playing */
+  gint rubberband_backlog;      /* at the last callback, -1 without rubberband */
+  gint rubberband_max;
+  gint records_lost;            /* not recorded because the queue thread had not written out the last ones */
+  jack_ringbuffer_t *records;   /* created with the first recording and kept */
+} DriverTelemetry;
+
+static const gchar *driver_names[NUM_TELEMETRY_DRIVERS] = { "jack", "portaudio" };
+static const gchar *backend_names[NUM_BACKENDS] = { "audio", "midi" };
+
+static DriverTelemetry drivers[NUM_TELEMETRY_DRIVERS];
+static gint immediate_dropped[NUM_BACKENDS];
+static gint mixer_underruns[NUM_BACKENDS];
+static gint64 reset_time;
+
+static gint recording;          /* TRUE while the callbacks should push records */
+static GMutex record_mutex;     /* guards what follows */
+static FILE *record_file;
+static gint64 record_start;
+
+static gint
+bucket (gint microseconds)
+{
+  gint n = 0;
+  while (n < TELEMETRY_BUCKETS - 1 && microseconds >= (1 << n))
+    n++;
+  return n;
+}
+
+static void
+atomic_max (gint * value, gint candidate)
+{
+  gint old;
+  do
+    {
+      old = g_atomic_int_get (value);
+      if (candidate <= old)
+        return;
+    }
+  while (!g_atomic_int_compare_and_exchange (value, old, candidate));
+}
+
+static void
+atomic_min (gint * value, gint candidate)
+{
+  gint old;
+  do
+    {
+      old = g_atomic_int_get (value);
+      if (candidate >= old)
+        return;
+    }
+  while (!g_atomic_int_compare_and_exchange (value, old, candidate));
+}
+
+void
+audio_telemetry_callback (telemetry_driver_t driver, const telemetry_callback_t * callback)
+{
+  DriverTelemetry *t = drivers + driver;
+  gint duration = (gint) (g_get_monotonic_time () - callback->start);
+  gint budget = callback->sample_rate ? (gint) ((gint64) callback->frames * G_USEC_PER_SEC / callback->sample_rate) : 0;
+  g_atomic_int_inc (&t->callbacks);
+  g_atomic_int_inc (t->histogram + bucket (duration));
+  atomic_max (&t->max_duration, duration);
+  g_atomic_int_set (&t->frames, callback->frames);
+  g_atomic_int_set (&t->sample_rate, callback->sample_rate);
+  if (budget && duration > budget)
+    g_atomic_int_inc (&t->overruns);
+  if (callback->xrun)
+    g_atomic_int_inc (&t->xruns);
+  g_atomic_int_add (&t->events, callback->events);
+  g_atomic_int_set (&t->playback_fill, callback->playback_fill);
+  if (callback->playback_fill >= 0 && is_playing ())
+    {
+      atomic_min (&t->playback_low, callback->playback_fill);
+      if (callback->playback_fill == 0)
+        g_atomic_int_inc (&t->ran_dry);
+    }
+  g_atomic_int_set (&t->rubberband_backlog, callback->rubberband_backlog);
+  atomic_max (&t->rubberband_max, callback->rubberband_backlog);
+  if (g_atomic_int_get (&recording))
+    {
+      TelemetryRecord record;
+      if (jack_ringbuffer_write_space (t->records) < sizeof (record))
+        {
+          g_atomic_int_inc (&t->records_lost);
+          return;
+        }
+      record.start = callback->start - record_start;
+      record.duration = duration;
+      record.budget = budget;
+      record.frames = callback->frames;
+      record.events = callback->events;
+      record.playback_fill = callback->playback_fill;
+      record.rubberband_backlog = callback->rubberband_backlog;
+      record.xrun = callback->xrun;
+      jack_ringbuffer_write (t->records, (const char *) &record, sizeof (record));
+    }
+}
+
+void
+audio_telemetry_xrun (telemetry_driver_t driver)
+{
+  g_atomic_int_inc (&drivers[driver].xruns);
+}
+
+void
+audio_telemetry_mixer_underrun (backend_type_t backend)
+{
+  g_atomic_int_inc (mixer_underruns + backend);
+}
+
+void
+audio_telemetry_immediate_dropped (backend_type_t backend)
+{
+  g_atomic_int_inc (immediate_dropped + backend);
+}
+
+/* write out the records waiting, must hold record_mutex */
+static void
+drain_records (void)
+{
+  gint driver;
+  for (driver = 0; driver < NUM_TELEMETRY_DRIVERS; driver++)
+    {
+      jack_ringbuffer_t *records = drivers[driver].records;
+      TelemetryRecord record;
+      if (records == NULL)
+        continue;
+      while (jack_ringbuffer_read_space (records) >= sizeof (record))
+        {
+          jack_ringbuffer_read (records, (char *) &record, sizeof (record));
+          if (record_file)
+            fprintf (record_file, "%.6f\t%s\t%d\t%d\t%d\t%d\t%d\t%d\t%d\n", record.start / (double) G_USEC_PER_SEC, driver_names[driver],
+                     record.duration, record.budget, record.frames, record.events, record.playback_fill, record.rubberband_backlog, record.xrun);
+        }
+    }
+}
+
+void
+audio_telemetry_drain (void)
+{
+  if (!g_atomic_int_get (&recording))
+    return;
+  g_mutex_lock (&record_mutex);
+  drain_records ();
+  g_mutex_unlock (&record_mutex);
+}
+
+gboolean
+audio_telemetry_record (const gchar * filename)
+{
+  gboolean ret = TRUE;
+  gint driver;
+  g_mutex_lock (&record_mutex);
+  g_atomic_int_set (&recording, FALSE);
+  if (record_file)
+    {
+      drain_records ();
+      fclose (record_file);
+      record_file = NULL;
+    }
+  if (filename)
+    {
+      record_file = fopen (filename, "w");
+      if (record_file == NULL)
+        {
+          g_warning ("Could not open %s for the audio telemetry", filename);
+          ret = FALSE;
+        }
+      else
+        {
+          fprintf (record_file, "# seconds\tdriver\tduration_us\tperiod_us\tframes\tevents\tplayback_fill\trubberband_backlog\txrun\n");
+          for (driver = 0; driver < NUM_TELEMETRY_DRIVERS; driver++)
+            if (drivers[driver].records == NULL)
+              drivers[driver].records = jack_ringbuffer_create (TELEMETRY_RECORDS * sizeof (TelemetryRecord));
+            else                //records left by a callback that began before the last recording stopped
+              jack_ringbuffer_read_advance (drivers[driver].records, jack_ringbuffer_read_space (drivers[driver].records));
+          record_start = g_get_monotonic_time ();
+          g_atomic_int_set (&recording, TRUE);
+        }
+    }
+  g_mutex_unlock (&record_mutex);
+  return ret;
+}
+
+void
+audio_telemetry_reset (void)
+{
+  gint driver, n;
+  for (driver = 0; driver < NUM_TELEMETRY_DRIVERS; driver++)
+    {
+      DriverTelemetry *t = drivers + driver;
+      g_atomic_int_set (&t->callbacks, 0);
+      for (n = 0; n < TELEMETRY_BUCKETS; n++)
+        g_atomic_int_set (t->histogram + n, 0);
+      g_atomic_int_set (&t->max_duration, 0);
+      g_atomic_int_set (&t->overruns, 0);
+      g_atomic_int_set (&t->xruns, 0);
+      g_atomic_int_set (&t->events, 0);
+      g_atomic_int_set (&t->playback_fill, -1);
+      g_atomic_int_set (&t->playback_low, G_MAXINT);
+      g_atomic_int_set (&t->ran_dry, 0);
+      g_atomic_int_set (&t->rubberband_backlog, -1);
+      g_atomic_int_set (&t->rubberband_max, -1);
+      g_atomic_int_set (&t->records_lost, 0);
+    }
+  for (n = 0; n < NUM_BACKENDS; n++)
+    {
+      g_atomic_int_set (immediate_dropped + n, 0);
+      g_atomic_int_set (mixer_underruns + n, 0);
+    }
+  reset_time = g_get_monotonic_time ();
+}
+
+static void
+append_bucket (GString * text, gint n)
+{
+  if (n == TELEMETRY_BUCKETS - 1)
+    g_string_append_printf (text, ">=%dus", 1 << (n - 1));
+  else
+    g_string_append_printf (text, "<%dus", 1 << n);
+}
+
+/* append the bucket within which the given fraction of the callbacks ended */
+static void
+append_percentile (GString * text, const gchar * label, gint * histogram, gint callbacks, gdouble fraction)
+{
+  gint n, count = 0;
+  for (n = 0; n < TELEMETRY_BUCKETS - 1; n++)
+    if ((count += histogram[n]) >= fraction * callbacks)
+      break;
+  g_string_append_printf (text, " %s ", label);
+  append_bucket (text, n);
+}
+
+static void
+append_driver (GString * text, gint driver)
+{
+  DriverTelemetry *t = drivers + driver;
+  gint histogram[TELEMETRY_BUCKETS];
+  gint callbacks = g_atomic_int_get (&t->callbacks);
+  gint frames = g_atomic_int_get (&t->frames);
+  gint sample_rate = g_atomic_int_get (&t->sample_rate);
+  gint playback_fill = g_atomic_int_get (&t->playback_fill);
+  gint playback_low = g_atomic_int_get (&t->playback_low);
+  gint rubberband_backlog = g_atomic_int_get (&t->rubberband_backlog);
+  gint n;
+  if (callbacks == 0)
+    {
+      g_string_append_printf (text, "%s: no callbacks\n", driver_names[driver]);
+      return;
+    }
+  for (n = 0; n < TELEMETRY_BUCKETS; n++)
+    histogram[n] = g_atomic_int_get (t->histogram + n);
+  g_string_append_printf (text, "%s: %d callbacks of %d frames at %d Hz", driver_names[driver], callbacks, frames, sample_rate);
+  if (sample_rate)
+    g_string_append_printf (text, " (period %dus)", (gint) ((gint64) frames * G_USEC_PER_SEC / sample_rate));
+  g_string_append (text, "\n    duration:");
+  append_percentile (text, "50%", histogram, callbacks, 0.5);
+  append_percentile (text, "90%", histogram, callbacks, 0.9);
+  append_percentile (text, "99%", histogram, callbacks, 0.99);
+  append_percentile (text, "99.9%", histogram, callbacks, 0.999);
+  g_string_append_printf (text, " max %dus\n    histogram:", g_atomic_int_get (&t->max_duration));
+  for (n = 0; n < TELEMETRY_BUCKETS; n++)
+    if (histogram[n])
+      {
+        g_string_append_c (text, ' ');
+        append_bucket (text, n);
+        g_string_append_printf (text, ":%d", histogram[n]);
+      }
+  g_string_append_printf (text, "\n    longer than the period: %d, xruns: %d, events dispatched: %d\n",
+                          g_atomic_int_get (&t->overruns), g_atomic_int_get (&t->xruns), g_atomic_int_get (&t->events));
+  if (playback_fill >= 0)
+    {
+      g_string_append_printf (text, "    playback queue: %d events waiting", playback_fill);
+      if (playback_low != G_MAXINT)
+        g_string_append_printf (text, ", fewest while playing %d, empty while playing %d times", playback_low, g_atomic_int_get (&t->ran_dry));
+      g_string_append_c (text, '\n');
+    }
+  if (rubberband_backlog >= 0)
+    g_string_append_printf (text, "    rubberband backlog: %d frames, at most %d\n", rubberband_backlog, g_atomic_int_get (&t->rubberband_max));
+  if (g_atomic_int_get (&t->records_lost))
+    g_string_append_printf (text, "    %d callbacks were not recorded\n", g_atomic_int_get (&t->records_lost));
+}
+
+gchar *
+audio_telemetry_report (void)
+{
+  GString *text = g_string_new ("");
+  gint n;
+  if (reset_time == 0)
+    audio_telemetry_reset ();
+  g_string_append_printf (text, "Audio telemetry over %.1f seconds\n", (g_get_monotonic_time () - reset_time) / (double) G_USEC_PER_SEC);
+  for (n = 0; n < NUM_TELEMETRY_DRIVERS; n++)
+    append_driver (text, n);
+  for (n = 0; n < NUM_BACKENDS; n++)
+    g_string_append_printf (text, "%s queue: %d immediate events dropped, %d source audio underruns\n", backend_names[n],
+                            g_atomic_int_get (immediate_dropped + n), g_atomic_int_get (mixer_underruns + n));
+  if (g_atomic_int_get (&recording))
+    g_string_append (text, "Recording each callback\n");
+  return g_string_free (text, FALSE);
+}
+
+static GtkWidget *dialog;
+static guint refresh_id;
+
+static gboolean
+refresh_dialog (GtkWidget * label)
+{
+  gchar *report = audio_telemetry_report ();
+  gchar *markup = g_markup_printf_escaped ("<tt>%s</tt>", report);
+  gtk_label_set_markup (GTK_LABEL (label), markup);
+  g_free (markup);
+  g_free (report);
+  return TRUE;
+}
+
+#define TELEMETRY_RESPONSE_RESET (1)
+
+static void
+dialog_response (GtkWidget * widget, gint response, GtkWidget * label)
+{
+  if (response == TELEMETRY_RESPONSE_RESET)
+    {
+      audio_telemetry_reset ();
+      refresh_dialog (label);
+      return;
+    }
+  g_source_remove (refresh_id);
+  gtk_widget_destroy (dialog);
+  dialog = NULL;
+}
+
+void
+audio_telemetry_dialog (void)
+{
+  GtkWidget *label;
+  if (dialog)
+    {
+      gtk_window_present (GTK_WINDOW (dialog));
+      return;
+    }
+  dialog = gtk_dialog_new_with_buttons (_("Audio Diagnostics"), GTK_WINDOW (Denemo.window), GTK_DIALOG_DESTROY_WITH_PARENT,
+                                        _("Reset"), TELEMETRY_RESPONSE_RESET, _("Close"), GTK_RESPONSE_CLOSE, NULL);
+  label = gtk_label_new ("");
+  gtk_label_set_selectable (GTK_LABEL (label), TRUE);
+  gtk_box_pack_start (GTK_BOX (gtk_dialog_get_content_area (GTK_DIALOG (dialog))), label, TRUE, TRUE, 0);
+  refresh_dialog (label);
+  refresh_id = g_timeout_add (TELEMETRY_REFRESH, (GSourceFunc) refresh_dialog, label);
+  g_signal_connect (dialog, "response", G_CALLBACK (dialog_response), label);
+  gtk_widget_show_all (dialog);
+}
@@ -0,0 +1,95 @@
+/*
+ * audiotelemetry.h
+ * timing the audio callbacks of the backends and watching their queues,
+ * see d-AudioTelemetry
+ *
+ * for Denemo, a gtk+ frontend to GNU Lilypond
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ */
+
+#ifndef AUDIOTELEMETRY_H
+#define AUDIOTELEMETRY_H
+
+#include <glib.h>
+#include "audio/audiointerface.h"
+
+/**
+ * The drivers whose callbacks are timed.
+ */
+typedef enum telemetry_driver_t
+{
+  TELEMETRY_JACK = 0,
+  TELEMETRY_PORTAUDIO = 1,
+  NUM_TELEMETRY_DRIVERS = 2
+} telemetry_driver_t;
+
+/**
+ * What a callback did, passed to audio_telemetry_callback() as it returns.
+ */
+typedef struct telemetry_callback_t
+{
+  gint64 start;                 /* g_get_monotonic_time() on entering the callback */
+  guint frames;                 /* the frames the callback was asked for */
+  guint sample_rate;
+  guint events;                 /* MIDI events dispatched to the synth or the ports */
+  gint playback_fill;           /* events waiting in the playback queue, -1 if not known */
+  gint rubberband_backlog;      /* frames stretched but not yet played, -1 without rubberband */
+  gboolean xrun;                /* the driver reported an under- or overrun with this callback */
+} telemetry_callback_t;
+
+/* Called from the audio callbacks, these take no locks and do not allocate */
+
+/**
+ * Records a callback of driver, ending now.
+ */
+void audio_telemetry_callback (telemetry_driver_t driver, const telemetry_callback_t * callback);
+
+/**
+ * Records an xrun the driver reported apart from a callback.
+ */
+void audio_telemetry_xrun (telemetry_driver_t driver);
+
+/**
+ * Records that source audio was wanted for mixing but there was not enough in the mixer queue.
+ */
+void audio_telemetry_mixer_underrun (backend_type_t backend);
+
+/* Called from the other threads */
+
+/**
+ * Records an event for immediate output that did not fit in the queue.
+ */
+void audio_telemetry_immediate_dropped (backend_type_t backend);
+
+/**
+ * Writes the records of the callbacks made since the last call to the file given to
+ * audio_telemetry_record(). Called by the queue thread.
+ */
+void audio_telemetry_drain (void);
+
+/**
+ * Starts writing a line for each callback to filename, or stops if filename is NULL.
+ * Returns FALSE if the file could not be opened.
+ */
+gboolean audio_telemetry_record (const gchar * filename);
+
+/**
+ * Forgets the telemetry collected so far.
+ */
+void audio_telemetry_reset (void);
+
+/**
+ * A description of the telemetry collected so far, caller must g_free.
+ */
+gchar *audio_telemetry_report (void);
+
+/**
+ * Shows the telemetry in a dialog which is refreshed while it is open.
+ */
+void audio_telemetry_dialog (void);
+
+#endif // AUDIOTELEMETRY_H
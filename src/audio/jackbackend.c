@@ -15,6 +15,8 @@
 #include "audio/jackbackend.h"
 #include "audio/midi.h"
 #include "audio/fluid.h"
+#include "audio/audiotelemetry.h"
+#include "core/profile.h"
 #include <jack/jack.h>
 #include <jack/midiport.h>
 #include <glib.h>
@@ -62,10 +64,12 @@ seconds_to_nframes (double seconds)
 }
 
 
-static void
+// returns the number of events passed to the synth
+static guint
 process_audio (nframes_t nframes)
 {
   size_t i;
+  guint events = 0;
   sample_t *port_buffers[num_audio_out_ports];
 
   for (i = 0; i < num_audio_out_ports; ++i)
@@ -80,7 +84,7 @@ process_audio (nframes_t nframes)
     {
       fluidsynth_all_notes_off ();
       reset_audio = FALSE;
-      return;
+      return 0;
     }
 
   unsigned char event_data[3];
@@ -93,6 +97,7 @@ process_audio (nframes_t nframes)
     {
       // FIXME: we can't pass an exact frame/time to fluidsynth, can we...?
       fluidsynth_feed_midi (event_data, event_length);
+      events++;
     }
 
 
@@ -100,6 +105,7 @@ process_audio (nframes_t nframes)
 
   fluidsynth_render_audio (nframes, port_buffers[0], port_buffers[1]);
 #endif
+  return events;
 }
 
 
@@ -125,10 +131,12 @@ process_midi_input (nframes_t nframes)
 }
 
 
-static void
+// returns the number of events written to the ports
+static guint
 process_midi_output (nframes_t nframes)
 {
   size_t i;
+  guint events = 0;
   void *port_buffers[num_midi_out_ports];
 
   for (i = 0; i < num_midi_out_ports; ++i)
@@ -153,7 +161,7 @@ process_midi_output (nframes_t nframes)
 
       reset_midi = FALSE;
 
-      return;
+      return 0;
     }
 
   unsigned char event_data[3];
@@ -176,7 +184,9 @@ process_midi_output (nframes_t nframes)
 
       // FIXME: use correct port
       jack_midi_event_write (port_buffers[0], frame, event_data, event_length);
+      events++;
     }
+  return events;
 }
 
 
@@ -185,14 +195,19 @@ process_midi_output (nframes_t nframes)
 static int
 process_callback (nframes_t nframes, void *arg)
 {
+  telemetry_callback_t telemetry = { g_get_monotonic_time (), nframes, jack_get_sample_rate (client), 0, -1, -1, FALSE };
+  PROFILE_BEGIN_REALTIME (mark, "jack process_callback");
   if (g_atomic_int_get (&audio_initialized))
     {
-      process_audio (nframes);
+      telemetry.events += process_audio (nframes);
+      telemetry.playback_fill = playback_queue_fill (AUDIO_BACKEND);
     }
   if (g_atomic_int_get (&midi_initialized))
     {
       process_midi_input (nframes);
-      process_midi_output (nframes);
+      telemetry.events += process_midi_output (nframes);
+      if (telemetry.playback_fill < 0)
+        telemetry.playback_fill = playback_queue_fill (MIDI_BACKEND);
     }
 
   if (is_playing ())
@@ -202,6 +217,16 @@ process_callback (nframes_t nframes, void *arg)
       update_playback_time (TIMEBASE_PRIO_AUDIO, nframes_to_seconds (playback_frame));
     }
 
+  PROFILE_END (mark);
+  audio_telemetry_callback (TELEMETRY_JACK, &telemetry);
+  return 0;
+}
+
+
+static int
+xrun_callback (void *arg)
+{
+  audio_telemetry_xrun (TELEMETRY_JACK);
   return 0;
 }
 
@@ -233,6 +258,7 @@ initialize_client (char const *name)
     }
 
   jack_set_process_callback (client, &process_callback, NULL);
+  jack_set_xrun_callback (client, &xrun_callback, NULL);
   jack_on_shutdown (client, &shutdown_callback, NULL);
 
   if (jack_activate (client))
@@ -0,0 +1,290 @@
+/* pitchtracker.c
+ * enhanced autocorrelation of audio input, used to measure the pitch of a note being tuned, see audiocapture.c
+ *
+ * The autocorrelation is Audacity's FreqWindow::Recalc() by way of accordeur, shaved down to
+ * be enhanced auto-correlation only. The FFT is derived from Audacity's FFT.cpp (Dominic Mazzoni, September 2000),
+ * computing the transform of a real window as a complex transform of half the size. Everything that depends
+ * only on the window size (bit reversal, twiddle factors, the Hamming window and work space) is computed
+ * once per size and kept, as determine_frequency() runs continuously while tuning.
+ *
+ * for Denemo, a gtk+ frontend to GNU Lilypond
+ */
+#include <math.h>
+#include <string.h>
+#include "audio/pitchtracker.h"
+
+#define MAX_FFT_BITS (16)       /* windows of up to 65536 samples */
+
+/* the tables and work space for windows of one size */
+typedef struct FFTPlan
+{
+  gint size;                    /* samples in a window, a power of two */
+  gint *bitrev;                 /* bit reversed indexes for the size/2 point complex transform */
+  gfloat *costable;             /* cos (2 pi k/size) for k < size/2 */
+  gfloat *sintable;             /* -sin (2 pi k/size) for k < size/2 */
+  gfloat *window;               /* the Hamming window */
+  gfloat *in;                   /* size values */
+  gfloat *re, *im;              /* size/2 + 1 values each */
+  gfloat *acc;                  /* size/2 + 1 values */
+} FFTPlan;
+
+static FFTPlan *Plans[MAX_FFT_BITS + 1];
+
+static gint
+number_of_bits (gint size)
+{
+  gint bits = 0;
+  while ((1 << bits) < size)
+    bits++;
+  return bits;
+}
+
+static gint
+reverse_bits (gint index, gint numbits)
+{
+  gint i, rev;
+  for (i = rev = 0; i < numbits; i++)
+    {
+      rev = (rev << 1) | (index & 1);
+      index >>= 1;
+    }
+  return rev;
+}
+
+/* return the plan for windows of size samples, creating it on first use, or NULL if size is not a usable power of two */
+static FFTPlan *
+get_plan (gint size)
+{
+  gint bits = number_of_bits (size);
+  FFTPlan *plan;
+  gint half = size / 2, k;
+  if ((size < 4) || (size != (1 << bits)) || (bits > MAX_FFT_BITS))
+    return NULL;
+  if (Plans[bits])
+    return Plans[bits];
+  plan = (FFTPlan *) g_malloc (sizeof (FFTPlan));
+  plan->size = size;
+  plan->bitrev = (gint *) g_malloc (half * sizeof (gint));
+  for (k = 0; k < half; k++)
+    plan->bitrev[k] = reverse_bits (k, bits - 1);
+  plan->costable = (gfloat *) g_malloc (half * sizeof (gfloat));
+  plan->sintable = (gfloat *) g_malloc (half * sizeof (gfloat));
+  for (k = 0; k < half; k++)
+    {
+      plan->costable[k] = cos (2 * G_PI * k / size);
+      plan->sintable[k] = -sin (2 * G_PI * k / size);
+    }
+  plan->window = (gfloat *) g_malloc (size * sizeof (gfloat));
+  for (k = 0; k < size; k++)
+    plan->window[k] = 0.54 - 0.46 * cos (2 * G_PI * k / (size - 1));
+  plan->in = (gfloat *) g_malloc (size * sizeof (gfloat));
+  plan->re = (gfloat *) g_malloc ((half + 1) * sizeof (gfloat));
+  plan->im = (gfloat *) g_malloc ((half + 1) * sizeof (gfloat));
+  plan->acc = (gfloat *) g_malloc ((half + 1) * sizeof (gfloat));
+  Plans[bits] = plan;
+  return plan;
+}
+
+/* in place forward transform of the plan->size/2 complex values re, im */
+static void
+complex_fft (FFTPlan * plan, gfloat * re, gfloat * im)
+{
+  gint n = plan->size / 2;
+  gint i, j, blocksize;
+  for (i = 0; i < n; i++)
+    {
+      j = plan->bitrev[i];
+      if (j > i)
+        {
+          gfloat t = re[i];
+          re[i] = re[j];
+          re[j] = t;
+          t = im[i];
+          im[i] = im[j];
+          im[j] = t;
+        }
+    }
+  for (blocksize = 2; blocksize <= n; blocksize <<= 1)
+    {
+      gint blockend = blocksize / 2;
+      gint step = plan->size / blocksize;       /* stride through the twiddle tables */
+      for (i = 0; i < n; i += blocksize)
+        for (j = 0; j < blockend; j++)
+          {
+            gfloat wr = plan->costable[j * step];
+            gfloat wi = plan->sintable[j * step];
+            gint a = i + j, b = a + blockend;
+            gfloat tr = wr * re[b] - wi * im[b];
+            gfloat ti = wr * im[b] + wi * re[b];
+            re[b] = re[a] - tr;
+            im[b] = im[a] - ti;
+            re[a] += tr;
+            im[a] += ti;
+          }
+    }
+}
+
+/* transform the plan->size real values in, leaving bins 0 to size/2 in plan->re, plan->im
+ * (the remaining bins of a real input are their complex conjugates) */
+static void
+real_fft (FFTPlan * plan, const gfloat * in)
+{
+  gint n = plan->size / 2;
+  gfloat *re = plan->re, *im = plan->im;
+  gfloat re0, im0;
+  gint k;
+  /* pack the even samples as real and odd as imaginary parts of half as many complex values */
+  for (k = 0; k < n; k++)
+    {
+      re[k] = in[2 * k];
+      im[k] = in[2 * k + 1];
+    }
+  complex_fft (plan, re, im);
+  /* separate the transforms of the even and odd samples and combine them, working inwards in pairs k, n - k */
+  re0 = re[0];
+  im0 = im[0];
+  for (k = 1; k <= n / 2; k++)
+    {
+      gint m = n - k;
+      gfloat a = re[k], b = im[k], c = re[m], d = im[m];
+      gfloat er = (a + c) / 2, ei = (b - d) / 2;        /* transform of the even samples at k */
+      gfloat orr = (b + d) / 2, oi = (c - a) / 2;       /* transform of the odd samples at k */
+      gfloat wr = plan->costable[k], wi = plan->sintable[k];
+      re[k] = er + wr * orr - wi * oi;
+      im[k] = ei + wr * oi + wi * orr;
+      if (m != k)
+        {                       /* at n - k the even and odd transforms are the conjugates of those at k */
+          wr = plan->costable[m];
+          wi = plan->sintable[m];
+          re[m] = er + wr * orr + wi * oi;
+          im[m] = -ei + wi * orr - wr * oi;
+        }
+    }
+  re[0] = re0 + im0;
+  im[0] = 0.0;
+  re[n] = re0 - im0;
+  im[n] = 0.0;
+}
+
+gboolean
+pitch_tracker_autocorrelation (const gfloat * data, gint datalen, gint windowsize, gfloat * processed)
+{
+  FFTPlan *plan;
+  gfloat *in, *re, *im, *acc;
+  gint i, start, windows = 0;
+  gint half = windowsize / 2;
+  if (datalen < windowsize)
+    return FALSE;               // Not enough data to get even one window
+  plan = get_plan (windowsize);
+  if (plan == NULL)
+    {
+      g_warning ("Pitch tracking window %d is not a power of two", windowsize);
+      return FALSE;
+    }
+  in = plan->in;
+  re = plan->re;
+  im = plan->im;
+  acc = plan->acc;
+  memset (processed, 0, windowsize * sizeof (gfloat));
+  memset (acc, 0, (half + 1) * sizeof (gfloat));
+  for (start = 0; start + windowsize <= datalen; start += half, windows++)
+    {
+      // Window the data to lose crazy artifacts due to finite-length window
+      for (i = 0; i < windowsize; i++)
+        in[i] = data[start + i] * plan->window[i];
+      real_fft (plan, in);
+      // Compute power, then, as Tolonen and Karjalainen recommend, take the cube root of it instead of the square root
+      for (i = 0; i <= half; i++)
+        in[i] = re[i] * re[i] + im[i] * im[i];
+      for (i = 0; i <= half; i++)
+        in[i] = cbrtf (in[i]);
+      // The spectrum of a real window is symmetric, so its transform is real
+      for (i = 1; i < half; i++)
+        in[windowsize - i] = in[i];
+      real_fft (plan, in);
+      for (i = 0; i < half; i++)
+        acc[i] += re[i];
+    }
+
+  // Enhanced Autocorrelation, clipped at zero
+  for (i = 0; i < half; i++)
+    {
+      gfloat v = acc[i] / windows;
+      acc[i] = v > 0.0 ? v : 0.0;
+    }
+  acc[half] = 0.0;
+
+  // Peak Pruning as described by Tolonen and Karjalainen, 2000
+  // Subtract a time-doubled signal (linearly interp.) from the original (clipped) signal and clip at zero again
+  for (i = 0; i < half; i += 2)
+    processed[i] = acc[i] - acc[i / 2];
+  for (i = 1; i < half; i += 2)
+    processed[i] = acc[i] - (acc[i / 2] + acc[i / 2 + 1]) / 2;
+  for (i = 0; i < half; i++)
+    processed[i] = processed[i] > 0.0 ? processed[i] : 0.0;
+  return TRUE;
+}
+
+static gfloat
+Parabole (gfloat * y, gint nb, gfloat * maxyVal)
+{
+  gint i;
+  gfloat mx4 = 0, mx3 = 0, mx2 = 0, mx = 0;
+  gfloat mx2y = 0, mxy = 0, my = 0;
+  gfloat a, b, c;
+  gfloat highX;
+  for (i = 0; i < nb; i++)
+    {
+      mx += i;
+      mx2 += i * i;
+      mx3 += i * i * i;
+      mx4 += i * i * i * i;
+      mxy += i * y[i];
+      mx2y += i * i * y[i];
+      my += y[i];
+    }
+  mx /= nb;
+  mx2 /= nb;
+  mx3 /= nb;
+  mx4 /= nb;
+  my /= nb;
+  mxy /= nb;
+  mx2y /= nb;
+  a = ((mx2y - mx2 * my) * (mx2 - mx * mx) - (mxy - mx * my) * (mx3 - mx2 * mx)) / ((mx4 - mx2 * mx2) * (mx2 - mx * mx) - (mx3 - mx * mx2) * (mx3 - mx * mx2));
+  b = (mxy - mx * my - a * (mx3 - mx * mx2)) / (mx2 - mx * mx);
+  c = my - a * mx2 - b * mx;
+  highX = (-b / (2 * a));
+  *maxyVal = a * highX * highX + b * highX + c;
+  return (-b / (2 * a));
+}
+
+gfloat
+pitch_tracker_best_peak (gfloat * mProcessed, gint mProcessedSize)
+{
+  gfloat highestpeak_y = 0;
+  gint iMaxX = 0;
+  gint bin;
+
+  gboolean up = (mProcessed[1] > mProcessed[0]);
+  for (bin = 2; bin < mProcessedSize; bin++)
+    {
+      gboolean nowUp = mProcessed[bin] > mProcessed[bin - 1];
+      if (!nowUp && up)
+        {
+          if (mProcessed[bin - 1] > highestpeak_y)
+            {
+              highestpeak_y = mProcessed[bin - 1];
+              iMaxX = bin - 1;
+            }
+        }
+      up = nowUp;
+    }
+  // cherche le pic par recherche de la parabole la plus proche.
+  gint leftbin = iMaxX - 1;
+  while (leftbin > 1 && leftbin > (iMaxX - 20) && mProcessed[leftbin - 1] > mProcessed[iMaxX] / 2)
+    leftbin--;
+  gint nb = (iMaxX - leftbin) * 2 + 1;
+  gfloat thispeak_y;
+  gfloat max = leftbin + Parabole (&mProcessed[leftbin], nb, &thispeak_y);
+  return max;
+}
@@ -0,0 +1,17 @@
+/* pitchtracker.h
+ * enhanced autocorrelation of audio input, used to measure the pitch of a note being tuned
+ *
+ * for Denemo, a gtk+ frontend to GNU Lilypond
+ */
+#ifndef PITCHTRACKER_H
+#define PITCHTRACKER_H
+
+#include <glib.h>
+
+/* accumulate the pruned enhanced autocorrelation of data over half-overlapping windows of windowsize samples
+   (a power of two) into processed, which must hold windowsize values. Returns FALSE if data is shorter than one window. */
+gboolean pitch_tracker_autocorrelation (const gfloat * data, gint datalen, gint windowsize, gfloat * processed);
+/* return the position, in samples, of the highest peak among the first size values of processed, interpolated between samples */
+gfloat pitch_tracker_best_peak (gfloat * processed, gint size);
+
+#endif //PITCHTRACKER_H
@@ -20,12 +20,14 @@
 #include "audio/midi.h"
 #include "audio/fluid.h"
 #include "audio/audiointerface.h"
+#include "audio/audiotelemetry.h"
 
 #include <portaudio.h>
 #include <glib.h>
 #include <string.h>
 #include "export/audiofile.h"
 #include "core/utils.h"
+#include "core/profile.h"
 
 static PaStream *stream;
 static unsigned long sample_rate;
@@ -140,7 +142,7 @@ static void record_audio(float ** buffers, unsigned long frames_per_buffer){
 }
 
 static int
-stream_callback (const void *input_buffer, void *output_buffer, unsigned long frames_per_buffer, const PaStreamCallbackTimeInfo * time_info, PaStreamCallbackFlags status_flags, void *user_data)
+stream_callback (const void *input_buffer, void *output_buffer, unsigned long frames_per_buffer, const PaStreamCallbackTimeInfo * time_info, PaStreamCallbackFlags status_flags, telemetry_callback_t * telemetry)
 {
   float **buffers = (float **) output_buffer;
 #ifdef _HAVE_RUBBERBAND_
@@ -182,6 +184,7 @@ if((!rubberband_active) || (available < (gint)frames_per_buffer)) {
   while (read_event_from_queue (AUDIO_BACKEND, event_data, &event_length, &event_time, until_time/slowdown))
     {//g_print("%x %x %x\n", event_data[0], event_data[1], event_data[2] );
       fluidsynth_feed_midi (event_data, event_length);  //in fluid.c note fluidsynth api ues fluid_synth_xxx these naming conventions are a bit too similar
+      telemetry->events++;
     }
 
   fluidsynth_render_audio (frames_per_buffer, buffers[0], buffers[1]);  //in fluid.c calls fluid_synth_write_float()
@@ -209,8 +212,10 @@ if((!rubberband_active) || (available < (gint)frames_per_buffer)) {
       read_event_from_rubberband_queue (AUDIO_BACKEND, (unsigned char *) buffers[0], &event_length);
       event_length = frames_per_buffer;
       read_event_from_rubberband_queue (AUDIO_BACKEND, (unsigned char *) buffers[1],  &event_length);
+      telemetry->rubberband_backlog = available;
       }
 #endif //_HAVE_RUBBERBAND_
+  telemetry->playback_fill = playback_queue_fill (AUDIO_BACKEND);
 
   if (until_time < get_playuntil ())
     {
@@ -226,6 +231,18 @@ if((!rubberband_active) || (available < (gint)frames_per_buffer)) {
   return paContinue;
 }
 
+static int
+timed_stream_callback (const void *input_buffer, void *output_buffer, unsigned long frames_per_buffer, const PaStreamCallbackTimeInfo * time_info, PaStreamCallbackFlags status_flags, void *user_data)
+{
+  int ret;
+  telemetry_callback_t telemetry = { g_get_monotonic_time (), frames_per_buffer, sample_rate, 0, -1, -1, (status_flags & (paOutputUnderflow | paOutputOverflow)) != 0 };
+  PROFILE_BEGIN_REALTIME (mark, "portaudio stream_callback");
+  ret = stream_callback (input_buffer, output_buffer, frames_per_buffer, time_info, status_flags, &telemetry);
+  PROFILE_END (mark);
+  audio_telemetry_callback (TELEMETRY_PORTAUDIO, &telemetry);
+  return ret;
+}
+
 static int
 actual_portaudio_initialize (DenemoPrefs * config)
 {
@@ -289,7 +306,7 @@ actual_portaudio_initialize (DenemoPrefs * config)
   output_parameters.sampleFormat = paFloat32 | paNonInterleaved;
   output_parameters.suggestedLatency = Pa_GetDeviceInfo (output_parameters.device)->defaultLowOutputLatency;
   output_parameters.hostApiSpecificStreamInfo = NULL;
-  err = Pa_OpenStream (&stream, NULL, &output_parameters, config->portaudio_sample_rate, config->portaudio_period_size, paNoFlag /* make this a pref??? paClipOff */ , stream_callback, NULL);
+  err = Pa_OpenStream (&stream, NULL, &output_parameters, config->portaudio_sample_rate, config->portaudio_period_size, paNoFlag /* make this a pref??? paClipOff */ , timed_stream_callback, NULL);
   if (err != paNoError)
     {
       g_warning ("Couldn't open output stream");
@@ -105,6 +105,13 @@ findreversealigns (DenemoObject * thechord)
   setpixelmin (thechord);
 }
 
+/* a chord object and its chord are allocated together, so freechord() frees both with the DenemoObject */
+typedef struct ChordObject
+{
+  DenemoObject object;
+  chord thechord;
+} ChordObject;
+
 /**
  * Allocate new chord from the heap
  * and do the basic initialisation
@@ -113,8 +120,9 @@ findreversealigns (DenemoObject * thechord)
 DenemoObject *
 newchord (gint baseduration, gint numdots, int tied)
 {
-  DenemoObject *thechord = (DenemoObject *) g_malloc0 (sizeof (DenemoObject));
-  chord *newchord = (chord *) g_malloc0 (sizeof (chord));
+  ChordObject *block = (ChordObject *) g_malloc0 (sizeof (ChordObject));
+  DenemoObject *thechord = &block->object;
+  chord *newchord = &block->thechord;
   thechord->type = CHORD;
   thechord->isinvisible = FALSE;
 
@@ -238,19 +246,45 @@ modify_note (chord * thechord, gint mid_c_offset, gint enshift, gint dclef)
   displayhelper (Denemo.project);
 }
 
-/* Allocate a new note structure initializing the fields
- * caller must g_free
+/* Return zeroed storage for a note of thechord, one of its inline notes if any is free,
+ * otherwise from the heap. Give it back with release_note ()
+ */
+static note *
+alloc_note (chord * thechord)
+{
+  gint i;
+  for (i = 0; i < DENEMO_INLINE_NOTES; i++)
+    if (!(thechord->inline_notes_used & (1 << i)))
+      {
+        thechord->inline_notes_used |= (1 << i);
+        memset (&thechord->inline_notes[i], 0, sizeof (note));
+        return &thechord->inline_notes[i];
+      }
+  return (note *) g_malloc0 (sizeof (note));
+}
+
+static void
+release_note (chord * thechord, note * thenote)
+{
+  if (thenote >= thechord->inline_notes && thenote < thechord->inline_notes + DENEMO_INLINE_NOTES)
+    thechord->inline_notes_used &= ~(1 << (thenote - thechord->inline_notes));
+  else
+    g_free (thenote);
+}
+
+/* Allocate a new note structure for thechord initializing the fields
+ * caller must release_note ()
  */
 
 static note *
-new_note (gint mid_c_offset, gint enshift, gint dclef)
+new_note (chord * thechord, gint mid_c_offset, gint enshift, gint dclef)
 {
   note *newnote;
   if (enshift > 2)
     enshift = 2;
   if (enshift < -2)
     enshift = -2;
-  newnote = (note *) g_malloc0 (sizeof (note));
+  newnote = alloc_note (thechord);
   newnote->mid_c_offset = mid_c_offset;
   newnote->enshift = enshift;
   newnote->y = calculateheight (mid_c_offset, dclef);
@@ -267,9 +301,22 @@ new_note (gint mid_c_offset, gint enshift, gint dclef)
  */
 note *
 addtone (DenemoObject * thechord, gint mid_c_offset, gint enshift)
-{ gint dclef = thechord->clef->type;
-  note *newnote = new_note (mid_c_offset, (Denemo.project->movement?Denemo.project->movement->pending_enshift:0) + enshift, dclef);
+{
+  note *newnote = addtone_with_enshift (thechord, mid_c_offset, (Denemo.project->movement?Denemo.project->movement->pending_enshift:0) + enshift);
   if(Denemo.project->movement) Denemo.project->movement->pending_enshift = 0;
+  return newnote;
+}
+
+/**
+ * Add a note with exactly the accidental enshift to thechord, which must have its clef set.
+ * Unlike addtone() it does not consume the movement's pending_enshift and touches nothing
+ * but thechord, so importers can call it from worker threads.
+ * return note added
+ */
+note *
+addtone_with_enshift (DenemoObject * thechord, gint mid_c_offset, gint enshift)
+{ gint dclef = thechord->clef->type;
+  note *newnote = new_note ((chord *) thechord->object, mid_c_offset, enshift, dclef);
   ((chord *) thechord->object)->notes = g_list_insert_sorted (((chord *) thechord->object)->notes, newnote, insertcomparefunc);
   if (mid_c_offset > ((chord *) thechord->object)->highestpitch)
     {
@@ -389,7 +436,7 @@ removetone (DenemoObject * thechord, gint mid_c_offset)
       /* Now that we no longer need any info in tnode or tone,
        * actually free stuff */
 
-      g_free (tone);
+      release_note ((chord *) thechord->object, tone);
       ((chord *) thechord->object)->notes = g_list_remove_link (((chord *) thechord->object)->notes, tnode);
       g_list_free_1 (tnode);
     }
@@ -497,14 +544,14 @@ changenumdots (DenemoObject * thechord, gint number)
 
 
 static void
-freenote (gpointer thenote)
+freenote (gpointer thenote, gpointer thechord)
 {
   if (((note *) thenote)->directives)
     {
       free_directives (((note *) thenote)->directives);
       //g_list_free(thenote->directives);
     }
-  g_free (thenote);
+  release_note ((chord *) thechord, (note *) thenote);
 }
 
 
@@ -514,7 +561,7 @@ freenote (gpointer thenote)
 void
 freechord (DenemoObject * thechord)
 {
-  g_list_foreach (((chord *) thechord->object)->notes, (GFunc) freenote, NULL);
+  g_list_foreach (((chord *) thechord->object)->notes, (GFunc) freenote, thechord->object);
   g_list_free (((chord *) thechord->object)->notes);
   g_list_free (((chord *) thechord->object)->dynamics);
   if (((chord *) thechord->object)->lyric)
@@ -529,7 +576,8 @@ freechord (DenemoObject * thechord)
       //g_list_free(((chord *) thechord->object)->directives);
     }
 //FIXME we should free thechord->directives too if scripts fail to delete them
-  g_free (thechord);
+  g_free (thechord->lilycache);
+  g_free (thechord);            //and the chord allocated with it by newchord ()
 }
 
 
@@ -541,17 +589,19 @@ freechord (DenemoObject * thechord)
 DenemoObject *
 clone_chord (DenemoObject * thechord)
 {
-  DenemoObject *ret = (DenemoObject *) g_malloc0 (sizeof (DenemoObject));
+  ChordObject *block = (ChordObject *) g_malloc0 (sizeof (ChordObject));
+  DenemoObject *ret = &block->object;
   GList *curtone;
   note *newnote;
   chord *curchord = (chord *) thechord->object;
-  chord *clonedchord = (chord *) g_malloc0 (sizeof (chord));
+  chord *clonedchord = &block->thechord;
   /* I'd use a g_list_copy here, only that won't do the deep copy of
    * the list data that I'd want it to */
   memcpy ((DenemoObject *) ret, (DenemoObject *) thechord, sizeof (DenemoObject));
 
   ret->object = NULL;
   ret->directives = NULL;       //currently the only pointers in DenemoObject
+  ret->lilycache = NULL;
   memcpy ((chord *) clonedchord, curchord, sizeof (chord));
   clonedchord->directives = NULL;
   clonedchord->dynamics = NULL;
@@ -582,9 +632,10 @@ clone_chord (DenemoObject * thechord)
   clonedchord->directives = clone_directives (curchord->directives);
 
   clonedchord->notes = NULL;
+  clonedchord->inline_notes_used = 0;
   for (curtone = ((chord *) thechord->object)->notes; curtone; curtone = curtone->next)
     {
-      newnote = (note *) g_malloc0 (sizeof (note));
+      newnote = alloc_note (clonedchord);
       note *curnote = (note *) curtone->data;
       memcpy (newnote, curnote, sizeof (note));
       newnote->directives = clone_directives (curnote->directives);
@@ -598,3 +649,41 @@ clone_chord (DenemoObject * thechord)
      */
   return ret;
 }
+
+/**
+ * Copy a chord into arena, keeping what clone_chord () needs to make a copy
+ * of it again on the heap, see freeze_movement ()
+ * @param thechord the chord to copy
+ * @param arena the arena to hold the copy
+ * @return the copy, which must not be freed with freechord ()
+ */
+DenemoObject *
+freeze_chord (DenemoObject * thechord, DenemoArena * arena)
+{
+  ChordObject *block = (ChordObject *) arena_alloc (arena, sizeof (ChordObject));
+  DenemoObject *ret = &block->object;
+  chord *curchord = (chord *) thechord->object;
+  chord *frozenchord = &block->thechord;
+  GList *curtone;
+  memcpy (ret, thechord, sizeof (DenemoObject));
+  ret->object = frozenchord;
+  ret->directives = NULL;
+  ret->lilycache = NULL;
+  memcpy (frozenchord, curchord, sizeof (chord));
+  frozenchord->dynamics = NULL;
+  frozenchord->tone_node = NULL;
+  frozenchord->lyric = NULL;
+  frozenchord->figure = curchord->figure ? arena_string_new (arena, ((GString *) curchord->figure)->str) : NULL;
+  frozenchord->fakechord = curchord->fakechord ? arena_string_new (arena, ((GString *) curchord->fakechord)->str) : NULL;
+  frozenchord->directives = freeze_directives (curchord->directives, arena);
+  frozenchord->notes = NULL;
+  frozenchord->inline_notes_used = 0;
+  for (curtone = curchord->notes; curtone; curtone = curtone->next)
+    {
+      note *newnote = (note *) arena_memdup (arena, curtone->data, sizeof (note));
+      newnote->directives = freeze_directives (newnote->directives, arena);
+      frozenchord->notes = arena_list_prepend (arena, frozenchord->notes, newnote);
+    }
+  frozenchord->notes = g_list_reverse (frozenchord->notes);
+  return ret;
+}
@@ -9,6 +9,7 @@
 
 #include <glib.h>
 #include <denemo/denemo.h>
+#include "core/arena.h"
 #ifndef CHORDOPSH
 #define CHORDOPSH
 
@@ -23,6 +24,7 @@ objnode *nearestnote (DenemoObject * thechord, gint mid_c_offset);
 void modify_note (chord * thechord, gint mid_c_offset, gint enshift, gint dclef);
 
 note *addtone (DenemoObject * mudelaobj, gint mid_c_offset, gint enshift);
+note *addtone_with_enshift (DenemoObject * mudelaobj, gint mid_c_offset, gint enshift);
 
 void addornament (DenemoObject * obj, Ornament orn);
 
@@ -41,6 +43,7 @@ void changenumdots (DenemoObject * thechord, int number);
 void freechord (DenemoObject * mudelaobj);
 
 DenemoObject *clone_chord (DenemoObject * mudelaobj);
+DenemoObject *freeze_chord (DenemoObject * mudelaobj, DenemoArena * arena);
 DenemoObject *hidechord (DenemoObject * thechord);
 
 
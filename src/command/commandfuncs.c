@@ -32,6 +32,7 @@
 #include "audio/audiointerface.h"
 #include "display/displayanimation.h"
 #include "core/cache.h"
+#include "core/profile.h"
 /**
  * Macro to get the current DenemoObject
  */
@@ -110,12 +111,12 @@ setcurrents (DenemoMovement * si)
 {
   if (((DenemoStaff *) si->currentstaff->data)->nummeasures >= si->currentmeasurenum)
     {
-      si->currentmeasure = g_list_nth (staff_first_measure_node (si->currentstaff), si->currentmeasurenum - 1);
+      si->currentmeasure = staff_nth_measure_node (si->currentstaff, si->currentmeasurenum - 1);
     }
   else
     {
       g_debug ("Setting measure to %d which is last in Staff\n", ((DenemoStaff *) si->currentstaff->data)->nummeasures);
-      si->currentmeasure = g_list_nth (staff_first_measure_node (si->currentstaff), ((DenemoStaff *) si->currentstaff->data)->nummeasures - 1);
+      si->currentmeasure = staff_nth_measure_node (si->currentstaff, ((DenemoStaff *) si->currentstaff->data)->nummeasures - 1);
       si->currentmeasurenum = ((DenemoStaff *) si->currentstaff->data)->nummeasures;
 
     }
@@ -280,21 +281,11 @@ object_insert (DenemoProject * gui, DenemoObject * mudela_obj_new)
     }
   ((DenemoMeasure*)si->currentmeasure->data)->objects = g_list_insert ((objnode *) ((DenemoMeasure*)si->currentmeasure->data)->objects, mudela_obj_new, si->cursor_x);
 
-  obj = g_list_nth ((objnode *) ((DenemoMeasure*)si->currentmeasure->data)->objects, si->cursor_x);//g_assert (obj->data == mudela_obj_new);
-
-  if (mudela_obj_new->type == CLEF)
-    update_clef_cache (si->currentmeasure, obj);
-  else if (mudela_obj_new->type == KEYSIG)
-     update_keysig_cache (si->currentmeasure, obj);
-  else if (mudela_obj_new->type == TIMESIG)
-     update_timesig_cache (si->currentmeasure);
-  else if (mudela_obj_new->type == STEMDIRECTIVE)
-     update_stemdir_cache (si->currentmeasure, obj);
+  if (mudela_obj_new->type == CLEF || mudela_obj_new->type == KEYSIG || mudela_obj_new->type == TIMESIG || mudela_obj_new->type == STEMDIRECTIVE)
+    staff_update_context (si->currentstaff, si->currentmeasure);
   if (mudela_obj_new->type == CLEF)
     {
       reset_cursor_stats (si);
-      staff_fix_note_heights ((DenemoStaff *) si->currentstaff->data);
-      staff_beams_and_stems_dirs ((DenemoStaff *) si->currentstaff->data);
       find_xes_in_all_measures (si);
     }
 
@@ -2118,6 +2109,7 @@ displayhelper (DenemoProject * gui)
   if(Denemo.non_interactive)
     return;
 
+  PROFILE_BEGIN (mark, "displayhelper");
   DenemoMovement *si = gui->movement;
   beamandstemdirhelper (si);
   showwhichaccidentals ((objnode *)((DenemoMeasure*)si->currentmeasure->data)->objects);
@@ -2126,6 +2118,7 @@ displayhelper (DenemoProject * gui)
   set_bottom_staff (gui);
   write_status (gui);
   gtk_widget_queue_draw (Denemo.scorearea);
+  PROFILE_END (mark);
 }
 
 
@@ -2396,10 +2389,10 @@ insertmeasurebefore (DenemoAction* action, G_GNUC_UNUSED DenemoScriptParam* para
 void
 appendmeasures (DenemoMovement * si, gint number)
 {
-  dnm_addmeasures (si, g_list_length (staff_first_measure_node (si->currentstaff)), number, FALSE);
+  dnm_addmeasures (si, staff_measure_count (si->currentstaff), number, FALSE);
   /* Reset these two variables because si->currentmeasure and
    * si->currentobject may now be pointing to dead data */
-  si->currentmeasure = g_list_nth (staff_first_measure_node (si->currentstaff), si->currentmeasurenum - 1);
+  si->currentmeasure = staff_nth_measure_node (si->currentstaff, si->currentmeasurenum - 1);
   si->currentobject = g_list_nth ((objnode *) ((DenemoMeasure*)si->currentmeasure->data)->objects, si->cursor_x - (si->cursor_appending == TRUE));
   set_rightmeasurenum (si);
   displayhelper (Denemo.project);
@@ -2410,10 +2403,10 @@ appendmeasures (DenemoMovement * si, gint number)
 void
 appendmeasurestoentirescore (DenemoMovement * si, gint number)
 {
-  dnm_addmeasures (si, g_list_length (staff_first_measure_node (si->currentstaff)), number, TRUE);
+  dnm_addmeasures (si, staff_measure_count (si->currentstaff), number, TRUE);
   /* Reset these two variables because si->currentmeasure and
    * si->currentobject may now be pointing to dead data */
-  si->currentmeasure = g_list_nth (staff_first_measure_node (si->currentstaff), si->currentmeasurenum - 1);
+  si->currentmeasure = staff_nth_measure_node (si->currentstaff, si->currentmeasurenum - 1);
   si->currentobject = g_list_nth ((objnode *) ((DenemoMeasure*)si->currentmeasure->data)->objects, si->cursor_x - (si->cursor_appending == TRUE));
   set_rightmeasurenum (si);
   /* update_hscrollbar (si); */
@@ -2645,39 +2638,23 @@ dnm_deleteobject (DenemoMovement * si)
 /* here we have to re-validate leftmost clef e.g. find_leftmost_allcontexts (gui->movement);
  which seems to be done... */
           delete_object_helper (si);
-          cache_staff (si->currentstaff);
-          staff_fix_note_heights ((DenemoStaff *) si->currentstaff->data);
-          staff_beams_and_stems_dirs ((DenemoStaff *) si->currentstaff->data);
+          staff_update_context (si->currentstaff, si->currentmeasure);
           find_xes_in_all_measures (si);
           break;
         case KEYSIG:
           delete_object_helper (si);
-          cache_staff (si->currentstaff);
-          staff_beams_and_stems_dirs ((DenemoStaff *) si->currentstaff->data);
-          staff_show_which_accidentals ((DenemoStaff *) si->currentstaff->data);
+          staff_update_context (si->currentstaff, si->currentmeasure);
           find_xes_in_all_measures (si);
           break;
         case TIMESIG:
           delete_object_helper (si);
-          DenemoMeasure *measure = (DenemoMeasure *)si->currentmeasure->data;
-          if (si->currentmeasure->prev)
-            {
-                DenemoMeasure *prevmeas = (DenemoMeasure *)si->currentmeasure->prev->data;
-                measure->timesig = prevmeas->timesig;
-            }
-            else
-            {
-              DenemoStaff *thestaff = (DenemoStaff *) si->currentstaff->data;
-              measure->timesig = &thestaff->timesig;
-            }
-          update_timesig_cache (si->currentmeasure);
+          staff_update_context (si->currentstaff, si->currentmeasure);
           reset_cursor_stats (si);
           find_xes_in_all_measures (si);
           break;
         case STEMDIRECTIVE:
           delete_object_helper (si);
-          cache_staff (si->currentstaff);
-          staff_beams_and_stems_dirs ((DenemoStaff *) si->currentstaff->data);
+          staff_update_context (si->currentstaff, si->currentmeasure);
           find_xes_in_all_measures (si);
           break;
         case DYNAMIC:
@@ -1928,10 +1928,78 @@ however, at least the rest of this code expects a valid GtkWidget...
   g_free (value);
 }
 
+/*
+  directive_widget_deferred()
+  returns TRUE if the widget for a directive of the type given by fn is not to be built now.
+  Staff and voice directives are edited via the staff and voice editors, so no menu shows their menu items, and
+  the buttons of movement directives are only built when the movement is displayed, see realize_movement_directive_widgets().
+*/
+gboolean
+directive_widget_deferred (gpointer fn)
+{
+  if ((fn == (gpointer) staff_directive_put_graphic) || (fn == (gpointer) voice_directive_put_graphic))
+    return TRUE;
+  if ((fn == (gpointer) movementcontrol_directive_put_graphic) || (fn == (gpointer) header_directive_put_graphic))
+    return Denemo.project->movement && Denemo.project->movement->widgets_deferred;
+  return FALSE;
+}
+
+static void
+realize_directive_widgets (GList ** directives, void fn ())
+{
+  GList *g;
+  for (g = *directives; g; g = g->next)
+    {
+      DenemoDirective *directive = g->data;
+      widget_for_directive_menu (directive, fn, NULL);
+      if (directive->widget)
+        g_object_set_data (G_OBJECT (directive->widget), "directives-pointer", (gpointer) directives);
+    }
+}
+
+static void
+evict_directive_widgets (GList * directives)
+{
+  for (; directives; directives = directives->next)
+    {
+      DenemoDirective *directive = directives->data;
+      if (directive->widget)
+        {
+          GtkWidget *texteditor = (GtkWidget *) g_object_get_data (G_OBJECT (directive->widget), DENEMO_TEXTEDITOR_TAG);
+          if (texteditor)
+            gtk_widget_destroy (gtk_widget_get_toplevel (texteditor));
+          gtk_widget_destroy (directive->widget);
+          directive->widget = NULL;
+        }
+    }
+}
+
+/* build the buttons for the directives of movement, which is the current movement, that were deferred */
+void
+realize_movement_directive_widgets (DenemoMovement * movement)
+{
+  if (Denemo.non_interactive)
+    return;
+  realize_directive_widgets (&movement->movementcontrol.directives, (void (*)()) movementcontrol_directive_put_graphic);
+  realize_directive_widgets (&movement->header.directives, (void (*)()) header_directive_put_graphic);
+}
+
+/* destroy the buttons for the directives of movement, they will be re-built by realize_movement_directive_widgets() */
+void
+evict_movement_directive_widgets (DenemoMovement * movement)
+{
+  if (Denemo.non_interactive)
+    return;
+  evict_directive_widgets (movement->movementcontrol.directives);
+  evict_directive_widgets (movement->header.directives);
+}
+
 void
 widget_for_directive (DenemoDirective * directive, void fn ())
 {
   if(Denemo.non_interactive) return;
+  if (directive->widget == NULL && directive_widget_deferred ((gpointer) fn))
+    return;
   GtkMenu *menu = NULL;
   if (Denemo.project->movement)
     {
@@ -1947,18 +2015,6 @@ widget_for_directive (DenemoDirective * directive, void fn ())
   widget_for_directive_menu (directive, fn, menu);
 }
 
-void
-widget_for_staff_directive (DenemoDirective * directive, GtkMenu * menu)
-{
-  return widget_for_directive_menu (directive, (void (*)()) staff_directive_put_graphic, menu);
-}
-
-void
-widget_for_voice_directive (DenemoDirective * directive, GtkMenu * menu)
-{
-  return widget_for_directive_menu (directive, (void (*)()) voice_directive_put_graphic, menu);
-}
-
 void
 widget_for_movementcontrol_directive (DenemoDirective * directive)
 {
@@ -2791,6 +2847,10 @@ put_edit_script (GtkWidget * widget, gchar * tag)
 static gboolean
 activate_directive (DenemoDirective * directive, gchar * what)
 {
+  /* staff and voice directives are edited in the staff and voice editors and have no widget built for them
+     (see directive_widget_deferred()), the menu item they used to get had nothing connected to it, so activating one is done at once */
+  if (!strcmp (what, "staff") || !strcmp (what, "voice"))
+    return TRUE;
   if (directive->widget && GTK_IS_WIDGET (directive->widget))
     {
       g_debug ("Activate");
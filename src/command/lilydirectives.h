@@ -23,11 +23,12 @@ gboolean unpopulate_menu (GtkWidget * menu);
 
 gchar *get_scoretitle (void);
 void widget_for_directive (DenemoDirective * directive, void fn ());
-void widget_for_staff_directive (DenemoDirective * directive, GtkMenu * menu);
-void widget_for_voice_directive (DenemoDirective * directive, GtkMenu * menu);
 void widget_for_movementcontrol_directive (DenemoDirective * directive);
 void widget_for_header_directive (DenemoDirective * directive);
 void widget_for_layout_directive (DenemoDirective * directive);
+gboolean directive_widget_deferred (gpointer fn);
+void realize_movement_directive_widgets (DenemoMovement * movement);
+void evict_movement_directive_widgets (DenemoMovement * movement);
 gboolean text_edit_chord_directive (gchar * tag);
 gboolean text_edit_note_directive (gchar * tag);
 gboolean text_edit_clef_directive (gchar * tag);
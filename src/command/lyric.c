@@ -21,8 +21,16 @@
 //staff->verse_views is a list of GtkTextView which are packed in a GtkScrolledWindow
 //so  movement->lyricsbox contains Notebook->ScrolledWindow->TextView
 //the text of the verses is stored in staff->verses
-static GtkWidget *DummyVerse;   /* a non-existent verse */
 static gint SkipCount = 0;      //count of syllables to be skipped
+static GPtrArray *DrawnSyllables = NULL;        /* the syllables of the verse being drawn, see reset_lyrics() */
+static guint NextSyllable = 0;  /* index in DrawnSyllables of the syllable next_syllable() returns */
+
+/* the syllable count and slur state at the start of a measure, see staff_syllables_before() */
+typedef struct SyllableMark
+{
+  gint count;
+  gboolean in_slur;
+} SyllableMark;
 
 
 gboolean
@@ -103,11 +111,31 @@ denemo_pango_scan_string (const char **pos, GString *out)
   return TRUE;
 }
 
+/* find the project and movement that staff belongs to, returning FALSE if it is in none */
+static gboolean
+find_staff_movement (DenemoStaff * staff, DenemoProject ** project, DenemoMovement ** movement)
+{
+  GList *g, *h;
+  for (g = Denemo.projects; g; g = g->next)
+    for (h = ((DenemoProject *) g->data)->movements; h; h = h->next)
+      if (g_list_find (((DenemoMovement *) h->data)->thescore, staff))
+        {
+          *project = (DenemoProject *) g->data;
+          *movement = (DenemoMovement *) h->data;
+          return TRUE;
+        }
+  return FALSE;
+}
+
 GtkWidget *
 verse_get_current_view (DenemoStaff * staff)
 {
+  DenemoProject *project;
+  DenemoMovement *movement;
   if (!staff)
     return NULL;
+  if (staff->verses && !staff->verse_views && find_staff_movement (staff, &project, &movement) && movement->widgets_deferred)
+    realize_movement (project, movement);       //the views of the staff's movement have not been built yet
   if (!staff->current_verse_view)
     return NULL;
   return staff->current_verse_view->data;
@@ -196,6 +224,7 @@ lyric_changed_cb (GtkTextBuffer * buffer)
   DenemoStaff *staff = (DenemoStaff *) Denemo.project->movement->currentstaff->data;
   gchar *text = get_lyrics_for_current_verse (staff);
   verse_set_current_text (staff, text);
+  g_object_set_data (G_OBJECT (buffer), "syllables", NULL);     //tokenized again when next drawn
   {
     GtkTextIter startiter, enditer;
     gtk_text_buffer_get_start_iter (buffer, &startiter);
@@ -547,13 +576,10 @@ populate_called (G_GNUC_UNUSED GtkWidget * view, GtkMenuShell * menu)
 
 
 
-guint
-add_verse_to_staff (DenemoMovement * movement, DenemoStaff * staff)
+/* build the GtkTextView for a verse of staff holding text, creating the notebook for the staff's verses if need be */
+static void
+new_verse_view (DenemoMovement * movement, DenemoStaff * staff, const gchar * text)
 {
-  staff->verses = g_list_append (staff->verses, NULL);
-  if (Denemo.non_interactive)
-    return g_list_length (staff->verses) - 1;
-
   GtkWidget *notebook, *textview;
   if (staff->verse_views == NULL)
     {
@@ -577,8 +603,7 @@ add_verse_to_staff (DenemoMovement * movement, DenemoStaff * staff)
   gtk_text_view_set_wrap_mode (GTK_TEXT_VIEW (textview), GTK_WRAP_WORD_CHAR);
   gtk_widget_show_all (gtk_widget_get_parent (textview));
   staff->verse_views = g_list_append (staff->verse_views, textview);
-  guint pos = g_list_position (staff->verse_views, g_list_last (staff->verse_views));
-  point_to_verse (staff, pos);
+  point_to_verse (staff, g_list_length (staff->verse_views) - 1);
   gint pagenum = gtk_notebook_append_page (GTK_NOTEBOOK (notebook), gtk_widget_get_parent (textview), NULL);
   gtk_notebook_set_current_page (GTK_NOTEBOOK (notebook), pagenum);
   gchar *tablabel = g_strdup_printf (_("Verse %d"), pagenum + 1);
@@ -587,6 +612,8 @@ add_verse_to_staff (DenemoMovement * movement, DenemoStaff * staff)
   if (pagenum)
     gtk_notebook_set_show_tabs (GTK_NOTEBOOK (notebook), TRUE);
   GtkTextView *verse_view = (GtkTextView *) verse_get_current_view (staff);
+  if (text)
+    gtk_text_buffer_set_text (gtk_text_view_get_buffer (verse_view), text, -1);
   g_signal_connect (G_OBJECT (gtk_text_view_get_buffer (verse_view)), "changed", G_CALLBACK (lyric_changed_cb), NULL);
   g_signal_connect (G_OBJECT (verse_view), "key-release-event", G_CALLBACK (text_inserted_cb), NULL);
   g_signal_connect (G_OBJECT (verse_view), "key-press-event", G_CALLBACK (keypress), NULL);
@@ -643,7 +670,92 @@ gtk_style_context_add_provider(gsc, GTK_STYLE_PROVIDER(gcp),
 } 
 #endif
   show_verses ();
-  return pos;
+}
+
+/**
+ * Append a verse holding a copy of text (which may be NULL) to staff.
+ * The view for the verse is only built if the verse views of the movement have been realized,
+ * otherwise the text is held in staff->verses until realize_movement() is called.
+ * @return the number of the new verse, counting from 0
+ */
+guint
+add_verse_with_text (DenemoMovement * movement, DenemoStaff * staff, const gchar * text)
+{
+  staff->verses = g_list_append (staff->verses, g_strdup (text));
+  if (!(Denemo.non_interactive || movement->widgets_deferred))
+    new_verse_view (movement, staff, text);
+  return g_list_length (staff->verses) - 1;
+}
+
+guint
+add_verse_to_staff (DenemoMovement * movement, DenemoStaff * staff)
+{
+  return add_verse_with_text (movement, staff, NULL);
+}
+
+/* build the verse views of every staff of movement from the text held in staff->verses, see realize_movement() */
+void
+realize_verses (DenemoMovement * movement)
+{
+  GList *g, *h;
+  if (Denemo.non_interactive)
+    return;
+  for (g = movement->thescore; g; g = g->next)
+    {
+      DenemoStaff *staff = (DenemoStaff *) g->data;
+      for (h = staff->verses; h; h = h->next)
+        new_verse_view (movement, staff, h->data);
+    }
+  if (movement->lyricsbox && !Denemo.prefs.lyrics_pane)
+    gtk_widget_hide (movement->lyricsbox);
+}
+
+/* destroy the verse views of every staff of movement, keeping their text in staff->verses */
+void
+evict_verses (DenemoMovement * movement)
+{
+  GList *g, *h, *v;
+  if (Denemo.non_interactive)
+    return;
+  for (g = movement->thescore; g; g = g->next)
+    {
+      DenemoStaff *staff = (DenemoStaff *) g->data;
+      if (staff->verse_views == NULL)
+        continue;
+      //store the text of each view back in its verse, so the views can be rebuilt from staff->verses on demand
+      for (h = staff->verses, v = staff->verse_views; h && v; h = h->next, v = v->next)
+        {
+          g_free (h->data);
+          h->data = get_text_from_view (v->data);
+        }
+      gtk_widget_destroy (gtk_widget_get_parent (gtk_widget_get_parent (staff->verse_views->data)));       //the notebook
+      g_list_free (staff->verse_views);
+      staff->verse_views = staff->current_verse_view = NULL;
+    }
+  if (movement->lyricsbox)
+    {
+      gtk_widget_destroy (movement->lyricsbox);
+      movement->lyricsbox = NULL;
+    }
+}
+
+/* the number of verses of staff, whether or not their views have been built */
+gint
+staff_verse_count (DenemoStaff * staff)
+{
+  return staff->verse_views ? g_list_length (staff->verse_views) : g_list_length (staff->verses);
+}
+
+/* return a newly allocated copy of the text of verse number versenum (counting from 0) of staff, or NULL if there is no such verse */
+gchar *
+staff_verse_text (DenemoStaff * staff, gint versenum)
+{
+  if (staff->verse_views)
+    {
+      GtkWidget *view = g_list_nth_data (staff->verse_views, versenum);
+      return view ? get_text_from_view (view) : NULL;
+    }
+  return g_strdup (g_list_nth_data (staff->verses, versenum));
 }
 
 void
@@ -651,6 +763,7 @@ add_verse (DenemoAction * action, DenemoScriptParam * param)
 {
   DenemoProject *project = Denemo.project;
   DenemoMovement *movement = project->movement;
+  realize_movement (project, movement);
   if (project->movement->currentstaff)
     {
       DenemoStaff *staff = movement->currentstaff->data;
@@ -666,6 +779,7 @@ delete_verse (DenemoAction * action, DenemoScriptParam * param)
 {
   DenemoProject *gui = Denemo.project;
   DenemoMovement *si = gui->movement;
+  realize_movement (gui, si);
   if (si->currentstaff)
     {
       DenemoStaff *staff = si->currentstaff->data;
@@ -707,58 +821,121 @@ get_text_from_view (GtkWidget * textview)
 }
 
 
-// For the first call a textview is passed and the count'th syllable in that textview is set to be the next syllable returned.
-// Subsequent calls with NULL for textview return the next syllable of the textview that was set up by the above
-static gchar *
-lyric_iterator (GtkWidget * textview, gint count)
+/* the syllables of the verse held in buffer, tokenized once and kept on the buffer until its text changes, see lyric_changed_cb() */
+static GPtrArray *
+verse_syllables (GtkTextBuffer * buffer)
 {
-  static const gchar *next;
-  static gchar *lyrics;
-  static GString *gs;
-  if (gs == NULL)
-    gs = g_string_new ("");
-  if (textview == NULL)
-    {
-      gboolean result = scan_syllable ((gchar **) & next, gs);
-      if (result && gs->len)
-        return gs->str;
-      else
-        return NULL;
-    }
-  if (textview != DummyVerse)
+  GPtrArray *syllables = g_object_get_data (G_OBJECT (buffer), "syllables");
+  if (syllables == NULL)
     {
+      GtkTextIter startiter, enditer;
+      GString *gs = g_string_new ("");
+      gchar *text, *next;
+      gtk_text_buffer_get_start_iter (buffer, &startiter);
+      gtk_text_buffer_get_end_iter (buffer, &enditer);
+      text = next = gtk_text_buffer_get_text (buffer, &startiter, &enditer, FALSE);
+      syllables = g_ptr_array_new_with_free_func (g_free);
       SkipCount = 0;
-      if (lyrics)
-        g_free (lyrics);
-      lyrics = get_text_from_view (textview);
-      next = lyrics;
-      while (count--)
-        scan_syllable ((gchar **) & next, gs);
+      while (scan_syllable (&next, gs))
+        g_ptr_array_add (syllables, g_strdup (gs->str));
+      g_string_free (gs, TRUE);
+      g_free (text);
+      g_object_set_data_full (G_OBJECT (buffer), "syllables", syllables, (GDestroyNotify) g_ptr_array_unref);
     }
-  return NULL;
+  return syllables;
 }
 
 //for every chord while drawing next_syllable is called.
 gchar *
 next_syllable (void)
 {
-  return lyric_iterator (NULL, 0);
+  if (DrawnSyllables && (NextSyllable < DrawnSyllables->len))
+    {
+      gchar *syllable = g_ptr_array_index (DrawnSyllables, NextSyllable++);
+      return *syllable ? syllable : NULL;
+    }
+  return NULL;
 }
 
 /* reset_lyrics sets up the lyric iterator so that a call to next_syllable() will return the count'th syllable */
 void
 reset_lyrics (DenemoStaff * staff, gint count)
 {
+  GtkTextView *verse_view;
   if (Denemo.non_interactive)
     return;
-
-  if (DummyVerse == NULL)
-    DummyVerse = gtk_text_view_new ();
-  GtkTextView *verse_view = (GtkTextView *) verse_get_current_view (staff);
+  if (DrawnSyllables)
+    g_ptr_array_unref (DrawnSyllables);
+  DrawnSyllables = NULL;
+  NextSyllable = count;
+  verse_view = (GtkTextView *) verse_get_current_view (staff);
   if (staff && verse_view)
-    lyric_iterator (GTK_WIDGET (verse_view), count);
-  else
-    lyric_iterator (DummyVerse, count);
+    DrawnSyllables = g_ptr_array_ref (verse_syllables (gtk_text_view_get_buffer (verse_view)));
+}
+
+/* advances mark over the syllables of measure */
+static void
+count_measure_syllables (DenemoMeasure * measure, SyllableMark * mark)
+{
+  objnode *curobj;
+  for (curobj = measure->objects; curobj; curobj = curobj->next)
+    {
+      DenemoObject *obj = curobj->data;
+
+      if (obj->type == CHORD)
+        {
+          chord *thechord = ((chord *) obj->object);
+          if (thechord->notes && !mark->in_slur)
+            mark->count++;
+          if (thechord->slur_begin_p)
+            mark->in_slur = TRUE;
+          if (thechord->slur_end_p)
+            mark->in_slur = FALSE;
+          if (thechord->is_tied && (!mark->in_slur))
+            mark->count--;
+        }
+    }                           //for objs
+}
+
+/**
+ * Count the syllables of the staff thestaff of movement si before measure number from (counting from 1).
+ * The counts at the start of each measure are kept in staff->syllable_marks, so only
+ * measures not counted since the last edit to the movement are walked.
+ * An edit may touch any measure of any staff (paste, undo, scripts) so the marks are
+ * stamped with the changecount of the movement and discarded once that moves on.
+ * @return the count, negated if the measure starts inside a slur
+ */
+gint
+staff_syllables_before (DenemoMovement * si, staffnode * thestaff, gint from)
+{
+  DenemoStaff *staff = (DenemoStaff *) thestaff->data;
+  SyllableMark mark = { 0, FALSE };
+  (void) staff_measure_count (thestaff);        //discards the marks along with the measure index if that is stale
+  if (staff->syllable_marks && (staff->syllable_marks_changecount != si->changecount))
+    {
+      g_array_free (staff->syllable_marks, TRUE);
+      staff->syllable_marks = NULL;
+    }
+  if (staff->syllable_marks == NULL)
+    {
+      staff->syllable_marks = g_array_new (FALSE, FALSE, sizeof (SyllableMark));
+      staff->syllable_marks_changecount = si->changecount;
+      g_array_append_val (staff->syllable_marks, mark);
+    }
+  if ((gint) staff->syllable_marks->len < from)
+    {
+      measurenode *curmeasure = staff_nth_measure_node (thestaff, staff->syllable_marks->len - 1);
+      mark = g_array_index (staff->syllable_marks, SyllableMark, staff->syllable_marks->len - 1);
+      for (; curmeasure && ((gint) staff->syllable_marks->len < from); curmeasure = curmeasure->next)
+        {
+          count_measure_syllables ((DenemoMeasure *) curmeasure->data, &mark);
+          g_array_append_val (staff->syllable_marks, mark);
+        }
+    }
+  mark = g_array_index (staff->syllable_marks, SyllableMark, MIN ((gint) staff->syllable_marks->len, MAX (from, 1)) - 1);
+  if (mark.in_slur)
+    return -mark.count;
+  return mark.count;
 }
 
 void
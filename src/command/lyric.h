@@ -13,7 +13,13 @@ void delete_verse (DenemoAction * action, DenemoScriptParam * param);
 void reset_lyrics (DenemoStaff * staff, gint count);
 gchar *get_text_from_view (GtkWidget * textview);
 guint add_verse_to_staff (DenemoMovement * si, DenemoStaff * staff);
+guint add_verse_with_text (DenemoMovement * movement, DenemoStaff * staff, const gchar * text);
+void realize_verses (DenemoMovement * movement);
+void evict_verses (DenemoMovement * movement);
+gint staff_verse_count (DenemoStaff * staff);
+gchar *staff_verse_text (DenemoStaff * staff, gint versenum);
 gchar *next_syllable (void);
+gint staff_syllables_before (DenemoMovement * si, staffnode * thestaff, gint from);
 void install_lyrics_preview (DenemoMovement * si, GtkWidget * top_vbox);
 void hide_lyrics (void);
 void show_lyrics (void);
@@ -52,6 +52,7 @@ addmeasures (DenemoMovement * si, gint pos, guint nummeasures, gint all)
               barlinenode = g_malloc0 (sizeof (DenemoMeasure)); //use NULL  originally
               ((DenemoStaff *) curstaff->data)->themeasures = g_list_insert (staff_first_measure_node (curstaff), barlinenode, pos);
               ((DenemoStaff *) curstaff->data)->nummeasures++;
+              staff_invalidate_measure_index ((DenemoStaff *) curstaff->data);
             }
 
         }
@@ -61,6 +62,7 @@ addmeasures (DenemoMovement * si, gint pos, guint nummeasures, gint all)
            barlinenode = g_malloc0 (sizeof (DenemoMeasure)); //use NULL  originally
           ((DenemoStaff *) si->currentstaff->data)->themeasures = g_list_insert (staff_first_measure_node (si->currentstaff), barlinenode, pos);
           ((DenemoStaff *) si->currentstaff->data)->nummeasures++;
+          staff_invalidate_measure_index ((DenemoStaff *) si->currentstaff->data);
         }
 
       gint maxmeasures = 0;
@@ -83,7 +85,7 @@ addmeasures (DenemoMovement * si, gint pos, guint nummeasures, gint all)
     else
         cache_staff (si->currentstaff);
   set_measure_transition (-20 * nummeasures, all);
-  measurenode *ret = g_list_nth (staff_first_measure_node (si->currentstaff), pos);
+  measurenode *ret = staff_nth_measure_node (si->currentstaff, pos);
 //  displayhelper (Denemo.project);
  // score_status(Denemo.project, TRUE);
 //check not returning NULL!!!!
@@ -154,7 +156,7 @@ staffremovemeasures (staffnode * curstaff, guint pos)
   measurenode *delmeasure;
 
   firstmeasure = staff_first_measure_node (curstaff);
-  delmeasure = g_list_nth (firstmeasure, pos);
+  delmeasure = staff_nth_measure_node (curstaff, pos);
   if (delmeasure)
     {
 
@@ -175,6 +177,7 @@ staffremovemeasures (staffnode * curstaff, guint pos)
         g_free ((DenemoMeasure*)delmeasure->data);
         g_list_free_1 (delmeasure);
         ((DenemoStaff *) curstaff->data)->nummeasures--;
+        staff_invalidate_measure_index ((DenemoStaff *) curstaff->data);
         if ( ((DenemoStaff *) curstaff->data)->themeasures != NULL)
             {//if the removed measures have a clef change in them the noteheights may need to change so...
             cache_staff (curstaff);
@@ -207,12 +210,11 @@ measurenode *
 removemeasures (DenemoMovement * si, guint pos, guint nummeasures, gboolean all)
 {
   staffnode *curstaff;
-  measurenode *firstmeasure;
   GList *temp;
   guint totalmeasures = 0;
   guint i;
 
-  if (nummeasures <= g_list_length (staff_first_measure_node ((staffnode *) si->currentstaff)) - pos)
+  if (nummeasures <= staff_measure_count (si->currentstaff) - pos)
     {
       if(all)
         stage_undo (si, ACTION_STAGE_END);
@@ -228,6 +230,7 @@ removemeasures (DenemoMovement * si, guint pos, guint nummeasures, gboolean all)
                     {
                       ((DenemoStaff *) curstaff->data)->themeasures = g_list_append (NULL, g_malloc0(sizeof (DenemoMeasure)));
                       ((DenemoStaff *) curstaff->data)->nummeasures = 1;
+                      staff_invalidate_measure_index ((DenemoStaff *) curstaff->data);
                     }
                 }
             }
@@ -255,15 +258,14 @@ removemeasures (DenemoMovement * si, guint pos, guint nummeasures, gboolean all)
                    than exist.  Junking request."));
       return si->currentmeasure;
     }
-  firstmeasure = staff_first_measure_node (si->currentstaff);
-  if (pos == g_list_length (staff_first_measure_node ((staffnode *) si->currentstaff)))
+  if (pos == (guint) staff_measure_count (si->currentstaff))
     {
       /* That is, we deleted the last measure */
       si->currentmeasurenum--;
-      return g_list_nth (firstmeasure, pos - 1);
+      return staff_nth_measure_node (si->currentstaff, pos - 1);
     }
   else
-    return g_list_nth (firstmeasure, pos);
+    return staff_nth_measure_node (si->currentstaff, pos);
 }
 
 
@@ -3081,6 +3081,43 @@ clone_directives (GList * directives)
   return ret;
 }
 
+/* copy directive into arena, as clone_directive () does onto the heap, see freeze_movement () */
+DenemoDirective *
+freeze_directive (DenemoDirective * directive, DenemoArena * arena)
+{
+  DenemoDirective *ret = (DenemoDirective *) arena_memdup (arena, directive, sizeof (DenemoDirective));
+#define FREEZE(field) \
+      if(directive->field && directive->field->len)\
+        ret->field = arena_string_new(arena, directive->field->str);\
+      else\
+        ret->field = NULL;
+  FREEZE (tag);
+  FREEZE (prefix);
+  FREEZE (postfix);
+  FREEZE (display);
+  FREEZE (graphic_name);
+  FREEZE (grob);
+  FREEZE (midibytes);
+  FREEZE (data);
+#undef FREEZE
+  ret->widget = NULL;
+  GList *g;
+  ret->layouts = NULL;
+  for (g = directive->layouts; g; g = g->next)
+    ret->layouts = arena_list_prepend (arena, ret->layouts, g->data);
+  ret->layouts = g_list_reverse (ret->layouts);
+  return ret;
+}
+
+GList *
+freeze_directives (GList * directives, DenemoArena * arena)
+{
+  GList *ret = NULL;
+  for (; directives; directives = directives->next)
+    ret = arena_list_prepend (arena, ret, freeze_directive (directives->data, arena));
+  return g_list_reverse (ret);
+}
+
 void
 free_directive_data (DenemoDirective * directive)
 {
@@ -3207,6 +3244,58 @@ dnm_clone_object (DenemoObject * orig)
   return ret;
 }
 
+/**
+ * Copy orig into arena, keeping what dnm_clone_object () needs to make a
+ * copy of it again on the heap, see freeze_movement ()
+ * @param orig the object to copy
+ * @param arena the arena to hold the copy
+ * @return the copy, which must not be freed with freeobject ()
+ */
+DenemoObject *
+freeze_object (DenemoObject * orig, DenemoArena * arena)
+{
+  DenemoObject *ret;
+  if (orig->type == CHORD)
+    ret = freeze_chord (orig, arena);
+  else
+    {
+      ret = (DenemoObject *) arena_memdup (arena, orig, sizeof (DenemoObject));
+      ret->directives = NULL;
+      switch (orig->type)
+        {
+        case TUPOPEN:
+        case TUPCLOSE:
+          ret->object = arena_memdup (arena, orig->object, sizeof (tupopen));
+          ((tupopen *) ret->object)->directives = freeze_directives (((tupopen *) orig->object)->directives, arena);
+          break;
+        case CLEF:
+          ret->object = arena_memdup (arena, orig->object, sizeof (clef));
+          ((clef *) ret->object)->directives = freeze_directives (((clef *) orig->object)->directives, arena);
+          break;
+        case TIMESIG:
+          ret->object = arena_memdup (arena, orig->object, sizeof (timesig));
+          ((timesig *) ret->object)->directives = freeze_directives (((timesig *) orig->object)->directives, arena);
+          break;
+        case KEYSIG:
+          ret->object = arena_memdup (arena, orig->object, sizeof (keysig));
+          ((keysig *) ret->object)->directives = freeze_directives (((keysig *) orig->object)->directives, arena);
+          break;
+        case STEMDIRECTIVE:
+          ret->object = arena_memdup (arena, orig->object, sizeof (stemdirective));
+          ((stemdirective *) ret->object)->directives = freeze_directives (((stemdirective *) orig->object)->directives, arena);
+          break;
+        case LILYDIRECTIVE:
+          ret->object = freeze_directive ((DenemoDirective *) orig->object, arena);
+          break;
+        default:
+          ret->object = NULL;   //nothing of it is cloned
+          break;
+        }
+    }
+  ret->lilypond = arena_strdup (arena, orig->lilypond);
+  return ret;
+}
+
 /**
  *  Create a new stem directive
  *  @param type the stem directive type
@@ -8,6 +8,7 @@
 #define OBJOPS_H
 
 #include <denemo/denemo.h>
+#include "core/arena.h"
 
 DenemoObject *get_object (void);
 
@@ -47,6 +48,12 @@ DenemoDirective *clone_directive (DenemoDirective * directive);
 
 GList *clone_directives (GList * directives);
 
+DenemoDirective *freeze_directive (DenemoDirective * directive, DenemoArena * arena);
+
+GList *freeze_directives (GList * directives, DenemoArena * arena);
+
+DenemoObject *freeze_object (DenemoObject * orig, DenemoArena * arena);
+
 void free_directives (GList * directives);
 
 void free_directive (DenemoDirective * directive);
@@ -67,6 +67,142 @@ point_to_new_movement (DenemoProject * gui)
   gui->movement->undo_guard = Denemo.prefs.disable_undo;
 }
 
+#define MAX_REALIZED_MOVEMENTS (8)
+/* destroy the widgets of movement, keeping their content, so that it is re-built on the next visit */
+static void
+evict_movement (DenemoMovement * movement)
+{
+  evict_verses (movement);
+  evict_movement_directive_widgets (movement);
+  movement->widgets_deferred = TRUE;
+}
+
+/**
+ * Give every staff of si as many measures as the longest one and si a width for each measure.
+ * For importers, which build the measure lists of the staffs directly and need not
+ * produce staffs of the same length.
+ */
+void
+pad_movement_measures (DenemoMovement * si)
+{
+  staffnode *curstaff;
+  gint maxmeasures = 0;
+  for (curstaff = si->thescore; curstaff; curstaff = curstaff->next)
+    maxmeasures = MAX (maxmeasures, ((DenemoStaff *) curstaff->data)->nummeasures);
+  if (maxmeasures == 0)
+    maxmeasures = 1;
+  for (curstaff = si->thescore; curstaff; curstaff = curstaff->next)
+    {
+      DenemoStaff *staff = (DenemoStaff *) curstaff->data;
+      for (; staff->nummeasures < maxmeasures; staff->nummeasures++)
+        staff->themeasures = g_list_append (staff->themeasures, g_malloc0 (sizeof (DenemoMeasure)));
+      staff_invalidate_measure_index (staff);
+    }
+  while (g_list_length (si->measurewidths) < maxmeasures)
+    si->measurewidths = g_list_append (si->measurewidths, GINT_TO_POINTER (si->measurewidth));
+}
+
+/**
+ * Compute the cached contexts, note heights, beaming, accidentals and positions for the whole of si
+ * in one pass, after its staffs have been built directly.
+ */
+void
+recache_movement (DenemoMovement * si)
+{
+  staffnode *curstaff;
+  for (curstaff = si->thescore; curstaff; curstaff = curstaff->next)
+    {
+      cache_staff (curstaff);
+      staff_fix_note_heights ((DenemoStaff *) curstaff->data);
+      staff_beams_and_stems_dirs ((DenemoStaff *) curstaff->data);
+      staff_show_which_accidentals ((DenemoStaff *) curstaff->data);
+    }
+  find_xes_in_all_measures (si);
+  find_leftmost_allcontexts (si);
+}
+
+/**
+ * Return the staff of si if it is still the single empty measure a new movement starts with, else NULL.
+ */
+DenemoStaff *
+movement_blank_staff (DenemoMovement * si)
+{
+  DenemoStaff *staff;
+  if (!si->thescore || si->thescore->next)
+    return NULL;
+  staff = (DenemoStaff *) si->thescore->data;
+  if (staff->themeasures && !staff->themeasures->next && !((DenemoMeasure *) staff->themeasures->data)->objects)
+    return staff;
+  return NULL;
+}
+
+static guint visits;            /* counts the visits to movements, to find the one left idle longest */
+static guint realize_idle;      /* the idle source realizing the current movement, 0 if none is pending */
+
+/**
+ * Build the widgets of movement, one of the movements of gui, that were deferred when it was loaded
+ * (verse views and movement directive buttons) and record the visit. Once more than MAX_REALIZED_MOVEMENTS
+ * movements have their widgets built those of the movement left idle longest are evicted, never those of
+ * movement or of the current movement.
+ */
+void
+realize_movement (DenemoProject * gui, DenemoMovement * movement)
+{
+  if (movement == NULL)
+    return;
+  movement->last_visit = ++visits;
+  if (!movement->widgets_deferred)
+    return;
+  movement->widgets_deferred = FALSE;
+  if (Denemo.non_interactive)
+    return;
+  realize_verses (movement);
+  realize_movement_directive_widgets (movement);
+  for (;;)
+    {
+      GList *g;
+      DenemoMovement *idlest = NULL;
+      gint realized = 0;
+      for (g = gui->movements; g; g = g->next)
+        {
+          DenemoMovement *mvt = (DenemoMovement *) g->data;
+          if (mvt->widgets_deferred)
+            continue;
+          realized++;
+          if (mvt != movement && mvt != gui->movement && (idlest == NULL || mvt->last_visit < idlest->last_visit))
+            idlest = mvt;
+        }
+      if (realized <= MAX_REALIZED_MOVEMENTS || idlest == NULL)
+        break;
+      evict_movement (idlest);
+    }
+}
+
+static gboolean
+realize_current_movement (G_GNUC_UNUSED gpointer data)
+{
+  realize_idle = 0;
+  if (Denemo.project)
+    realize_movement (Denemo.project, Denemo.project->movement);
+  return FALSE;
+}
+
+/**
+ * Record a visit to the current movement of gui, as when it is drawn. If its widgets were deferred
+ * they are built from an idle, as building them, and evicting those of other movements, must not
+ * be done while drawing.
+ */
+void
+visit_movement (DenemoProject * gui)
+{
+  DenemoMovement *movement = gui->movement;
+  if (movement == NULL)
+    return;
+  movement->last_visit = ++visits;
+  if (movement->widgets_deferred && !Denemo.non_interactive && realize_idle == 0)
+    realize_idle = g_idle_add (realize_current_movement, NULL);
+}
+
 static void select_movement (gint movementnum) {
    gboolean ok = goto_movement_staff_obj (NULL, movementnum, 1, 1, 0, 0);// this was moving to the movement but failing on the staff num g_print ("ok is %d\n", ok);
     set_movement_selector (Denemo.project);
@@ -415,8 +551,7 @@ get_object_by_position (gint movementnum, gint staffnum, gint measurenum, gint o
   DenemoMovement *movement = this->data;
   this = g_list_nth (movement->thescore, staffnum - 1);
   if (this == NULL) return NULL;
-  DenemoStaff *thestaff = (DenemoStaff*)this->data;
-  this = g_list_nth (thestaff->themeasures, measurenum -1);
+  this = staff_nth_measure_node (this, measurenum -1);
   if (this==NULL) return NULL;
   this = g_list_nth (((DenemoMeasure*)this->data)->objects, objnum-1);
   if (this==NULL) return NULL;
@@ -722,13 +857,16 @@ extract_verses (GList * verses)
   return ret;
 }
 
-static void clone_staff (DenemoStaff *srcStaff, DenemoStaff *thestaff)
+/* copy srcStaff into thestaff, srcStaff may be a frozen staff (see freeze_staff ()) whose verse_views already hold the text of the verses */
+static void clone_staff (DenemoStaff *srcStaff, DenemoStaff *thestaff, gboolean frozen)
 {
  //   There are things like
  //   measurenode *measures; /**< This is a pointer to each measure in the staff */ actually a GList * of measures.
 // and nummeasures which must be fixed by the caller.
     memcpy (thestaff, srcStaff, sizeof (DenemoStaff));
     thestaff->staffmenu = thestaff->voicemenu = NULL;
+    thestaff->measure_index = NULL;
+    thestaff->syllable_marks = NULL;
     thestaff->sources = NULL;
     thestaff->denemo_name = g_string_new (srcStaff->denemo_name->str);
     thestaff->lily_name = g_string_new (srcStaff->lily_name->str);
@@ -793,21 +931,34 @@ static void clone_staff (DenemoStaff *srcStaff, DenemoStaff *thestaff)
     }
 
 
+    GList *verse;
 //this rather horrible: it is for the snapshot() routine
 //the verses not the verse_views are extracted, and then select.c expects that!
 //the reason is there is nowhere on the DenemoStaff structure to store the index of the current view,
 //so the current_verse_view is set to the index'th element of staff->verse_views.
 //so the only other way, other than creating a special field for a snapshotted staff would be to store a pointer into staff->verses in the current_verse_view field
 //which select.c would have to know about. Not much better.
-    thestaff->verse_views = extract_verses (srcStaff->verse_views);
+    if (frozen)
+      {
+        thestaff->verse_views = NULL;
+        for (verse = srcStaff->verse_views; verse; verse = verse->next)
+          thestaff->verse_views = g_list_append (thestaff->verse_views, g_strdup (verse->data));
+      }
+    else
+      thestaff->verse_views = extract_verses (srcStaff->verse_views);
+    //the text of verses not yet realized as views is held only in staff->verses, so it is copied rather than shared
+    thestaff->verses = NULL;
+    for (verse = srcStaff->verses; verse; verse = verse->next)
+      thestaff->verses = g_list_prepend (thestaff->verses, g_strdup (verse->data));
+    thestaff->verses = g_list_reverse (thestaff->verses);
     gint pos = verse_get_current (srcStaff);
     if (pos>=0)
      thestaff->current_verse_view = g_list_nth (thestaff->verse_views, pos);
 }
 
 
-DenemoMovement *
-clone_movement (DenemoMovement * si)
+static DenemoMovement *
+copy_movement (DenemoMovement * si, gboolean frozen)
 {
   DenemoMovement *newscore = (DenemoMovement *) g_malloc0 (sizeof (DenemoMovement));
   memcpy (newscore, si, sizeof (DenemoMovement));
@@ -824,7 +975,7 @@ clone_movement (DenemoMovement * si)
       DenemoStaff *srcStaff = (DenemoStaff *) g->data;
       // staff_copy(srcStaff, thestaff);!!!!!! does not copy e.g. no of lines ... need proper clone code.
       DenemoStaff *thestaff = (DenemoStaff *)g_malloc(sizeof(DenemoStaff));
-      clone_staff (srcStaff, thestaff);
+      clone_staff (srcStaff, thestaff, frozen);
       newscore->lyricsbox = NULL;
       newscore->thescore = g_list_append (newscore->thescore, thestaff);
       if (g == si->currentprimarystaff)
@@ -879,6 +1030,181 @@ clone_movement (DenemoMovement * si)
   return newscore;
 }
 
+DenemoMovement *
+clone_movement (DenemoMovement * si)
+{
+  return copy_movement (si, FALSE);
+}
+
+/* copy srcStaff into arena as clone_staff () does onto the heap, leaving the text of its verses in verse_views.
+ * If verse_texts srcStaff->verse_views already hold the text of the verses rather than their views */
+static DenemoStaff *
+freeze_staff (DenemoStaff * srcStaff, DenemoArena * arena, gboolean verse_texts)
+{
+  DenemoStaff *thestaff = (DenemoStaff *) arena_memdup (arena, srcStaff, sizeof (DenemoStaff));
+  GList *g;
+  thestaff->staffmenu = thestaff->voicemenu = NULL;
+  thestaff->measure_index = NULL;
+  thestaff->syllable_marks = NULL;
+  thestaff->sources = NULL;
+  thestaff->denemo_name = arena_string_new (arena, srcStaff->denemo_name->str);
+  thestaff->lily_name = arena_string_new (arena, srcStaff->lily_name->str);
+  thestaff->midi_instrument = arena_string_new (arena, srcStaff->midi_instrument->str);
+  thestaff->device_port = arena_string_new (arena, srcStaff->device_port->str);
+  thestaff->clef.directives = freeze_directives (srcStaff->clef.directives, arena);
+  thestaff->keysig.directives = freeze_directives (srcStaff->keysig.directives, arena);
+  thestaff->timesig.directives = freeze_directives (srcStaff->timesig.directives, arena);
+  thestaff->leftmost_clefcontext = &thestaff->clef;     //as clone_staff () does
+  thestaff->leftmost_timesig = &thestaff->timesig;
+  thestaff->leftmost_keysig = &thestaff->keysig;
+  thestaff->staff_directives = freeze_directives (srcStaff->staff_directives, arena);
+  thestaff->voice_directives = freeze_directives (srcStaff->voice_directives, arena);
+
+  thestaff->verse_views = NULL;
+  for (g = srcStaff->verse_views; g; g = g->next)
+    {
+      gchar *text = verse_texts ? g_strdup (g->data) : get_text_from_view (GTK_WIDGET (g->data));
+      thestaff->verse_views = arena_list_prepend (arena, thestaff->verse_views, arena_strdup (arena, text));
+      g_free (text);
+    }
+  thestaff->verse_views = g_list_reverse (thestaff->verse_views);
+  thestaff->verses = NULL;
+  for (g = srcStaff->verses; g; g = g->next)
+    thestaff->verses = arena_list_prepend (arena, thestaff->verses, arena_strdup (arena, g->data));
+  thestaff->verses = g_list_reverse (thestaff->verses);
+  thestaff->current_verse_view = g_list_nth (thestaff->verse_views, verse_get_current (srcStaff));
+  thestaff->themeasures = NULL;
+  return thestaff;
+}
+
+static DenemoMovement *
+copy_movement_to_arena (DenemoMovement * si, DenemoArena * arena, gboolean verse_texts)
+{
+  DenemoMovement *newscore = (DenemoMovement *) arena_memdup (arena, si, sizeof (DenemoMovement));
+  GList *g;
+  newscore->measurewidths = NULL;
+  for (g = si->measurewidths; g; g = g->next)
+    newscore->measurewidths = arena_list_prepend (arena, newscore->measurewidths, g->data);
+  newscore->measurewidths = g_list_reverse (newscore->measurewidths);
+  newscore->playingnow = NULL;
+  newscore->lyricsbox = NULL;
+  newscore->currentmeasure = newscore->currentobject = NULL;
+
+  for (newscore->thescore = NULL, g = si->thescore; g; g = g->next)
+    {
+      DenemoStaff *srcStaff = (DenemoStaff *) g->data;
+      DenemoStaff *thestaff = freeze_staff (srcStaff, arena, verse_texts);
+      GList *h;
+      newscore->thescore = arena_list_prepend (arena, newscore->thescore, thestaff);
+      if (g == si->currentprimarystaff)
+        newscore->currentprimarystaff = newscore->thescore;
+      if (g == si->currentstaff)
+        newscore->currentstaff = newscore->thescore;
+      for (h = srcStaff->themeasures; h; h = h->next)
+        {
+          DenemoMeasure *newmeasure = (DenemoMeasure *) arena_alloc (arena, sizeof (DenemoMeasure));
+          GList *i;
+          for (i = ((DenemoMeasure *) h->data)->objects; i; i = i->next)
+            {
+              newmeasure->objects = arena_list_prepend (arena, newmeasure->objects, freeze_object ((DenemoObject *) i->data, arena));
+              if (i == si->currentobject)
+                newscore->currentobject = newmeasure->objects;
+            }
+          newmeasure->objects = g_list_reverse (newmeasure->objects);
+          thestaff->themeasures = arena_list_prepend (arena, thestaff->themeasures, newmeasure);
+          if (h == si->currentmeasure)
+            newscore->currentmeasure = thestaff->themeasures;
+        }
+      thestaff->themeasures = g_list_reverse (thestaff->themeasures);
+    }
+  newscore->thescore = g_list_reverse (newscore->thescore);
+
+  newscore->movementcontrol.directives = freeze_directives (si->movementcontrol.directives, arena);
+  newscore->layout.directives = freeze_directives (si->layout.directives, arena);
+  newscore->header.directives = freeze_directives (si->header.directives, arena);
+  newscore->smfsync = G_MAXINT;
+  newscore->markstaffnum = 0;   //Do not clone the selection
+  return newscore;
+}
+
+/**
+ * Copy the music of a movement into arena, for holding as an undo snapshot.
+ * The copy is made in a few large blocks and is given back by arena_free (), which
+ * takes time in proportion to the number of blocks rather than of objects.
+ * It is not a usable movement, thaw_movement () makes one from it.
+ * @param si the movement to copy
+ * @param arena the arena to hold the copy
+ * @return the frozen movement
+ */
+DenemoMovement *
+freeze_movement (DenemoMovement * si, DenemoArena * arena)
+{
+  return copy_movement_to_arena (si, arena, FALSE);
+}
+
+/* free the music of a movement taken out of the score by undoing to a snapshot, see refreeze_movement ().
+ * Only what copy_movement () allocated is freed: the widgets, MIDI data and undo queues
+ * are shared with the movement that replaced it. */
+static void
+free_displaced_movement (DenemoMovement * si)
+{
+  GList *g, *h;
+  for (g = si->thescore; g; g = g->next)
+    {
+      DenemoStaff *staff = (DenemoStaff *) g->data;
+      for (h = staff->themeasures; h; h = h->next)
+        freeobjlist (((DenemoMeasure *) h->data)->objects);
+      g_list_free_full (staff->themeasures, g_free);
+      staff_invalidate_measure_index (staff);
+      free_directives (staff->clef.directives);
+      free_directives (staff->keysig.directives);
+      free_directives (staff->timesig.directives);
+      free_directives (staff->staff_directives);
+      free_directives (staff->voice_directives);
+      g_string_free (staff->denemo_name, TRUE);
+      g_string_free (staff->lily_name, TRUE);
+      g_string_free (staff->midi_instrument, TRUE);
+      g_string_free (staff->device_port, TRUE);
+      g_list_free_full (staff->verse_views, g_free); //the text of the verses, see action_chunk ()
+      g_list_free_full (staff->verses, g_free);
+      g_free (staff);
+    }
+  g_list_free (si->thescore);
+  g_list_free (si->measurewidths);
+  free_directives (si->movementcontrol.directives);
+  free_directives (si->layout.directives);
+  free_directives (si->header.directives);
+  g_free (si);
+}
+
+/**
+ * Move a movement taken out of the score by undoing to a snapshot into arena, so that
+ * it is held for redo as a snapshot is and is freed with the arena.
+ * The movement's verse_views must hold the text of its verses, as action_chunk () leaves them.
+ * @param si the movement, which is freed
+ * @param arena the arena to hold the copy
+ * @return the frozen movement
+ */
+DenemoMovement *
+refreeze_movement (DenemoMovement * si, DenemoArena * arena)
+{
+  DenemoMovement *frozen = copy_movement_to_arena (si, arena, TRUE);
+  free_displaced_movement (si);
+  return frozen;
+}
+
+/**
+ * Make a movement on the heap from one frozen by freeze_movement (),
+ * which can then be freed with its arena.
+ * @param frozen the frozen movement
+ * @return the new movement
+ */
+DenemoMovement *
+thaw_movement (DenemoMovement * frozen)
+{
+  return copy_movement (frozen, TRUE);
+}
+
 
 
 
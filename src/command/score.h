@@ -5,6 +5,7 @@
  * (c) 2000-2005 Matthew Hiller */
 
 #include <denemo/denemo.h>
+#include "core/arena.h"
 
 #ifndef SCOREOPS_H
 #define SCOREOPS_H
@@ -12,7 +13,15 @@
 void point_to_empty_movement /*new_empty_score */ (DenemoProject * gui);
 void point_to_new_movement /*new_score */ (DenemoProject * gui);
 void init_score (DenemoMovement * si, DenemoProject * gui);
+void realize_movement (DenemoProject * gui, DenemoMovement * movement);
+void visit_movement (DenemoProject * gui);
+void pad_movement_measures (DenemoMovement * si);
+void recache_movement (DenemoMovement * si);
+DenemoStaff *movement_blank_staff (DenemoMovement * si);
 DenemoMovement *clone_movement (DenemoMovement * si);
+DenemoMovement *freeze_movement (DenemoMovement * si, DenemoArena * arena);
+DenemoMovement *refreeze_movement (DenemoMovement * si, DenemoArena * arena);
+DenemoMovement *thaw_movement (DenemoMovement * frozen);
 void free_movement (DenemoProject * gui);
 void deletescore (GtkWidget * widget, DenemoProject * gui);
 void updatescoreinfo (DenemoProject * gui);
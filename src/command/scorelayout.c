@@ -25,6 +25,7 @@
 #include "printview/printview.h"
 #include "command/lilydirectives.h"
 #include "command/score.h"
+#include "command/lyric.h"
 #include "command/processstaffname.h"
 #include "core/view.h"
 #include "core/menusystem.h"
@@ -44,6 +45,8 @@ static void install_duplicate_movement_callback (DenemoScoreblock * sb);
 static void reorder_movement_callback (DenemoScoreblock * psb);
 static gboolean edit_lilypond_prefix (GtkWidget * widget, gchar * oldval, gchar * newval);
 static void reload_scorewide_block (GtkWidget * frame);
+static void realize_scoreblock_view (DenemoScoreblock * sb);
+static void realize_current_scoreblock_view (void);
 static gint layout_sync;
 
 // Reverses (reflects) bits in a 32-bit word.
@@ -249,6 +252,139 @@ get_versename (gint movementnum, gint voice_count, gint versenum)
   return g_string_free (name, FALSE);
 }
 
+/* The LilyPond text making up a standard layout. The builders of the Score Layout window attach
+ * these texts to the widgets, while standard_scoreblock_lilypond () appends them directly, so the
+ * text is defined only here. All return newly allocated strings. */
+
+#define LILYPOND_MOVEMENT_START "\n\\score { %Start of Movement\n"
+#define LILYPOND_MOVEMENT_END "\n       } %End of Movement\n"
+#define LILYPOND_HEADER_START "\n\\header {\n"
+#define LILYPOND_HEADER_END "\n        }\n"
+#define LILYPOND_LAYOUT_START "\n\\layout {\n"
+#define LILYPOND_LAYOUT_END "\n}\n"
+#define LILYPOND_PAPER_START "\\paper {\n"
+#define LILYPOND_PAPER_END "\n       }\n"
+#define LILYPOND_STAFFS_END "\n          >>\n"
+#define LILYPOND_SCORE_OVERRIDE_END "\n          >>\n>>"
+#define LILYPOND_MISSING_GROUP_END " >>%Missing staff group end inserted here\n"
+#define LILYPOND_PART_GROUP_END " >>%Closing staff group end for part layout\n"
+
+static gchar *
+lilypond_for_tagline (void)
+{
+  gchar *escaped_name = g_strescape (Denemo.project->filename->str, NULL);
+  gchar *tagline = g_strdup_printf ("tagline = \\markup {\"%s\" on \\simple #(strftime \"%%x\" (localtime (current-time)))}\n", escaped_name);
+  g_free (escaped_name);
+  return tagline;
+}
+
+static gchar *
+lilypond_for_paper_size (void)
+{
+  DenemoProject *gui = Denemo.project;
+  return g_strdup_printf ("#(set-default-paper-size \"%s\"%s)\n", gui->lilycontrol.papersize->str, gui->lilycontrol.orientation ? "" : " 'landscape");
+}
+
+static gchar *
+lilypond_for_staff_size (void)
+{
+  return g_strdup_printf ("#(set-global-staff-size %s)\n", Denemo.project->lilycontrol.staffsize->str);
+}
+
+//the start of a score directive wrapping the staffs of each movement, see install_scoreblock_overrides ()
+static gchar *
+lilypond_for_score_override (DenemoDirective * d)
+{
+  return g_strdup_printf ("\n<< %s\n<< ", d->postfix->str);
+}
+
+static gchar *
+lilypond_for_staffs_start (DenemoMovement * si)
+{
+  GString *start = g_string_new ("");
+  set_initiate_scoreblock (si, start);  // ie << possibly overridden
+  return g_string_free (start, FALSE);
+}
+
+static gchar *
+lilypond_for_chord_names (gint movementnum, gint voice_count)
+{
+  gchar *voicename = get_voicename (movementnum, voice_count);
+  gchar *text = g_strdup_printf ("\n" TAB TAB "\\new ChordNames \\chordmode { \\%sChords }\n", voicename);
+  g_free (voicename);
+  return text;
+}
+
+static gchar *
+lilypond_for_bass_figures (gint movementnum, gint voice_count)
+{
+  gchar *voicename = get_voicename (movementnum, voice_count);
+  gchar *text = g_strdup_printf ("\n" TAB TAB "\\context Staff \\with {implicitBassFigures = #'(0) } \\%sBassFiguresLine %%End of bass figures\n", voicename);
+  g_free (voicename);
+  return text;
+}
+
+static gchar *
+lilypond_for_staff_start (DenemoStaff * staff)
+{
+  GString *text = g_string_new ("");
+  set_staff_definition (text, staff);   // TAKES DENEMO_ALT_OVERRIDE that are DENEMO_OVERRIDE_AFFIX in exportlilypond
+  return g_string_free (text, FALSE);
+}
+
+static gchar *
+lilypond_for_staff_end (DenemoStaff * staff)
+{
+  GString *text = g_string_new ("");
+  set_staff_termination (text, staff);  // "\n>>\n%End of Staff\n"
+  return g_string_free (text, FALSE);
+}
+
+static gchar *
+lilypond_for_staff_finalize (DenemoStaff * staff)
+{
+  GString *text = g_string_new ("");
+  set_staff_finalize (text, staff);
+  return g_string_free (text, FALSE);
+}
+
+static gchar *
+lilypond_for_voice_start (DenemoStaff * staff, gchar * voicetag)
+{
+  GString *voicetext = g_string_new ("");
+  //That is \new Voice = name prefix { postfix FIXME is prefix any use here????
+  set_voice_definition (voicetext, staff, voicetag);
+  gchar *text = g_strdup_printf (" %s ", voicetext->str);
+  g_string_free (voicetext, TRUE);
+  return text;
+}
+
+static gchar *
+lilypond_for_voice_end (DenemoStaff * staff)
+{
+  GString *voicetext = g_string_new ("");
+  set_voice_termination (voicetext, staff);     // TAB TAB"} %End of voice" if not overridden
+  return g_string_free (voicetext, FALSE);
+}
+
+static gchar *
+lilypond_for_voice_music (gchar * voicename)
+{
+  return g_strdup_printf (" \\%s", voicename);
+}
+
+static gchar *
+lilypond_for_verse_start (gchar * versename)
+{
+  return g_strdup_printf ("\n" TAB "\\new Lyrics = %s\n", versename /*e.g. MvmntIVoiceIVerseI */ );
+}
+
+static gchar *
+lilypond_for_verse_context (gchar * versename)
+{
+  return g_strdup_printf ("\n" TAB "\\%s%s", versename, "Context\n");
+}
+
 //Change the name of the scoreblock to user given value
 static gboolean
 name_scoreblock (DenemoScoreblock * sb, gchar * name)
@@ -345,7 +481,8 @@ static void
 delete_standard_scoreblock_callback (GtkWidget * widget, DenemoScoreblock * sb)
 {
   Denemo.project->standard_scoreblocks = g_list_remove (Denemo.project->standard_scoreblocks, sb);
-  gtk_widget_destroy (sb->widget);
+  if (sb->widget)
+    gtk_widget_destroy (sb->widget);
   if (Denemo.project->standard_scoreblocks == NULL && Denemo.project->custom_scoreblocks == NULL)
     create_default_scoreblock ();
   score_status (Denemo.project, TRUE);
@@ -420,6 +557,7 @@ static DenemoScoreblock *
 clone_scoreblock (DenemoScoreblock * sb, gchar * name)
 {
   gchar *partname = g_strdup (sb->partname);
+  realize_scoreblock_view (sb);
   //prune_layout (sb->widget);
   GtkWidget *options = get_options_button (sb, TRUE);
   gtk_widget_show_all (options);
@@ -716,7 +854,7 @@ create_voice_widget (DenemoStaff * staff, gchar * voicename, guint location)
   g_signal_connect (w, "clicked", G_CALLBACK (remove_element), NULL);
   gtk_box_pack_end (GTK_BOX (ret), w, FALSE, TRUE, 0);
 
-  gchar *text = g_strdup_printf (" \\%s", voicename);
+  gchar *text = lilypond_for_voice_music (voicename);
   gchar *label_text = _("Initial Signatures");
   if (staff->voicecontrol == DENEMO_PRIMARY)
     {
@@ -800,13 +938,7 @@ install_voice (DenemoStaff * staff, gint movementnum, gint voice_count, GtkWidge
   gchar *voicename = get_voicename (movementnum, voice_count);
   GtkWidget *voice = create_voice_widget (staff, voicename, get_location (movementnum, voice_count));
 
-  GString *voicetext = g_string_new ("");
-  //That is \new Voice = name prefix { postfix FIXME is prefix any use here????
-  set_voice_definition (voicetext, staff, voicetag);
-  gchar *text = g_strdup_printf (" %s ", voicetext->str);
-  g_string_assign (voicetext, "");
-  set_voice_termination (voicetext, staff);     // TAB TAB"} %End of voice" if not overridden
-  add_lilypond (voice, text, g_string_free (voicetext, FALSE));
+  add_lilypond (voice, lilypond_for_voice_start (staff, voicetag), lilypond_for_voice_end (staff));
 
 
   gtk_box_pack_start (GTK_BOX (vbox), voice, FALSE, TRUE, 0);
@@ -815,20 +947,17 @@ install_voice (DenemoStaff * staff, gint movementnum, gint voice_count, GtkWidge
 static void
 do_verses (DenemoStaff * staff, GtkWidget * vbox, gint movementnum, gint voice_count)
 {
-  //FIXME do text of the verses get_text_from_view(GtkWidget *textview) where staff->verse_views->data is textview widget
-  GList *g = staff->verse_views;
-  gint versenum = 1;
+  gint versenum, count = staff_verse_count (staff);
   if (!staff->hide_lyrics)
-    for (versenum = 1; g; g = g->next, versenum++)
+    for (versenum = 1; versenum <= count; versenum++)
       {
         gchar *versename = get_versename (movementnum, voice_count, versenum);
-        gchar *context_text = g_strdup_printf ("\n" TAB "\\%s%s", versename, "Context\n");
+        gchar *context_text = lilypond_for_verse_context (versename);
         //gchar *label = g_strconcat("Lyrics:", staff->denemo_name->str, NULL);
         gchar *label = g_strdup_printf ("Verse %d: %s", versenum, staff->denemo_name->str);
         GtkWidget *voice = create_lyric_widget (context_text, label);
         g_free (label);
-        gchar *lyrics = g_strdup_printf ("\n" TAB "\\new Lyrics = %s\n", versename /*e.g. MvmntIVoiceIVerseI */ );
-        add_lilypond (voice, lyrics, NULL);     //FIXME the destroy of these widgets should free the string
+        add_lilypond (voice, lilypond_for_verse_start (versename), NULL);     //FIXME the destroy of these widgets should free the string
         add_lilypond (voice, NULL, context_text);
 
         gtk_box_pack_start (GTK_BOX (vbox), voice, FALSE, TRUE, 0);     //has to go outside the staff
@@ -1031,6 +1160,81 @@ popup_movement_titles_menu (GtkWidget * button)
     warningdialog (_("This button is for changing the score itself, it will not affect this custom layout"));
 }
 
+/* Which of the score's directives are laid out where. These tests choose the directives both for the
+ * widgets of the Score Layout window and for the text of a standard layout (standard_scoreblock_lilypond ()).
+ */
+
+/* movement directives placed before (prefix) and after (postfix) the movement */
+static gboolean
+movement_prolog_directive (DenemoDirective * d, DenemoScoreblock * sb)
+{
+  if (d->override & (DENEMO_OVERRIDE_AFFIX | DENEMO_OVERRIDE_HIDDEN))
+    return FALSE;
+  return !(sb && wrong_layout (d, sb->id));
+}
+
+/* movement directives placed at the end of the movement's \score block */
+static gboolean
+movement_block_directive (DenemoDirective * d, DenemoScoreblock * sb)
+{
+  if (sb && wrong_layout (d, sb->id))
+    return FALSE;
+  return (d->override & DENEMO_OVERRIDE_AFFIX) && d->postfix;
+}
+
+/* movement header and layout directives */
+static gboolean
+block_directive (DenemoDirective * d, DenemoScoreblock * sb)
+{
+  if (d->override & DENEMO_OVERRIDE_HIDDEN)
+    return FALSE;
+  if (sb && wrong_layout (d, sb->id))
+    return FALSE;
+  return d->postfix && d->postfix->len;
+}
+
+/* score directives whose postfix wraps the staffs of each movement, see install_scoreblock_overrides () */
+static gboolean
+score_override_directive (DenemoDirective * d, DenemoScoreblock * sb)
+{
+  if (d->override & (DENEMO_OVERRIDE_AFFIX | DENEMO_OVERRIDE_HIDDEN))
+    return FALSE;
+  if (wrong_layout (d, sb->id))
+    return FALSE;
+  return d->postfix && d->postfix->len;
+}
+
+/* score header directives */
+static gboolean
+score_header_directive (DenemoDirective * d, DenemoScoreblock * sb)
+{
+  if (d->override & (DENEMO_OVERRIDE_AFFIX | DENEMO_OVERRIDE_HIDDEN))
+    return FALSE;
+  return d->postfix && !wrong_layout (d, sb->id);
+}
+
+/* score directives placed before the movements */
+static gboolean
+score_directive (DenemoDirective * d, DenemoScoreblock * sb)
+{
+  if (wrong_layout (d, sb->id))
+    return FALSE;
+  return d->prefix && !(d->override & DENEMO_OVERRIDE_AFFIX);
+}
+
+/* score directives placed after the movements */
+static gboolean
+score_epilog_directive (DenemoDirective * d, DenemoScoreblock * sb)
+{
+  if (d->override & DENEMO_OVERRIDE_HIDDEN)
+    return FALSE;
+  if (!(d->override & DENEMO_OVERRIDE_AFFIX))
+    return FALSE;
+  if (wrong_layout (d, sb->id))
+    return FALSE;
+  return d->postfix && d->postfix->len;
+}
+
 /* installs movement titles, page breaks etc
  *
  */
@@ -1070,13 +1274,7 @@ install_pre_movement_widgets (GtkWidget * vbox, DenemoMovement * si, gboolean st
   for (g = si->movementcontrol.directives; g; g = g->next)
     {
       DenemoDirective *d = (DenemoDirective *) g->data;
-      if (d->override & DENEMO_OVERRIDE_AFFIX)  //see set_initiate_scoreblock() call which outputs the DENEMO_OVERRIDE_AFFIX
-        continue;
-      if (d->override & DENEMO_OVERRIDE_HIDDEN)
-        continue;
-      if (sb && wrong_layout (d, sb->id))
-        continue;
-      if (d->prefix)
+      if (movement_prolog_directive (d, sb) && d->prefix)
         {
           gchar *text = label_for_directive (d);
           GtkWidget *label = gtk_label_new (text);
@@ -1114,15 +1312,7 @@ install_scoreblock_overrides (GtkWidget * vbox, DenemoProject * gui, DenemoMovem
   for (g = gui->lilycontrol.directives; g; g = g->next)
     {
       DenemoDirective *d = g->data;
-      if (d->override & DENEMO_OVERRIDE_HIDDEN)
-        continue;
-      if (d->override & DENEMO_OVERRIDE_AFFIX)
-        continue;
-      if (wrong_layout (d, sb->id))
-        continue;
-
-      gchar *start = (d->postfix && d->postfix->len) ? d->postfix->str : NULL;
-      if (start)
+      if (score_override_directive (d, sb))
         {
           GtkWidget *frame = gtk_frame_new (NULL);
 
@@ -1131,8 +1321,7 @@ install_scoreblock_overrides (GtkWidget * vbox, DenemoProject * gui, DenemoMovem
           g_free (text);
           gtk_frame_set_label_widget (GTK_FRAME (frame), button);
           gtk_box_pack_start (GTK_BOX (vbox), frame, FALSE, TRUE, 0);
-          gchar *lily = g_strdup_printf ("\n<< %s\n<< ", start);
-          add_lilypond (frame, lily, g_strdup ("\n          >>\n>>"));
+          add_lilypond (frame, lilypond_for_score_override (d), g_strdup (LILYPOND_SCORE_OVERRIDE_END));
 
           GtkWidget *menu = gtk_menu_new ();
           GtkWidget *menuitem = gtk_menu_item_new_with_label ("Edit");
@@ -1320,8 +1509,85 @@ move_context_down (GtkWidget * button, GtkWidget * parent)
 }
 */
 
-static GtkWidget *
-install_staff_group_start (GList ** pstaffs, GtkWidget * vbox, GList * directives, gint * nesting)
+/* A movement's staffs are laid out by one traversal, walk_movement_staffs (), both for their widgets
+ * in the Score Layout window and for the LilyPond text of a standard layout (see standard_scoreblock_lilypond ()).
+ * The traversal decides which staffs, voices, verses and staff groups are included and calls the sink for each
+ * in the order the widgets are built.
+ */
+typedef struct StaffLayoutSink
+{
+  void (*group_start) (gpointer data, DenemoDirective * directive);
+  void (*group_end) (gpointer data, DenemoDirective * directive);
+  void (*chord_names) (gpointer data, gint movementnum, gint voice_count);
+  void (*staff_start) (gpointer data, DenemoStaff * staff, gint staff_count, gint movementnum, gint voice_count, gboolean with_voices);
+  void (*bass_figures) (gpointer data, gint movementnum, gint voice_count);
+  void (*voice) (gpointer data, DenemoStaff * staff, gint movementnum, gint voice_count);
+  void (*verses) (gpointer data, DenemoStaff * staff, gint movementnum, gint voice_count);
+  void (*staff_finalize) (gpointer data, DenemoStaff * staff, gint staff_count);
+  void (*staff_done) (gpointer data, DenemoStaff * staff);
+  void (*unterminated_group) (gpointer data, const gchar * lilypond);
+} StaffLayoutSink;
+
+/* the widgets a movement's staffs are being installed in */
+typedef struct LayoutWidgets
+{
+  GList **pstaffs;              /* the staff frames of the scoreblock */
+  GtkWidget *vbox;              /* where the staffs go, inside any open staff group frame */
+  GtkWidget *voices_vbox;       /* where the voices of the current staff go */
+} LayoutWidgets;
+
+static void
+widget_group_start (gpointer data, DenemoDirective * directive)
+{
+  LayoutWidgets *lw = (LayoutWidgets *) data;
+  GtkWidget *frame = (GtkWidget *) gtk_frame_new (directive->tag->str);
+  add_lilypond (frame, directive->prefix ? g_strdup (directive->prefix->str) : NULL, directive->postfix ? g_strdup (directive->postfix->str) : NULL);
+  *lw->pstaffs = g_list_append (*lw->pstaffs, frame);
+  g_signal_connect (G_OBJECT (frame), "destroy", G_CALLBACK (remove_from_staff_list), lw->pstaffs);
+  gtk_box_pack_start (GTK_BOX (lw->vbox), frame, FALSE, TRUE, 0);
+  GtkWidget *hbox = gtk_hbox_new (FALSE, 8);
+  gtk_container_add (GTK_CONTAINER (frame), hbox);
+
+
+  GtkWidget *layout = gtk_drawing_area_new ();
+  gtk_widget_set_tooltip_text (layout, _("This brace connects together several staffs - you can delete it for a customized layout."));
+
+#if GTK_MAJOR_VERSION == 2
+  g_signal_connect (G_OBJECT (layout), "expose_event", G_CALLBACK (draw_staff_brace_gtk2), directive->tag->str);
+#else
+  g_signal_connect (G_OBJECT (layout), "draw", G_CALLBACK (draw_staff_brace_for_layout), directive->tag->str);
+#endif
+
+  gint width = 20, height = 100;
+  gtk_widget_set_size_request (layout, width, height);
+
+  gtk_box_pack_start (GTK_BOX (hbox), layout, TRUE, TRUE, 0);
+
+
+  GtkWidget *controls = gtk_vbox_new (FALSE, 8);
+  gtk_box_pack_start (GTK_BOX (hbox), controls, FALSE, TRUE, 0);
+
+  GtkWidget *button = gtk_button_new_with_label ("X");
+  gtk_widget_set_tooltip_text (button, _("Remove this staff brace from these staffs for a customized layout."));
+  g_signal_connect (button, "clicked", G_CALLBACK (remove_context), hbox);
+  gtk_box_pack_start (GTK_BOX (controls), button, FALSE, TRUE, 0);
+  lw->vbox = gtk_vbox_new (FALSE, 8);   //this vbox is where the staffs are put inside this staff group frame.
+  gtk_box_pack_end (GTK_BOX (hbox), lw->vbox, FALSE, TRUE, 0);
+}
+
+/* closes one staff group frame, whatever number of ends the directive gives */
+static void
+widget_group_end (gpointer data, DenemoDirective * directive)
+{
+  LayoutWidgets *lw = (LayoutWidgets *) data;
+  //show_type (gtk_widget_get_parent (vbox), "Adding beam ends to type: "); g_print ("Specifically %s to %p\n", directive->postfix->str, gtk_widget_get_parent (vbox));
+  add_lilypond (gtk_widget_get_parent (lw->vbox), NULL, g_strdup (directive->postfix->str));
+  lw->vbox = gtk_widget_get_parent (gtk_widget_get_parent (gtk_widget_get_parent (lw->vbox)));
+}
+
+/* calls the sink for the staff group starts among directives */
+static void
+walk_staff_group_start (const StaffLayoutSink * sink, gpointer data, GList * directives, gint * nesting)
 {
   GList *g;
   for (g = directives; g; g = g->next)
@@ -1333,48 +1599,16 @@ install_staff_group_start (GList ** pstaffs, GtkWidget * vbox, GList * directive
             continue;
           if (directive->prefix && (directive->prefix->len > 0))
             {
-              GtkWidget *frame = (GtkWidget *) gtk_frame_new (directive->tag->str);
-              add_lilypond (frame, directive->prefix ? g_strdup (directive->prefix->str) : NULL, directive->postfix ? g_strdup (directive->postfix->str) : NULL);
               (*nesting)++;
-              *pstaffs = g_list_append (*pstaffs, frame);
-              g_signal_connect (G_OBJECT (frame), "destroy", G_CALLBACK (remove_from_staff_list), pstaffs);
-              gtk_box_pack_start (GTK_BOX (vbox), frame, FALSE, TRUE, 0);
-              GtkWidget *hbox = gtk_hbox_new (FALSE, 8);
-              gtk_container_add (GTK_CONTAINER (frame), hbox);
-
-
-              GtkWidget *layout = gtk_drawing_area_new ();
-              gtk_widget_set_tooltip_text (layout, _("This brace connects together several staffs - you can delete it for a customized layout."));
-
-#if GTK_MAJOR_VERSION == 2
-              g_signal_connect (G_OBJECT (layout), "expose_event", G_CALLBACK (draw_staff_brace_gtk2), directive->tag->str);
-#else
-              g_signal_connect (G_OBJECT (layout), "draw", G_CALLBACK (draw_staff_brace_for_layout), directive->tag->str);
-#endif
-
-              gint width = 20, height = 100;
-              gtk_widget_set_size_request (layout, width, height);
-
-              gtk_box_pack_start (GTK_BOX (hbox), layout, TRUE, TRUE, 0);
-
-
-              GtkWidget *controls = gtk_vbox_new (FALSE, 8);
-              gtk_box_pack_start (GTK_BOX (hbox), controls, FALSE, TRUE, 0);
-
-              GtkWidget *button = gtk_button_new_with_label ("X");
-              gtk_widget_set_tooltip_text (button, _("Remove this staff brace from these staffs for a customized layout."));
-              g_signal_connect (button, "clicked", G_CALLBACK (remove_context), hbox);
-              gtk_box_pack_start (GTK_BOX (controls), button, FALSE, TRUE, 0);
-              vbox = gtk_vbox_new (FALSE, 8);   //this vbox will be passed back so that the staffs can be put inside this staff group frame.
-              gtk_box_pack_end (GTK_BOX (hbox), vbox, FALSE, TRUE, 0);
+              sink->group_start (data, directive);
             }
         }
     }
-  return vbox;
 }
 
-static GtkWidget *
-install_staff_group_end (GtkWidget * vbox, GList * directives, gint * nesting)
+/* calls the sink for the staff group ends among directives */
+static void
+walk_staff_group_end (const StaffLayoutSink * sink, gpointer data, GList * directives, gint * nesting)
 {
   GList *g;
   for (g = directives; g; g = g->next)
@@ -1389,23 +1623,20 @@ install_staff_group_end (GtkWidget * vbox, GList * directives, gint * nesting)
             {
               if (*nesting)
                 {
-                  //show_type (gtk_widget_get_parent (vbox), "Adding beam ends to type: "); g_print ("Specifically %s to %p\n", directive->postfix->str, gtk_widget_get_parent (vbox));
-                  add_lilypond (gtk_widget_get_parent (vbox), NULL, g_strdup (directive->postfix->str));
                   gint number_of_ends = 1;
                   if (directive->data)
                     number_of_ends = atoi (directive->data->str);
                   if (number_of_ends < 0 || (number_of_ends > 10))
                     number_of_ends = 1; //sanity check on data in directive
 
+                  sink->group_end (data, directive);
                   (*nesting) -= number_of_ends;
-                  vbox = gtk_widget_get_parent (gtk_widget_get_parent (gtk_widget_get_parent (vbox)));
                 }
               else
                 g_warning ("Badly placed end of staff group - ignored");
             }
         }
     }
-  return vbox;
 }
 
 static GtkWidget *
@@ -1496,30 +1727,22 @@ add_staff_widget (DenemoStaff * staff, GtkWidget * hbox)
 
 
 static void
-install_staff_with_voices (GList ** pstaffs, GtkWidget ** pvbox, gchar * partname, GList ** pstafflist, gint * pvoice_count, gint staff_count, gint movementnum, gint * pstaff_group_nesting, gboolean standard, gboolean append_only)
+widget_chord_names (gpointer data, gint movementnum, gint voice_count)
 {
-  DenemoMovement *si = Denemo.project->movement;
-  GList *g = *pstafflist;
-  GtkWidget *vbox = *pvbox;
-  DenemoStaff *staff = g->data;
-  DenemoStaff *nextstaff = g->next ? g->next->data : NULL;
-
-
-  //if (partname == NULL) Don't omit staff groups start for single part, since parts can be multi-staff e.g. piano, it will be closed at the end if the part doesn't include the close
-  if (!append_only)
-    vbox = install_staff_group_start (pstaffs, vbox, staff->staff_directives, pstaff_group_nesting);
-
-  if (staff->hasfakechords)
-    {                           //the reason these are outside the staff frame is it makes them appear above the staff
-      GtkWidget *chords = gtk_label_new (_("Chord Symbols"));
-      gchar *text = g_strdup_printf ("\n" TAB TAB "\\new ChordNames \\chordmode { \\%sChords }\n",
-                                     get_voicename (movementnum, (*pvoice_count)));
-      add_lilypond (chords, text, NULL);
-      gtk_box_pack_start (GTK_BOX (vbox), chords, FALSE, TRUE, 0);
-      *pstaffs = g_list_append (*pstaffs, chords);
-      g_signal_connect (G_OBJECT (chords), "destroy", G_CALLBACK (remove_from_staff_list), pstaffs);
-    }
+  LayoutWidgets *lw = (LayoutWidgets *) data;
+  //the reason these are outside the staff frame is it makes them appear above the staff
+  GtkWidget *chords = gtk_label_new (_("Chord Symbols"));
+  add_lilypond (chords, lilypond_for_chord_names (movementnum, voice_count), NULL);
+  gtk_box_pack_start (GTK_BOX (lw->vbox), chords, FALSE, TRUE, 0);
+  *lw->pstaffs = g_list_append (*lw->pstaffs, chords);
+  g_signal_connect (G_OBJECT (chords), "destroy", G_CALLBACK (remove_from_staff_list), lw->pstaffs);
+}
 
+static void
+widget_staff_start (gpointer data, DenemoStaff * staff, gint staff_count, gint movementnum, gint voice_count, gboolean with_voices)
+{
+  LayoutWidgets *lw = (LayoutWidgets *) data;
+  DenemoMovement *si = Denemo.project->movement;
   gchar *label_text = (si->thescore->next == NULL) ? g_strdup (_("Staff Start")) : g_strdup_printf (_("Staff %d Start"), staff_count);
   GtkWidget *frame = gtk_frame_new (NULL);
 
@@ -1534,7 +1757,7 @@ install_staff_with_voices (GList ** pstaffs, GtkWidget ** pvbox, gchar * partnam
   GtkWidget *menu = gtk_menu_new ();
   GtkWidget *menuitem = gtk_menu_item_new_with_label (_("Move Denemo Cursor to this staff"));
   gtk_widget_set_tooltip_text (menuitem, _("This will move the Denemo Cursor to the start of this staff in this movement"));
-  g_signal_connect (G_OBJECT (menuitem), "activate", G_CALLBACK (navigate_to_location), GINT_TO_POINTER (get_location (movementnum, (*pvoice_count))));
+  g_signal_connect (G_OBJECT (menuitem), "activate", G_CALLBACK (navigate_to_location), GINT_TO_POINTER (get_location (movementnum, voice_count)));
   gtk_menu_shell_append (GTK_MENU_SHELL (menu), menuitem);
 
 
@@ -1546,36 +1769,17 @@ install_staff_with_voices (GList ** pstaffs, GtkWidget ** pvbox, gchar * partnam
 
   gtk_widget_show_all (menu);
   g_signal_connect (button, "clicked", G_CALLBACK (popup), menu);
-#if 0
-//having buttons that affect the score itself is confusing
-  if (standard && (si->thescore->next != NULL))
-    {
-      button = gtk_button_new_with_label (_("Set Staff Group Start/End"));
-      mark_as_non_custom (button);
-      gtk_box_pack_start (GTK_BOX (staff_hbox), button, FALSE, TRUE, 0);
-      gtk_widget_set_tooltip_text (button, _("The braces { and [ binding staffs together can be set here. Set the start on one staff and the end on a later staff.\nThis is editing the score, not just customizing a layout.\nRefresh the layout view (see under Options for this Layout button at the top) once you have made the changes."));
-      g_signal_connect (button, "button-press-event", G_CALLBACK (staff_groups_menu), GINT_TO_POINTER (get_location (movementnum, (*pvoice_count))));
-    }
-#endif
-  *pstaffs = g_list_append (*pstaffs, frame);
-  g_signal_connect (G_OBJECT (frame), "destroy", G_CALLBACK (remove_from_staff_list), pstaffs);
-
-  GString *staffprefix = g_string_new ("");
-  set_staff_definition (staffprefix, staff); // TAKES DENEMO_ALT_OVERRIDE that are DENEMO_OVERRIDE_AFFIX in exportlilypond
+  *lw->pstaffs = g_list_append (*lw->pstaffs, frame);
+  g_signal_connect (G_OBJECT (frame), "destroy", G_CALLBACK (remove_from_staff_list), lw->pstaffs);
 
   // if (staff->no_of_lines != 5) now done by a directive
   //   g_string_append_printf (staffprefix, TAB "\\override Staff.StaffSymbol  #'line-count = #%d\n", staff->no_of_lines);     //FIXME create_element
 
-  GString *stafftext = g_string_new ("");
-  g_string_assign (stafftext, "");
-  set_staff_termination (stafftext, staff);     // "\n>>\n%End of Staff\n"
-
-
-  add_lilypond (frame, g_string_free (staffprefix, FALSE), g_string_free (stafftext, FALSE));
+  add_lilypond (frame, lilypond_for_staff_start (staff), lilypond_for_staff_end (staff));
 
 
 
-  gtk_box_pack_start (GTK_BOX (vbox), frame, FALSE, TRUE, 0);
+  gtk_box_pack_start (GTK_BOX (lw->vbox), frame, FALSE, TRUE, 0);
 
   GtkWidget *outer_vbox = gtk_vbox_new (FALSE, 8);
   gtk_container_add (GTK_CONTAINER (frame), outer_vbox);
@@ -1585,49 +1789,86 @@ install_staff_with_voices (GList ** pstaffs, GtkWidget ** pvbox, gchar * partnam
 
   GtkWidget *hbox = gtk_hbox_new (FALSE, 8);
   gtk_box_pack_end (GTK_BOX (outer_vbox), hbox, FALSE, TRUE, 0);
-  //gtk_container_add (GTK_CONTAINER (frame), hbox);
   add_staff_widget (staff, hbox);
 
-  label_text = (nextstaff && nextstaff->voicecontrol & DENEMO_SECONDARY) ? _("Voices") : _("Voice");
-  GtkWidget *expander = gtk_expander_new (label_text);
+  GtkWidget *expander = gtk_expander_new (with_voices ? _("Voices") : _("Voice"));
   gtk_widget_set_tooltip_text (expander, _("This holds the voice(s) of the staff - the clef, time signature, key signature and music are all here"));
-  //gtk_container_add (GTK_CONTAINER (frame), expander);
   gtk_box_pack_end (GTK_BOX (hbox), expander, FALSE, TRUE, 0);
-  GtkWidget *voices_vbox = gtk_vbox_new (FALSE, 8);
-  gtk_container_add (GTK_CONTAINER (expander), voices_vbox);
+  lw->voices_vbox = gtk_vbox_new (FALSE, 8);
+  gtk_container_add (GTK_CONTAINER (expander), lw->voices_vbox);
+}
 
-  if (staff->hasfigures)
-    {
-      GtkWidget *voice = gtk_label_new ("Bass figures");
-      gchar *text = g_strdup_printf ("\n" TAB TAB "\\context Staff \\with {implicitBassFigures = #'(0) } \\%sBassFiguresLine %%End of bass figures\n",
-                                     get_voicename (movementnum, (*pvoice_count)));
-      add_lilypond (voice, text, NULL);
-      gtk_box_pack_start (GTK_BOX (voices_vbox), voice, FALSE, TRUE, 0);
-    }
+static void
+widget_bass_figures (gpointer data, gint movementnum, gint voice_count)
+{
+  GtkWidget *voice = gtk_label_new ("Bass figures");
+  add_lilypond (voice, lilypond_for_bass_figures (movementnum, voice_count), NULL);
+  gtk_box_pack_start (GTK_BOX (((LayoutWidgets *) data)->voices_vbox), voice, FALSE, TRUE, 0);
+}
 
-  install_voice (staff, movementnum, (*pvoice_count), voices_vbox);     //Primary voice
-  do_verses (staff, vbox, movementnum, (*pvoice_count));
+static void
+widget_voice (gpointer data, DenemoStaff * staff, gint movementnum, gint voice_count)
+{
+  install_voice (staff, movementnum, voice_count, ((LayoutWidgets *) data)->voices_vbox);
+}
 
-{  
-    label_text = (si->thescore->next == NULL) ? g_strdup (_("Staff End")) : g_strdup_printf (_("Staff %d End"), staff_count);
-     GString *text = g_string_new ("");
-    set_staff_finalize (text, staff);
-    GtkWidget *butt = gtk_button_new_with_label (label_text);
-    g_free (label_text);
-    create_element (vbox, butt,  g_string_free (text, FALSE));
+static void
+widget_verses (gpointer data, DenemoStaff * staff, gint movementnum, gint voice_count)
+{
+  do_verses (staff, ((LayoutWidgets *) data)->vbox, movementnum, voice_count);  //!!! these need *pstaffs = g_list_append(*pstaffs, voice); treatment too...
+}
+
+static void
+widget_staff_finalize (gpointer data, DenemoStaff * staff, gint staff_count)
+{
+  gchar *label_text = (Denemo.project->movement->thescore->next == NULL) ? g_strdup (_("Staff End")) : g_strdup_printf (_("Staff %d End"), staff_count);
+  GtkWidget *butt = gtk_button_new_with_label (label_text);
+  g_free (label_text);
+  create_element (((LayoutWidgets *) data)->vbox, butt, lilypond_for_staff_finalize (staff));
+}
+
+static void
+widget_unterminated_group (gpointer data, const gchar * lilypond)
+{
+  add_lilypond (((LayoutWidgets *) data)->vbox, NULL, g_strdup (lilypond));
 }
 
+static const StaffLayoutSink widget_layout_sink = {
+  widget_group_start, widget_group_end, widget_chord_names, widget_staff_start, widget_bass_figures,
+  widget_voice, widget_verses, widget_staff_finalize, NULL, widget_unterminated_group
+};
+
+/* lays out the staff at *pstafflist with the voices that follow it, leaving *pstafflist at its last voice */
+static void
+walk_staff_with_voices (const StaffLayoutSink * sink, gpointer data, GList ** pstafflist, gchar * partname, gint * pvoice_count, gint staff_count, gint movementnum, gint * pstaff_group_nesting, gboolean append_only)
+{
+  GList *g = *pstafflist;
+  DenemoStaff *staff = g->data;
+  DenemoStaff *nextstaff = g->next ? g->next->data : NULL;
+  gboolean with_voices = nextstaff && (nextstaff->voicecontrol & DENEMO_SECONDARY);
+
+  //if (partname == NULL) Don't omit staff groups start for single part, since parts can be multi-staff e.g. piano, it will be closed at the end if the part doesn't include the close
+  if (!append_only)
+    walk_staff_group_start (sink, data, staff->staff_directives, pstaff_group_nesting);
 
-  if (nextstaff && (nextstaff->voicecontrol & DENEMO_SECONDARY))
+  if (staff->hasfakechords)
+    sink->chord_names (data, movementnum, (*pvoice_count));
+  sink->staff_start (data, staff, staff_count, movementnum, (*pvoice_count), with_voices);
+  if (staff->hasfigures)
+    sink->bass_figures (data, movementnum, (*pvoice_count));
+  sink->voice (data, staff, movementnum, (*pvoice_count));      //Primary voice
+  sink->verses (data, staff, movementnum, (*pvoice_count));
+  sink->staff_finalize (data, staff, staff_count);
+
+  if (with_voices)
     {
       for (g = g->next, (*pvoice_count)++; g && (((DenemoStaff *) g->data)->voicecontrol & DENEMO_SECONDARY); g = g->next, (*pvoice_count)++)
         {
-
-          DenemoStaff *staff = g->data;
-          install_voice (staff, movementnum, (*pvoice_count), voices_vbox);
-          do_verses (staff, vbox, movementnum, (*pvoice_count));        //!!! these need *pstaffs = g_list_append(*pstaffs, voice); treatment too...
+          DenemoStaff *voice = g->data;
+          sink->voice (data, voice, movementnum, (*pvoice_count));
+          sink->verses (data, voice, movementnum, (*pvoice_count));
           if (partname == NULL)
-            vbox = install_staff_group_end (vbox, staff->staff_directives, pstaff_group_nesting);
+            walk_staff_group_end (sink, data, voice->staff_directives, pstaff_group_nesting);
         }
       if (g != NULL)
         {
@@ -1636,64 +1877,26 @@ install_staff_with_voices (GList ** pstaffs, GtkWidget ** pvbox, gchar * partnam
         }
     }
   if (partname == NULL)         //Have to omit all end braces for part layouts, since the part may not include all the start braces for them.
-    vbox = install_staff_group_end (vbox, staff->staff_directives, pstaff_group_nesting);
+    walk_staff_group_end (sink, data, staff->staff_directives, pstaff_group_nesting);
+  if (sink->staff_done)
+    sink->staff_done (data, staff);
   *pstafflist = g;
-  *pvbox = vbox;
 }
 
+/* lays out the staffs of movement si which belong to partname (all of them if it is NULL) */
 static void
-append_staff (GtkWidget * widget, GList ** pstaffs)
-{
-  if (!clone_scoreblock_if_needed (widget))
-    return;
-  gint staff_group_nesting = 0;
-  gint voice_count = Denemo.project->movement->currentstaffnum;
-  gint movementnum = 1;
-  if (Denemo.project->movements)
-    movementnum = 1 + g_list_index (Denemo.project->movements, Denemo.project->movement);
-  GtkWidget *vbox = gtk_widget_get_parent (widget);
-  install_staff_with_voices (pstaffs, &vbox, NULL, &Denemo.project->movement->currentstaff, &voice_count, Denemo.project->movement->currentstaffnum, movementnum, &staff_group_nesting, FALSE, TRUE);
-  gtk_widget_show_all (vbox);
-  Denemo.project->lilysync = G_MAXUINT;
-}
-
-static GtkWidget *
-get_movement_widget (GList ** pstaffs, gchar * partname, DenemoMovement * si, gint movementnum, gboolean last_movement, gboolean standard, DenemoScoreblock * sb)
+walk_movement_staffs (const StaffLayoutSink * sink, gpointer data, gchar * partname, DenemoMovement * si, gint movementnum)
 {
-  DenemoProject *gui = Denemo.project;
   gint staff_group_nesting = 0; //to check on loose staff group markers
   gint voice_count;             //a count of voices from the very top of the score (ie DenemoStaffs in thescore)
   gint staff_count;             //a count of staffs excluding voices from top of score
-  GtkWidget *ret = gtk_frame_new (NULL);
-  GString *start = g_string_new ("");
-  set_initiate_scoreblock (si, start);  // ie << possibly overridden
-  add_lilypond (ret, g_string_free (start, FALSE), g_strdup ("\n          >>\n"));
-
-  GtkWidget *vbox = gtk_vbox_new (FALSE, 8);
-  gtk_container_add (GTK_CONTAINER (ret), vbox);
-
-  vbox = install_scoreblock_overrides (vbox, gui, si, last_movement, sb);       //things like transpose whole score etc
-
-  gchar *label_text = (si->thescore->next == NULL) ? _("The Staff") : _("The Staffs");
-  GtkWidget *topexpander = gtk_expander_new (label_text);
-  gtk_widget_set_tooltip_text (topexpander, _("This holds the staffs below which are the voices with the music."));
-  gtk_expander_set_expanded (GTK_EXPANDER (topexpander), si == Denemo.project->movement);
-  gtk_box_pack_start (GTK_BOX (vbox), topexpander, FALSE, TRUE, 0);
-  vbox = gtk_vbox_new (FALSE, 8);
-  gtk_container_add (GTK_CONTAINER (topexpander), vbox);
-  GtkWidget *addbutton = gtk_button_new_with_label (_("Append Current Staff"));
-  gtk_widget_set_tooltip_text (addbutton, _("Appends the current staff (the one where the cursor is in the Denemo Display) to this layout. The same staff can be placed at multiple positions in the layout with individual edits in each."));
-
-  gtk_box_pack_start (GTK_BOX (vbox), addbutton, FALSE, TRUE, 0);
-  g_signal_connect (G_OBJECT (addbutton), "clicked", G_CALLBACK (append_staff), pstaffs);
-
   GList *g;
   for (voice_count = 1, staff_count = 1, g = si->thescore; g; g = g->next, voice_count++, staff_count++)
     {
       DenemoStaff *staff = g->data;
       if ((*(staff->lily_name->str)) && (partname && strcmp (partname, staff->lily_name->str))) // empty partname means include with all parts.
         continue;
-      install_staff_with_voices (pstaffs, &vbox, partname, &g, &voice_count, staff_count /*sic */ , movementnum, &staff_group_nesting, standard, FALSE);
+      walk_staff_with_voices (sink, data, &g, partname, &voice_count, staff_count /*sic */ , movementnum, &staff_group_nesting, FALSE);
 
       if (g == NULL)
         break;
@@ -1705,22 +1908,62 @@ get_movement_widget (GList ** pstaffs, gchar * partname, DenemoMovement * si, gi
     }
   else
     {
-
       for (; staff_group_nesting; staff_group_nesting--)
         {
           if (partname == NULL)
             {
               g_warning ("Staff group start without end - terminating it");
-              add_lilypond (vbox, NULL, g_strdup (" >>%Missing staff group end inserted here\n"));
+              sink->unterminated_group (data, LILYPOND_MISSING_GROUP_END);
             }
           else
-            add_lilypond (vbox, NULL, g_strdup (" >>%Closing staff group end for part layout\n"));
-
+            sink->unterminated_group (data, LILYPOND_PART_GROUP_END);
         }
     }
+}
+
+static void
+append_staff (GtkWidget * widget, GList ** pstaffs)
+{
+  if (!clone_scoreblock_if_needed (widget))
+    return;
+  gint staff_group_nesting = 0;
+  gint voice_count = Denemo.project->movement->currentstaffnum;
+  gint movementnum = 1;
+  if (Denemo.project->movements)
+    movementnum = 1 + g_list_index (Denemo.project->movements, Denemo.project->movement);
+  LayoutWidgets lw = { pstaffs, gtk_widget_get_parent (widget), NULL };
+  walk_staff_with_voices (&widget_layout_sink, &lw, &Denemo.project->movement->currentstaff, NULL, &voice_count, Denemo.project->movement->currentstaffnum, movementnum, &staff_group_nesting, TRUE);
+  gtk_widget_show_all (gtk_widget_get_parent (widget));
+  Denemo.project->lilysync = G_MAXUINT;
+}
+
+static GtkWidget *
+get_movement_widget (GList ** pstaffs, gchar * partname, DenemoMovement * si, gint movementnum, gboolean last_movement, gboolean standard, DenemoScoreblock * sb)
+{
+  DenemoProject *gui = Denemo.project;
+  GtkWidget *ret = gtk_frame_new (NULL);
+  add_lilypond (ret, lilypond_for_staffs_start (si), g_strdup (LILYPOND_STAFFS_END));
+
+  GtkWidget *vbox = gtk_vbox_new (FALSE, 8);
+  gtk_container_add (GTK_CONTAINER (ret), vbox);
+
+  vbox = install_scoreblock_overrides (vbox, gui, si, last_movement, sb);       //things like transpose whole score etc
 
+  gchar *label_text = (si->thescore->next == NULL) ? _("The Staff") : _("The Staffs");
+  GtkWidget *topexpander = gtk_expander_new (label_text);
+  gtk_widget_set_tooltip_text (topexpander, _("This holds the staffs below which are the voices with the music."));
+  gtk_expander_set_expanded (GTK_EXPANDER (topexpander), si == Denemo.project->movement);
+  gtk_box_pack_start (GTK_BOX (vbox), topexpander, FALSE, TRUE, 0);
+  vbox = gtk_vbox_new (FALSE, 8);
+  gtk_container_add (GTK_CONTAINER (topexpander), vbox);
+  GtkWidget *addbutton = gtk_button_new_with_label (_("Append Current Staff"));
+  gtk_widget_set_tooltip_text (addbutton, _("Appends the current staff (the one where the cursor is in the Denemo Display) to this layout. The same staff can be placed at multiple positions in the layout with individual edits in each."));
 
+  gtk_box_pack_start (GTK_BOX (vbox), addbutton, FALSE, TRUE, 0);
+  g_signal_connect (G_OBJECT (addbutton), "clicked", G_CALLBACK (append_staff), pstaffs);
 
+  LayoutWidgets lw = { pstaffs, vbox, NULL };
+  walk_movement_staffs (&widget_layout_sink, &lw, partname, si, movementnum);
 
   return ret;
 }
@@ -1773,6 +2016,325 @@ movement_part_name (gint movement, gchar * partname)
   return g_strdup (DEFAULT_SCORE_LAYOUT);
 }
 
+/* Standard layouts are generated directly from the score, without building their widgets.
+ * The staffs are laid out by walk_movement_staffs (), the same traversal that builds their widgets,
+ * with a sink that appends the texts the widgets are given in the order lilypond_for_layout() recovers them;
+ * the rest of the layout takes the directives chosen by the same tests as the widgets (score_directive () etc).
+ * So a standard layout typesets identically whether or not it has ever been shown in the
+ * Score Layout window. check_standard_scoreblocks () compares the two.
+ */
+
+/* the state of a movement being generated, standing in for the nesting of staff group frames */
+typedef struct LayoutText
+{
+  GString *out;                 /* the LilyPond text so far */
+  GList *groups;                /* GStrings closing each open staff group, innermost first */
+  GString *after;               /* the verses and staff group ends that follow the end of the staff being generated */
+} LayoutText;
+
+/* where the texts outside the staff being generated go */
+static GString *
+layout_text_tail (LayoutText * lt)
+{
+  return lt->after ? lt->after : lt->out;
+}
+
+/* see install_voice () and create_voice_widget () */
+static void
+append_voice (GString * out, DenemoStaff * staff, gint movementnum, gint voice_count)
+{
+  gchar *voicetag = get_voicetag (movementnum, voice_count);
+  gchar *text = lilypond_for_voice_start (staff, voicetag);
+  g_string_append (out, text);
+  g_free (text);
+  if (staff->voicecontrol == DENEMO_PRIMARY)
+    {
+      text = get_lilypond_for_clef (&staff->clef);
+      g_string_append (out, text);
+      g_free (text);
+      text = get_lilypond_for_keysig (&staff->keysig);
+      g_string_append (out, text);
+      g_free (text);
+      text = get_lilypond_for_timesig (&staff->timesig);
+      g_string_append (out, text);
+      g_free (text);
+    }
+  text = lilypond_for_voice_music (voicetag);   //voicetag is the voicename
+  g_string_append (out, text);
+  g_free (text);
+  text = lilypond_for_voice_end (staff);
+  g_string_append (out, text);
+  g_free (text);
+  g_free (voicetag);
+}
+
+/* see do_verses () */
+static void
+append_verses (GString * out, DenemoStaff * staff, gint movementnum, gint voice_count)
+{
+  gint versenum, count = staff_verse_count (staff);
+  if (!staff->hide_lyrics)
+    for (versenum = 1; versenum <= count; versenum++)
+      {
+        gchar *versename = get_versename (movementnum, voice_count, versenum);
+        gchar *text = lilypond_for_verse_start (versename);
+        g_string_append (out, text);
+        g_free (text);
+        text = lilypond_for_verse_context (versename);
+        g_string_append (out, text);
+        g_free (text);
+        g_free (versename);
+      }
+}
+
+static void
+text_group_start (gpointer data, DenemoDirective * directive)
+{
+  LayoutText *lt = (LayoutText *) data;
+  g_string_append (lt->out, directive->prefix->str);
+  lt->groups = g_list_prepend (lt->groups, g_string_new (directive->postfix ? directive->postfix->str : ""));
+}
+
+/* closes one staff group, as widget_group_end () closes one staff group frame */
+static void
+text_group_end (gpointer data, DenemoDirective * directive)
+{
+  LayoutText *lt = (LayoutText *) data;
+  GString *out = layout_text_tail (lt);
+  g_string_append (out, directive->postfix->str);
+  if (lt->groups)
+    {
+      GString *close = lt->groups->data;
+      lt->groups = g_list_delete_link (lt->groups, lt->groups);
+      g_string_append (out, close->str);
+      g_string_free (close, TRUE);
+    }
+}
+
+static void
+text_chord_names (gpointer data, gint movementnum, gint voice_count)
+{
+  gchar *text = lilypond_for_chord_names (movementnum, voice_count);
+  g_string_append (((LayoutText *) data)->out, text);
+  g_free (text);
+}
+
+/* the voices of the staff are typeset inside the staff, its verses and any staff group ends follow the end of the staff, see text_staff_done () */
+static void
+text_staff_start (gpointer data, DenemoStaff * staff, gint staff_count, gint movementnum, gint voice_count, gboolean with_voices)
+{
+  LayoutText *lt = (LayoutText *) data;
+  gchar *text = lilypond_for_staff_start (staff);
+  g_string_append (lt->out, text);
+  g_free (text);
+  lt->after = g_string_new ("");
+}
+
+static void
+text_bass_figures (gpointer data, gint movementnum, gint voice_count)
+{
+  gchar *text = lilypond_for_bass_figures (movementnum, voice_count);
+  g_string_append (((LayoutText *) data)->out, text);
+  g_free (text);
+}
+
+static void
+text_voice (gpointer data, DenemoStaff * staff, gint movementnum, gint voice_count)
+{
+  append_voice (((LayoutText *) data)->out, staff, movementnum, voice_count);
+}
+
+static void
+text_verses (gpointer data, DenemoStaff * staff, gint movementnum, gint voice_count)
+{
+  append_verses (layout_text_tail ((LayoutText *) data), staff, movementnum, voice_count);
+}
+
+static void
+text_staff_finalize (gpointer data, DenemoStaff * staff, gint staff_count)
+{
+  gchar *text = lilypond_for_staff_finalize (staff);
+  g_string_append (layout_text_tail ((LayoutText *) data), text);
+  g_free (text);
+}
+
+static void
+text_staff_done (gpointer data, DenemoStaff * staff)
+{
+  LayoutText *lt = (LayoutText *) data;
+  gchar *text = lilypond_for_staff_end (staff);
+  g_string_append (lt->out, text);
+  g_free (text);
+  g_string_append (lt->out, lt->after->str);
+  g_string_free (lt->after, TRUE);
+  lt->after = NULL;
+}
+
+static void
+text_unterminated_group (gpointer data, const gchar * lilypond)
+{
+  g_string_append (((LayoutText *) data)->out, lilypond);
+}
+
+static const StaffLayoutSink text_layout_sink = {
+  text_group_start, text_group_end, text_chord_names, text_staff_start, text_bass_figures,
+  text_voice, text_verses, text_staff_finalize, text_staff_done, text_unterminated_group
+};
+
+/* see get_movement_widget () and install_scoreblock_overrides () */
+static void
+append_movement_staffs (GString * out, gchar * partname, DenemoMovement * si, gint movementnum, DenemoScoreblock * sb)
+{
+  DenemoProject *gui = Denemo.project;
+  LayoutText lt = { out, NULL, NULL };
+  GString *tail = g_string_new (LILYPOND_STAFFS_END);
+  gchar *text = lilypond_for_staffs_start (si);
+  GList *g;
+
+  g_string_append (out, text);
+  g_free (text);
+  for (g = gui->lilycontrol.directives; g; g = g->next)
+    {
+      DenemoDirective *d = g->data;
+      if (score_override_directive (d, sb))
+        {
+          text = lilypond_for_score_override (d);
+          g_string_append (out, text);
+          g_free (text);
+          g_string_prepend (tail, LILYPOND_SCORE_OVERRIDE_END);
+        }
+    }
+
+  walk_movement_staffs (&text_layout_sink, &lt, partname, si, movementnum);
+
+  for (g = lt.groups; g; g = g->next)
+    {
+      g_string_append (out, ((GString *) g->data)->str);
+      g_string_free ((GString *) g->data, TRUE);
+    }
+  g_list_free (lt.groups);
+  g_string_append (out, tail->str);
+  g_string_free (tail, TRUE);
+}
+
+/* append the postfixes of the header or layout block directives for this layout, see install_movement_widget () */
+static void
+append_block_directives (GString * out, GList * directives, DenemoScoreblock * sb)
+{
+  GList *g;
+  for (g = directives; g; g = g->next)
+    {
+      DenemoDirective *d = g->data;
+      if (block_directive (d, sb))
+        g_string_append (out, d->postfix->str);
+    }
+}
+
+/* see install_movement_widget () and install_pre_movement_widgets () */
+static void
+append_movement (GString * out, DenemoMovement * si, gchar * partname, gint movement_num, DenemoScoreblock * sb)
+{
+  GList *g;
+  for (g = si->movementcontrol.directives; g; g = g->next)
+    {
+      DenemoDirective *d = (DenemoDirective *) g->data;
+      if (movement_prolog_directive (d, sb) && d->prefix)
+        g_string_append (out, d->prefix->str);
+    }
+
+  g_string_append (out, LILYPOND_MOVEMENT_START);
+  append_movement_staffs (out, partname, si, movement_num, sb);
+  if (si->header.directives)
+    {
+      g_string_append (out, LILYPOND_HEADER_START);
+      append_block_directives (out, si->header.directives, sb);
+      g_string_append (out, LILYPOND_HEADER_END);
+    }
+  if (si->layout.directives)
+    {
+      g_string_append (out, LILYPOND_LAYOUT_START);
+      append_block_directives (out, si->layout.directives, sb);
+      g_string_append (out, LILYPOND_LAYOUT_END);
+    }
+  for (g = si->movementcontrol.directives; g; g = g->next)
+    {
+      DenemoDirective *d = (DenemoDirective *) g->data;
+      if (movement_block_directive (d, sb))
+        g_string_append (out, d->postfix->str);
+    }
+  g_string_append (out, LILYPOND_MOVEMENT_END);
+
+  for (g = si->movementcontrol.directives; g; g = g->next)
+    {
+      DenemoDirective *d = (DenemoDirective *) g->data;
+      if (movement_prolog_directive (d, sb) && d->postfix)
+        g_string_append (out, d->postfix->str);
+    }
+}
+
+/* see fill_scorewide_frame () */
+static void
+append_scorewide (GString * out, DenemoScoreblock * sb)
+{
+  DenemoProject *gui = Denemo.project;
+  gchar *text = lilypond_for_tagline ();
+  GList *g;
+
+  g_string_append (out, LILYPOND_HEADER_START);
+  g_string_append (out, text);
+  g_free (text);
+  for (g = gui->scoreheader.directives; g; g = g->next)
+    {
+      DenemoDirective *directive = (DenemoDirective *) g->data;
+      if (score_header_directive (directive, sb))
+        g_string_append (out, directive->postfix->str);
+    }
+  g_string_append (out, LILYPOND_HEADER_END);
+
+  for (g = gui->lilycontrol.directives; g; g = g->next)
+    {
+      DenemoDirective *directive = g->data;
+      if (score_directive (directive, sb))
+        g_string_append (out, directive->prefix->str);
+    }
+
+  text = lilypond_for_paper_size ();
+  g_string_append (out, text);
+  g_free (text);
+  text = lilypond_for_staff_size ();
+  g_string_append (out, text);
+  g_free (text);
+  g_string_append (out, LILYPOND_PAPER_START);
+  text = get_lilypond_paper ();
+  g_string_append (out, text);
+  g_free (text);
+  g_string_append (out, LILYPOND_PAPER_END);
+}
+
+/* append the LilyPond for the standard scoreblock sb to out, generated from the current score. See set_default_scoreblock () */
+static void
+standard_scoreblock_lilypond (GString * out, DenemoScoreblock * sb)
+{
+  DenemoProject *gui = Denemo.project;
+  guint layout_id = gui->layout_id;
+  GList *g;
+  gint movement_num = 1;
+  gui->layout_id = sb->id;      //conditional directives are taken for this layout, as when creating it
+  append_scorewide (out, sb);
+  for (g = gui->movements; g; g = g->next, movement_num++)
+    {
+      if (sb->movement == 0 /*all movements */  || (sb->movement == movement_num) /*this movement */ )
+        append_movement (out, (DenemoMovement *) g->data, sb->partname, movement_num, sb);
+    }
+  for (g = gui->lilycontrol.directives; g; g = g->next)
+    {
+      DenemoDirective *d = g->data;
+      if (score_epilog_directive (d, sb))
+        g_string_append (out, d->postfix->str);
+    }
+  gui->layout_id = layout_id;
+}
+
 static GtkWidget *
 get_event_box (GtkWidget * vbox)
 {
@@ -1793,16 +2355,11 @@ get_event_box (GtkWidget * vbox)
 static void
 create_misc_scorewide (GtkWidget * inner_vbox)
 {
-  DenemoProject *gui = Denemo.project;
-
-
-  gchar *lily = g_strdup_printf ("#(set-default-paper-size \"%s\"%s)\n", gui->lilycontrol.papersize->str, gui->lilycontrol.orientation ? "" : " 'landscape");
-  create_element (inner_vbox, gtk_button_new_with_label (_("paper size")), lily);
-  lily = g_strdup_printf ("#(set-global-staff-size %s)\n", gui->lilycontrol.staffsize->str);
-  create_element (inner_vbox, gtk_button_new_with_label (_("Global staff size")), lily);
+  create_element (inner_vbox, gtk_button_new_with_label (_("paper size")), lilypond_for_paper_size ());
+  create_element (inner_vbox, gtk_button_new_with_label (_("Global staff size")), lilypond_for_staff_size ());
   GtkWidget *expander = gtk_expander_new (_("Paper Block"));
   gtk_widget_set_tooltip_text (expander, _("Settings for whole score: includes overall staff size, paper size ...\n"));
-  add_lilypond (expander, g_strdup ("\\paper {\n"), g_strdup ("\n       }\n"));
+  add_lilypond (expander, g_strdup (LILYPOND_PAPER_START), g_strdup (LILYPOND_PAPER_END));
   gtk_box_pack_start (GTK_BOX (inner_vbox), expander, FALSE, TRUE, 0);
   GtkWidget *paper_box = gtk_vbox_new (FALSE, 8);
   gtk_container_add (GTK_CONTAINER (expander), paper_box);
@@ -1819,30 +2376,20 @@ create_scoreheader_directives (GtkWidget * vbox, DenemoScoreblock * sb)
   gtk_box_pack_start (GTK_BOX (vbox), frame, FALSE, TRUE, 0);
   GtkWidget *top_expander = gtk_expander_new (_("Score Titles"));
   gtk_expander_set_expanded (GTK_EXPANDER (top_expander), TRUE);
-  add_lilypond (top_expander, g_strdup ("\n\\header {\n"), g_strdup ("\n        }\n"));
+  add_lilypond (top_expander, g_strdup (LILYPOND_HEADER_START), g_strdup (LILYPOND_HEADER_END));
   gtk_widget_set_tooltip_text (top_expander, _("Titles, layout settings, preferences etc for the whole score.\nIncludes main title, composer, date, instrumentation, tagline"));
   gtk_container_add (GTK_CONTAINER (frame), top_expander);
   GtkWidget *header_box = gtk_vbox_new (FALSE, 8);
   gtk_container_add (GTK_CONTAINER (top_expander), header_box);
 
-  gchar *escaped_name = g_strescape (gui->filename->str, NULL);
-  gchar *default_tagline = g_strdup_printf ("tagline = \\markup {\"%s\" on \\simple #(strftime \"%%x\" (localtime (current-time)))}\n", escaped_name);
-  g_free (escaped_name);
-  create_element (header_box, gtk_label_new (_("Default tagline")), default_tagline);
+  create_element (header_box, gtk_label_new (_("Default tagline")), lilypond_for_tagline ());
 
   GList *g;
   for (g = gui->scoreheader.directives; g; g = g->next)
     {
       DenemoDirective *directive = (DenemoDirective *) g->data;
-      if (directive->override & (DENEMO_OVERRIDE_AFFIX | DENEMO_OVERRIDE_HIDDEN))
-        continue;
-      if (directive->postfix == NULL)
-        continue;
-      if (wrong_layout (directive, sb->id))
-        continue;
-
-
-      create_element (header_box, gtk_label_new (directive->tag->str), g_strdup (directive->postfix->str));
+      if (score_header_directive (directive, sb))
+        create_element (header_box, gtk_label_new (directive->tag->str), g_strdup (directive->postfix->str));
     }
 }
 
@@ -1864,10 +2411,7 @@ create_score_directives (GtkWidget * vbox, DenemoScoreblock * sb)
   for (; g; g = g->next)
     {
       DenemoDirective *directive = g->data;
-      if (wrong_layout (directive, sb->id))
-        continue;
-
-      if (directive->prefix && !(directive->override & (DENEMO_OVERRIDE_AFFIX)))
+      if (score_directive (directive, sb))
         {
           GtkWidget *label = gtk_label_new (directive->tag->str);
           create_element (inner_vbox, label, g_strdup (directive->prefix->str));
@@ -1967,7 +2511,7 @@ install_movement_widget (DenemoMovement * si, GtkWidget * vbox, DenemoScoreblock
   gtk_box_pack_start (GTK_BOX (outer_hbox), movement_vbox, FALSE, TRUE, 10);
   install_pre_movement_widgets (movement_vbox, si, standard, *psb);
   GtkWidget *frame = gtk_frame_new (NULL);
-  add_lilypond (frame, g_strdup ("\n\\score { %Start of Movement\n"), g_strdup ("\n       } %End of Movement\n"));
+  add_lilypond (frame, g_strdup (LILYPOND_MOVEMENT_START), g_strdup (LILYPOND_MOVEMENT_END));
   gtk_box_pack_start (GTK_BOX (movement_vbox), frame, FALSE, TRUE, 0);
   GtkWidget *outer_vbox = gtk_vbox_new (FALSE, 8);
   gtk_container_add (GTK_CONTAINER (frame), outer_vbox);
@@ -1979,44 +2523,30 @@ install_movement_widget (DenemoMovement * si, GtkWidget * vbox, DenemoScoreblock
     {
       GtkWidget *frame = gtk_frame_new (_("Header block"));
       gtk_box_pack_start (GTK_BOX (outer_vbox), frame, FALSE, TRUE, 0);
-      add_lilypond (frame, g_strdup ("\n\\header {\n"), g_strdup ("\n        }\n"));
+      add_lilypond (frame, g_strdup (LILYPOND_HEADER_START), g_strdup (LILYPOND_HEADER_END));
       GtkWidget *innerbox = gtk_vbox_new (FALSE, 8);
       gtk_container_add (GTK_CONTAINER (frame), innerbox);
       GList *g;
       for (g = si->header.directives; g; g = g->next)
         {
           DenemoDirective *d = g->data;
-          if (d->override & DENEMO_OVERRIDE_HIDDEN)
-            continue;
-          if (sb && wrong_layout (d, sb->id))
-            continue;
-          gchar *lily = (d->postfix && d->postfix->len) ? d->postfix->str : NULL;
-          if (lily)
-            {
-              create_element (innerbox, gtk_button_new_with_label (d->tag->str), g_strdup (lily));
-            }
+          if (block_directive (d, sb))
+            create_element (innerbox, gtk_button_new_with_label (d->tag->str), g_strdup (d->postfix->str));
         }
     }
   if (si->layout.directives)
     {
       GtkWidget *frame = gtk_frame_new (_("Layout block"));
       gtk_box_pack_start (GTK_BOX (outer_vbox), frame, FALSE, TRUE, 0);
-      add_lilypond (frame, g_strdup ("\n\\layout {\n"), g_strdup ("\n}\n"));
+      add_lilypond (frame, g_strdup (LILYPOND_LAYOUT_START), g_strdup (LILYPOND_LAYOUT_END));
       GtkWidget *innerbox = gtk_vbox_new (FALSE, 8);
       gtk_container_add (GTK_CONTAINER (frame), innerbox);
       GList *g;
       for (g = si->layout.directives; g; g = g->next)
         {
           DenemoDirective *d = g->data;
-          if (d->override & DENEMO_OVERRIDE_HIDDEN)
-            continue;
-          if (sb && wrong_layout (d, sb->id))
-            continue;
-          gchar *lily = (d->postfix && d->postfix->len) ? d->postfix->str : NULL;
-          if (lily)
-            {
-              create_element (innerbox, gtk_button_new_with_label (d->tag->str), g_strdup (lily));
-            }
+          if (block_directive (d, sb))
+            create_element (innerbox, gtk_button_new_with_label (d->tag->str), g_strdup (d->postfix->str));
         }
     }
 
@@ -2030,9 +2560,7 @@ install_movement_widget (DenemoMovement * si, GtkWidget * vbox, DenemoScoreblock
       for (g = si->movementcontrol.directives; g; g = g->next)
         {
           DenemoDirective *d = (DenemoDirective *) g->data;
-          if (sb && wrong_layout (d, sb->id))
-            continue;
-          if (d->override & DENEMO_OVERRIDE_AFFIX && d->postfix)
+          if (movement_block_directive (d, sb))
             {
               gchar *text = label_for_directive (d);
               GtkWidget *label = gtk_label_new (text);
@@ -2054,13 +2582,7 @@ install_movement_widget (DenemoMovement * si, GtkWidget * vbox, DenemoScoreblock
       for (g = si->movementcontrol.directives; g; g = g->next)
         {
           DenemoDirective *d = (DenemoDirective *) g->data;
-          if (d->override & DENEMO_OVERRIDE_AFFIX)
-            continue;
-          if (d->override & DENEMO_OVERRIDE_HIDDEN)
-            continue;
-          if (sb && wrong_layout (d, sb->id))
-            continue;
-          if (d->postfix)
+          if (movement_prolog_directive (d, sb) && d->postfix)
             {
               gchar *text = label_for_directive (d);
               GtkWidget *label = gtk_label_new (text);
@@ -2122,44 +2644,59 @@ reorder_movement_callback (DenemoScoreblock * psb)
 
  //find the one that is expanded FIXME
 
-//populates the scoreblock *psb with the movement or movements for partname from the current score Denemo.project
+//sets up the scoreblock *psb for the movement or movements for partname from the current score Denemo.project
+//The LilyPond text is generated from the score when needed (standard_scoreblock_lilypond()), the widgets showing
+//the layout are only created when the layout is viewed or customized (realize_scoreblock_view()).
 static void
 set_default_scoreblock (DenemoScoreblock ** psb, gint movement, gchar * partname)
 {
   DenemoProject *gui = Denemo.project;
   (*psb)->staff_list = NULL;    //list of staff frames in order they appear in scoreblock
-
-  (*psb)->widget = gtk_scrolled_window_new (gtk_adjustment_new (1.0, 1.0, 2.0, 1.0, 4.0, 1.0), gtk_adjustment_new (1.0, 1.0, 2.0, 1.0, 4.0, 1.0));
+  if (!Denemo.non_interactive)
+    (*psb)->widget = gtk_scrolled_window_new (gtk_adjustment_new (1.0, 1.0, 2.0, 1.0, 4.0, 1.0), gtk_adjustment_new (1.0, 1.0, 2.0, 1.0, 4.0, 1.0));
 
   (*psb)->visible = FALSE;      //will be set true when/if tab is selected
   if (partname)
     (*psb)->partname = g_strdup (partname);
   (*psb)->movement = movement;
   layout_sync = (*psb)->layout_sync = gui->layout_sync;
+}
 
+//creates the widgets showing the standard scoreblock sb, unless they already exist.
+//They are placed in sb->widget, which is created if need be.
+static void
+realize_scoreblock_view (DenemoScoreblock * sb)
+{
+  DenemoProject *gui = Denemo.project;
+  guint layout_id = gui->layout_id;
+  if (sb->widget == NULL)
+    sb->widget = gtk_scrolled_window_new (gtk_adjustment_new (1.0, 1.0, 2.0, 1.0, 4.0, 1.0), gtk_adjustment_new (1.0, 1.0, 2.0, 1.0, 4.0, 1.0));
+  else if (gtk_bin_get_child (GTK_BIN (sb->widget)))
+    return;
+  gui->layout_id = sb->id;      //conditional directives are taken for this layout
 
   GtkWidget *vbox = gtk_vbox_new (FALSE, 8);
  
 #if (GTK_MAJOR_VERSION==3 && GTK_MINOR_VERSION<8) 
-           gtk_scrolled_window_add_with_viewport (GTK_SCROLLED_WINDOW ((*psb)->widget), vbox);
+           gtk_scrolled_window_add_with_viewport (GTK_SCROLLED_WINDOW (sb->widget), vbox);
 #else          
-          gtk_container_add (GTK_CONTAINER((*psb)->widget), vbox);
+          gtk_container_add (GTK_CONTAINER(sb->widget), vbox);
 #endif   
   
   
-  GtkWidget *options = get_options_button (*psb, FALSE);
+  GtkWidget *options = get_options_button (sb, FALSE);
   gtk_box_pack_start (GTK_BOX (vbox), options, FALSE, FALSE, 0);
   //now create a hierarchy of widgets representing the score
-  create_scorewide_block (vbox, *psb);
+  create_scorewide_block (vbox, sb);
 
   GList *g;
   gint movement_num = 1;
   for (g = gui->movements; g; g = g->next, movement_num++)
     {
-      if (movement == 0 /*all movements */  || (movement == movement_num) /*this movement */ )
+      if (sb->movement == 0 /*all movements */  || (sb->movement == movement_num) /*this movement */ )
         {
           DenemoMovement *si = (DenemoMovement *) g->data;
-          install_movement_widget (si, vbox, psb, partname, movement_num, !(gboolean) GPOINTER_TO_INT (g->next), TRUE);
+          install_movement_widget (si, vbox, &sb, sb->partname, movement_num, !(gboolean) GPOINTER_TO_INT (g->next), TRUE);
 
         }                       //if movement is wanted
     }                           //for all movements
@@ -2167,21 +2704,72 @@ set_default_scoreblock (DenemoScoreblock ** psb, gint movement, gchar * partname
   for (g = gui->lilycontrol.directives; g; g = g->next)
     {
       DenemoDirective *d = g->data;     // g_print("Trying tag %s postfix %s\n", d->tag->str, d->postfix?d->postfix->str:"No postfix");
-      if (d->override & DENEMO_OVERRIDE_HIDDEN)
-        continue;
-      if (!(d->override & DENEMO_OVERRIDE_AFFIX))
-        continue;
-      if (wrong_layout (d, (*psb)->id))
-        continue;
+      if (score_epilog_directive (d, sb))
+        create_element (vbox, gtk_button_new_with_label (d->tag->str), g_strdup (d->postfix->str));
+    }
+  gui->layout_id = layout_id;
+  gtk_widget_show_all (sb->widget);
+}
+
+//creates the widgets for the standard scoreblock on the current page of the Score Layout window, if it is showing
+static void
+realize_current_scoreblock_view (void)
+{
+  GtkWidget *notebook = get_score_layout_notebook (Denemo.project);
+  GtkWidget *page;
+  GList *g;
+  if (notebook == NULL || !gtk_widget_get_visible (Denemo.project->score_layout))
+    return;
+  page = gtk_notebook_get_nth_page (GTK_NOTEBOOK (notebook), gtk_notebook_get_current_page (GTK_NOTEBOOK (notebook)));
+  for (g = Denemo.project->standard_scoreblocks; g; g = g->next)
+    {
+      DenemoScoreblock *sb = ((DenemoScoreblock *) g->data);
+      if (sb->widget && (sb->widget == page))
+        realize_scoreblock_view (sb);
+    }
+}
 
-      gchar *post = (d->postfix && d->postfix->len) ? d->postfix->str : NULL;
-      if (post)
+/* compares the LilyPond generated from the score for each standard scoreblock with the LilyPond
+ * recovered from its widgets, building them for the comparison if they have not been built,
+ * and creating the default scoreblock if there are no standard ones.
+ * Returns NULL if the widgets cannot be built (no display), otherwise a newly allocated string,
+ * empty if they all agree, or else giving the name of each layout that differs and the two texts */
+gchar *
+check_standard_scoreblocks (void)
+{
+  DenemoProject *gui = Denemo.project;
+  GString *report;
+  GList *g;
+  if (gdk_display_get_default () == NULL)
+    return NULL;
+  if (gui->standard_scoreblocks == NULL)
+    create_default_scoreblock ();
+  report = g_string_new ("");
+  for (g = gui->standard_scoreblocks; g; g = g->next)
+    {
+      DenemoScoreblock *sb = (DenemoScoreblock *) g->data;
+      gboolean had_widget = (sb->widget != NULL);
+      gboolean had_view = had_widget && gtk_bin_get_child (GTK_BIN (sb->widget));
+      GString *generated = g_string_new ("");
+      GString *recovered = g_string_new ("");
+      standard_scoreblock_lilypond (generated, sb);
+      realize_scoreblock_view (sb);
+      lilypond_for_layout (recovered, sb->widget);
+      if (strcmp (generated->str, recovered->str))
+        g_string_append_printf (report, "Layout %s generated from the score:\n%s\nrecovered from its widgets:\n%s\n", sb->name, generated->str, recovered->str);
+      if (!had_widget)
         {
-          create_element (vbox, gtk_button_new_with_label (d->tag->str), g_strdup (post));
+          g_object_ref_sink (sb->widget);
+          gtk_widget_destroy (sb->widget);
+          g_object_unref (sb->widget);
+          sb->widget = NULL;
         }
+      else if (!had_view)
+        gtk_widget_destroy (gtk_bin_get_child (GTK_BIN (sb->widget)));
+      g_string_free (generated, TRUE);
+      g_string_free (recovered, TRUE);
     }
-
-
+  return g_string_free (report, FALSE);
 }
 
 //recompute a standard scoreblock if out of date
@@ -2272,17 +2860,19 @@ change_tab (GtkNotebook * notebook, GtkWidget * page, gint pagenum)
     }
   // Denemo.project->layout_id = 0;
   Denemo.project->lilysync = G_MAXUINT;
+  realize_current_scoreblock_view ();
   return TRUE;
 }
 
 
-//takes a DenemoScoreblock that has a valid widget field and recomputes the lilypond field of the scoreblock
-//from the widget. It also sets the name field of the scoreblock to the name on the Notebook tab.
+//recomputes the lilypond field of the scoreblock, generating it from the score for a standard scoreblock
+//or else from the widget, which must be valid. It also sets the name field of the scoreblock to the name on the Notebook tab.
 // It sets the instrumentation if set in the scoreblock structure.
 void
 refresh_lilypond (DenemoScoreblock * sb)
 {
-  if (sb->widget)
+  gboolean standard = is_in_standard_scoreblock (sb);
+  if (sb->widget || standard)
     {
 
       if ((!is_lilypond_text_layout (sb)))
@@ -2302,7 +2892,10 @@ refresh_lilypond (DenemoScoreblock * sb)
           g_string_prepend (sb->lilypond, "%");
           g_string_append_printf (sb->lilypond, "\n\\header{DenemoLayoutName = \"%s\"\n%s        }\n", sb->name, set_instr);
           g_free (set_instr);
-          lilypond_for_layout (sb->lilypond, sb->widget);
+          if (standard)
+            standard_scoreblock_lilypond (sb->lilypond, sb);
+          else
+            lilypond_for_layout (sb->lilypond, sb->widget);
         }
     }
   else
@@ -2563,6 +3156,7 @@ get_score_layout_notebook (DenemoProject * gui)
       notebook = gtk_notebook_new ();
       g_signal_connect (notebook, "switch_page", G_CALLBACK (change_tab), NULL);
       g_signal_connect (gui->score_layout, "focus-in-event", G_CALLBACK (check_for_update), NULL);
+      g_signal_connect (gui->score_layout, "show", G_CALLBACK (realize_current_scoreblock_view), NULL);
       gtk_container_add (GTK_CONTAINER (gui->score_layout), notebook);
     }
   return notebook;
@@ -2594,11 +3188,14 @@ create_standard_scoreblock (DenemoScoreblock ** psb, gint movement, gchar * part
 static void
 set_notebook_page (GtkWidget * w)
 {
+  if (Denemo.non_interactive || (w == NULL))
+    return;
   GtkWidget *notebook = get_score_layout_notebook (Denemo.project);
   GList *g = gtk_container_get_children (GTK_CONTAINER (notebook));
   gint position = g_list_index (g, w);
   g_list_free (g);
   gtk_notebook_set_current_page (GTK_NOTEBOOK (notebook), position);
+  realize_current_scoreblock_view ();   //no switch-page signal if it was already the current page
 }
 
 void
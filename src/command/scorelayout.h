@@ -51,6 +51,7 @@ void select_custom_layout (DenemoScoreblock * sb);
 gboolean select_custom_layout_for_name (gchar * name);
 GtkWidget *GetLayoutMenu (void);
 void refresh_lilypond (DenemoScoreblock * sb);
+gchar *check_standard_scoreblocks (void);
 gboolean select_layout_id (gint id);
 guint get_layout_id_for_name (gchar * name);
 #endif
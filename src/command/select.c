@@ -59,10 +59,10 @@ clone_obj_list (GList * g)
   GList *ret = NULL;
   do
     {
-      ret = g_list_append (ret, dnm_clone_object (g->data));
+      ret = g_list_prepend (ret, dnm_clone_object (g->data));
     }
   while ((g = g->next));
-  return ret;
+  return g_list_reverse (ret);
 }
 
 // pushes the current copybuffer; pushes a NULL clipboard if none.
@@ -179,7 +179,7 @@ insert_clipboard (GList * clipboard)
       copybuffer = clipboard;
       measurebreaksinbuffer = 0;
       staffsinbuffer = 1;
-      call_out_to_guile ("(d-Paste)");
+      pastewrapper (NULL, NULL);
       copybuffer = NULL;
       pop_clipboard (0);
       displayhelper (Denemo.project);
@@ -229,14 +229,14 @@ copytobuffer (DenemoMovement * si)
       /* Initialize first ->data for copybuffer to NULL.  */
       theobjs = NULL;
       /* Measure loop.  */
-      for (j = si->selection.firstmeasuremarked, k = si->selection.firstobjmarked, curmeasure = g_list_nth (staff_first_measure_node (curstaff), j - 1); curmeasure && j <= si->selection.lastmeasuremarked; curmeasure = curmeasure->next, j++)
+      for (j = si->selection.firstmeasuremarked, k = si->selection.firstobjmarked, curmeasure = staff_nth_measure_node (curstaff, j - 1); curmeasure && j <= si->selection.lastmeasuremarked; curmeasure = curmeasure->next, j++)
         {
           for (curobj = g_list_nth ((objnode *) ((DenemoMeasure*)curmeasure->data)->objects, k);
                /* cursor_x is 0-indexed */
                curobj && (j < si->selection.lastmeasuremarked || k <= si->selection.lastobjmarked); curobj = curobj->next, k++)
             {
               clonedobject = dnm_clone_object ((DenemoObject *) curobj->data);
-              theobjs = g_list_append (theobjs, clonedobject);
+              theobjs = g_list_prepend (theobjs, clonedobject);
             }                   /* End object loop */
           g_debug ("cloned objects on staff \n");
 
@@ -248,7 +248,7 @@ copytobuffer (DenemoMovement * si)
                   /* ???outdated comment??? That is, there's another measure, the cursor is in appending
                      position, or the selection spans multiple staffs, in which
                      case another measure boundary should be added.  */
-                  theobjs = g_list_append (theobjs, newmeasurebreakobject ());
+                  theobjs = g_list_prepend (theobjs, newmeasurebreakobject ());
                   if (i == si->selection.firststaffmarked)
                     measurebreaksinbuffer++;
                 }
@@ -258,15 +258,124 @@ copytobuffer (DenemoMovement * si)
         }                       /* End measure loop */
       if ((staffsinbuffer > 1) && (i < si->selection.laststaffmarked))
         {
-          theobjs = g_list_append (theobjs, newstaffbreakobject ());
+          theobjs = g_list_prepend (theobjs, newstaffbreakobject ());
           g_debug ("Inserting Staffbreak object in copybuffer");
         }
       if (theobjs)
-        copybuffer = g_list_append (copybuffer, theobjs);
+        copybuffer = g_list_append (copybuffer, g_list_reverse (theobjs));
     }                           /* End staff loop */
 }
 
 
+/* make sure si->measurewidths has an entry for every measure of the longest staff */
+static void
+extend_measurewidths (DenemoMovement * si)
+{
+  staffnode *curstaff;
+  gint maxmeasures = 0;
+  gint numwidths = g_list_length (si->measurewidths);
+  for (curstaff = si->thescore; curstaff; curstaff = curstaff->next)
+    maxmeasures = MAX (maxmeasures, ((DenemoStaff *) curstaff->data)->nummeasures);
+  for (; numwidths < maxmeasures; numwidths++)
+    si->measurewidths = g_list_append (si->measurewidths, GINT_TO_POINTER (si->measurewidth));
+}
+
+/* drop entries of si->measurewidths from position pos on, until there are no more than the longest staff has measures */
+static void
+trim_measurewidths (DenemoMovement * si, gint pos)
+{
+  staffnode *curstaff;
+  gint maxmeasures = 0;
+  gint numwidths = g_list_length (si->measurewidths);
+  GList *width = g_list_nth (si->measurewidths, pos);
+  for (curstaff = si->thescore; curstaff; curstaff = curstaff->next)
+    maxmeasures = MAX (maxmeasures, ((DenemoStaff *) curstaff->data)->nummeasures);
+  while (width && numwidths > maxmeasures)
+    {
+      GList *next = width->next;
+      si->measurewidths = g_list_delete_link (si->measurewidths, width);
+      width = next;
+      numwidths--;
+    }
+}
+
+/* re-establish the cached contexts, note heights, accidentals and beaming of a staff after a bulk edit */
+static void
+recache_staff (staffnode * curstaff)
+{
+  cache_staff (curstaff);
+  staff_fix_note_heights ((DenemoStaff *) curstaff->data);
+  staff_show_which_accidentals ((DenemoStaff *) curstaff->data);
+  staff_beams_and_stems_dirs ((DenemoStaff *) curstaff->data);
+}
+
+/* link a new node holding data into *list after the node prev (at the head if prev is NULL), returning the new node */
+static GList *
+link_after (GList ** list, GList * prev, gpointer data)
+{
+  GList *node = g_list_alloc ();
+  node->data = data;
+  node->prev = prev;
+  if (prev)
+    {
+      node->next = prev->next;
+      prev->next = node;
+    }
+  else
+    {
+      node->next = *list;
+      *list = node;
+    }
+  if (node->next)
+    node->next->prev = node;
+  return node;
+}
+
+/* remove count measures starting at measure pos (counting from 0) from the staff, splicing the run out in one step.
+ * A staff is never left without a measure. No undo information is stored, the caller must take a snapshot */
+static void
+staff_remove_measure_run (staffnode * curstaff, gint pos, gint count)
+{
+  DenemoStaff *staff = (DenemoStaff *) curstaff->data;
+  measurenode *first = staff_nth_measure_node (curstaff, pos);
+  measurenode *last, *g;
+  gint i;
+  if (first == NULL || count < 1)
+    return;
+  for (last = first, i = 1; i < count && last->next; i++)
+    last = last->next;
+  if (first->prev)
+    first->prev->next = last->next;
+  else
+    staff->themeasures = last->next;
+  if (last->next)
+    last->next->prev = first->prev;
+  first->prev = last->next = NULL;
+  for (g = first; g; g = g->next)
+    {
+      free_measure ((DenemoMeasure *) g->data);
+      g_free (g->data);
+      staff->nummeasures--;
+    }
+  g_list_free (first);
+  if (staff->themeasures == NULL)
+    {
+      staff->themeasures = g_list_append (NULL, g_malloc0 (sizeof (DenemoMeasure)));
+      staff->nummeasures = 1;
+    }
+  staff_invalidate_measure_index (staff);
+}
+
+/* remove count whole measures starting at measure pos (counting from 0) from every staff of the movement */
+static void
+remove_measure_range (DenemoMovement * si, gint pos, gint count)
+{
+  staffnode *curstaff;
+  for (curstaff = si->thescore; curstaff; curstaff = curstaff->next)
+    staff_remove_measure_run (curstaff, pos, count);
+  trim_measurewidths (si, pos);
+}
+
 /**
  *  cuttobuffer
  *  Cuts selection to the copybuffer, removing it from the score
@@ -300,18 +409,21 @@ cuttobuffer (DenemoMovement * si, gboolean copyfirst)
     {
       /* Just a single staff is a special case, again.  */
       jcounter = si->selection.firstmeasuremarked;      //currently clearing stuff from the firstmeasuremarked
-      curmeasure = g_list_nth (staff_first_measure_node (si->currentstaff), jcounter - 1);
+      curmeasure = staff_nth_measure_node (si->currentstaff, jcounter - 1);
 
       /* Clear the relevant part of the first measure selected */
       if (lmeasurebreaksinbuffer)
         max = G_MAXINT;
       else
         max = si->selection.lastobjmarked;
-      for (i = si->selection.firstobjmarked; ((tempobj = g_list_nth ((objnode *) ((DenemoMeasure*)curmeasure->data)->objects, si->selection.firstobjmarked)) && i <= max); i++)
+      tempobj = g_list_nth ((objnode *) ((DenemoMeasure*)curmeasure->data)->objects, si->selection.firstobjmarked);
+      for (i = si->selection.firstobjmarked; tempobj && i <= max; i++)
         {
+          objnode *nextobj = tempobj->next;
            ((DenemoMeasure*)curmeasure->data)->objects = g_list_remove_link ((objnode *)  ((DenemoMeasure*)curmeasure->data)->objects, tempobj);
           freeobject ((DenemoObject *) tempobj->data);
           g_list_free_1 (tempobj);
+          tempobj = nextobj;
         }
       jcounter++;               //move on to the second measure being cleared
       curmeasure = curmeasure->next;
@@ -322,7 +434,8 @@ cuttobuffer (DenemoMovement * si, gboolean copyfirst)
              remove the (whole) measures between the first and last - which may be partial. */
           if (lmeasurebreaksinbuffer - 1 > 0)
             {
-              curmeasure = removemeasures (si, jcounter - 1, lmeasurebreaksinbuffer - 1, TRUE);
+              remove_measure_range (si, jcounter - 1, lmeasurebreaksinbuffer - 1);
+              curmeasure = staff_nth_measure_node (si->currentstaff, jcounter - 1);
               jcounter += lmeasurebreaksinbuffer - 1;   // increased by the number of measures *between* first and last marked
             }
         }
@@ -346,7 +459,7 @@ cuttobuffer (DenemoMovement * si, gboolean copyfirst)
              one staff.  */
 
           if (!((DenemoMeasure*)curmeasure->data)->objects && !si->thescore->next)
-            removemeasures (si, g_list_position (staff_first_measure_node (si->currentstaff), curmeasure), 1, TRUE);
+            remove_measure_range (si, g_list_position (staff_first_measure_node (si->currentstaff), curmeasure), 1);
         }
 
       cache_staff (si->currentstaff);
@@ -363,15 +476,16 @@ cuttobuffer (DenemoMovement * si, gboolean copyfirst)
           if (lmeasurebreaksinbuffer > 0)
             {
 
-              removemeasures (si, si->selection.firstmeasuremarked - 1, lmeasurebreaksinbuffer + 1, TRUE);
+              remove_measure_range (si, si->selection.firstmeasuremarked - 1, lmeasurebreaksinbuffer + 1);
               staffs_removed_measures = lmeasurebreaksinbuffer;
 
-              cache_all ();
+              for (curstaff = si->thescore; curstaff; curstaff = curstaff->next)
+                recache_staff (curstaff);
             }
           else
             for (curstaff = si->thescore; curstaff; curstaff = curstaff->next)
               {
-                curmeasure = g_list_nth (staff_first_measure_node (curstaff), si->selection.firstmeasuremarked - 1);
+                curmeasure = staff_nth_measure_node (curstaff, si->selection.firstmeasuremarked - 1);
                 freeobjlist ( ((DenemoMeasure*)curmeasure->data)->objects);
                  ((DenemoMeasure*)curmeasure->data)->objects = NULL;
 
@@ -389,7 +503,7 @@ cuttobuffer (DenemoMovement * si, gboolean copyfirst)
               if (((DenemoStaff *) curstaff->data)->is_parasite)
                 continue;
               /* Measure loop */
-              for (jcounter = si->selection.firstmeasuremarked, curmeasure = g_list_nth (staff_first_measure_node (curstaff), jcounter - 1); curmeasure && jcounter <= si->selection.lastmeasuremarked; curmeasure = curmeasure->next, jcounter++)
+              for (jcounter = si->selection.firstmeasuremarked, curmeasure = staff_nth_measure_node (curstaff, jcounter - 1); curmeasure && jcounter <= si->selection.lastmeasuremarked; curmeasure = curmeasure->next, jcounter++)
                 {
                   freeobjlist ( ((DenemoMeasure*)curmeasure->data)->objects);
                    ((DenemoMeasure*)curmeasure->data)->objects = NULL;
@@ -419,7 +533,7 @@ cuttobuffer (DenemoMovement * si, gboolean copyfirst)
     }
 
 
-  si->currentmeasure = g_list_nth (staff_first_measure_node (si->currentstaff), si->currentmeasurenum - 1);
+  si->currentmeasure = staff_nth_measure_node (si->currentstaff, si->currentmeasurenum - 1);
 
   si->cursor_x = si->selection.firstobjmarked;
   if (si->cursor_x < (gint) (g_list_length ((objnode *) ((DenemoMeasure*)si->currentmeasure->data)->objects)))
@@ -489,21 +603,213 @@ insert_clip_obj (gint m, gint n)
   DenemoObject *clonedobj;
   DenemoObject *curobj = (DenemoObject *) curbufferobj->data;
   clonedobj = dnm_clone_object (curobj);
-  object_insert (Denemo.project, clonedobj);
-  cache_measure (si->currentmeasure);
+  object_insert (Denemo.project, clonedobj);     //this updates the staff as far as needed for a clef, keysig, timesig or stem directive
   //reset_cursor_stats (si);
-  if (clonedobj->type == CLEF)
-    staff_fix_note_heights ((DenemoStaff *) si->currentstaff->data);
-  else
-    if (clonedobj->type == CHORD)
-        newclefify (clonedobj);
-  staff_beams_and_stems_dirs ((DenemoStaff *) si->currentstaff->data);
+  if (clonedobj->type == CHORD)
+    newclefify (clonedobj);
+  calculatebeamsandstemdirs ((DenemoMeasure *) si->currentmeasure->data);
   find_xes_in_all_measures (si);
   showwhichaccidentals ((objnode *) ((DenemoMeasure*)si->currentmeasure->data)->objects);
 
   return TRUE;
 }
 
+/* paste the objects of one staff of the copybuffer into curstaff at measure measurenum (counting from 1) before the object at position cursor (counting from 0).
+ * A measure break in the buffer moves on to the next measure if that is empty, otherwise the measure is split at the paste point, as the Scheme DenemoPaste does.
+ * Returns the number of the measure holding the last pasted object, with *cursor_out set to the position following it */
+static gint
+paste_objects_into_staff (staffnode * curstaff, gint measurenum, gint cursor, GList * objs, gint * cursor_out)
+{
+  DenemoStaff *staff = (DenemoStaff *) curstaff->data;
+  measurenode *mnode = staff_nth_measure_node (curstaff, measurenum - 1);
+  objnode *prev;
+  if (mnode == NULL)
+    return 0;
+  prev = cursor > 0 ? g_list_nth (((DenemoMeasure *) mnode->data)->objects, cursor - 1) : NULL;
+  for (; objs; objs = objs->next)
+    {
+      DenemoObject *obj = (DenemoObject *) objs->data;
+      if (obj->type == STAFFBREAK)
+        break;
+      if (obj->type == MEASUREBREAK)
+        {
+          if (!(mnode->next && ((DenemoMeasure *) mnode->next->data)->objects == NULL))
+            {
+              /* split the measure, the objects after the paste point going to a new measure */
+              DenemoMeasure *measure = (DenemoMeasure *) mnode->data;
+              DenemoMeasure *newmeasure = (DenemoMeasure *) g_malloc0 (sizeof (DenemoMeasure));
+              objnode *tail = prev ? prev->next : measure->objects;
+              if (tail)
+                {
+                  if (tail->prev)
+                    tail->prev->next = NULL;
+                  else
+                    measure->objects = NULL;
+                  tail->prev = NULL;
+                }
+              newmeasure->objects = tail;
+              link_after (&staff->themeasures, mnode, newmeasure);
+              staff->nummeasures++;
+            }
+          mnode = mnode->next;
+          prev = NULL;
+          cursor = 0;
+          measurenum++;
+          continue;
+        }
+      prev = link_after (&((DenemoMeasure *) mnode->data)->objects, prev, dnm_clone_object (obj));
+      cursor++;
+    }
+  staff_invalidate_measure_index (staff);
+  *cursor_out = cursor;
+  return measurenum;
+}
+
+/* TRUE if measure measurenum (counting from 1) exists and is empty in each of the numstaffs staffs starting at curstaff */
+static gboolean
+measures_empty (staffnode * curstaff, gint numstaffs, gint measurenum)
+{
+  for (; curstaff && numstaffs--; curstaff = curstaff->next)
+    {
+      DenemoMeasure *measure = staff_nth_measure (curstaff, measurenum - 1);
+      if (measure == NULL || measure->objects)
+        return FALSE;
+    }
+  return TRUE;
+}
+
+/* paste a multi-staff copybuffer: the music goes into the current measure if it is empty in all the staffs being pasted to, otherwise after it.
+ * Empty measures are filled, and new measures are inserted into the staffs being pasted to where the following measure is not empty.
+ * Returns the number of the last measure pasted into */
+static gint
+paste_staffs (DenemoMovement * si)
+{
+  gint numstaffs = 0, s;
+  gint first = si->currentmeasurenum;
+  gint measurenum;
+  staffnode *curstaff;
+  GList *g;
+  for (g = copybuffer, curstaff = si->currentstaff; g && curstaff; g = g->next, curstaff = curstaff->next)
+    numstaffs++;
+  staffnode **staffs = g_new (staffnode *, numstaffs);
+  GList **objs = g_new (GList *, numstaffs);
+  measurenode **prevmeasure = g_new (measurenode *, numstaffs);
+  for (s = 0, g = copybuffer, curstaff = si->currentstaff; s < numstaffs; s++, g = g->next, curstaff = curstaff->next)
+    {
+      staffs[s] = curstaff;
+      objs[s] = (GList *) g->data;
+    }
+  if (!measures_empty (si->currentstaff, numstaffs, first))
+    first++;
+  for (s = 0; s < numstaffs; s++)
+    {
+      DenemoStaff *staff = (DenemoStaff *) staffs[s]->data;
+      /* pad out short staffs so that there is a measure before the first one pasted into */
+      if (staff->nummeasures < first - 1)
+        {
+          measurenode *last = g_list_last (staff->themeasures);
+          while (staff->nummeasures < first - 1)
+            {
+              last = link_after (&staff->themeasures, last, g_malloc0 (sizeof (DenemoMeasure)));
+              staff->nummeasures++;
+            }
+          staff_invalidate_measure_index (staff);
+        }
+      prevmeasure[s] = first > 1 ? staff_nth_measure_node (staffs[s], first - 2) : NULL;
+    }
+  for (measurenum = first;; measurenum++)
+    {
+      gboolean more = FALSE, reuse = TRUE;
+      for (s = 0; s < numstaffs; s++)
+        {
+          measurenode *next = prevmeasure[s] ? prevmeasure[s]->next : ((DenemoStaff *) staffs[s]->data)->themeasures;
+          if (next == NULL || ((DenemoMeasure *) next->data)->objects)
+            reuse = FALSE;
+          if (objs[s] && ((DenemoObject *) objs[s]->data)->type != STAFFBREAK)
+            more = TRUE;
+        }
+      if (!more)
+        break;
+      for (s = 0; s < numstaffs; s++)
+        {
+          DenemoStaff *staff = (DenemoStaff *) staffs[s]->data;
+          measurenode *mnode;
+          GList *theobjs = NULL;
+          if (reuse)
+            mnode = prevmeasure[s] ? prevmeasure[s]->next : staff->themeasures;
+          else
+            {
+              mnode = link_after (&staff->themeasures, prevmeasure[s], g_malloc0 (sizeof (DenemoMeasure)));
+              staff->nummeasures++;
+            }
+          for (; objs[s]; objs[s] = objs[s]->next)
+            {
+              DenemoObject *obj = (DenemoObject *) objs[s]->data;
+              if (obj->type == STAFFBREAK)
+                break;
+              if (obj->type == MEASUREBREAK)
+                {
+                  objs[s] = objs[s]->next;
+                  break;
+                }
+              theobjs = g_list_prepend (theobjs, dnm_clone_object (obj));
+            }
+          ((DenemoMeasure *) mnode->data)->objects = g_list_reverse (theobjs);
+          prevmeasure[s] = mnode;
+        }
+    }
+  for (s = 0; s < numstaffs; s++)
+    staff_invalidate_measure_index ((DenemoStaff *) staffs[s]->data);
+  g_free (staffs);
+  g_free (objs);
+  g_free (prevmeasure);
+  return MAX (first, measurenum - 1);
+}
+
+/**
+ * paste_buffer
+ * Pastes the copybuffer at the cursor directly into the movement, measure runs being spliced into the staffs,
+ * rather than object by object via the Scheme DenemoPaste. The staffs are recached once and a single snapshot is taken for undo.
+ * @param si the movement to paste into
+ * @return FALSE if there was nothing to paste
+ */
+gboolean
+paste_buffer (DenemoMovement * si)
+{
+  staffnode *curstaff;
+  gint measurenum, cursor = 0, numstaffs = g_list_length (copybuffer);
+  if (copybuffer == NULL || copybuffer->data == NULL)
+    return FALSE;
+  take_snapshot ();
+  si->undo_guard++;
+  si->markstaffnum = 0;
+  if (copybuffer->next)
+    measurenum = paste_staffs (si);
+  else
+    {
+      numstaffs = 1;
+      measurenum = paste_objects_into_staff (si->currentstaff, si->currentmeasurenum, si->cursor_x, (GList *) copybuffer->data, &cursor);
+    }
+  extend_measurewidths (si);
+  for (curstaff = si->currentstaff; curstaff && numstaffs--; curstaff = curstaff->next)
+    recache_staff (curstaff);
+  si->undo_guard--;
+  if (measurenum < 1)
+    measurenum = si->currentmeasurenum;
+  si->currentmeasurenum = measurenum;
+  si->currentmeasure = staff_nth_measure_node (si->currentstaff, measurenum - 1);
+  if (copybuffer->next)
+    cursor = g_list_length (((DenemoMeasure *) si->currentmeasure->data)->objects);
+  si->cursor_x = cursor;
+  si->currentobject = g_list_nth (((DenemoMeasure *) si->currentmeasure->data)->objects, cursor);
+  si->cursor_appending = (si->currentobject == NULL);
+  if (si->cursor_appending)
+    si->currentobject = g_list_last (((DenemoMeasure *) si->currentmeasure->data)->objects);
+  find_xes_in_all_measures (si);
+  isoffleftside (Denemo.project);
+  isoffrightside (Denemo.project);
+  return TRUE;
+}
 
 DenemoObject *
 get_mark_object (void)
@@ -514,7 +820,7 @@ get_mark_object (void)
     return NULL;
   staffnode *curstaff = g_list_nth (si->thescore, si->selection.firststaffmarked - 1);
   DenemoStaff *firststaff = (DenemoStaff *) curstaff->data;
-  measurenode *firstmeasure = g_list_nth (firststaff->themeasures, si->selection.firstmeasuremarked - 1);
+  measurenode *firstmeasure = staff_nth_measure_node (curstaff, si->selection.firstmeasuremarked - 1);
   objnode *firstobj = g_list_nth (((DenemoMeasure*)firstmeasure->data)->objects, si->selection.firstobjmarked);
   //g_debug("First %d\n",  si->selection.firstobjmarked);
   return firstobj ? ((DenemoObject *) firstobj->data) : NULL;
@@ -529,7 +835,7 @@ get_point_object (void)
     return NULL;
   staffnode *curstaff = g_list_nth (si->thescore, si->selection.laststaffmarked - 1);
   DenemoStaff *laststaff = (DenemoStaff *) curstaff->data;
-  measurenode *lastmeasure = g_list_nth (laststaff->themeasures, si->selection.lastmeasuremarked - 1);
+  measurenode *lastmeasure = staff_nth_measure_node (curstaff, si->selection.lastmeasuremarked - 1);
   objnode *lastobj = g_list_nth (((DenemoMeasure*)lastmeasure->data)->objects, si->selection.lastobjmarked);
   return lastobj ? ((DenemoObject *) lastobj->data) : NULL;
 }
@@ -894,7 +1200,7 @@ pastewrapper (DenemoAction * action, DenemoScriptParam * param)
   if ((Denemo.project->movement->directive_on_clipboard) && (copybuffer == NULL))
     call_out_to_guile ("(eval-string CreateScriptForDirective::clipboard)");
   else
-    call_out_to_guile ("(DenemoPaste)");
+    paste_buffer (Denemo.project->movement);
   //FIXME if not success a ACTION_SCRIPT_ERROR will have been put in the undo queue...
   stage_undo (Denemo.project->movement, ACTION_STAGE_START);
 
@@ -1030,7 +1336,10 @@ free_chunk (DenemoUndoData * chunk)
       g_free (chunk);
       break;
     case ACTION_SNAPSHOT:
-      g_warning ("Snapshot free is not implemented");
+      if (chunk->arena)
+        arena_free (chunk->arena);      //the whole frozen movement, block by block
+      else
+        g_warning ("Snapshot free is not implemented");
       g_free (chunk);
       break;
     default:
@@ -1124,7 +1433,8 @@ take_snapshot (void)
     {
       DenemoUndoData *chunk;
       chunk = (DenemoUndoData *) g_malloc (sizeof (DenemoUndoData));
-      chunk->object = (DenemoObject *) clone_movement (Denemo.project->movement);
+      chunk->arena = arena_new ();
+      chunk->object = (DenemoObject *) freeze_movement (Denemo.project->movement, chunk->arena);
       //fix up somethings...
       get_position (Denemo.project->movement, &chunk->position);
       chunk->position.appending = 0;
@@ -1248,7 +1558,7 @@ action_chunk (DenemoProject * gui, DenemoUndoData ** pchunk)
         //create empty measure in the chunk->position.staff at measure number chunk->position->object
         insertmeasureafter (NULL, NULL);
 
-        cache_measure (Denemo.project->movement->currentmeasure);//rather than cache_staff (Denemo.project->movement->currentstaff); //rather than cach_all ();
+        (void) cache_staff_from (Denemo.project->movement->currentstaff, Denemo.project->movement->currentmeasure, NULL);//rather than cache_staff (Denemo.project->movement->currentstaff); //rather than cach_all ();
 
         chunk->action = ACTION_MEASURE_CREATE;
         chunk->position.measure++;
@@ -1266,6 +1576,7 @@ action_chunk (DenemoProject * gui, DenemoUndoData ** pchunk)
         GList *curstaff = g_list_nth (gui->movement->thescore, chunk->position.staff -1); //g_print ("Selecting staff %d\n",  chunk->position.staff -1);
         ((DenemoStaff *) curstaff->data)->themeasures = g_list_insert (staff_first_measure_node (curstaff), chunk->object, chunk->position.measure - 1);
         ((DenemoStaff *) curstaff->data)->nummeasures++;
+        staff_invalidate_measure_index ((DenemoStaff *) curstaff->data);
         //find_xes_in_measure (Denemo.project->movement,  chunk->position.measure);
         cache_staff (curstaff);
         staff_fix_note_heights (curstaff->data);
@@ -1312,7 +1623,8 @@ action_chunk (DenemoProject * gui, DenemoUndoData ** pchunk)
       break;
     case ACTION_DELETE:
       {
-        object_insert (gui, chunk->object);cache_all ();
+        object_insert (gui, chunk->object);
+        (void) cache_staff_from (gui->movement->currentstaff, gui->movement->currentmeasure, NULL);
         chunk->action = ACTION_INSERT;
         chunk->object = NULL;
       }
@@ -1322,13 +1634,20 @@ action_chunk (DenemoProject * gui, DenemoUndoData ** pchunk)
         //FIXME guard against a corrupt undo queue here by checking  if(gui->movement->currentobject) {
         DenemoObject *temp = gui->movement->currentobject->data;
         gui->movement->currentobject->data = chunk->object;
-        chunk->object = temp;cache_all ();
+        chunk->object = temp;
+        staff_update_context (gui->movement->currentstaff, gui->movement->currentmeasure);
       }
       break;
     case ACTION_SNAPSHOT:
       {
-
-        DenemoMovement *si = (DenemoMovement *) chunk->object;
+        DenemoMovement *si;
+        if (chunk->arena)
+          {                     //a snapshot just taken, make it a movement and drop the frozen copy
+            chunk->object = thaw_movement ((DenemoMovement *) chunk->object);
+            arena_free (chunk->arena);
+            chunk->arena = NULL;
+          }
+        si = (DenemoMovement *) chunk->object;
         gint initial_guard = gui->movement->undo_guard;
         gint initial_changecount = gui->movement->changecount;
         gboolean initial_redo_invalid = gui->movement->redo_invalid;
@@ -1412,66 +1731,36 @@ action_chunk (DenemoProject * gui, DenemoUndoData ** pchunk)
             }
 
             g_list_free (gorig);
-            chunk->object = (DenemoObject *) gui->movement;
             //FIXME fix up other values in stored object si?????? voice/staff directive widgets
-            gui->movement = si;
+            {
+              //the movement taken out is held for redo in an arena, as the snapshot was, so that it is freed with the chunk
+              DenemoMovement *displaced = gui->movement;
+              gui->movement = si;
+              chunk->arena = arena_new ();
+              chunk->object = (DenemoObject *) refreeze_movement (displaced, chunk->arena);
+            }
             for (curstaff = si->thescore; curstaff; curstaff = curstaff->next)
               {
                 DenemoStaff *thestaff = curstaff->data;
                 gorig = g = thestaff->verse_views;
                 gint curversenum = g_list_position (g, thestaff->current_verse_view);
                 thestaff->verse_views = NULL;
+                if (gorig)
+                  {             //staff->verses is rebuilt from the text of the views
+                    g_list_free_full (thestaff->verses, g_free);
+                    thestaff->verses = NULL;
+                  }
 
                 for (; g; g = g->next)
-                  {
-                    add_verse_to_staff (si, thestaff);
-                    gtk_text_buffer_set_text (gtk_text_view_get_buffer ((GtkTextView *) thestaff->current_verse_view->data), g->data, -1);
-                    gtk_widget_show (thestaff->current_verse_view->data);
-                    g_signal_connect (G_OBJECT (gtk_text_view_get_buffer (thestaff->current_verse_view->data)), "changed", G_CALLBACK (lyric_changed_cb), NULL);
-                  }
+                  add_verse_with_text (si, thestaff, g->data);
                 thestaff->current_verse_view = g_list_nth (thestaff->verse_views, curversenum);
-
-
-                {
-                  GList *direc;
-                  for (direc = thestaff->staff_directives; direc; direc = direc->next)
-                    {
-                      DenemoDirective *directive = direc->data;
-                      directive->widget = NULL;
-                      widget_for_staff_directive (directive, thestaff->staffmenu);
-                    }
-                }
-                {
-                  GList *direc;
-                  for (direc = thestaff->voice_directives; direc; direc = direc->next)
-                    {
-                      DenemoDirective *directive = direc->data;
-                      directive->widget = NULL;
-                      widget_for_voice_directive (directive, thestaff->voicemenu);
-                    }
-                }
+                //staff and voice directives have no widgets, see directive_widget_deferred()
                 g_list_free (gorig);
               }
 
 
-            {
-              GList *direc;
-              for (direc = gui->movement->movementcontrol.directives; direc; direc = direc->next)
-                {
-                  DenemoDirective *directive = direc->data;
-                  directive->widget = NULL;
-                  widget_for_movementcontrol_directive (directive);
-                }
-            }
-            {
-              GList *direc;
-              for (direc = gui->movement->header.directives; direc; direc = direc->next)
-                {
-                  DenemoDirective *directive = direc->data;
-                  directive->widget = NULL;
-                  widget_for_header_directive (directive);
-                }
-            }
+            if (!si->widgets_deferred)
+              realize_movement_directive_widgets (si);  //cloned directives have no widgets
             {
               GList *direc;
               for (direc = gui->movement->layout.directives; direc; direc = direc->next)
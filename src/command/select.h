@@ -46,6 +46,8 @@ void cutwrapper (DenemoAction * action, DenemoScriptParam * param);
 
 void pastewrapper (DenemoAction * action, DenemoScriptParam * param);
 
+gboolean paste_buffer (DenemoMovement * si);
+
 
 
 void calcmarkboundaries (DenemoMovement * si);
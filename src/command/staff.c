@@ -80,15 +80,90 @@ staff_first_measure_node (staffnode * thestaff)
 }
 
 /**
- * Return the nth measure of the given staff
+ * Discard the positional index of the staff's measures, along with the
+ * syllable counts cached by measure position.
+ * Must be called by anything that inserts, removes or replaces nodes of
+ * staff->themeasures; the index is rebuilt on the next positional lookup.
+ * @param staff the staff whose measures have changed
+ */
+void
+staff_invalidate_measure_index (DenemoStaff * staff)
+{
+  if (staff->measure_index)
+    {
+      g_ptr_array_free (staff->measure_index, TRUE);
+      staff->measure_index = NULL;
+    }
+  if (staff->syllable_marks)
+    {
+      g_array_free (staff->syllable_marks, TRUE);
+      staff->syllable_marks = NULL;
+    }
+}
+
+/* return the positional index of the staff's measures, building it if it is missing.
+ * The paths inserting, removing or replacing measures drop the index; the check on the
+ * count and the first node only catches a missed one that changed either */
+static GPtrArray *
+staff_measure_index (DenemoStaff * staff)
+{
+  GPtrArray *index = staff->measure_index;
+  if (index && ((index->len != (guint) staff->nummeasures) || (index->len && (g_ptr_array_index (index, 0) != staff->themeasures)) || (!index->len && staff->themeasures)))
+    staff_invalidate_measure_index (staff);
+  if (staff->measure_index == NULL)
+    {
+      measurenode *curmeasure;
+      index = g_ptr_array_sized_new (MAX (staff->nummeasures, 1));
+      for (curmeasure = staff->themeasures; curmeasure; curmeasure = curmeasure->next)
+        g_ptr_array_add (index, curmeasure);
+      staff->measure_index = index;
+    }
+  return staff->measure_index;
+}
+
+/**
+ * Return the nth measure node of the given staff, counting from 0.
+ * Uses the staff's measure index, so the lookup is O(1) once built.
  * @param thestaff a staffnode
  * @param n the number of the measure to return
- * @return the nth measure of the staff
+ * @return the nth measure node of the staff or NULL if there is none
  */
 measurenode *
 staff_nth_measure_node (staffnode * thestaff, gint n)
 {
-  return g_list_nth (((DenemoStaff *) thestaff->data)->themeasures, n);
+  GPtrArray *index;
+  if (thestaff == NULL || n < 0)
+    return NULL;
+  index = staff_measure_index ((DenemoStaff *) thestaff->data);
+  if ((guint) n >= index->len)
+    return NULL;
+  return (measurenode *) g_ptr_array_index (index, n);
+}
+
+/**
+ * Return the nth measure of the given staff, counting from 0.
+ * @param thestaff a staffnode
+ * @param n the number of the measure to return
+ * @return the nth DenemoMeasure of the staff or NULL if there is none
+ */
+DenemoMeasure *
+staff_nth_measure (staffnode * thestaff, gint n)
+{
+  measurenode *mnode = staff_nth_measure_node (thestaff, n);
+  return mnode ? (DenemoMeasure *) mnode->data : NULL;
+}
+
+/**
+ * Return the number of measures in the given staff without walking the list
+ * @param thestaff a staffnode
+ * @return the number of measures
+ */
+gint
+staff_measure_count (staffnode * thestaff)
+{
+  if (thestaff == NULL)
+    return 0;
+  return ((DenemoStaff *) thestaff->data)->nummeasures;
 }
 
 /**
@@ -307,6 +382,7 @@ staff_new (DenemoProject * project, enum newstaffcallbackaction action, DenemoCo
    * was done to begin with */
 
   staff->themeasures = themeasures;
+  staff->measure_index = NULL;
   staff->denemo_name = g_string_new ("");
   staff->lily_name = g_string_new ("");
 
@@ -440,6 +516,7 @@ staff_delete (DenemoProject * project, gboolean interactive)
 //FIXME DANGER
   g_list_foreach (curstaffstruct->themeasures, (GFunc)freemeasure, NULL);
   g_list_free_full (curstaffstruct->themeasures, g_free);
+  staff_invalidate_measure_index (curstaffstruct);
   g_string_free (curstaffstruct->denemo_name, FALSE);   //FIXME these should all be TRUE??
   g_string_free (curstaffstruct->lily_name, FALSE);
   g_string_free (curstaffstruct->midi_instrument, FALSE);
@@ -556,6 +633,39 @@ staff_fix_note_heights (DenemoStaff * thestaff)
   staff_beams_and_stems_dirs (thestaff);
 }
 
+/* refresh the note heights, accidentals and stems of measure as needed after its cached context changed */
+static void
+refresh_measure_for_context (DenemoMeasure * measure, guint changed)
+{
+  if (changed & CONTEXT_CLEF)
+    {
+      objnode *curobj;
+      for (curobj = measure->objects; curobj; curobj = curobj->next)
+        if (((DenemoObject *) curobj->data)->type == CHORD)
+          newclefify ((DenemoObject *) curobj->data);
+    }
+  if (changed & (CONTEXT_CLEF | CONTEXT_KEYSIG))
+    showwhichaccidentals (measure->objects);
+  if (changed & (CONTEXT_CLEF | CONTEXT_STEMDIR | CONTEXT_TIMESIG))
+    calculatebeamsandstemdirs (measure);
+}
+
+/**
+ * Updates the staff after a clef, key signature, time signature or stem directive
+ * has been inserted, deleted or changed in the measure mnode.
+ * The cached context is only re-scanned as far as the next overriding object, see cache_staff_from(),
+ * and only the measures whose context changed have their note heights, accidentals and stems refreshed.
+ * @param curstaff the staff
+ * @param mnode the measure edited
+ * @return none
+ */
+void
+staff_update_context (staffnode * curstaff, measurenode * mnode)
+{
+  (void) cache_staff_from (curstaff, mnode, refresh_measure_for_context);
+  refresh_measure_for_context ((DenemoMeasure *) mnode->data, CONTEXT_CLEF | CONTEXT_KEYSIG | CONTEXT_STEMDIR);
+}
+
 /**
  * Callback function to insert a staff in the initial position
  * @param action a Gtk Action
@@ -32,6 +32,12 @@ measurenode *staff_first_measure_node (staffnode * thestaff);
 
 measurenode *staff_nth_measure_node (staffnode * thestaff, gint n);
 
+DenemoMeasure *staff_nth_measure (staffnode * thestaff, gint n);
+
+gint staff_measure_count (staffnode * thestaff);
+
+void staff_invalidate_measure_index (DenemoStaff * staff);
+
 void staff_set_current_primary (DenemoMovement * movement);
 
 /* default context shall be DENEMO_NONE */
@@ -44,6 +50,7 @@ void staff_beams_and_stems_dirs (DenemoStaff * thestaff);
 void staff_show_which_accidentals (DenemoStaff * thestaff);
 
 void staff_fix_note_heights (DenemoStaff * thestaff);
+void staff_update_context (staffnode * curstaff, measurenode * mnode);
 
 void staff_new_initial (DenemoAction * action, DenemoScriptParam * param);
 
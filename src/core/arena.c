@@ -0,0 +1,176 @@
+/*
+ * arena.c
+ * region allocator: memory is handed out from large blocks by bumping a pointer
+ * and only given back when the whole arena is freed
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor Boston, MA 02110-1301,  USA
+ */
+#include <string.h>
+#include "core/arena.h"
+
+#define ARENA_BLOCK_SIZE (64 * 1024)
+#define ARENA_ALIGN (2 * sizeof (gpointer))
+
+typedef struct ArenaBlock
+{
+  struct ArenaBlock *next;
+  gsize size;                   /* bytes available after the header */
+  gsize used;
+} ArenaBlock;
+
+/* the header is padded so that the first allocation in a block is aligned */
+#define BLOCK_HEADER ((sizeof (ArenaBlock) + ARENA_ALIGN - 1) & ~(ARENA_ALIGN - 1))
+
+struct DenemoArena
+{
+  ArenaBlock *blocks;           /* the block being filled first */
+};
+
+/* totals for the session, arenas are only used from the main thread */
+static struct
+{
+  guint arenas;                 /* arenas created */
+  guint live_arenas;
+  guint blocks;                 /* blocks allocated */
+  guint live_blocks;
+  guint64 requested;            /* bytes asked for */
+  gsize live_reserved;          /* bytes held in blocks of arenas not yet freed */
+  gsize peak_reserved;
+} Stats;
+
+static ArenaBlock *
+new_block (gsize size)
+{
+  ArenaBlock *block = (ArenaBlock *) g_malloc (BLOCK_HEADER + size);
+  block->next = NULL;
+  block->size = size;
+  block->used = 0;
+  Stats.blocks++;
+  Stats.live_blocks++;
+  Stats.live_reserved += BLOCK_HEADER + size;
+  if (Stats.live_reserved > Stats.peak_reserved)
+    Stats.peak_reserved = Stats.live_reserved;
+  return block;
+}
+
+DenemoArena *
+arena_new (void)
+{
+  DenemoArena *arena = (DenemoArena *) g_malloc0 (sizeof (DenemoArena));
+  Stats.arenas++;
+  Stats.live_arenas++;
+  return arena;
+}
+
+void
+arena_free (DenemoArena * arena)
+{
+  ArenaBlock *block, *next;
+  if (arena == NULL)
+    return;
+  for (block = arena->blocks; block; block = next)
+    {
+      next = block->next;
+      Stats.live_blocks--;
+      Stats.live_reserved -= BLOCK_HEADER + block->size;
+      g_free (block);
+    }
+  Stats.live_arenas--;
+  g_free (arena);
+}
+
+gpointer
+arena_alloc (DenemoArena * arena, gsize size)
+{
+  ArenaBlock *block = arena->blocks;
+  gpointer ret;
+  size = (size + ARENA_ALIGN - 1) & ~(ARENA_ALIGN - 1);
+  Stats.requested += size;
+  if (size > ARENA_BLOCK_SIZE / 4)
+    {                           //large requests get a block of their own, kept behind the one being filled
+      ArenaBlock *big = new_block (size);
+      big->used = size;
+      if (block)
+        {
+          big->next = block->next;
+          block->next = big;
+        }
+      else
+        arena->blocks = big;
+      ret = (gchar *) big + BLOCK_HEADER;
+    }
+  else
+    {
+      if (block == NULL || block->size - block->used < size)
+        {
+          block = new_block (ARENA_BLOCK_SIZE);
+          block->next = arena->blocks;
+          arena->blocks = block;
+        }
+      ret = (gchar *) block + BLOCK_HEADER + block->used;
+      block->used += size;
+    }
+  memset (ret, 0, size);
+  return ret;
+}
+
+gchar *
+arena_strdup (DenemoArena * arena, const gchar * str)
+{
+  gsize len;
+  gchar *ret;
+  if (str == NULL)
+    return NULL;
+  len = strlen (str) + 1;
+  ret = (gchar *) arena_alloc (arena, len);
+  memcpy (ret, str, len);
+  return ret;
+}
+
+gpointer
+arena_memdup (DenemoArena * arena, gconstpointer mem, gsize size)
+{
+  gpointer ret = arena_alloc (arena, size);
+  memcpy (ret, mem, size);
+  return ret;
+}
+
+GString *
+arena_string_new (DenemoArena * arena, const gchar * str)
+{
+  GString *ret = (GString *) arena_alloc (arena, sizeof (GString));
+  ret->str = arena_strdup (arena, str ? str : "");
+  ret->len = strlen (ret->str);
+  ret->allocated_len = ret->len + 1;
+  return ret;
+}
+
+GList *
+arena_list_prepend (DenemoArena * arena, GList * list, gpointer data)
+{
+  GList *link = (GList *) arena_alloc (arena, sizeof (GList));
+  link->data = data;
+  link->next = list;
+  if (list)
+    list->prev = link;
+  return link;
+}
+
+gchar *
+arena_statistics (void)
+{
+  return g_strdup_printf ("Arenas: %u created, %u in use; blocks: %u allocated, %u in use; %" G_GUINT64_FORMAT " bytes requested, %" G_GSIZE_FORMAT " bytes held now, %" G_GSIZE_FORMAT " at most",
+                          Stats.arenas, Stats.live_arenas, Stats.blocks, Stats.live_blocks, Stats.requested, Stats.live_reserved, Stats.peak_reserved);
+}
@@ -0,0 +1,41 @@
+/*
+ * arena.h
+ * region allocator for data that is created together and freed together,
+ * such as the frozen copy of a movement held for undo, see freeze_movement ()
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor Boston, MA 02110-1301,  USA
+ */
+#ifndef ARENA_H
+#define ARENA_H
+#include <glib.h>
+
+typedef struct DenemoArena DenemoArena;
+
+DenemoArena *arena_new (void);
+/* free everything allocated in arena, in time proportional to the number of blocks (O(blocks)), not of allocations */
+void arena_free (DenemoArena * arena);
+/* zeroed storage for size bytes, valid until arena_free () */
+gpointer arena_alloc (DenemoArena * arena, gsize size);
+gchar *arena_strdup (DenemoArena * arena, const gchar * str);
+/* as g_memdup () into arena */
+gpointer arena_memdup (DenemoArena * arena, gconstpointer mem, gsize size);
+/* a GString held in arena, which must not be appended to or freed with g_string_free () */
+GString *arena_string_new (DenemoArena * arena, const gchar * str);
+/* as g_list_prepend () with the link held in arena, the list must not be freed with g_list_free () */
+GList *arena_list_prepend (DenemoArena * arena, GList * list, gpointer data);
+/* a description of the use of arenas so far this session, caller must g_free */
+gchar *arena_statistics (void);
+
+#endif //ARENA_H
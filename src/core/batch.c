@@ -0,0 +1,265 @@
+/*
+ * batch.c
+ * running conversion jobs read from standard input without restarting (denemo --batch)
+ *
+ * A job is the name of a file to open, optionally followed by a tab and scheme to run on it (for example to
+ * export it); either may be empty. Jobs are read one per line until the input ends. The score is reset to a
+ * new one before each job, so nothing is carried over from one job to the next except the Scheme definitions
+ * made. For each job a record
+ *   job <number>\t<ok|error>\t<seconds>\t<file>\t<message>
+ * is written on standard output. Jobs should not call d-Quit or d-Exit, which would end the batch.
+ *
+ * With --jobs the jobs are shared out among that many worker processes, each itself a denemo --batch
+ * with its own project, so that a directory of scores is converted (and typeset, if the jobs ask for it)
+ * on all the processors. Each worker is given one job at a time, the next as soon as it reports the last.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor Boston, MA 02110-1301,  USA
+ */
+#include <string.h>
+#include <errno.h>
+#include <denemo/denemo.h>
+#include "core/batch.h"
+#include "core/utils.h"
+#include "core/view.h"
+#include "export/file.h"
+#ifndef G_OS_WIN32
+#include <poll.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#endif
+
+/* read a line from fp into line, without the line ending. Returns FALSE at the end of the input */
+static gboolean
+read_job_line (FILE * fp, GString * line)
+{
+  gchar buf[1024];
+  g_string_truncate (line, 0);
+  while (fgets (buf, sizeof (buf), fp))
+    {
+      g_string_append (line, buf);
+      if (line->len && line->str[line->len - 1] == '\n')
+        break;
+    }
+  if (line->len == 0)
+    return FALSE;
+  while (line->len && (line->str[line->len - 1] == '\n' || line->str[line->len - 1] == '\r'))
+    g_string_truncate (line, line->len - 1);
+  return TRUE;
+}
+
+/* run the job in line, which is modified, on the current project */
+static void
+run_job (guint number, GString * line)
+{
+  gchar *filename = line->str;
+  gchar *scheme = strchr (line->str, '\t');
+  const gchar *error = NULL;
+  DenemoScriptParam param;
+  gint64 start;
+  if (scheme)
+    *scheme++ = 0;
+  start = g_get_monotonic_time ();
+  param.string = NULL;
+  file_newwrapper (NULL, &param);
+  if (*filename && open_for_real (filename, Denemo.project, FALSE, REPLACE_SCORE))
+    error = "could not open file";
+  else if (scheme && *scheme && call_out_to_guile (scheme))
+    error = "scheme error";
+  score_status (Denemo.project, FALSE); //so that the next reset does not query the unsaved changes
+  fprintf (stdout, "job %u\t%s\t%.3f\t%s\t%s\n", number, error ? "error" : "ok", (g_get_monotonic_time () - start) / 1000000.0, filename, error ? error : "");
+  fflush (stdout);
+}
+
+/* run the jobs read from fp in this process, numbering them after *number */
+static void
+run_jobs_here (FILE * fp, guint * number)
+{
+  GString *line = g_string_new ("");
+  while (read_job_line (fp, line))
+    if (line->len)
+      run_job (++*number, line);
+  g_string_free (line, TRUE);
+}
+
+#ifndef G_OS_WIN32
+typedef struct BatchWorker
+{
+  GPid pid;
+  gint in, out;                 /* the worker's standard input and output */
+  GString *pending;             /* output read from the worker but not yet a whole line */
+  guint number;                 /* the job the worker is running, 0 if it is idle */
+  gchar *filename;              /* the file of that job */
+  gboolean running;             /* FALSE once the worker has ended */
+} BatchWorker;
+
+static gboolean
+start_worker (BatchWorker * worker)
+{
+  GError *error = NULL;
+  gchar *program = g_build_filename (get_executable_dir (), g_get_prgname ()? g_get_prgname () : "denemo", NULL);
+  gchar *argv[] = { program, "--batch", NULL };
+  worker->running = g_spawn_async_with_pipes (NULL, argv, NULL, G_SPAWN_DO_NOT_REAP_CHILD, NULL, NULL, &worker->pid, &worker->in, &worker->out, NULL, &error);
+  if (!worker->running)
+    {
+      g_warning ("Could not start a batch worker %s: %s", program, error->message);
+      g_error_free (error);
+    }
+  worker->pending = g_string_new ("");
+  g_free (program);
+  return worker->running;
+}
+
+/* pass on what the worker has written, renumbering the record of its job. Returns FALSE when the worker has closed its output */
+static gboolean
+read_from_worker (BatchWorker * worker)
+{
+  gchar buf[4096];
+  gchar *newline;
+  gssize length = read (worker->out, buf, sizeof (buf));
+  if (length < 0 && errno == EINTR)
+    return TRUE;
+  if (length <= 0)
+    return FALSE;
+  g_string_append_len (worker->pending, buf, length);
+  while ((newline = strchr (worker->pending->str, '\n')))
+    {
+      gchar *tab;
+      *newline = 0;
+      if (worker->number && g_str_has_prefix (worker->pending->str, "job ") && (tab = strchr (worker->pending->str, '\t')))
+        {
+          fprintf (stdout, "job %u%s\n", worker->number, tab);
+          worker->number = 0;
+        }
+      else
+        fprintf (stdout, "%s\n", worker->pending->str);
+      g_string_erase (worker->pending, 0, newline - worker->pending->str + 1);
+    }
+  fflush (stdout);
+  return TRUE;
+}
+
+/* wait for the worker to end, reporting the job it was running as failed if it had not finished */
+static void
+end_worker (BatchWorker * worker)
+{
+  if (!worker->running)
+    return;
+  close (worker->in);
+  while (read_from_worker (worker))
+    ;
+  close (worker->out);
+  waitpid (worker->pid, NULL, 0);
+  g_spawn_close_pid (worker->pid);
+  worker->running = FALSE;
+  if (worker->number)
+    {
+      fprintf (stdout, "job %u\terror\t0.000\t%s\t%s\n", worker->number, worker->filename, "worker ended");
+      fflush (stdout);
+      worker->number = 0;
+    }
+}
+
+/* give the job in line to the worker */
+static void
+send_job (BatchWorker * worker, guint number, GString * line)
+{
+  g_free (worker->filename);
+  worker->filename = g_strndup (line->str, strcspn (line->str, "\t"));
+  worker->number = number;
+  g_string_append_c (line, '\n');
+  if (write (worker->in, line->str, line->len) != (gssize) line->len)
+    end_worker (worker);
+}
+
+/* run the jobs read from fp on count worker processes */
+static void
+run_jobs_in_workers (FILE * fp, gint count)
+{
+  BatchWorker *workers = g_new0 (BatchWorker, count);
+  struct pollfd *fds = g_new (struct pollfd, count);
+  gint *polled = g_new (gint, count);
+  GString *line = g_string_new ("");
+  gboolean more = TRUE;         //FALSE once the input has ended
+  guint number = 0;
+  gint i;
+  signal (SIGPIPE, SIG_IGN);    //a worker that has ended is noticed when its output closes
+  for (i = 0; i < count; i++)
+    start_worker (workers + i);
+  for (;;)
+    {
+      gint n = 0, busy = 0;
+      for (i = 0; i < count; i++)
+        {
+          BatchWorker *worker = workers + i;
+          if (worker->running && !worker->number && more)
+            {
+              while ((more = read_job_line (fp, line)) && line->len == 0)
+                ;
+              if (more)
+                send_job (worker, ++number, line);
+            }
+          if (worker->running)
+            {
+              fds[n].fd = worker->out;
+              fds[n].events = POLLIN;
+              polled[n++] = i;
+              if (worker->number)
+                busy++;
+            }
+        }
+      if (busy == 0)
+        break;
+      if (poll (fds, n, -1) < 0)
+        {
+          if (errno == EINTR)
+            continue;
+          g_warning ("Batch: could not wait for the workers: %s", g_strerror (errno));
+          break;
+        }
+      for (i = 0; i < n; i++)
+        if (fds[i].revents && !read_from_worker (workers + polled[i]))
+          end_worker (workers + polled[i]);
+    }
+  for (i = 0; i < count; i++)
+    {
+      end_worker (workers + i);
+      if (workers[i].pending)
+        g_string_free (workers[i].pending, TRUE);
+      g_free (workers[i].filename);
+    }
+  if (more)                     //no worker could run the rest
+    run_jobs_here (fp, &number);
+  g_string_free (line, TRUE);
+  g_free (polled);
+  g_free (fds);
+  g_free (workers);
+}
+#endif
+
+void
+run_batch_jobs (FILE * fp)
+{
+  guint number = 0;
+  gint count = Denemo.batch_workers > 0 ? Denemo.batch_workers : (gint) g_get_num_processors ();
+#ifndef G_OS_WIN32
+  if (count > 1)
+    {
+      run_jobs_in_workers (fp, count);
+      return;
+    }
+#endif
+  run_jobs_here (fp, &number);
+}
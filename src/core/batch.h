@@ -0,0 +1,27 @@
+/*
+ * batch.h
+ * running conversion jobs read from standard input without restarting (denemo --batch)
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor Boston, MA 02110-1301,  USA
+ */
+#ifndef BATCH_H
+#define BATCH_H
+#include <stdio.h>
+#include <glib.h>
+
+/* run the jobs read from fp until it ends, on Denemo.batch_workers processes */
+void run_batch_jobs (FILE * fp);
+
+#endif //BATCH_H
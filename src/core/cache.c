@@ -32,193 +32,140 @@ static void object_set_cache (DenemoObject *obj, clef *clef, keysig *keysig, ste
     obj->keysig = keysig;
     obj->stemdir = stem;
 }
-void cache_from_cursor (void)
+/* the prevailing context at some point in a staff */
+typedef struct prevailing_context
 {
+  clef *clef;
+  timesig *timesig;
+  keysig *keysig;
+  stemdirective *stemdir;
+  gint offset;                  /* the measure number of the previous measure */
+} prevailing_context;
 
+static stemdirective StemNeutral = {
+    DENEMO_STEMBOTH,
+    NULL
+};
 
-}
-void update_timesig_cache (measurenode *mnode)
+/* cache the context ctx prevailing at the start of measure on the measure and its objects, leaving ctx as the context at its end.
+ * Returns the CONTEXT_ flags for the cached values that changed. */
+static guint cache_measure_context (DenemoMeasure *measure, prevailing_context *ctx)
 {
-    DenemoMeasure *measure = mnode->data;
-    gint time1 = measure->timesig->time1;
-    gint time2 = measure->timesig->time2;
-    timesig *new = measure->timesig;
-    for (mnode=mnode->next;mnode;mnode=mnode->next)
+    guint changed = 0;
+    timesig *oldtime = measure->timesig;
+    GList *o;
+    ctx->offset += measure->measure_numbering_offset;
+    if (measure->clef != ctx->clef)
+        changed |= CONTEXT_CLEF;
+    if (measure->keysig != ctx->keysig)
+        changed |= CONTEXT_KEYSIG;
+    if (measure->stemdir != ctx->stemdir)
+        changed |= CONTEXT_STEMDIR;
+    if (measure->measure_number != ctx->offset + 1)
+        changed |= CONTEXT_NUMBER;
+    measure_set_cache (measure, ctx->clef, ctx->timesig, ctx->keysig, ctx->stemdir, ++ctx->offset);
+    for (o = measure->objects; o; o = o->next)
         {
-            measure = mnode->data;
-
-          /*  examine objects in mnode - if there is a timesignature then don't change it
-            */
-            GList *h = measure->objects;
-            for (; h; h=h->next)
+           DenemoObject *obj = (DenemoObject *)o->data;
+           switch (obj->type)
                 {
-                    DenemoObject *obj = h->data;
-                if (obj->object == measure->timesig)
-                    return;
-                if (obj->type == CHORD)
+                    case CLEF:
+                        ctx->clef = obj->object;
                     break;
+                    case TIMESIG:
+                        ctx->timesig = obj->object;
+                        measure->timesig = ctx->timesig;
+                    break;
+                    case KEYSIG:
+                        ctx->keysig = obj->object;
+                    break;
+                    case STEMDIRECTIVE:
+                        ctx->stemdir = obj->object;
+                    break;
+                    default:
+                        break;
                 }
-            if ((measure->timesig->time1 != time1) || (measure->timesig->time2 != time2))
-                measure->timesig = new;
-            else
-                return;
+            if (obj->clef != ctx->clef)
+                changed |= CONTEXT_CLEF;
+            if (obj->keysig != ctx->keysig)
+                changed |= CONTEXT_KEYSIG;
+            if (obj->stemdir != ctx->stemdir)
+                changed |= CONTEXT_STEMDIR;
+            object_set_cache (obj, ctx->clef, ctx->keysig, ctx->stemdir);
         }
+    if (measure->timesig != oldtime)
+        changed |= CONTEXT_TIMESIG;
+    return changed;
 }
 
-void update_clef_cache (measurenode *mnode, objnode *onode)
+/* TRUE if the values cached on measure are those that ctx, the context prevailing at its start, would give it */
+static gboolean context_unchanged (DenemoMeasure *measure, prevailing_context *ctx)
 {
-    DenemoMeasure *measure = mnode->data;
-    clef *current = onode?((DenemoObject*)onode->data)->clef: measure->clef;
-    if (current == NULL)
-        current =  measure->clef;
-    if (current == NULL)
-        {
-            g_critical ("update_clef_cache called with uncached measure clef");
-            cache_all();
-            return;
-        }
-
-    if (onode)
-        {
-            ((DenemoObject*)onode->data)->clef = current;
-            onode = onode->next;
-        }
-    for (;mnode;mnode=mnode->next, onode = mnode? ((DenemoMeasure*)mnode->data)->objects:NULL,
-                                    mnode?((DenemoMeasure*)mnode->data)->clef = current:NULL)
-        {
-            while (onode)
-                    {
-                       DenemoObject *obj = (DenemoObject *)onode->data;
-                       if (obj->type == CLEF)
-                            return;
-                        obj->clef = current;
-                        onode = onode->next;
-                    }
-        }
+    GList *o;
+    if ((measure->clef != ctx->clef) || (measure->keysig != ctx->keysig) || (measure->stemdir != ctx->stemdir))
+        return FALSE;
+    if (measure->measure_number != ctx->offset + measure->measure_numbering_offset + 1)
+        return FALSE;
+    if (measure->timesig == ctx->timesig)
+        return TRUE;
+    for (o = measure->objects; o; o = o->next)
+        if (((DenemoObject *)o->data)->object == measure->timesig)
+            return TRUE; /* the measure has its own time signature so the one coming in does not matter */
+    return FALSE;
 }
 
-void update_keysig_cache (measurenode *mnode, objnode *onode)
+void cache_staff (staffnode *s)
 {
-    DenemoMeasure *measure = mnode->data;
-    keysig *current = onode?((DenemoObject*)onode->data)->keysig : measure->keysig;
-
-    if (current == NULL)
-        current =  measure->keysig;
-    if (current == NULL)
-        {
-            g_critical ("update_keysig_cache called with uncached measure clef");
-            cache_all();
-            return;
-        }
-    if (onode)
-        {
-        ((DenemoObject*)onode->data)->keysig = current;
-        onode = onode->next;
-        }
-    for (;mnode;mnode=mnode->next,
-                onode = mnode? ((DenemoMeasure*)mnode->data)->objects:NULL,
-                mnode?((DenemoMeasure*)mnode->data)->keysig = current:NULL)
-        {
-            while (onode)
-                    {
-                       DenemoObject *obj = (DenemoObject *)onode->data;
-                       if (obj->type == KEYSIG)
-                            return;
-                        obj->keysig = current;
-                        onode = onode->next;
-                    }
-        }
+    DenemoStaff *staff = (DenemoStaff*)s->data;
+    prevailing_context ctx = {&staff->clef, &staff->timesig, &staff->keysig, &StemNeutral, 0};
+    GList *m;
+    for (m = staff->themeasures; m; m = m->next)
+        (void) cache_measure_context ((DenemoMeasure*)m->data, &ctx);
 }
 
-void update_stemdir_cache (measurenode *mnode, objnode *onode)
+/**
+ * Re-caches the prevailing context (clef, time and key signature, stem direction and measure number)
+ * of the staff s from the measure mnode onwards, after an edit within mnode.
+ * The context at the start of mnode is that cached at the end of the measure before it, and the scan stops at the
+ * first later measure which already has the context coming into it cached, so that, for example, a key signature change
+ * is only propagated as far as the next key signature.
+ * @param fn if not NULL, called for each measure re-cached whose cached context changed, with the CONTEXT_ flags saying what changed
+ * @return the last measure node re-cached
+ */
+measurenode *cache_staff_from (staffnode *s, measurenode *mnode, DenemoContextChangedFn fn)
 {
-    DenemoMeasure *measure = mnode->data;
-    stemdirective *current = onode? ((DenemoObject*)onode->data)->stemdir : measure->stemdir;
-
-    if (current == NULL)
-        current =  measure->stemdir;
-    if (current == NULL)
+    DenemoStaff *staff = (DenemoStaff*)s->data;
+    prevailing_context ctx = {&staff->clef, &staff->timesig, &staff->keysig, &StemNeutral, 0};
+    measurenode *m, *last = mnode;
+    if (mnode->prev)
         {
-            g_critical ("update_stemdir_cache called with uncached measure clef");
-            cache_all();
-            return;
-        }
-     if (onode)
-        {
-        ((DenemoObject*)onode->data)->stemdir = current;
-        onode = onode->next;
+            DenemoMeasure *prev = (DenemoMeasure*)mnode->prev->data;
+            GList *o = g_list_last (prev->objects);
+            DenemoObject *obj = o ? (DenemoObject*)o->data : NULL;
+            if (prev->clef == NULL || prev->keysig == NULL || prev->stemdir == NULL || prev->timesig == NULL)
+                {
+                    g_critical ("cache_staff_from called with uncached previous measure");
+                    cache_staff (s);
+                    return g_list_last (mnode);
+                }
+            ctx.clef = (obj && obj->clef) ? obj->clef : prev->clef;
+            ctx.keysig = (obj && obj->keysig) ? obj->keysig : prev->keysig;
+            ctx.stemdir = (obj && obj->stemdir) ? obj->stemdir : prev->stemdir;
+            ctx.timesig = prev->timesig;
+            ctx.offset = prev->measure_number;
         }
-    for (;mnode;mnode=mnode->next,
-                                    onode = mnode? ((DenemoMeasure*)mnode->data)->objects:NULL,
-                                    mnode?((DenemoMeasure*)mnode->data)->stemdir = current:NULL)
+    for (m = mnode; m; m = m->next)
         {
-            while (onode)
-                    {
-                       DenemoObject *obj = (DenemoObject *)onode->data;
-                       if (obj->type == STEMDIRECTIVE)
-                            return;
-                        obj->stemdir = current;
-                        onode = onode->next;
-                    }
+            DenemoMeasure *measure = (DenemoMeasure*)m->data;
+            guint changed;
+            if ((m != mnode) && context_unchanged (measure, &ctx))
+                break;
+            changed = cache_measure_context (measure, &ctx);
+            if (changed && fn)
+                fn (measure, changed);
+            last = m;
         }
-}
-static stemdirective StemNeutral = {
-    DENEMO_STEMBOTH,
-    NULL
-};
-
-void cache_staff (staffnode *s)
-{
-      DenemoStaff *staff = (DenemoStaff*)s->data;
-      GList *m;
-        DenemoMeasure *measure = (DenemoMeasure*)staff->themeasures->data;
-        clef *cclef =  &staff->clef;
-        timesig *ctim =  &staff->timesig;
-        keysig *ckey =  &staff->keysig;
-        stemdirective *cstem =  &StemNeutral;
-        gint offset = 0;
-        for (m = staff->themeasures;m; m = m->next)
-            {
-                GList *o;
-                measure = (DenemoMeasure*)m->data;
-                offset += measure->measure_numbering_offset;
-                measure_set_cache (measure, cclef, ctim, ckey, cstem, ++offset);
-                for (o=measure->objects; o; o = o->next)
-                    {
-                       DenemoObject *obj = (DenemoObject *)o->data;
-                       switch (obj->type)
-                            {
-                                case CLEF:
-                                    cclef = obj->object;
-                                break;
-                                case TIMESIG:
-                                    ctim = obj->object;
-                                    measure->timesig = ctim;
-                                break;
-                                case KEYSIG:
-                                    ckey = obj->object;
-                                break;
-                                case STEMDIRECTIVE:
-                                    cstem = obj->object;
-                                break;
-                                default:
-                                    break;
-
-                            }
-                     object_set_cache (obj, cclef, ckey, cstem);
-                    }
-            }
-}
-
-void cache_measure (measurenode *mnode)
- {
-    if (mnode->data) {
-        objnode *onode = ((DenemoMeasure*) mnode->data)->objects;
-        update_clef_cache (mnode, onode);
-        update_keysig_cache (mnode, onode);
-        update_timesig_cache (mnode);
-        update_stemdir_cache (mnode, onode);
-    }
+    return last;
 }
 
 void cache_all (void)
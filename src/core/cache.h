@@ -23,11 +23,16 @@
 #include <denemo/denemo.h>
 
 
-void update_timesig_cache (measurenode *mnode);
-void update_clef_cache (measurenode *mnode, objnode *onode);
-void update_keysig_cache (measurenode *mnode, objnode *onode);
-void update_stemdir_cache (measurenode *mnode, objnode *onode);
-void cache_measure (measurenode *mnode);
+/* what changed in the context cached on a measure, see cache_staff_from () */
+#define CONTEXT_CLEF (1<<0)
+#define CONTEXT_KEYSIG (1<<1)
+#define CONTEXT_TIMESIG (1<<2)
+#define CONTEXT_STEMDIR (1<<3)
+#define CONTEXT_NUMBER (1<<4)
+
+typedef void (*DenemoContextChangedFn) (DenemoMeasure *measure, guint changed);
+
+measurenode *cache_staff_from (staffnode *s, measurenode *mnode, DenemoContextChangedFn fn);
 void cache_staff (staffnode *s);
 void cache_all (void);
 
@@ -12,6 +12,7 @@
 #include "core/exportxml.h"
 #include "source/source.h"
 #include "core/utils.h"
+#include "core/profile.h"
 #include "command/lyric.h"
 #include "command/lilydirectives.h"
 #include "ui/texteditors.h"
@@ -1106,6 +1107,7 @@ newScrollPointsElem (xmlNodePtr curElem, xmlNsPtr ns, GList * scroll_points)
 gint
 exportXML (gchar * thefilename, DenemoProject * gui)
 {
+  PROFILE_BEGIN (mark, "exportXML");
   gint ret = 0;
   GString *filename = g_string_new (thefilename);
   xmlDocPtr doc;
@@ -1375,5 +1377,6 @@ exportXML (gchar * thefilename, DenemoProject * gui)
   sNextXMLID = 0;
 
   g_string_free (filename, TRUE);
+  PROFILE_END (mark);
   return ret;
 }
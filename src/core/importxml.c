@@ -17,6 +17,7 @@
 #include "command/tuplet.h"
 #include "export/xmldefs.h"
 #include "core/cache.h"
+#include "core/projectcache.h"
 #include "core/view.h"
 #include "ui/texteditors.h"
 #include "command/lilydirectives.h"
@@ -398,7 +399,8 @@ parseWidgetDirective (xmlNodePtr parentElem, gpointer fn, DenemoDirective * dire
     g_string_assign (directive->postfix, "");
   UPDATE_OVERRIDE (directive);
 
-  widget_for_directive_menu (directive, fn, menu);
+  if (!directive_widget_deferred (fn))
+    widget_for_directive_menu (directive, fn, menu);
   return TRUE;
 }
 
@@ -406,35 +408,15 @@ parseWidgetDirective (xmlNodePtr parentElem, gpointer fn, DenemoDirective * dire
 #undef DO_DIREC
 #undef DO_INTDIREC
 
-static void
-parseVerse (xmlNodePtr parentElem, guint verse)
-{
-  gchar *text = (gchar *) xmlNodeListGetString (parentElem->doc, parentElem->xmlChildrenNode, 1);
-  DenemoStaff* staff = (DenemoStaff*) Denemo.project->movement->currentstaff->data;
-
-  if(!Denemo.non_interactive){
-    GtkTextView* verse_view = g_list_nth_data (staff->verse_views, verse);
-    gtk_text_buffer_set_text (gtk_text_view_get_buffer(verse_view), text ? text : "", -1);
-    g_signal_connect (G_OBJECT (gtk_text_view_get_buffer (verse_view)), "changed", G_CALLBACK (lyric_changed_cb), NULL);
-    g_free (text);
-  }
-
-  else{
-    GList* _current_verse = g_list_nth(staff->verses, verse);
-    if(_current_verse->data)
-      g_free(_current_verse->data);
-    _current_verse->data = text;
-  }
-}
-
 static void
 parseVerses (DenemoMovement * movement, DenemoStaff * staff, xmlNodePtr parentElem)
 {
   xmlNodePtr childElem;
   FOREACH_CHILD_ELEM (childElem, parentElem)
   {
-    guint verse = add_verse_to_staff (movement, staff);
-    parseVerse (childElem, verse);
+    gchar *text = (gchar *) xmlNodeListGetString (childElem->doc, childElem->xmlChildrenNode, 1);
+    add_verse_with_text (movement, staff, text ? text : "");
+    g_free (text);
   }
 }
 
@@ -2706,11 +2688,7 @@ parseVoice (xmlNodePtr voiceElem, DenemoProject * gui)
   if (Lyric->len)
     {
       DenemoStaff *staff = (DenemoStaff *) si->currentstaff->data;
-      add_verse_to_staff (si, staff);
-      GtkTextView* verse_view = (GtkTextView*) verse_get_current_view (staff);
-      gtk_text_buffer_set_text (gtk_text_view_get_buffer (verse_view), Lyric->str, Lyric->len);
-      //g_signal_connect (G_OBJECT (gtk_text_view_get_buffer (verse_view)), "changed", G_CALLBACK (lyric_changed_cb), NULL);
-      //allow save on backward compatibility files... gtk_text_buffer_set_modified(gtk_text_view_get_buffer(verse_view), FALSE);
+      add_verse_with_text (si, staff, Lyric->str);
       //g_debug("Appended <%s>\n", Lyric->str);
     }
   g_string_free (Lyric, FALSE);
@@ -2808,7 +2786,10 @@ parseMovement (xmlNodePtr childElem, DenemoProject * gui, ImportType type)
   gint previous_staffnum = 0;
   DenemoMovement *si = gui->movement;
   if (type != ADD_STAFFS)
-    gui->movements = g_list_append (gui->movements, gui->movement);
+    {
+      gui->movements = g_list_append (gui->movements, gui->movement);
+      si->widgets_deferred = !Denemo.non_interactive; //verse views and directive buttons are built when the movement is first displayed
+    }
   else
     previous_staffnum = g_list_length(si->thescore);
   si->currentstaffnum = 0;
@@ -2930,9 +2911,16 @@ importXML (gchar * filename, DenemoProject * gui, ImportType type)
       g_warning ("Recursive call to importXML - ignored");
       return -1;
     }
-  /* Try to parse the file. */
+  /* Try the cache beside the file, else parse the file. */
 
-  doc = xmlParseFile (filename);
+  if (Denemo.prefs.project_cache)
+    doc = project_cache_read (filename);
+  if (doc == NULL)
+    {
+      doc = xmlParseFile (filename);
+      if (doc && Denemo.prefs.project_cache)
+        project_cache_write (filename, doc);
+    }
   if (doc == NULL)
     {
       g_warning ("Could not read XML file %s", filename);
@@ -117,6 +117,10 @@ command_row_init(command_row *command)
   command->fallback = NULL;
   command->menupath = NULL;
   command->scheme = NULL;
+  command->scheme_file = NULL;
+  command->scheme_mtime = 0;
+  command->init_mtime = 0;
+  command->procedure = NULL;
 }
 
 command_row*
@@ -833,7 +837,8 @@ lookup_command_for_keybinding_name (keymap * the_keymap, const gchar * binding_n
  * @idx: The command id.
  *
  * Returns null if idx is not valid.
- * Loads the scheme code if it is not yet loaded, and caches it.
+ * Loads the scheme code if it is not yet loaded, or if its file or the init.scm
+ * beside it has changed since, and caches it.
  * Finally returns the scheme code, or NULL if the command is builtin.
  **/
 
@@ -842,12 +847,30 @@ get_scheme_from_idx (gint idx){
   command_row* row = g_hash_table_lookup(Denemo.map->commands, &idx);
   if(!row)
     return NULL;
+  if(row->scheme && command_data_changed (row))
+    forget_command_data (row);
   if(row->scheme)
     return row->scheme;
   row->scheme = load_command_data (idx);
   return row->scheme;
 }
 
+/**
+ * forget_command_data:
+ * @row: The command.
+ *
+ * Drops the cached scheme code of the command and the procedure compiled from it,
+ * so that they are loaded afresh when next needed.
+ **/
+void
+forget_command_data (command_row * row)
+{
+  forget_script_procedure (row);
+  row->scheme = NULL;
+  g_free (row->scheme_file);
+  row->scheme_file = NULL;
+}
+
 /**
  * Look up for a command index.
  *
@@ -1396,7 +1419,7 @@ execute_callback_from_name (const gchar * command_name)
   if (!builtin){
     gchar* text = get_scheme_from_idx (idx);
     if(text)
-      call_out_to_guile (text);
+      call_out_to_script (idx, SCM_BOOL_F);
     else
       denemo_action_activate (action);
   }
@@ -165,4 +165,5 @@ command_row* get_or_create_command(gchar* name);
 gboolean load_keymap_files(GList* files);
 GString *keymap_get_bindings (keymap * the_keymap);
 gchar* get_scheme_from_idx(gint idx);
+void forget_command_data (command_row * row);
 #endif
@@ -1,3 +1,4 @@
+#include <glib/gstdio.h>
 #include "core/keymapio.h"
 #include "core/kbd-custom.h"
 #include "core/view.h"
@@ -754,9 +755,38 @@ save_command_data (gchar * filename, gchar * myscheme)
   return 0;
 }
 
+/* the modification time of filename, 0 if it does not exist */
+static gint64
+file_mtime (const gchar * filename)
+{
+  GStatBuf st;
+  if (g_stat (filename, &st) != 0)
+    return 0;
+  return (gint64) st.st_mtime;
+}
+
+/* TRUE if the script for row, or the init.scm beside it, has changed since the script was loaded */
+gboolean
+command_data_changed (command_row * row)
+{
+  gboolean changed;
+  gchar *dir, *init;
+  if (row->scheme_file == NULL)
+    return FALSE;
+  if (file_mtime (row->scheme_file) != row->scheme_mtime)
+    return TRUE;
+  dir = g_path_get_dirname (row->scheme_file);
+  init = g_build_filename (dir, INIT_SCM, NULL);
+  changed = (file_mtime (init) != row->init_mtime);
+  g_free (init);
+  g_free (dir);
+  return changed;
+}
+
 gchar *
 load_command_data (gint idx)
 {
+  command_row *row = NULL;
   gchar *basename = (gchar*) lookup_name_from_idx (Denemo.map, idx);
   gchar *filename = g_strconcat (basename, SCM_EXT, NULL);
   gchar* path = NULL;
@@ -785,10 +815,21 @@ load_command_data (gint idx)
     g_free(path);
     return NULL;
   }
-  g_free(path);
+
+  // Note where it came from, so that changes to it can be noticed
+  if (keymap_get_command_row (Denemo.map, &row, idx))
+    {
+      g_free (row->scheme_file);
+      row->scheme_file = path;
+      row->scheme_mtime = file_mtime (path);
+    }
+  else
+    g_free(path);
 
   // Load the init script if there is one
   path = g_build_filename (dir, INIT_SCM, NULL);
+  if (row)
+    row->init_mtime = file_mtime (path);
   if (g_file_test (path, G_FILE_TEST_EXISTS))
     //scm_c_primitive_load(path);Use scm_c_primitive_load together with scm_internal_catch and scm_handle_by_message_no_exit instead.
     eval_file_with_catch (path);
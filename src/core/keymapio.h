@@ -17,6 +17,7 @@ gint load_xml_keybindings (gchar * filename);
 gint save_command_metadata (gchar * filename, gchar * myname, gchar * mylabel, gchar * mytooltip, gchar * after);
 gint save_command_data (gchar * filename, gchar * myscheme);
 gchar* load_command_data (gint idx);
+gboolean command_data_changed (command_row * row);
 
 #define XML_ENCODING "UTF-8"
 
@@ -144,6 +144,8 @@ process_command_line (int argc, char **argv, gboolean gtkstatus)
     { "silent",              'm', 0, G_OPTION_ARG_NONE, &Denemo.silent, _("Don't log any message"), NULL },
     { "verbose",             'V', 0, G_OPTION_ARG_NONE, &Denemo.verbose, _("Display every messages"), NULL },
     { "non-interactive",     'n', 0, G_OPTION_ARG_NONE, &Denemo.non_interactive, _("Launch Denemo without GUI"), NULL },
+    { "batch",               'b', 0, G_OPTION_ARG_NONE, &Denemo.batch, _("Without GUI, run jobs read from standard input, one per line: a file to open, a tab and scheme to run on it"), NULL },
+    { "jobs",                'j', 0, G_OPTION_ARG_INT, &Denemo.batch_workers, _("With --batch, the number of processes to run the jobs on, 0 for one per processor"), _("n") },
     { "version",             'v', 0, G_OPTION_ARG_NONE, &version,  _("Print version information and exit"), NULL },
     { "audio-options",       'A', G_OPTION_FLAG_HIDDEN, G_OPTION_ARG_NONE, &Denemo.prefs.audio_driver,_("Audio driver options"), _("options") },
     { "midi-options",        'M', G_OPTION_FLAG_HIDDEN, G_OPTION_ARG_NONE, &Denemo.prefs.midi_driver, _("Midi driver options"), _("options") },
@@ -158,6 +160,7 @@ process_command_line (int argc, char **argv, gboolean gtkstatus)
   const gchar* footer = _("Report bugs to http://www.denemo.org\n"
                           "GNU Denemo, a free and open music notation editor");
   Denemo.LastCommandId = -1;
+  Denemo.batch_workers = 1;
   context = g_option_context_new (subtitle);
   g_option_context_set_summary (context, header);
   g_free(header);
@@ -195,8 +198,8 @@ process_command_line (int argc, char **argv, gboolean gtkstatus)
   //signal (SIGCHLD, sigchld_handler);
 #endif
 
-  //Set command line mode if gtk could not be initialized
-  if(!gtkstatus)
+  //Set command line mode if gtk could not be initialized, or jobs are to be run in batch
+  if(!gtkstatus || Denemo.batch)
     Denemo.non_interactive = TRUE;
 
   return filenames;
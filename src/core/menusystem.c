@@ -27,6 +27,7 @@
 #include "core/keymapio.h"
 #include "core/menusystem.h"
 #include "core/keyboard.h"
+#include "core/profile.h"
 
 #include "command/commandfuncs.h"
 #include "command/select.h"
@@ -211,7 +212,7 @@ saveMenuItem (GtkWidget * widget, DenemoAction * action)
       g_free (dirpath);
       save_command_metadata (xml_filename, name, label, tooltip, row->after);
       save_command_data (scm_path, scheme);
-      row->scheme = NULL;
+      forget_command_data (row);
     }
   else
     warningdialog (_("No script saved"));
@@ -1460,7 +1461,11 @@ void denemo_action_activate(DenemoAction *action)
     if(action) 
         {
         if (action->type)
+            {
+            PROFILE_BEGIN (mark, denemo_action_get_name (action));
             ((BuiltInCallback)(action->callback))(&DummyAction, NULL);
+            PROFILE_END (mark);
+            }
         else 
             activate_script (action, NULL);
         }
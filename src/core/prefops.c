@@ -143,6 +143,7 @@ initprefs ()
   ret->createclones = FALSE;
   ret->enable_thumbnails = TRUE;
   ret->opensources = TRUE;
+  ret->project_cache = FALSE;
   ret->autosave = TRUE;
   ret->autosave_timeout = 5;
   ret->compression = 3;
@@ -357,6 +358,7 @@ parseConfig (xmlDocPtr doc, xmlNodePtr cur, DenemoPrefs * prefs)
         READBOOLXMLENTRY (overlays)
         READBOOLXMLENTRY (enable_thumbnails)
         READBOOLXMLENTRY (opensources)
+        READBOOLXMLENTRY (project_cache)
         READBOOLXMLENTRY (ignorescripts)
         READBOOLXMLENTRY (continuous)
         READBOOLXMLENTRY (spillover)
@@ -434,6 +436,7 @@ get_bool_pref (gchar * prefname)
     GETBOOLPREF (overlays)
     GETBOOLPREF (enable_thumbnails)
     GETBOOLPREF (opensources)
+    GETBOOLPREF (project_cache)
     GETBOOLPREF (ignorescripts)
     GETBOOLPREF (continuous)
     GETBOOLPREF (spillover)
@@ -817,6 +820,7 @@ writeXMLPrefs (DenemoPrefs * prefs)
     WRITEBOOLXMLENTRY (overlays)
     WRITEBOOLXMLENTRY (enable_thumbnails)
     WRITEBOOLXMLENTRY (opensources)
+    WRITEBOOLXMLENTRY (project_cache)
     WRITEBOOLXMLENTRY (ignorescripts)
     WRITEBOOLXMLENTRY (continuous)
     WRITEBOOLXMLENTRY (toolbar)
@@ -0,0 +1,353 @@
+/*
+ * profile.c
+ * counting and timing the commands and the busiest functions of Denemo while
+ * profiling is switched on: for each name the number of calls, the wall clock
+ * and processor time they took, with histograms of each, and the heap they
+ * left allocated. Each call can also be written to a trace file which the
+ * Chrome trace viewer (chrome://tracing) or Perfetto can show as a timeline.
+ * The audio callbacks only push their calls onto a ring buffer, which the
+ * queue thread folds into the profile.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor Boston, MA 02110-1301,  USA
+ */
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#if defined(HAVE_MALLOC_H) && (defined(HAVE_MALLINFO2) || defined(HAVE_MALLINFO))
+#include <malloc.h>
+#endif
+#ifdef _HAVE_JACK_
+#include <jack/ringbuffer.h>
+#else
+#include "audio/ringbuffer.h"
+#endif
+#include "core/profile.h"
+
+/* histogram bucket n counts calls taking less than 2^n microseconds (and at least half that), the last any longer */
+#define PROFILE_BUCKETS (24)
+/* the calls from the audio callbacks that can be held until the queue thread folds them in */
+#define PROFILE_REALTIME_CALLS (1024)
+/* the thread id under which the calls from the audio callbacks are written to the trace */
+#define PROFILE_REALTIME_TID (1000)
+
+typedef struct ProfileEntry
+{
+  gchar *name;
+  guint calls;
+  gint64 wall;                  /* total microseconds */
+  gint64 cpu;
+  gint64 wall_max;
+  glong heap;                   /* total bytes left allocated */
+  guint wall_histogram[PROFILE_BUCKETS];
+  guint cpu_histogram[PROFILE_BUCKETS];
+} ProfileEntry;
+
+/* a call from an audio callback, waiting to be folded into the profile */
+typedef struct RealtimeCall
+{
+  const gchar *name;
+  gint64 start;                 /* monotonic microseconds */
+  gint64 wall;
+  gint64 cpu;
+} RealtimeCall;
+
+gboolean profile_active = FALSE;
+static GMutex profile_mutex;    /* guards all that follows */
+static GHashTable *entries;     /* ProfileEntry by name */
+static gint dropped;            /* calls from the audio callbacks not recorded because the ring was full or busy */
+static jack_ringbuffer_t *realtime_calls;       /* created with the first profile and kept, written only by the audio callbacks */
+static gint realtime_writing;   /* set while an audio callback writes to realtime_calls, so that there is only one writer */
+static FILE *trace;
+static gint64 trace_start;
+static GPrivate thread_number;  /* the thread id written to the trace, numbered from 1 */
+static gint threads;
+
+static gint64
+thread_cpu_time (void)
+{
+#ifdef CLOCK_THREAD_CPUTIME_ID
+  struct timespec now;
+  if (clock_gettime (CLOCK_THREAD_CPUTIME_ID, &now) == 0)
+    return (gint64) now.tv_sec * G_USEC_PER_SEC + now.tv_nsec / 1000;
+#endif
+  return 0;
+}
+
+/* bytes of heap in use, -1 if they cannot be measured here */
+glong
+profile_heap_in_use (void)
+{
+#if defined(HAVE_MALLOC_H) && defined(HAVE_MALLINFO2)
+  return (glong) mallinfo2 ().uordblks;
+#elif defined(HAVE_MALLOC_H) && defined(HAVE_MALLINFO)
+  return (glong) (guint) mallinfo ().uordblks;      //mallinfo() is deprecated since glibc 2.33, and wraps at 4GB
+#else
+  return -1;
+#endif
+}
+
+static gint
+bucket (gint64 microseconds)
+{
+  gint n = 0;
+  while (n < PROFILE_BUCKETS - 1 && microseconds >= ((gint64) 1 << n))
+    n++;
+  return n;
+}
+
+static gint
+current_thread_number (void)
+{
+  gint number = GPOINTER_TO_INT (g_private_get (&thread_number));
+  if (number == 0)
+    {
+      number = g_atomic_int_add (&threads, 1) + 1;
+      g_private_set (&thread_number, GINT_TO_POINTER (number));
+    }
+  return number;
+}
+
+/* write name as a JSON string */
+static void
+write_json_string (FILE * fp, const gchar * name)
+{
+  fputc ('"', fp);
+  for (; *name; name++)
+    if (*name == '"' || *name == '\\')
+      fprintf (fp, "\\%c", *name);
+    else if ((guchar) * name < 0x20)
+      fprintf (fp, "\\u%04x", *name);
+    else
+      fputc (*name, fp);
+  fputc ('"', fp);
+}
+
+static void
+free_entry (ProfileEntry * entry)
+{
+  g_free (entry->name);
+  g_free (entry);
+}
+
+/* add a call to the profile and the trace, must hold profile_mutex */
+static void
+record_call (const gchar * name, gint64 start, gint64 wall, gint64 cpu, glong heap, gint tid)
+{
+  ProfileEntry *entry;
+  if (entries == NULL)          //the profile may have been stopped and dumped since the mark
+    return;
+  entry = g_hash_table_lookup (entries, name);
+  if (entry == NULL)
+    {
+      entry = g_new0 (ProfileEntry, 1);
+      entry->name = g_strdup (name);
+      g_hash_table_insert (entries, entry->name, entry);
+    }
+  entry->calls++;
+  entry->wall += wall;
+  entry->cpu += cpu;
+  entry->heap += heap;
+  if (wall > entry->wall_max)
+    entry->wall_max = wall;
+  entry->wall_histogram[bucket (wall)]++;
+  entry->cpu_histogram[bucket (cpu)]++;
+  if (trace)
+    {
+      fprintf (trace, ",\n{\"name\":");
+      write_json_string (trace, name);
+      fprintf (trace, ",\"cat\":\"denemo\",\"ph\":\"X\",\"ts\":%" G_GINT64_FORMAT ",\"dur\":%" G_GINT64_FORMAT ",\"pid\":1,\"tid\":%d,\"args\":{\"cpu_us\":%" G_GINT64_FORMAT ",\"heap\":%ld}}",
+               start - trace_start, wall, tid, cpu, heap);
+    }
+}
+
+void
+profile_begin (ProfileMark * mark, const gchar * name, gboolean realtime)
+{
+  mark->name = name;
+  mark->realtime = realtime;
+  mark->heap = realtime ? -1 : profile_heap_in_use ();
+  mark->cpu = thread_cpu_time ();
+  mark->wall = g_get_monotonic_time ();
+}
+
+void
+profile_end (ProfileMark * mark)
+{
+  gint64 wall = g_get_monotonic_time () - mark->wall;
+  gint64 cpu = thread_cpu_time () - mark->cpu;
+  glong heap = mark->heap >= 0 ? profile_heap_in_use () - mark->heap : 0;
+  if (mark->realtime)
+    {
+      //no lock, allocation or output here: the call waits on the ring for profile_drain()
+      RealtimeCall call;
+      if (realtime_calls == NULL || !g_atomic_int_compare_and_exchange (&realtime_writing, FALSE, TRUE))
+        {
+          g_atomic_int_inc (&dropped);
+          return;
+        }
+      if (jack_ringbuffer_write_space (realtime_calls) < sizeof (call))
+        g_atomic_int_inc (&dropped);
+      else
+        {
+          call.name = mark->name;
+          call.start = mark->wall;
+          call.wall = wall;
+          call.cpu = cpu;
+          jack_ringbuffer_write (realtime_calls, (const char *) &call, sizeof (call));
+        }
+      g_atomic_int_set (&realtime_writing, FALSE);
+      return;
+    }
+  g_mutex_lock (&profile_mutex);
+  record_call (mark->name, mark->wall, wall, cpu, heap, current_thread_number ());
+  g_mutex_unlock (&profile_mutex);
+}
+
+/* fold the calls waiting from the audio callbacks into the profile, must hold profile_mutex */
+static void
+drain_realtime_calls (void)
+{
+  RealtimeCall call;
+  if (realtime_calls == NULL)
+    return;
+  while (jack_ringbuffer_read_space (realtime_calls) >= sizeof (call))
+    {
+      jack_ringbuffer_read (realtime_calls, (char *) &call, sizeof (call));
+      record_call (call.name, call.start, call.wall, call.cpu, 0, PROFILE_REALTIME_TID);
+    }
+}
+
+void
+profile_drain (void)
+{
+  if (!g_atomic_int_get (&profile_active))
+    return;
+  g_mutex_lock (&profile_mutex);
+  drain_realtime_calls ();
+  g_mutex_unlock (&profile_mutex);
+}
+
+gboolean
+profile_start (const gchar * trace_file)
+{
+  FILE *fp = NULL;
+  profile_stop ();
+  if (trace_file && *trace_file)
+    {
+      fp = fopen (trace_file, "w");
+      if (fp == NULL)
+        {
+          g_warning ("Could not open %s for the profile trace", trace_file);
+          return FALSE;
+        }
+      //the metadata event names the process, and starts the list so that each event can be written with a leading comma
+      fprintf (fp, "[\n{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"tid\":0,\"args\":{\"name\":\"Denemo\"}}");
+      fprintf (fp, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"audio callbacks\"}}", PROFILE_REALTIME_TID);
+    }
+  g_mutex_lock (&profile_mutex);
+  if (realtime_calls == NULL)
+    realtime_calls = jack_ringbuffer_create (PROFILE_REALTIME_CALLS * sizeof (RealtimeCall));
+  else                          //calls left by a callback that began before the last profile stopped
+    jack_ringbuffer_read_advance (realtime_calls, jack_ringbuffer_read_space (realtime_calls));
+  if (entries)
+    g_hash_table_destroy (entries);
+  entries = g_hash_table_new_full (g_str_hash, g_str_equal, NULL, (GDestroyNotify) free_entry);
+  dropped = 0;
+  trace = fp;
+  trace_start = g_get_monotonic_time ();
+  profile_active = TRUE;
+  g_mutex_unlock (&profile_mutex);
+  return TRUE;
+}
+
+void
+profile_stop (void)
+{
+  g_mutex_lock (&profile_mutex);
+  drain_realtime_calls ();
+  profile_active = FALSE;
+  if (trace)
+    {
+      fprintf (trace, "\n]\n");
+      fclose (trace);
+      trace = NULL;
+    }
+  g_mutex_unlock (&profile_mutex);
+}
+
+static gint
+compare_wall (ProfileEntry ** a, ProfileEntry ** b)
+{
+  return ((*a)->wall < (*b)->wall) - ((*a)->wall > (*b)->wall);
+}
+
+static void
+append_histogram (GString * text, const gchar * label, guint * histogram)
+{
+  gint n;
+  g_string_append_printf (text, "    %s:", label);
+  for (n = 0; n < PROFILE_BUCKETS; n++)
+    if (histogram[n])
+      {
+        if (n == PROFILE_BUCKETS - 1)
+          g_string_append_printf (text, " >=%.0fms:%u", (1 << (n - 1)) / 1000.0, histogram[n]);
+        else if (n < 10)
+          g_string_append_printf (text, " <%dus:%u", 1 << n, histogram[n]);
+        else
+          g_string_append_printf (text, " <%.0fms:%u", (1 << n) / 1000.0, histogram[n]);
+      }
+  g_string_append_c (text, '\n');
+}
+
+gchar *
+profile_dump (void)
+{
+  GString *text = g_string_new ("");
+  GPtrArray *sorted = g_ptr_array_new ();
+  GHashTableIter iter;
+  gpointer value;
+  guint i;
+  g_mutex_lock (&profile_mutex);
+  if (entries == NULL)
+    {
+      g_mutex_unlock (&profile_mutex);
+      g_ptr_array_free (sorted, TRUE);
+      g_string_free (text, TRUE);
+      return g_strdup ("Not profiled, see d-ProfileStart\n");
+    }
+  if (profile_active)
+    drain_realtime_calls ();
+  g_hash_table_iter_init (&iter, entries);
+  while (g_hash_table_iter_next (&iter, NULL, &value))
+    g_ptr_array_add (sorted, value);
+  g_ptr_array_sort (sorted, (GCompareFunc) compare_wall);
+  g_string_append_printf (text, "%-40s %8s %12s %12s %12s %12s %12s\n", "name", "calls", "wall ms", "cpu ms", "mean ms", "max ms", "heap bytes");
+  for (i = 0; i < sorted->len; i++)
+    {
+      ProfileEntry *entry = g_ptr_array_index (sorted, i);
+      g_string_append_printf (text, "%-40s %8u %12.3f %12.3f %12.3f %12.3f %12ld\n", entry->name, entry->calls,
+                              entry->wall / 1000.0, entry->cpu / 1000.0, entry->wall / 1000.0 / entry->calls, entry->wall_max / 1000.0, entry->heap);
+      append_histogram (text, "wall", entry->wall_histogram);
+      append_histogram (text, "cpu", entry->cpu_histogram);
+    }
+  if (dropped)
+    g_string_append_printf (text, "%d calls from the audio callbacks were not recorded\n", g_atomic_int_get (&dropped));
+  g_mutex_unlock (&profile_mutex);
+  g_ptr_array_free (sorted, TRUE);
+  return g_string_free (text, FALSE);
+}
@@ -0,0 +1,59 @@
+/*
+ * profile.h
+ * counting and timing the commands and the busiest functions of Denemo while
+ * profiling is switched on, see d-ProfileStart
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor Boston, MA 02110-1301,  USA
+ */
+#ifndef PROFILE_H
+#define PROFILE_H
+#include <glib.h>
+
+typedef struct ProfileMark
+{
+  const gchar *name;            /* NULL if profiling was off when the mark was made */
+  gint64 wall;                  /* microseconds */
+  gint64 cpu;                   /* microseconds of this thread */
+  glong heap;                   /* bytes of heap in use, -1 if not measured */
+  gboolean realtime;            /* made in an audio callback */
+} ProfileMark;
+
+/* TRUE while profiling, only to be read through the macros below */
+extern gboolean profile_active;
+
+void profile_begin (ProfileMark * mark, const gchar * name, gboolean realtime);
+void profile_end (ProfileMark * mark);
+
+/* PROFILE_BEGIN declares mark and starts timing name, PROFILE_END (mark) records the time since.
+   When profiling is off they cost a test of profile_active. name must stay valid until PROFILE_END.
+   PROFILE_BEGIN_REALTIME is for the audio callbacks: it leaves out the heap, which would take a lock,
+   and the call is only pushed onto a ring buffer for profile_drain (), or dropped if the ring is full */
+#define PROFILE_BEGIN(mark, name) ProfileMark mark = { NULL, 0, 0, -1, FALSE }; if (G_UNLIKELY (profile_active)) profile_begin (&mark, name, FALSE)
+#define PROFILE_BEGIN_REALTIME(mark, name) ProfileMark mark = { NULL, 0, 0, -1, FALSE }; if (G_UNLIKELY (profile_active)) profile_begin (&mark, name, TRUE)
+#define PROFILE_END(mark) G_STMT_START { if (G_UNLIKELY ((mark).name != NULL)) profile_end (&(mark)); } G_STMT_END
+
+/* clear the profile and start profiling, writing each call to trace_file in Chrome trace event format if not NULL.
+   Returns FALSE if the trace file could not be opened */
+gboolean profile_start (const gchar * trace_file);
+/* stop profiling, closing the trace file */
+void profile_stop (void);
+/* fold the calls from the audio callbacks into the profile, called from the queue thread */
+void profile_drain (void);
+/* a description of the calls profiled so far, caller must g_free */
+gchar *profile_dump (void);
+/* bytes of heap in use, whether profiling or not, -1 if they cannot be measured */
+glong profile_heap_in_use (void);
+
+#endif //PROFILE_H
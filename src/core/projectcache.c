@@ -0,0 +1,380 @@
+/*
+ * projectcache.c
+ * binary cache of the parsed XML of a score, kept beside the .denemo file
+ *
+ * The cache holds the document tree importXML() works from, after decompression and parsing:
+ * a stream of 32 bit words describing the nodes in document order followed by the (shared) strings
+ * they refer to. It is memory mapped and the tree rebuilt from it directly, with nothing to
+ * decompress, tokenize, unescape or validate. It is only used if the score's modification time,
+ * size and SHA-256 checksum match those it was made from, so the .denemo file remains the source
+ * of truth; a stale or unreadable cache is ignored and overwritten. The score is only read to be
+ * hashed once its size and modification time are found to match.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor Boston, MA 02110-1301,  USA
+ */
+#include <string.h>
+#include <glib/gstdio.h>
+#include "core/projectcache.h"
+
+#define CACHE_MAGIC "DNMCACHE"  /* the first 8 bytes, not NUL terminated */
+#define CACHE_VERSION (1)
+#define CACHE_BYTE_ORDER (0x01020304)
+#define NO_STRING G_MAXUINT32
+
+typedef struct CacheHeader
+{
+  gchar magic[8];
+  guint32 version;
+  guint32 header_size;          /* sizeof (CacheHeader) where the cache was written, with byte_order this keeps out caches from other architectures */
+  guint32 byte_order;
+  guint32 num_words;            /* length of the node stream that follows, in words */
+  guint32 strings_size;         /* bytes of NUL terminated strings after the node stream */
+  guint32 unused;
+  gint64 mtime;                 /* of the score the cache was made from */
+  guint64 size;
+  gchar checksum[72];           /* SHA-256 of the score, in hex */
+} CacheHeader;
+
+gchar *
+project_cache_filename (const gchar * filename)
+{
+  gchar *dirname = g_path_get_dirname (filename);
+  gchar *basename = g_path_get_basename (filename);
+  gchar *cachebase = g_strdup_printf (".%s.cache", basename);
+  gchar *ret = g_build_filename (dirname, cachebase, NULL);
+  g_free (cachebase);
+  g_free (basename);
+  g_free (dirname);
+  return ret;
+}
+
+/* the SHA-256 of the contents of filename, or NULL if it cannot be read or its size and modification time
+ * are no longer size and mtime. Hashing reads the whole score, so the cheap test comes first. caller must g_free */
+static gchar *
+file_checksum (const gchar * filename, gint64 mtime, guint64 size)
+{
+  GStatBuf st;
+  GMappedFile *mapped;
+  const gchar *contents;
+  gchar *ret;
+  if (g_stat (filename, &st) != 0 || (gint64) st.st_mtime != mtime || (guint64) st.st_size != size)
+    return NULL;
+  mapped = g_mapped_file_new (filename, FALSE, NULL);
+  if (mapped == NULL)
+    return NULL;
+  contents = g_mapped_file_get_contents (mapped);       //NULL for an empty file
+  ret = g_compute_checksum_for_data (G_CHECKSUM_SHA256, (const guchar *) (contents ? contents : ""), g_mapped_file_get_length (mapped));
+  g_mapped_file_unref (mapped);
+  return ret;
+}
+
+/******************* writing *******************/
+
+typedef struct CacheWriter
+{
+  GArray *words;                /* the node stream */
+  GByteArray *strings;
+  GHashTable *offsets;          /* offset + 1 in strings of each string added */
+  gboolean ok;                  /* FALSE if the document has nodes the cache cannot hold */
+} CacheWriter;
+
+static guint32
+intern_string (CacheWriter * w, const xmlChar * str)
+{
+  gpointer found;
+  guint32 offset;
+  if (str == NULL)
+    return NO_STRING;
+  found = g_hash_table_lookup (w->offsets, str);
+  if (found)
+    return GPOINTER_TO_UINT (found) - 1;
+  offset = w->strings->len;
+  g_byte_array_append (w->strings, str, strlen ((const gchar *) str) + 1);
+  g_hash_table_insert (w->offsets, g_strdup ((const gchar *) str), GUINT_TO_POINTER (offset + 1));
+  return offset;
+}
+
+static void
+put_word (CacheWriter * w, guint32 word)
+{
+  g_array_append_val (w->words, word);
+}
+
+static void
+write_node (CacheWriter * w, xmlNodePtr node)
+{
+  switch (node->type)
+    {
+    case XML_ELEMENT_NODE:
+      {
+        xmlNsPtr ns;
+        xmlAttrPtr attr;
+        xmlNodePtr child;
+        guint32 count;
+        put_word (w, XML_ELEMENT_NODE);
+        put_word (w, intern_string (w, node->name));
+        put_word (w, intern_string (w, node->ns ? node->ns->href : NULL));
+        for (count = 0, ns = node->nsDef; ns; ns = ns->next)
+          count++;
+        put_word (w, count);
+        for (ns = node->nsDef; ns; ns = ns->next)
+          {
+            put_word (w, intern_string (w, ns->href));
+            put_word (w, intern_string (w, ns->prefix));
+          }
+        for (count = 0, attr = node->properties; attr; attr = attr->next)
+          count++;
+        put_word (w, count);
+        for (attr = node->properties; attr; attr = attr->next)
+          {
+            xmlChar *value = xmlNodeListGetString (node->doc, attr->children, 1);
+            if (attr->ns)
+              w->ok = FALSE;    //Denemo does not use namespaced attributes
+            put_word (w, intern_string (w, attr->name));
+            put_word (w, intern_string (w, value));
+            xmlFree (value);
+          }
+        for (count = 0, child = node->children; child; child = child->next)
+          count++;
+        put_word (w, count);
+        for (child = node->children; child; child = child->next)
+          write_node (w, child);
+      }
+      break;
+    case XML_TEXT_NODE:
+    case XML_CDATA_SECTION_NODE:
+    case XML_COMMENT_NODE:
+      put_word (w, node->type);
+      put_word (w, intern_string (w, node->content));
+      break;
+    default:
+      w->ok = FALSE;            //entity references and the like are left to the parser
+      break;
+    }
+}
+
+gboolean
+project_cache_write (const gchar * filename, xmlDocPtr doc)
+{
+  GStatBuf st;
+  CacheWriter w;
+  CacheHeader header;
+  gchar *checksum;
+  gboolean ret = FALSE;
+  xmlNodePtr root = xmlDocGetRootElement (doc);
+  if (root == NULL || g_stat (filename, &st) != 0)
+    return FALSE;
+  checksum = file_checksum (filename, st.st_mtime, st.st_size);
+  if (checksum == NULL)
+    return FALSE;
+  w.words = g_array_new (FALSE, FALSE, sizeof (guint32));
+  w.strings = g_byte_array_new ();
+  w.offsets = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+  w.ok = TRUE;
+  write_node (&w, root);
+  if (w.ok)
+    {
+      GByteArray *contents = g_byte_array_sized_new (sizeof (CacheHeader) + w.words->len * sizeof (guint32) + w.strings->len);
+      gchar *cachename = project_cache_filename (filename);
+      GError *error = NULL;
+      memset (&header, 0, sizeof (CacheHeader));
+      memcpy (header.magic, CACHE_MAGIC, sizeof (header.magic));
+      header.version = CACHE_VERSION;
+      header.header_size = sizeof (CacheHeader);
+      header.byte_order = CACHE_BYTE_ORDER;
+      header.num_words = w.words->len;
+      header.strings_size = w.strings->len;
+      header.mtime = st.st_mtime;
+      header.size = st.st_size;
+      g_strlcpy (header.checksum, checksum, sizeof (header.checksum));
+      g_byte_array_append (contents, (const guint8 *) &header, sizeof (CacheHeader));
+      g_byte_array_append (contents, (const guint8 *) w.words->data, w.words->len * sizeof (guint32));
+      g_byte_array_append (contents, w.strings->data, w.strings->len);
+      ret = g_file_set_contents (cachename, (const gchar *) contents->data, contents->len, &error);
+      if (!ret)
+        {
+          g_debug ("Could not write the cache for %s: %s", filename, error->message);
+          g_error_free (error);
+        }
+      g_byte_array_free (contents, TRUE);
+      g_free (cachename);
+    }
+  g_hash_table_destroy (w.offsets);
+  g_byte_array_free (w.strings, TRUE);
+  g_array_free (w.words, TRUE);
+  g_free (checksum);
+  return ret;
+}
+
+/******************* reading *******************/
+
+typedef struct CacheReader
+{
+  const guint32 *words;
+  guint32 num_words;
+  guint32 pos;
+  const gchar *strings;
+  guint32 strings_size;
+  gboolean ok;                  /* FALSE once anything out of place is found */
+} CacheReader;
+
+static guint32
+get_word (CacheReader * r)
+{
+  if (r->pos >= r->num_words)
+    {
+      r->ok = FALSE;
+      return 0;
+    }
+  return r->words[r->pos++];
+}
+
+static const xmlChar *
+get_string (CacheReader * r)
+{
+  guint32 offset = get_word (r);
+  if (offset == NO_STRING)
+    return NULL;
+  if (offset >= r->strings_size)
+    {
+      r->ok = FALSE;
+      return NULL;
+    }
+  return (const xmlChar *) (r->strings + offset);
+}
+
+/* rebuild the next node of the stream as the last child of parent, or as the root element if parent is NULL */
+static void
+read_node (CacheReader * r, xmlDocPtr doc, xmlNodePtr parent)
+{
+  guint32 type = get_word (r);
+  if (!r->ok)
+    return;
+  if (type == XML_ELEMENT_NODE)
+    {
+      const xmlChar *name = get_string (r);
+      const xmlChar *href = get_string (r);
+      xmlNodePtr node;
+      guint32 i, count;
+      if (name == NULL)
+        {
+          r->ok = FALSE;
+          return;
+        }
+      node = xmlNewDocNode (doc, NULL, name, NULL);
+      if (parent)
+        xmlAddChild (parent, node);
+      else
+        xmlDocSetRootElement (doc, node);
+      count = get_word (r);
+      for (i = 0; r->ok && i < count; i++)
+        {
+          const xmlChar *nshref = get_string (r);
+          const xmlChar *prefix = get_string (r);
+          xmlNewNs (node, nshref, prefix);
+        }
+      if (href)
+        xmlSetNs (node, xmlSearchNsByHref (doc, node, href));
+      count = get_word (r);
+      for (i = 0; r->ok && i < count; i++)
+        {
+          const xmlChar *attrname = get_string (r);
+          const xmlChar *value = get_string (r);
+          if (attrname == NULL)
+            r->ok = FALSE;
+          else
+            xmlNewProp (node, attrname, value);
+        }
+      count = get_word (r);
+      for (i = 0; r->ok && i < count; i++)
+        read_node (r, doc, node);
+    }
+  else
+    {
+      const xmlChar *content = get_string (r);
+      xmlNodePtr node = NULL;
+      if (parent == NULL || !r->ok)
+        {
+          r->ok = FALSE;
+          return;
+        }
+      switch (type)
+        {
+        case XML_TEXT_NODE:
+          node = xmlNewDocText (doc, content);
+          break;
+        case XML_CDATA_SECTION_NODE:
+          node = xmlNewCDataBlock (doc, content, content ? strlen ((const gchar *) content) : 0);
+          break;
+        case XML_COMMENT_NODE:
+          node = xmlNewDocComment (doc, content);
+          break;
+        default:
+          r->ok = FALSE;
+          return;
+        }
+      xmlAddChild (parent, node);
+    }
+}
+
+xmlDocPtr
+project_cache_read (const gchar * filename)
+{
+  gchar *cachename = project_cache_filename (filename);
+  GMappedFile *mapped = NULL;
+  xmlDocPtr doc = NULL;
+  if (g_file_test (cachename, G_FILE_TEST_IS_REGULAR))
+    mapped = g_mapped_file_new (cachename, FALSE, NULL);
+  if (mapped)
+    {
+      const gchar *contents = g_mapped_file_get_contents (mapped);
+      gsize length = g_mapped_file_get_length (mapped);
+      const CacheHeader *header = (const CacheHeader *) contents;
+      if ((length >= sizeof (CacheHeader))
+          && !memcmp (header->magic, CACHE_MAGIC, sizeof (header->magic))
+          && (header->version == CACHE_VERSION)
+          && (header->header_size == sizeof (CacheHeader))
+          && (header->byte_order == CACHE_BYTE_ORDER)
+          && (length == sizeof (CacheHeader) + (gsize) header->num_words * sizeof (guint32) + header->strings_size)
+          && (header->strings_size > 0) && (contents[length - 1] == 0)
+          && memchr (header->checksum, 0, sizeof (header->checksum)))
+        {
+          gchar *checksum = file_checksum (filename, header->mtime, header->size);    //NULL, without reading the score, if it has been touched since
+          if (checksum && !strcmp (checksum, header->checksum))
+            {
+              CacheReader r;
+              r.words = (const guint32 *) (contents + sizeof (CacheHeader));
+              r.num_words = header->num_words;
+              r.pos = 0;
+              r.strings = contents + sizeof (CacheHeader) + (gsize) header->num_words * sizeof (guint32);
+              r.strings_size = header->strings_size;
+              r.ok = TRUE;
+              doc = xmlNewDoc ((const xmlChar *) "1.0");
+              doc->encoding = xmlStrdup ((const xmlChar *) "UTF-8");    //the strings are held as libxml holds them, in UTF-8
+              read_node (&r, doc, NULL);
+              if (!r.ok || r.pos != r.num_words)
+                {
+                  g_warning ("The cache %s is damaged, ignoring it", cachename);
+                  xmlFreeDoc (doc);
+                  doc = NULL;
+                }
+            }
+          g_free (checksum);
+        }
+      g_mapped_file_unref (mapped);
+    }
+  g_free (cachename);
+  return doc;
+}
@@ -0,0 +1,31 @@
+/*
+ * projectcache.h
+ * binary cache of the parsed XML of a score, kept beside the .denemo file
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor Boston, MA 02110-1301,  USA
+ */
+#ifndef PROJECTCACHE_H
+#define PROJECTCACHE_H
+#include <glib.h>
+#include <libxml/tree.h>
+
+/* the name of the cache for the score filename, caller must g_free */
+gchar *project_cache_filename (const gchar * filename);
+/* the parsed XML of filename (a .denemo or .denemo.gz file) taken from its cache if that is up to date, or NULL */
+xmlDocPtr project_cache_read (const gchar * filename);
+/* write doc, just parsed from filename, as the cache for filename. Returns FALSE if it could not be cached */
+gboolean project_cache_write (const gchar * filename, xmlDocPtr doc);
+
+#endif //PROJECTCACHE_H
@@ -562,9 +562,10 @@ normal_cursor (GtkWidget * area)
 static void
 windows_draw_text (cairo_t * cr, const char *font, const char *text, double x, double y, double size, gboolean invert)
 {
+  PangoLayout *layout;
+  flush_glyph_runs ();          //pango text goes above the glyphs drawn before it
   y -= size;
   size *= 0.75;
-  PangoLayout *layout;
   PangoFontDescription *desc;
   /* Create a PangoLayout, set the font and text */
   layout = pango_cairo_create_layout (cr);
@@ -589,6 +590,7 @@ windows_draw_text (cairo_t * cr, const char *font, const char *text, double x, d
 void
 drawbitmapinverse_cr (cairo_t * cr, DenemoGraphic * mask, gint x, gint y, gboolean invert)
 {
+  flush_glyph_runs ();          //directive graphics go above the glyphs drawn before them
   cairo_save (cr);
   switch (mask->type)
     {
@@ -629,19 +631,176 @@ drawbitmapinverse_cr (cairo_t * cr, DenemoGraphic * mask, gint x, gint y, gboole
   cairo_restore (cr);
 }
 
+/* A font resolved once by family name, with the scaled fonts made from it for the
+ * sizes and transformations recently drawn at, and the glyph index of each
+ * character drawn in it. */
+#define SCALED_FONTS (4)
+typedef struct DenemoScaledFont
+{
+  gdouble size;
+  cairo_matrix_t ctm;           /* only the linear part matters to the scaled font */
+  cairo_scaled_font_t *scaled;
+} DenemoScaledFont;
+
+typedef struct DenemoFontCache
+{
+  const gchar *family;
+  cairo_font_face_t *face;
+  GHashTable *glyphs;           /* character -> glyph index + 1 */
+  DenemoScaledFont scaled[SCALED_FONTS];
+  gint next;                    /* the slot to be replaced next */
+} DenemoFontCache;
+
+static DenemoFontCache feta_font = { "feta26" };
+static DenemoFontCache denemo_font = { "Denemo" };
+
+static cairo_scaled_font_t *
+get_scaled_font (DenemoFontCache * font, cairo_t * cr, gdouble size)
+{
+  cairo_matrix_t ctm, font_matrix;
+  cairo_font_options_t *options;
+  DenemoScaledFont *slot;
+  gint i;
+  if (font->face == NULL)
+    {
+      font->face = cairo_toy_font_face_create (font->family, CAIRO_FONT_SLANT_NORMAL, CAIRO_FONT_WEIGHT_NORMAL);
+      font->glyphs = g_hash_table_new (NULL, NULL);
+    }
+  cairo_get_matrix (cr, &ctm);
+  ctm.x0 = ctm.y0 = 0.0;
+  for (i = 0; i < SCALED_FONTS; i++)
+    {
+      slot = font->scaled + i;
+      if (slot->scaled && slot->size == size && !memcmp (&slot->ctm, &ctm, sizeof (ctm)))
+        return slot->scaled;
+    }
+  slot = font->scaled + font->next;
+  font->next = (font->next + 1) % SCALED_FONTS;
+  if (slot->scaled)
+    cairo_scaled_font_destroy (slot->scaled);
+  cairo_matrix_init_scale (&font_matrix, size, size);
+  options = cairo_font_options_create ();
+  cairo_get_font_options (cr, options);
+  slot->scaled = cairo_scaled_font_create (font->face, &font_matrix, &ctm, options);
+  cairo_font_options_destroy (options);
+  slot->size = size;
+  slot->ctm = ctm;
+  return slot->scaled;
+}
+
+/* Glyphs are collected into runs between begin_glyph_runs() and end_glyph_runs(), and a
+ * run is drawn with a single cairo_show_glyphs() when the font, source or transformation
+ * changes, or when flush_glyph_runs() is called. Outside these calls glyphs are drawn at once. */
+static struct
+{
+  cairo_t *cr;                  /* the context being drawn on, NULL when not collecting runs */
+  cairo_scaled_font_t *scaled;
+  cairo_pattern_t *source;
+  cairo_matrix_t ctm;
+  GArray *glyphs;
+} glyph_run;
+
+static gboolean
+same_source (cairo_pattern_t * a, cairo_pattern_t * b)
+{
+  gdouble ar, ag, ab, aa, br, bg, bb, ba;
+  if (a == b)
+    return TRUE;
+  if (cairo_pattern_get_rgba (a, &ar, &ag, &ab, &aa) != CAIRO_STATUS_SUCCESS || cairo_pattern_get_rgba (b, &br, &bg, &bb, &ba) != CAIRO_STATUS_SUCCESS)
+    return FALSE;
+  return ar == br && ag == bg && ab == bb && aa == ba;
+}
+
+/* draw the glyphs collected so far */
+void
+flush_glyph_runs (void)
+{
+  cairo_t *cr = glyph_run.cr;
+  if (cr == NULL || glyph_run.glyphs->len == 0)
+    return;
+  cairo_save (cr);
+  cairo_set_matrix (cr, &glyph_run.ctm);
+  cairo_set_source (cr, glyph_run.source);
+  cairo_set_scaled_font (cr, glyph_run.scaled);
+  cairo_show_glyphs (cr, (cairo_glyph_t *) glyph_run.glyphs->data, glyph_run.glyphs->len);
+  cairo_restore (cr);
+  g_array_set_size (glyph_run.glyphs, 0);
+  cairo_scaled_font_destroy (glyph_run.scaled);
+  cairo_pattern_destroy (glyph_run.source);
+  glyph_run.scaled = NULL;
+  glyph_run.source = NULL;
+}
+
+/* start collecting the glyphs drawn on cr into runs */
+void
+begin_glyph_runs (cairo_t * cr)
+{
+  end_glyph_runs ();
+  if (glyph_run.glyphs == NULL)
+    glyph_run.glyphs = g_array_new (FALSE, FALSE, sizeof (cairo_glyph_t));
+  glyph_run.cr = cairo_reference (cr);
+}
+
+/* draw the glyphs collected and stop collecting them */
+void
+end_glyph_runs (void)
+{
+  if (glyph_run.cr == NULL)
+    return;
+  flush_glyph_runs ();
+  cairo_destroy (glyph_run.cr);
+  glyph_run.cr = NULL;
+}
+
+static void
+show_glyphs (cairo_t * cr, cairo_scaled_font_t * scaled, cairo_glyph_t * glyphs, gint num_glyphs)
+{
+  cairo_matrix_t ctm;
+  if (cr != glyph_run.cr)
+    {
+      cairo_set_scaled_font (cr, scaled);
+      cairo_show_glyphs (cr, glyphs, num_glyphs);
+      return;
+    }
+  cairo_get_matrix (cr, &ctm);
+  if (glyph_run.glyphs->len && (scaled != glyph_run.scaled || !same_source (cairo_get_source (cr), glyph_run.source) || memcmp (&ctm, &glyph_run.ctm, sizeof (ctm))))
+    flush_glyph_runs ();
+  if (glyph_run.glyphs->len == 0)
+    {
+      glyph_run.scaled = cairo_scaled_font_reference (scaled);
+      glyph_run.source = cairo_pattern_reference (cairo_get_source (cr));
+      glyph_run.ctm = ctm;
+    }
+  g_array_append_vals (glyph_run.glyphs, glyphs, num_glyphs);
+}
+
 void
 drawfetachar_cr (cairo_t * cr, gunichar uc, double x, double y)
 {
-  int len;
-  char utf_string[8];
-  len = g_unichar_to_utf8 (uc, utf_string);
-  utf_string[len] = '\0';
   //    windows_draw_text (cr, "feta26", utf_string, x, y, 35.0, FALSE); this fails to position stuff correctly, but the code below is working on windows anyway.
-  cairo_select_font_face (cr, "feta26", CAIRO_FONT_SLANT_NORMAL, CAIRO_FONT_WEIGHT_NORMAL);
-  cairo_set_font_size (cr, 35.0);
-  cairo_move_to (cr, x, y);
-  cairo_show_text (cr, utf_string);
-
+  cairo_scaled_font_t *scaled = get_scaled_font (&feta_font, cr, 35.0);
+  cairo_glyph_t glyph;
+  gulong index = GPOINTER_TO_SIZE (g_hash_table_lookup (feta_font.glyphs, GUINT_TO_POINTER (uc)));
+  if (index == 0)
+    {
+      int len;
+      char utf_string[8];
+      cairo_glyph_t *glyphs = NULL;
+      int num_glyphs = 0;
+      len = g_unichar_to_utf8 (uc, utf_string);
+      if (cairo_scaled_font_text_to_glyphs (scaled, 0.0, 0.0, utf_string, len, &glyphs, &num_glyphs, NULL, NULL, NULL) != CAIRO_STATUS_SUCCESS || num_glyphs != 1)
+        {
+          cairo_glyph_free (glyphs);
+          return;
+        }
+      index = glyphs[0].index + 1;
+      cairo_glyph_free (glyphs);
+      g_hash_table_insert (feta_font.glyphs, GUINT_TO_POINTER (uc), GSIZE_TO_POINTER (index));
+    }
+  glyph.index = index - 1;
+  glyph.x = x;
+  glyph.y = y;
+  show_glyphs (cr, scaled, &glyph, 1);
 }
 
 
@@ -654,10 +813,12 @@ drawtext_cr (cairo_t * cr, const char *text, double x, double y, double size)
       return windows_draw_text (cr, "Denemo", text, x, y, size, FALSE); //these values arrived at by trial and error, to match the previously used code below
 #else
       //use the FreeSerif font as it has music symbols - there is no font substitution done by cairo here
-      cairo_select_font_face (cr, "Denemo", CAIRO_FONT_SLANT_NORMAL, CAIRO_FONT_WEIGHT_NORMAL);
-      cairo_set_font_size (cr, size);
-      cairo_move_to (cr, x, y);
-      cairo_show_text (cr, text);
+      cairo_scaled_font_t *scaled = get_scaled_font (&denemo_font, cr, size);
+      cairo_glyph_t *glyphs = NULL;
+      int num_glyphs = 0;
+      if (cairo_scaled_font_text_to_glyphs (scaled, x, y, text, -1, &glyphs, &num_glyphs, NULL, NULL, NULL) == CAIRO_STATUS_SUCCESS)
+        show_glyphs (cr, scaled, glyphs, num_glyphs);
+      cairo_glyph_free (glyphs);
 #endif
     }
 }
@@ -3545,6 +3706,29 @@ escape_scheme (gchar * input)
   return g_string_free (out, FALSE);
 }
 
+/* calls func (job, NULL) for each of jobs and returns when all are done, running them on a thread for each processor
+ * if there are several of them, or on at most the number of threads given by the environment variable threads_env
+ * if that is set, as the tests do to check that the output does not depend on the number of threads */
+void
+run_jobs_in_pool (GPtrArray * jobs, GFunc func, const gchar * threads_env)
+{
+  GThreadPool *pool = NULL;
+  gint numthreads = 1;
+  guint i;
+#if GLIB_CHECK_VERSION(2,36,0)
+  numthreads = MIN ((gint) g_get_num_processors (), (gint) jobs->len);
+#endif
+  if (threads_env && g_getenv (threads_env) && atoi (g_getenv (threads_env)) > 0)
+    numthreads = MIN (numthreads, atoi (g_getenv (threads_env)));
+  if (numthreads > 1)
+    pool = g_thread_pool_new (func, NULL, numthreads, TRUE, NULL);
+  for (i = 0; i < jobs->len; i++)
+    if (!pool || !g_thread_pool_push (pool, g_ptr_array_index (jobs, i), NULL))
+      func (g_ptr_array_index (jobs, i), NULL);
+  if (pool)
+    g_thread_pool_free (pool, FALSE, TRUE);     /* waits for the jobs to be done */
+}
+
 gboolean
 shift_held_down (void)
 {
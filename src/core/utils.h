@@ -66,6 +66,9 @@ void removeprintdir (void);
 void drawbitmapinverse_cr (cairo_t * cr, DenemoGraphic * mask, gint x, gint y, gboolean invert);
 
 void drawfetachar_cr (cairo_t * cr, gunichar uc, double x, double y);
+void begin_glyph_runs (cairo_t * cr);
+void flush_glyph_runs (void);
+void end_glyph_runs (void);
 
 //void
 //setcairocolor (cairo_t * cr, GdkGC * gc);
@@ -331,6 +334,7 @@ gchar *find_dir_for_files (GList * files, GList * dirs);
 gchar *find_path_for_file (gchar * filename, GList * dirs);
 gchar *find_denemo_file (DenemoDirectory dir, gchar * filename);
 gchar *escape_scheme (gchar * input);
+void run_jobs_in_pool (GPtrArray * jobs, GFunc func, const gchar * threads_env);
 gchar *time_spent_editing (void);
 void reset_editing_timer (void);
 gboolean shift_held_down (void);
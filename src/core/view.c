@@ -13,6 +13,7 @@
 #include "command/lilydirectives.h"
 #include "ui/dialogs.h"
 #include "core/utils.h"
+#include "core/arena.h"
 #include <stdlib.h>
 #include <glib/gstdio.h>
 #include <cairo.h>
@@ -42,6 +43,8 @@
 #include "command/scorelayout.h"
 #include "core/keymapio.h"
 #include "core/menusystem.h"
+#include "core/batch.h"
+#include "core/profile.h"
 #include "command/measure.h"
 #include "export/audiofile.h"
 #include "export/guidedimportmidi.h"
@@ -146,11 +149,294 @@ eval_file_with_catch (gchar * filename)
   return scm_eval_status;
 }
 
+#if SCM_MAJOR_VERSION >= 2
+/* the file in the user's .denemo directory holding the compiled code for the scheme source filename, caller must g_free */
+static gchar *
+compiled_filename (const gchar * filename)
+{
+  gchar *checksum = g_compute_checksum_for_string (G_CHECKSUM_MD5, filename, -1);
+  gchar *basename = g_path_get_basename (filename);
+  gchar *name = g_strdup_printf ("%s-%s.go", basename, checksum);
+  gchar *path = g_build_filename (get_user_data_dir (TRUE), "ccache", SCM_EFFECTIVE_VERSION, name, NULL);
+  g_free (name);
+  g_free (basename);
+  g_free (checksum);
+  return path;
+}
+
+/* compile the source file compiled[0] into compiled[1], with the macros and definitions already made visible to it */
+static SCM
+compile_scheme_file (SCM * compiled)
+{
+  SCM compile_file = scm_c_public_ref ("system base compile", "compile-file");
+  return scm_apply_0 (compile_file, scm_list_5 (compiled[0], scm_from_locale_keyword ("output-file"), compiled[1], scm_from_locale_keyword ("env"), scm_current_module ()));
+}
+
+static SCM
+load_compiled_file (SCM compiled)
+{
+  return scm_call_1 (scm_variable_ref (scm_c_lookup ("load-compiled")), compiled);
+}
+
+/* the files loaded through load_compiled_with_catch () so far, each once in the order first loaded; their definitions and macros
+ * are the environment the files after them are compiled in */
+static GList *compile_environment = NULL;
+
+static void
+append_dependency (GString * deps, const gchar * path)
+{
+  GStatBuf st;
+  if (g_stat (path, &st) == 0)
+    g_string_append_printf (deps, "%s\t%ld\t%ld\n", path, (long) st.st_mtime, (long) st.st_size);
+  else
+    g_string_append_printf (deps, "%s\tmissing\n", path);
+}
+
+/* append the .scm files in dir to deps, in order of name */
+static void
+append_scheme_files (GString * deps, const gchar * dir)
+{
+  GDir *d = g_dir_open (dir, 0, NULL);
+  GList *names = NULL, *g;
+  const gchar *name;
+  if (d == NULL)
+    return;
+  while ((name = g_dir_read_name (d)))
+    if (g_str_has_suffix (name, ".scm"))
+      names = g_list_insert_sorted (names, g_strdup (name), (GCompareFunc) strcmp);
+  g_dir_close (d);
+  for (g = names; g; g = g->next)
+    {
+      gchar *path = g_build_filename (dir, (gchar *) g->data, NULL);
+      append_dependency (deps, path);
+      g_free (path);
+    }
+  g_list_free_full (names, g_free);
+}
+
+/* what the code compiled from filename depends on, one per line: the versions of Guile and Denemo, filename, the .scm files
+ * in its directory and in the denemo-modules directory beside it (which init_environment () puts on the load path, so their
+ * macros may be used by filename), and the files first loaded before it, which make up the environment it is compiled in.
+ * The compiled copy is stale unless this is what it was compiled with. Caller must g_free */
+static gchar *
+compile_dependencies (const gchar * filename)
+{
+  GString *deps = g_string_new ("");
+  gchar *dir = g_path_get_dirname (filename);
+  gchar *modules = g_build_filename (dir, "denemo-modules", NULL);
+  char *guile = scm_to_locale_string (scm_version ());
+  GList *g;
+  g_string_append_printf (deps, "guile %s\ndenemo %s\n", guile, PACKAGE_VERSION);
+  free (guile);
+  append_dependency (deps, filename);
+  append_scheme_files (deps, dir);
+  append_scheme_files (deps, modules);
+  for (g = compile_environment; g && strcmp ((gchar *) g->data, filename); g = g->next)
+    append_dependency (deps, (gchar *) g->data);
+  g_free (modules);
+  g_free (dir);
+  return g_string_free (deps, FALSE);
+}
+
+/* whether the compiled copy go was made with the dependencies deps, as recorded in depsfile when it was made */
+static gboolean
+compiled_is_current (const gchar * go, const gchar * depsfile, const gchar * deps)
+{
+  gchar *recorded = NULL;
+  gboolean ret = g_file_test (go, G_FILE_TEST_EXISTS) && g_file_get_contents (depsfile, &recorded, NULL, NULL) && !strcmp (recorded, deps);
+  g_free (recorded);
+  return ret;
+}
+#endif
+
+/* load the scheme file filename from a compiled copy in the user's .denemo directory, compiling it first if the copy is missing or
+ * was compiled against anything different from now (see compile_dependencies ()). The file is evaluated from source if the compiled
+ * copy cannot be made or loaded, or if this Guile cannot compile.
+ * Returns as eval_file_with_catch() */
+gint
+load_compiled_with_catch (gchar * filename)
+{
+#if SCM_MAJOR_VERSION >= 2
+  gchar *go;
+  gchar *deps;
+  gchar *depsfile;
+  SCM files[2];
+  if (!g_file_test (filename, G_FILE_TEST_EXISTS))
+    return eval_file_with_catch (filename);
+  go = compiled_filename (filename);
+  deps = compile_dependencies (filename);
+  depsfile = g_strconcat (go, ".deps", NULL);
+  if (!g_list_find_custom (compile_environment, filename, (GCompareFunc) strcmp))
+    compile_environment = g_list_append (compile_environment, g_strdup (filename));
+  files[0] = scm_from_locale_string (filename);
+  files[1] = scm_from_locale_string (go);
+  scm_eval_status = 0;
+  if (!compiled_is_current (go, depsfile, deps))
+    {
+      gchar *dir = g_path_get_dirname (go);
+      g_mkdir_with_parents (dir, 0770);
+      g_free (dir);
+      g_remove (depsfile);
+      g_debug ("Compiling %s to %s", filename, go);
+      scm_internal_catch (SCM_BOOL_T, (scm_t_catch_body) compile_scheme_file, (void *) files, (scm_t_catch_handler) standard_handler, (void *) filename);
+      if (scm_eval_status == 0)
+        g_file_set_contents (depsfile, deps, -1, NULL);
+    }
+  if (scm_eval_status == 0)
+    scm_internal_catch (SCM_BOOL_T, (scm_t_catch_body) load_compiled_file, (void *) files[1], (scm_t_catch_handler) standard_handler, (void *) go);
+  g_free (deps);
+  if (scm_eval_status != 0)
+    {
+      g_warning ("Could not use compiled %s, loading %s from source", go, filename);
+      g_remove (go);
+      g_remove (depsfile);
+      g_free (depsfile);
+      g_free (go);
+      return eval_file_with_catch (filename);
+    }
+  g_free (depsfile);
+  g_free (go);
+  return scm_eval_status;
+#else
+  return eval_file_with_catch (filename);
+#endif
+}
+
 gint
 call_out_to_guile (const char *script)
 {
+  PROFILE_BEGIN (mark, "call_out_to_guile");
   scm_eval_status = 0;
   scm_internal_catch (SCM_BOOL_T, (scm_t_catch_body) scm_c_eval_string, (void *) script, (scm_t_catch_handler) standard_handler, (void *) script);
+  PROFILE_END (mark);
+  return scm_eval_status;
+}
+
+static SCM
+quiet_handler (gpointer data SCM_UNUSED, SCM tag SCM_UNUSED, SCM throw_args SCM_UNUSED)
+{
+  return SCM_BOOL_F;
+}
+
+/* the top level forms of the script text, reversed, as read by Guile */
+static SCM
+read_script_forms (gchar * text)
+{
+  SCM port = scm_open_input_string (scm_from_locale_string (text));
+  SCM forms = SCM_EOL;
+  SCM form;
+  while (!SCM_EOF_OBJECT_P (form = scm_read (port)))
+    forms = scm_cons (form, forms);
+  return forms;
+}
+
+/* TRUE if the top level form would define something globally, which it could not do inside a procedure body */
+static gboolean
+defines_globals (SCM form)
+{
+  gboolean ret;
+  gchar *head;
+  if (!scm_is_pair (form) || !scm_is_symbol (SCM_CAR (form)))
+    return FALSE;
+  head = scm_to_locale_string (scm_symbol_to_string (SCM_CAR (form)));
+  ret = g_str_has_prefix (head, "define") || g_str_has_prefix (head, "load") || !strcmp (head, "primitive-load")
+    || !strcmp (head, "use-modules") || !strcmp (head, "eval-when") || !strcmp (head, "export");
+  if (!ret && (!strcmp (head, "begin") || !strcmp (head, "if") || !strcmp (head, "when") || !strcmp (head, "unless")))
+    {
+      SCM rest;
+      for (rest = SCM_CDR (form); !ret && scm_is_pair (rest); rest = SCM_CDR (rest))
+        ret = defines_globals (SCM_CAR (rest));
+    }
+  free (head);
+  return ret;
+}
+
+/* compile the script for row into a procedure taking the name of the script (CurrentScript) and its params,
+ * returns #f if the script must be evaluated at the top level instead */
+static SCM
+compile_script (command_row * row)
+{
+  SCM forms = scm_internal_catch (SCM_BOOL_T, (scm_t_catch_body) read_script_forms, (void *) row->scheme, (scm_t_catch_handler) quiet_handler, NULL);
+  SCM procedure = SCM_BOOL_F;
+  gchar *text;
+  if (!scm_is_pair (forms))
+    return SCM_BOOL_F;          //empty, or a read error which the top level evaluation will report
+  for (; scm_is_pair (forms); forms = SCM_CDR (forms))
+    if (defines_globals (SCM_CAR (forms)))
+      return SCM_BOOL_F;
+  //the newline before the closing parenthesis stops a trailing comment swallowing it
+  text = g_strdup_printf ("(lambda (CurrentScript %s::params)\n%s\n)", row->name, row->scheme);
+  procedure = scm_internal_catch (SCM_BOOL_T, (scm_t_catch_body) scm_c_eval_string, (void *) text, (scm_t_catch_handler) quiet_handler, NULL);
+  g_free (text);
+  return scm_is_true (scm_procedure_p (procedure)) ? procedure : SCM_BOOL_F;
+}
+
+/* drop the procedure compiled from the script for row */
+void
+forget_script_procedure (command_row * row)
+{
+  if (row->procedure)
+    {
+      SCM procedure = SCM_PACK ((scm_t_bits) row->procedure);
+      if (scm_is_true (procedure))
+        scm_gc_unprotect_object (procedure);
+      row->procedure = NULL;
+    }
+}
+
+typedef struct ScriptCall
+{
+  SCM procedure;
+  SCM name;
+  SCM params;
+} ScriptCall;
+
+static SCM
+apply_script (ScriptCall * call)
+{
+  return scm_call_2 (call->procedure, call->name, call->params);
+}
+
+/* run the script for the command idx, which get_scheme_from_idx() has loaded, passing it params.
+ * The script is compiled into a procedure the first time it is run, and the procedure is kept in the command row until the script changes.
+ * Scripts that define things at the top level are evaluated from their text each time, with CurrentScript and <name>::params
+ * defined globally.
+ * Returns 0 on success, -1 if the script threw an error */
+gint
+call_out_to_script (gint idx, SCM params)
+{
+  command_row *row = NULL;
+  SCM procedure;
+  if (!keymap_get_command_row (Denemo.map, &row, idx) || row->scheme == NULL)
+    return -1;
+  PROFILE_BEGIN (mark, row->name);
+  if (row->procedure == NULL)
+    {
+      procedure = compile_script (row);
+      if (scm_is_true (procedure))
+        scm_gc_protect_object (procedure);
+      row->procedure = (gpointer) SCM_UNPACK (procedure);
+    }
+  procedure = SCM_PACK ((scm_t_bits) row->procedure);
+  scm_eval_status = 0;
+  if (scm_is_true (procedure))
+    {
+      ScriptCall call;
+      call.procedure = procedure;
+      call.name = scm_from_locale_string (row->name);
+      call.params = params;
+      scm_internal_catch (SCM_BOOL_T, (scm_t_catch_body) apply_script, (void *) &call, (scm_t_catch_handler) standard_handler, (void *) row->name);
+    }
+  else
+    {
+      gchar *paramvar = g_strdup_printf ("%s::params", row->name);
+      scm_c_define ("CurrentScript", scm_from_locale_string (row->name));
+      scm_c_define (paramvar, params);
+      call_out_to_guile (row->scheme);
+      scm_c_define (paramvar, SCM_BOOL_F);
+      g_free (paramvar);
+    }
+  PROFILE_END (mark);
   return scm_eval_status;
 }
 
@@ -446,7 +732,7 @@ load_scheme_init (void)
 
   g_debug ("System wide denemo.scm %s\n", filename);
   if (g_file_test (filename, G_FILE_TEST_EXISTS))
-    eval_file_with_catch (filename);    //scm_c_primitive_load(filename);
+    load_compiled_with_catch (filename);
   else
     g_warning ("Cannot find Denemo's scheme initialization file denemo.scm");
   g_free (filename);
@@ -681,6 +967,12 @@ inner_main (void *files)
       }
   }
 
+  if (Denemo.batch)
+    {
+      run_batch_jobs (stdin);
+      exit (0);
+    }
+
   //project related initializations
   if (!Denemo.non_interactive)
     {
@@ -858,6 +1150,15 @@ free_movements (DenemoProject * project)
   project->lilycontrol.orientation = TRUE;      //portrait
 }
 
+/* log how much memory undo snapshots took this session, shown with --verbose */
+static void
+report_arena_statistics (void)
+{
+  gchar *stats = arena_statistics ();
+  g_info ("Undo snapshots: %s", stats);
+  g_free (stats);
+}
+
 /**
 * Wrapper function to close application when the quit
 * menu item has been used
@@ -904,7 +1205,10 @@ closewrapper (DenemoAction * action, DenemoScriptParam * param)
         }
     }
   else
-    exit(ret);
+    {
+      report_arena_statistics ();
+      exit(ret);
+    }
 }
 
 /**
@@ -1063,6 +1367,10 @@ close_gui_with_check (DenemoAction * action, DenemoScriptParam * param)
       writePalettes ();
       // Remove the temporary print directory
       removeprintdir ();
+#ifdef USE_EVINCE
+      thumbnail_pool_shutdown ();
+#endif
+      report_arena_statistics ();
 #ifdef G_OS_WIN32
       if (project)
         {
@@ -2223,42 +2531,23 @@ activate_script (DenemoAction * action, DenemoScriptParam * param)
   gint idx = lookup_command_from_name (Denemo.map, name);
   gboolean ret = FALSE;
 
+  /* the script is passed its name (CurrentScript) and its parameters (<name>::params),
+     scripts must copy their name into local storage if they need it inside procedures they leave behind */
+  if (!is_action_name_builtin (name))
     {
-      //FIXME use define_scheme_variable for this
-      //define a global variable in Scheme (CurrentScript) to give the name of the currently executing script
-      const gchar *name = denemo_action_get_name (action);
-      gchar *current_script = g_strdup_printf ("(define CurrentScript \"%s\")\n", name);
-
-      /*note that scripts must copy their name from CurrentScript into local storage before calling other scripts if they
-         need it */
-      gchar *paramvar = NULL;
-      if (param && param->string)
+      gchar *text = get_scheme_from_idx (idx);
+      if (text)
         {
-          paramvar = g_strdup_printf ("%s::params", name);
-          scm_c_define (paramvar, scm_from_locale_string (param->string->str));
+          SCM params = (param && param->string) ? scm_from_locale_string (param->string->str) : SCM_BOOL_F;
+          stage_undo (project->movement, ACTION_STAGE_END); //undo is a queue so this is the end :)
+          ret = (gboolean) ! call_out_to_script (idx, params);
+          stage_undo (project->movement, ACTION_STAGE_START);
         }
-
-      scm_c_eval_string (current_script);
-      g_free (current_script);
-
-      gchar *text = get_scheme_from_idx (idx);
-      if (!is_action_name_builtin ((gchar *) denemo_action_get_name (action)))
+      else
         {
-          if (text)
-            {
-              stage_undo (project->movement, ACTION_STAGE_END); //undo is a queue so this is the end :)
-              ret = (gboolean) ! call_out_to_guile (text);
-              stage_undo (project->movement, ACTION_STAGE_START);
-            }
-          else
-            {
-              g_warning ("Could not get script for %s", denemo_action_get_name (action));
-              ret = FALSE;
-            }
+          g_warning ("Could not get script for %s", name);
+          ret = FALSE;
         }
-      if (paramvar)
-        scm_c_define (paramvar, SCM_BOOL_F);
-      g_free (paramvar);
     }
   return ret;
 }
@@ -89,6 +89,8 @@ gchar modifier_code (gpointer fn);
 gboolean code_is_a_duration (gchar code);
 
 gint call_out_to_guile (const char *script);
+gint call_out_to_script (gint idx, SCM params);
+void forget_script_procedure (command_row * row);
 
 void set_playbutton (gboolean pause);
 
@@ -117,6 +119,7 @@ SCM scheme_next_note (SCM optional);
 void define_scheme_literal_variable (const gchar * varname, const gchar * value, gchar * tooltip);
 gboolean show_midi_record_control (void);
 gint eval_file_with_catch (gchar * filename);
+gint load_compiled_with_catch (gchar * filename);
 
 GtkWidget *get_playalong_button ();
 GtkWidget *get_conduct_button ();
@@ -12,6 +12,7 @@
 #include "command/staff.h"
 #include "core/utils.h"
 #include "command/measure.h"
+#include "core/profile.h"
 
 #define mudobj(x) ((DenemoObject *) x->data)
 #define CHORDTEST(node) ((mudobj(node)->type!=CHORD)||((mudobj(node)->type==CHORD && ((chord *)(mudobj(node)->object))->is_grace)))
@@ -326,7 +327,7 @@ find_xes_in_measure (DenemoMovement * si, gint measurenum)
   gint time1, time2;
   //timesig *thetime = g_list_
   staffnode *cur_staff = si->currentstaff;
-  measurenode *mnode = g_list_nth (((DenemoStaff*)cur_staff->data)->themeasures, measurenum-1);
+  measurenode *mnode = staff_nth_measure_node (cur_staff, measurenum-1);
   if (mnode == NULL) { g_critical ("Call to find_xes_in_measure for bad measure number %d", measurenum);return;}
   DenemoMeasure *meas = (DenemoMeasure*)mnode->data;
   if (meas == NULL) { g_critical ("Call to find_xes_in_measure for bad measure number %d", measurenum);return;}
@@ -360,7 +361,7 @@ find_xes_in_measure (DenemoMovement * si, gint measurenum)
 // Point cur_obj_nodes[i] to the list of objects in the measure for the i'th staff  (if no measure NULL)
       if (((DenemoStaff *) cur_staff->data)->nummeasures >= measurenum)
         {
-          block_start_obj_nodes[i] = cur_obj_nodes[i] = /*measure_first_obj_node*/ (((DenemoMeasure*)g_list_nth (((DenemoStaff*)cur_staff->data)->themeasures, measurenum - 1)->data)->objects); //FIXME DANGER
+          block_start_obj_nodes[i] = cur_obj_nodes[i] = /*measure_first_obj_node*/ (staff_nth_measure (cur_staff, measurenum - 1)->objects); //FIXME DANGER
         }
       else
         {
@@ -427,8 +428,10 @@ void
 find_xes_in_all_measures (DenemoMovement * si)
 {
   gint i, n = g_list_length (si->measurewidths);
+  PROFILE_BEGIN (mark, "find_xes_in_all_measures");
   //g_debug ("Number of measures in score %d\n", n);
   for (i = 1; i <= n; i++)
     find_xes_in_measure (si, i);
   /* obviously inefficient; should fix this */
+  PROFILE_END (mark);
 }
@@ -24,10 +24,12 @@
 #include "export/exportlilypond.h"     /* to generate lily text for display */
 #include "audio/pitchentry.h"
 #include "command/lyric.h"
+#include "command/score.h"
 #include "audio/midi.h"
 #include "display/displayanimation.h"
 #include "ui/moveviewport.h"
 #include "audio/audiointerface.h"
+#include "core/profile.h"
 
 #define EXCL_WIDTH 3
 #define EXCL_HEIGHT 13
@@ -35,6 +37,20 @@
 static gboolean layout_needed = TRUE;   //Set FALSE when further call to draw_score(NULL) is not needed.
 static GList *MidiDrawObject;/* a chord used for drawing MIDI recorded notes on the score */
 static gboolean last_tied = FALSE;
+static gint offscreen_width, offscreen_height;  /* size of the surface being drawn by draw_score_offscreen(), 0 when drawing the score area */
+
+static gint
+score_area_width (void)
+{
+  return offscreen_width ? offscreen_width : get_widget_width (Denemo.scorearea);
+}
+
+static gint
+score_area_height (void)
+{
+  return offscreen_height ? offscreen_height : get_widget_height (Denemo.scorearea);
+}
+
 void
 initialize_playhead (void)
 {
@@ -154,40 +170,6 @@ struct infotopass
   gint range_lo, range_hi;
 };
 
-/* count the number of syllables up to staff->leftmeasurenum */
-static gint
-count_syllables (DenemoStaff * staff, gint from)
-{
-  gint count = 0;
-  gint i;
-  GList *curmeasure = staff->themeasures;
-  gboolean in_slur = FALSE;
-  for (i = 1; curmeasure && (i < from); i++, curmeasure = curmeasure->next)
-    {
-      objnode *curobj;
-      for (curobj = ((DenemoMeasure*)curmeasure->data)->objects; curobj; curobj = curobj->next)
-        {
-          DenemoObject *obj = curobj->data;
-
-          if (obj->type == CHORD)
-            {
-              chord *thechord = ((chord *) obj->object);
-              if (thechord->notes && !in_slur)
-                count++;
-              if (thechord->slur_begin_p)
-                in_slur = TRUE;
-              if (thechord->slur_end_p)
-                in_slur = FALSE;
-              if (thechord->is_tied && (!in_slur))
-                count--;
-            }
-        }                       //for objs
-    }                           //for measures
-  if (in_slur)
-    return -count;
-  return count;
-}
-
 static void draw_note_onset(cairo_t *cr, double x, const gchar *glyph, gboolean mark)
 {
     if(glyph) {
@@ -689,6 +671,7 @@ draw_object (cairo_t * cr, objnode * curobj, gint x, gint y, DenemoProject * gui
                                  itp->wholenotewidth));
   if (si->currentobject == curobj)
     {                           /* Draw the cursor */
+      flush_glyph_runs ();      //the cursor goes above the glyphs drawn so far
       /* Determine if it needs to be red or not */
       if (si->cursor_appending || mudelaitem->type != CHORD)
         si->cursoroffend = (mudelaitem->starttickofnextnote >= itp->tickspermeasure);
@@ -782,6 +765,7 @@ draw_measure (cairo_t * cr, measurenode * curmeasure, gint x, gint y, DenemoProj
       /* That is, the cursor's at the beginning of this blank measure */
       si->cursoroffend = FALSE;
       has_cursor = TRUE;
+      flush_glyph_runs ();
       draw_cursor (cr, si, x, y, 0, gui->mode, itp->clef->type);
     }
 
@@ -836,6 +820,7 @@ draw_measure (cairo_t * cr, measurenode * curmeasure, gint x, gint y, DenemoProj
     }                           // for each object
   if (cr)
     {
+      flush_glyph_runs ();      //the glyphs of the measure go under the fill status and selection marks
       cairo_save (cr);
       //marking the barline if within selection
       if (si->markstaffnum &&
@@ -940,7 +925,7 @@ draw_staff (cairo_t * cr, staffnode * curstaff, gint y, DenemoProject * gui, str
   // if(si->marked_onset_position)
     //g_debug("repeat"),repeat = TRUE;//we set up the marked onset with this, then need to repeat to draw it
   //g_debug("drawing staff %d at %d\n", itp->staffnum, y);
-  gint nummeasures = g_list_length (thestaff->themeasures);
+  gint nummeasures = staff_measure_count (curstaff);
 
   //g_debug("Of %d current %d\n", nummeasures, itp->measurenum);
   if (itp->measurenum > nummeasures)
@@ -1102,7 +1087,7 @@ draw_staff (cairo_t * cr, staffnode * curstaff, gint y, DenemoProject * gui, str
 
   /* Loop that will draw each measure. Basically a for loop, but was uglier
    * when written that way.  */
-  itp->curmeasure = g_list_nth (thestaff->themeasures, itp->measurenum - 1);
+  itp->curmeasure = staff_nth_measure_node (curstaff, itp->measurenum - 1);
   //g_debug("measurenum %d\nx=%d\n", itp->measurenum, x);
 
   //FIX in measure.c for case where si->measurewidths is too short
@@ -1144,7 +1129,7 @@ draw_staff (cairo_t * cr, staffnode * curstaff, gint y, DenemoProject * gui, str
   while ((!itp->line_end) && itp->measurenum <= nummeasures)
     {
 
-      if (x + GPOINTER_TO_INT (itp->mwidthiterator->data) + SPACE_FOR_BARLINE > (int) (get_widget_width (Denemo.scorearea) / gui->movement->zoom - (RIGHT_MARGIN + (gui->leftmargin+35) + si->maxkeywidth + SPACE_FOR_TIME)))
+      if (x + GPOINTER_TO_INT (itp->mwidthiterator->data) + SPACE_FOR_BARLINE > (int) (score_area_width () / gui->movement->zoom - (RIGHT_MARGIN + (gui->leftmargin+35) + si->maxkeywidth + SPACE_FOR_TIME)))
         itp->line_end = TRUE;
 
       itp->last_gap = 0;
@@ -1163,7 +1148,7 @@ draw_staff (cairo_t * cr, staffnode * curstaff, gint y, DenemoProject * gui, str
            (Denemo.project->view != DENEMO_PAGE_VIEW && itp->line_end && itp->measurenum > si->rightmeasurenum) ||
 #endif
            (Denemo.project->view == DENEMO_PAGE_VIEW && itp->line_end && itp->curmeasure->next))
-        *itp->scale = (int) (100 * x / (get_widget_width (Denemo.scorearea) / gui->movement->zoom));
+        *itp->scale = (int) (100 * x / (score_area_width () / gui->movement->zoom));
       else
         *itp->scale = 100;
 
@@ -1215,7 +1200,7 @@ draw_staff (cairo_t * cr, staffnode * curstaff, gint y, DenemoProject * gui, str
         if (!itp->end)
           {
              cairo_save (cr);
-             gint xx = get_widget_width (Denemo.scorearea) / gui->movement->zoom - 20;
+             gint xx = score_area_width () / gui->movement->zoom - 20;
               if (Denemo.hovering_over_right_arrow)
                 {
                     cairo_rectangle (cr, xx, y, 30, 40);
@@ -1269,7 +1254,7 @@ print_system_separator (cairo_t * cr, gdouble position)
 #define SYSTEM_SEP (6)
   cairo_save (cr);
   cairo_set_source_rgb (cr, 0.5, 0.0, 0.0);
-  cairo_rectangle (cr, 0, position - SYSTEM_SEP / 2, get_widget_width (Denemo.scorearea) / Denemo.project->movement->zoom, SYSTEM_SEP);
+  cairo_rectangle (cr, 0, position - SYSTEM_SEP / 2, score_area_width () / Denemo.project->movement->zoom, SYSTEM_SEP);
 
   cairo_set_source_rgb (cr, 0.7, 0.0, 0.0);
   cairo_fill (cr);
@@ -1378,7 +1363,7 @@ draw_score (cairo_t * cr)
   gdouble leftmost = 10000000.0;
   DenemoProject *gui = Denemo.project;
   DenemoMovement *si = gui->movement;
-  gint line_height = get_widget_height (Denemo.scorearea) * gui->movement->system_height / gui->movement->zoom;
+  gint line_height = score_area_height () * gui->movement->system_height / gui->movement->zoom;
   static gint flip_count;       //passed to a timer to indicate which stage of animation of page turn should be used when re-drawing, -1 means not animating 0+ are the stages
   
   last_tied = FALSE;
@@ -1542,7 +1527,7 @@ draw_score (cairo_t * cr)
                         
                         if (height == top_height) //the top and possibly other staffs are hidden
                             {
-                                cairo_rectangle (cr, 300, 5, get_widget_width (Denemo.scorearea) / Denemo.project->movement->zoom - 120, 3);
+                                cairo_rectangle (cr, 300, 5, score_area_width () / Denemo.project->movement->zoom - 120, 3);
                                 cairo_fill (cr);
                                 cairo_set_source_rgba (cr, 1.0, 0.5, 0.5, 1);
                                 drawnormaltext_cr (cr, hidden_text->str, 120, height);
@@ -1550,7 +1535,7 @@ draw_score (cairo_t * cr)
                             }
                         else 
                             {
-                                cairo_rectangle (cr, 20, height, get_widget_width (Denemo.scorearea) / Denemo.project->movement->zoom - 120, 3);
+                                cairo_rectangle (cr, 20, height, score_area_width () / Denemo.project->movement->zoom - 120, 3);
                                 cairo_fill (cr);
                                 cairo_set_source_rgba (cr, 1.0, 0.5, 0.5, 1);
                                 drawlargetext_cr (cr,hidden_text->str,  80, y - 35);
@@ -1662,7 +1647,7 @@ draw_score (cairo_t * cr)
       if (si->currentstaffnum == itp.staffnum)
         {
 
-          gint count = count_syllables (staff, si->leftmeasurenum);
+          gint count = staff_syllables_before (si, curstaff, si->leftmeasurenum);
           //g_print ("Count syllables from %d yields %d last_tied \n", si->leftmeasurenum, count, last_tied);
           if (count < 0)
             {
@@ -1708,7 +1693,7 @@ draw_score (cairo_t * cr)
         if (Denemo.project->movement->playingnow && itp.measurenum >= si->rightmeasurenum)
           itp.line_end = FALSE; //don't print whole lines of grayed out music during playback
 
-        while (((itp.left - gui->lefts) < DENEMO_MAX_SYSTEMS - 1) && itp.line_end && (yy < (get_widget_height (Denemo.scorearea) / gui->movement->zoom)))
+        while (((itp.left - gui->lefts) < DENEMO_MAX_SYSTEMS - 1) && itp.line_end && (yy < (score_area_height () / gui->movement->zoom)))
           {
             if (cr)
               if (itp.staffnum == si->top_staff)
@@ -1741,7 +1726,7 @@ draw_score (cairo_t * cr)
               {
                 cairo_save (cr);
                 cairo_set_source_rgb (cr, 0.0, 0.0, 1.0);       //Strong Blue Line to break pages
-                cairo_rectangle (cr, 0, line_height - 10, get_widget_width (Denemo.scorearea) / Denemo.project->movement->zoom, 10);
+                cairo_rectangle (cr, 0, line_height - 10, score_area_width () / Denemo.project->movement->zoom, 10);
                 cairo_fill (cr);
                 cairo_restore (cr);
               }
@@ -1763,13 +1748,13 @@ draw_score (cairo_t * cr)
               flip = flip_count / (gdouble) MAX_FLIP_STAGES;
             if (cr)
               {
-                cairo_translate (cr, get_widget_width (Denemo.scorearea) * (1 - flip) * 0.5 / Denemo.project->movement->zoom, 0.0);
+                cairo_translate (cr, score_area_width () * (1 - flip) * 0.5 / Denemo.project->movement->zoom, 0.0);
                 cairo_scale (cr, flip, 1.0);
 
                 if (draw_staff (flip_count > 0 ? cr : NULL, curstaff, y, gui, &itp))
                   repeat = TRUE;
                 cairo_scale (cr, 1 / flip, 1.0);
-                cairo_translate (cr, -get_widget_width (Denemo.scorearea) * (1 - flip) * 0.5 / Denemo.project->movement->zoom, 0.0);
+                cairo_translate (cr, -score_area_width () * (1 - flip) * 0.5 / Denemo.project->movement->zoom, 0.0);
               }
             //draw_break_marker();
           }
@@ -1827,6 +1812,7 @@ draw_callback (cairo_t * cr)
       g_warning ("Cannot draw!");
       return TRUE;
     }
+  visit_movement (gui);
 
   /* Layout the score. */
   if (layout_needed)
@@ -1859,11 +1845,37 @@ draw_callback (cairo_t * cr)
       cairo_set_source_rgb (cr, 0.8, 0.8, 0.8); //gray background when key strokes are not being received.
     }
   cairo_paint (cr);
-  /* Draw the score. */
+  /* Draw the score, collecting the glyphs of each measure into a few runs. */
+  PROFILE_BEGIN (mark, "draw_score");
+  begin_glyph_runs (cr);
   draw_score (cr);
+  end_glyph_runs ();
+  PROFILE_END (mark);
   return TRUE;
 }
 
+/**
+ * draw_score_offscreen
+ * Draws the score as the score area would show it into cr, a surface of width x height pixels, which needs
+ * no window, so that the drawing can be timed without the GUI.
+ */
+void
+draw_score_offscreen (cairo_t * cr, gint width, gint height)
+{
+  if ((!Denemo.project) || (!Denemo.project->movement) || (!Denemo.project->movement->currentmeasure))
+    return;
+  offscreen_width = width;
+  offscreen_height = height;
+  cairo_set_source_rgb (cr, 1.0, 1.0, 1.0);
+  cairo_paint (cr);
+  PROFILE_BEGIN (mark, "draw_score");
+  begin_glyph_runs (cr);
+  draw_score (cr);
+  end_glyph_runs ();
+  PROFILE_END (mark);
+  offscreen_width = offscreen_height = 0;
+}
+
 void
 update_drawing_cache (void)
 {
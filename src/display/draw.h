@@ -22,6 +22,7 @@ gint scorearea_draw_event (GtkWidget * widget, GdkEventExpose * event);
 #endif
 void update_drawing_cache (void);
 gboolean draw_score (cairo_t * cr);
+void draw_score_offscreen (cairo_t * cr, gint width, gint height);
 void fix_start_end_ordering();
 void draw_score_area();
 #endif
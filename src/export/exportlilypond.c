@@ -32,6 +32,7 @@
 #include "display/draw.h"
 #include "core/view.h"
 #include "core/menusystem.h"
+#include "core/profile.h"
 #include "audio/audiointerface.h"
 #include "printview/printview.h"
 
@@ -932,6 +933,253 @@ output_fakechord (GString * fakechord, chord * pchord)
 }
 
 #undef APPEND_DUR
+
+/* The LilyPond for a voice is generated into a LilyVoice as a list of LilyOps, runs of text and the
+ * anchors to be placed between them. Generating touches nothing outside the voice's own objects, so
+ * the voices can be generated in parallel (see generate_voices ()); the ops are then played into the
+ * text buffer in order, creating the anchors, on the main thread (see insert_voice ()).
+ *
+ * The ops for a chord are also kept with the chord, so that while the chord and the state prevailing
+ * before it are unchanged the next refresh can replay them instead of generating it again. The
+ * prevailing duration and grace state are all that chord output depends on outside the chord
+ * itself (pitches are absolute, so clef, key and time signature do not enter); the position of
+ * the chord in the score is only stored in the anchors and is supplied afresh on replay. */
+
+typedef enum
+{
+  LILY_TEXT,                    /* ineditable text */
+  LILY_HIGHLIGHTED_TEXT,        /* the gray blank between objects */
+  LILY_PLAIN_TEXT,              /* text without tags */
+  LILY_NAVIGATION_ANCHOR,
+  LILY_EDITABLE,                /* the prefix or postfix of a directive, see insert_editable () */
+  LILY_DIRECTIVE                /* the prefix or postfix of a standalone directive, see insert_directive () */
+} LilyOpType;
+
+typedef struct LilyOp
+{
+  LilyOpType type;
+  DenemoTargetType target;
+  gint mid_c_offset;
+  gint index;                   /* the directive's index for LILY_EDITABLE, else the length of the text */
+  guint text;                   /* offset of the text in the voice or cache */
+  gboolean blank;               /* LILY_EDITABLE with a space in place of the directive's text */
+  GString **pdirective;
+  gpointer objnode;             /* the position of the object in the score, not kept in a lilycache */
+  gint measurenum;
+  gint objnum;
+} LilyOp;
+
+/* a DenemoObject's lilycache, allocated in one block */
+typedef struct LilyCache
+{
+  guint signature_len;          /* bytes describing the chord and the state before it */
+  guint num_ops;
+  guint text_len;
+  gint prevduration;            /* the state after the chord */
+  gint prevnumdots;
+  gint grace_status;
+  gint open_braces;
+  LilyOp ops[];                 /* followed by the signature then the text */
+} LilyCache;
+
+#define LILY_CACHE_SIGNATURE(cache) ((gchar *) ((cache)->ops + (cache)->num_ops))
+#define LILY_CACHE_TEXT(cache) (LILY_CACHE_SIGNATURE (cache) + (cache)->signature_len)
+
+typedef struct LilyVoice
+{
+  DenemoProject *project;
+  DenemoStaff *staff;           /* the voice to generate */
+  gint start, end;              /* the measures to generate, 0 for all */
+  gchar *movement;              /* the LilyPond names of the movement and voice */
+  gchar *voice;
+  gint movement_count;          /* counting from 1 */
+  gint voice_count;
+  guint sbid;                   /* the layout */
+  GList *verses;                /* the text of each verse, fetched beforehand as it may be held in a widget */
+  struct LilyVoice *chained;    /* a voice to generate after this one, see generate_voices () */
+  GArray *ops;                  /* the music */
+  GString *text;
+  GString *lyrics_text;         /* the text for the lyrics, figures and chord symbols sections, if any */
+  GString *figures_text;
+  GString *fakechords_text;
+  gpointer objnode;             /* the position of the object being generated */
+  gint measurenum;
+  gint objnum;
+  gboolean recording;           /* the ops for a chord are being recorded for its lilycache */
+  guint recording_op;           /* the first of them */
+  guint recording_text;
+  GByteArray *signature;
+} LilyVoice;
+
+static void
+emit_op (LilyVoice * v, LilyOp * op)
+{
+  op->objnode = v->objnode;
+  op->measurenum = v->measurenum;
+  op->objnum = v->objnum;
+  g_array_append_val (v->ops, *op);
+}
+
+static void
+emit_text (LilyVoice * v, const gchar * text, LilyOpType type)
+{
+  LilyOp op;
+  gint len = strlen (text);
+  if (len == 0)
+    return;
+  //a run of text of the same kind is one op, but a recording starts a new one
+  if (v->ops->len > (v->recording ? v->recording_op : 0) && g_array_index (v->ops, LilyOp, v->ops->len - 1).type == type)
+    g_array_index (v->ops, LilyOp, v->ops->len - 1).index += len;
+  else
+    {
+      memset (&op, 0, sizeof (LilyOp));
+      op.type = type;
+      op.index = len;
+      op.text = v->text->len;
+      emit_op (v, &op);
+    }
+  g_string_append_len (v->text, text, len);
+}
+
+static void
+emit_navigation_anchor (LilyVoice * v, DenemoTargetType target, gint mid_c_offset)
+{
+  LilyOp op;
+  memset (&op, 0, sizeof (LilyOp));
+  op.type = LILY_NAVIGATION_ANCHOR;
+  op.target = target;
+  op.mid_c_offset = mid_c_offset;
+  emit_op (v, &op);
+}
+
+/* original is the directive's text or " " to give a space for editing */
+static void
+emit_editable (LilyVoice * v, GString ** pdirective, gchar * original, GString * lily_for_obj, DenemoTargetType target, gint directive_index, gint mid_c_offset)
+{
+  LilyOp op;
+  memset (&op, 0, sizeof (LilyOp));
+  op.type = LILY_EDITABLE;
+  op.target = target;
+  op.mid_c_offset = mid_c_offset;
+  op.index = directive_index;
+  op.pdirective = pdirective;
+  op.blank = (*pdirective == NULL) || (original != (*pdirective)->str);
+  emit_op (v, &op);
+  if (lily_for_obj)
+    g_string_append (lily_for_obj, original);
+}
+
+static void
+emit_directive (LilyVoice * v, GString ** pdirective)
+{
+  LilyOp op;
+  memset (&op, 0, sizeof (LilyOp));
+  op.type = LILY_DIRECTIVE;
+  op.pdirective = pdirective;
+  emit_op (v, &op);
+}
+
+static void
+sign_int (GByteArray * signature, gint val)
+{
+  g_byte_array_append (signature, (const guint8 *) &val, sizeof (gint));
+}
+
+static void
+sign_string (GByteArray * signature, GString * str)
+{
+  sign_int (signature, str ? (gint) str->len : -1);
+  if (str)
+    g_byte_array_append (signature, (const guint8 *) str->str, str->len);
+}
+
+/* the directives themselves are part of the signature as the replayed anchors point into them */
+static void
+sign_directives (GByteArray * signature, GList * g, guint sbid)
+{
+  sign_int (signature, g_list_length (g));
+  for (; g; g = g->next)
+    {
+      DenemoDirective *directive = (DenemoDirective *) g->data;
+      g_byte_array_append (signature, (const guint8 *) &directive, sizeof (gpointer));
+      sign_int (signature, directive->override);
+      sign_int (signature, wrong_layout (directive, sbid));
+      sign_string (signature, directive->prefix);
+      sign_string (signature, directive->postfix);
+    }
+}
+
+/* describe in signature everything the LilyPond generated for the chord curobj depends on */
+static void
+sign_chord (GByteArray * signature, DenemoObject * curobj, gint prevduration, gint prevnumdots, gint grace_status, guint sbid)
+{
+  chord *pchord = (chord *) curobj->object;
+  GList *g;
+  g_byte_array_set_size (signature, 0);
+  sign_int (signature, prevduration);
+  sign_int (signature, prevnumdots);
+  sign_int (signature, grace_status);
+  sign_int (signature, curobj->isinvisible);
+  sign_int (signature, pchord->baseduration);
+  sign_int (signature, pchord->numdots);
+  sign_int (signature, pchord->is_grace);
+  sign_int (signature, pchord->chordize);
+  sign_int (signature, pchord->is_tied);
+  sign_int (signature, pchord->slur_begin_p);
+  sign_int (signature, pchord->slur_end_p);
+  sign_int (signature, pchord->crescendo_begin_p);
+  sign_int (signature, pchord->crescendo_end_p);
+  sign_int (signature, pchord->diminuendo_begin_p);
+  sign_int (signature, pchord->diminuendo_end_p);
+  sign_int (signature, g_list_length (pchord->dynamics));
+  for (g = pchord->dynamics; g; g = g->next)
+    sign_string (signature, (GString *) g->data);
+  sign_directives (signature, pchord->directives, sbid);
+  sign_int (signature, g_list_length (pchord->notes));
+  for (g = pchord->notes; g; g = g->next)
+    {
+      note *curnote = (note *) g->data;
+      sign_int (signature, curnote->mid_c_offset);
+      sign_int (signature, curnote->enshift);
+      sign_int (signature, curnote->noteheadtype);
+      sign_directives (signature, curnote->directives, sbid);
+    }
+}
+
+/* start recording the ops generated for a chord */
+static void
+start_recording (LilyVoice * v)
+{
+  v->recording = TRUE;
+  v->recording_op = v->ops->len;
+  v->recording_text = v->text->len;
+}
+
+/* store what has been recorded, keyed by the voice's signature, as the lilycache of curobj */
+static void
+stop_recording (LilyVoice * v, DenemoObject * curobj, gint prevduration, gint prevnumdots, gint grace_status, gint open_braces)
+{
+  guint num_ops = v->ops->len - v->recording_op;
+  guint text_len = v->text->len - v->recording_text;
+  LilyCache *cache = (LilyCache *) g_malloc (sizeof (LilyCache) + num_ops * sizeof (LilyOp) + v->signature->len + text_len);
+  guint i;
+  v->recording = FALSE;
+  cache->signature_len = v->signature->len;
+  cache->num_ops = num_ops;
+  cache->text_len = text_len;
+  cache->prevduration = prevduration;
+  cache->prevnumdots = prevnumdots;
+  cache->grace_status = grace_status;
+  cache->open_braces = open_braces;
+  memcpy (cache->ops, &g_array_index (v->ops, LilyOp, v->recording_op), num_ops * sizeof (LilyOp));
+  for (i = 0; i < num_ops; i++)
+    cache->ops[i].text -= v->recording_text;
+  memcpy (LILY_CACHE_SIGNATURE (cache), v->signature->data, v->signature->len);
+  memcpy (LILY_CACHE_TEXT (cache), v->text->str + v->recording_text, text_len);
+  g_free (curobj->lilycache);
+  curobj->lilycache = cache;
+}
+
 /*
  * insert_editable()
  * Insert pair of invisble anchors and editable text between, adding the start anchor to the list in gui->anchors
@@ -945,7 +1193,7 @@ output_fakechord (GString * fakechord, chord * pchord)
  *
  */
 static void
-insert_editable (GString ** pdirective, gchar * original, GtkTextIter * iter, DenemoProject * gui, GString * lily_for_obj, DenemoTargetType type, gint movement_count, gint measurenum, gint voice_count, gint objnum, gint directive_index, gint midcoffset)
+insert_editable (GString ** pdirective, gchar * original, GtkTextIter * iter, DenemoProject * gui, DenemoTargetType type, gint movement_count, gint measurenum, gint voice_count, gint objnum, gint directive_index, gint midcoffset)
 {
   gint directivenum = directive_index + 1;
   GtkTextChildAnchor *lilyanc = gtk_text_buffer_create_child_anchor (Denemo.textbuffer, iter);
@@ -973,8 +1221,6 @@ insert_editable (GString ** pdirective, gchar * original, GtkTextIter * iter, De
   //g_debug("marked anchor %p as %d %d %d %d type %d\n", lilyanc, movement_count, measurenum, voice_count, objnum, type);
   gui->anchors = g_list_prepend (gui->anchors, lilyanc);
   gtk_text_buffer_insert_with_tags_by_name (Denemo.textbuffer, iter, g_strdup (original), -1, "bold", NULL);
-  if (lily_for_obj)
-    g_string_append (lily_for_obj, original);
   GtkTextChildAnchor *endanc = gtk_text_buffer_create_child_anchor (Denemo.textbuffer, iter);
   back = *iter;
   (void) gtk_text_iter_backward_char (&back);
@@ -1077,9 +1323,8 @@ GET_AFFIX (postfix);//defines get_postfix()
 
 //NAVANC
 #define DIRECTIVES_INSERT_EDITABLE_AFFIX(field) static void \
-directives_insert_##field##_editable (GList *directives, gint *popen_braces, gint *pprevduration, GtkTextIter *iter, gboolean override, GString *lily_for_obj,\
-                        DenemoTargetType type, gint movement_count, gint measurenum, gint voice_count, gint objnum, gint midcoffset, guint sbid) {\
-  DenemoProject *gui = Denemo.project;\
+directives_insert_##field##_editable (GList *directives, gint *popen_braces, gint *pprevduration, LilyVoice *v, gboolean override, GString *lily_for_obj,\
+                        DenemoTargetType type, gint midcoffset) {\
   GList *g = directives; gint num;\
   for(num=0;g;g=g->next, num++) {\
     DenemoDirective *directive = (DenemoDirective *)g->data;\
@@ -1087,13 +1332,12 @@ directives_insert_##field##_editable (GList *directives, gint *popen_braces, gin
       continue;\
     if(directive->override&DENEMO_OVERRIDE_HIDDEN)\
       continue;\
-      if (wrong_layout (directive, sbid))\
+      if (wrong_layout (directive, v->sbid))\
         continue;\
     if(directive->field && directive->field->len) {\
       if(pprevduration) *pprevduration = -1;            \
       if(popen_braces) *popen_braces += brace_count(directive->field->str); \
-      insert_editable(&directive->field, directive->field->str, iter, gui, lily_for_obj\
-      , type, movement_count, measurenum, voice_count, objnum, num, midcoffset);\
+      emit_editable(v, &directive->field, directive->field->str, lily_for_obj, type, num, midcoffset);\
     }\
   }\
 }
@@ -1102,9 +1346,8 @@ DIRECTIVES_INSERT_EDITABLE_AFFIX (prefix);
 DIRECTIVES_INSERT_EDITABLE_AFFIX (postfix);
 
 static void
-directives_insert_affix_postfix_editable (GList * directives, gint * popen_braces, gint * pprevduration, GtkTextIter * iter, GString * lily_for_obj, DenemoTargetType type, gint movement_count, gint measurenum, gint voice_count, gint objnum, gint midcoffset, guint sbid)
+directives_insert_affix_postfix_editable (GList * directives, gint * popen_braces, gint * pprevduration, LilyVoice * v, GString * lily_for_obj, DenemoTargetType type, gint midcoffset)
 {
-  DenemoProject *gui = Denemo.project;
   GList *g = directives;;
   gint num;
   for (num = 0; g; g = g->next, num++)
@@ -1114,7 +1357,7 @@ directives_insert_affix_postfix_editable (GList * directives, gint * popen_brace
         continue;
       if (directive->override & DENEMO_OVERRIDE_HIDDEN)
         continue;
-      if (wrong_layout (directive, sbid))
+      if (wrong_layout (directive, v->sbid))
         continue;
       if (directive->postfix && directive->postfix->len)
         {
@@ -1122,7 +1365,7 @@ directives_insert_affix_postfix_editable (GList * directives, gint * popen_brace
             *pprevduration = -1;
           if (popen_braces)
             *popen_braces += brace_count (directive->postfix->str);
-          insert_editable (&directive->postfix, directive->postfix->str, iter, gui, lily_for_obj, type, movement_count, measurenum, voice_count, objnum, num, midcoffset);
+          emit_editable (v, &directive->postfix, directive->postfix->str, lily_for_obj, type, num, midcoffset);
         }
     }
 }
@@ -1138,21 +1381,35 @@ get_lily_override (GList * g)
 
 
 
+/* output the ops recorded in the lilycache of an object, placing the anchors for its current position in the score */
+static void
+replay_lily_for_obj (LilyVoice * v, LilyCache * cache)
+{
+  guint i;
+  for (i = 0; i < cache->num_ops; i++)
+    {
+      LilyOp op = cache->ops[i];
+      op.text += v->text->len;
+      emit_op (v, &op);
+    }
+  g_string_append_len (v->text, LILY_CACHE_TEXT (cache), cache->text_len);
+}
+
 /**
  * generate the lilypond for the DenemoObject curobj
  * the state of the prevailing duration, clef keysignature are updated and returned.
  * returns the excess of open braces "{" created by this object.
  */
 static gint
-generate_lily_for_obj (DenemoProject * gui, GtkTextIter * iter, DenemoObject * curobj, gint * pprevduration, gint * pprevnumdots, gchar ** pclefname, gchar ** pkeyname, gint * pcur_stime1, gint * pcur_stime2, gint * pgrace_status, GString * figures, GString * fakechords, GtkTextMark * curmark, gpointer curobjnode, gint movement_count, gint measurenum, gint voice_count, gint objnum, guint sbid)
+generate_lily_for_obj (LilyVoice * v, DenemoObject * curobj, gint * pprevduration, gint * pprevnumdots, gchar ** pclefname, gchar ** pkeyname, gint * pcur_stime1, gint * pcur_stime2, gint * pgrace_status, GString * figures, GString * fakechords)
 {
   GString *lily_for_obj = g_string_new ("");
   GString *ret = g_string_new ("");     //no longer returned, instead put into *music
-#define outputret gtk_text_buffer_insert_with_tags_by_name (Denemo.textbuffer, iter, ret->str, -1, INEDITABLE, NULL), \
+#define outputret emit_text (v, ret->str, LILY_TEXT), \
     g_string_append(lily_for_obj, ret->str);\
     open_braces +=  brace_count(ret->str), \
     g_string_assign(ret, "")
-#define output(astring) (gtk_text_buffer_insert_with_tags_by_name (Denemo.textbuffer, iter, astring, -1, INEDITABLE, NULL));\
+#define output(astring) emit_text (v, astring, LILY_TEXT);\
             g_string_append(lily_for_obj, astring);
   gint prevduration = *pprevduration;
   gint prevnumdots = *pprevnumdots;
@@ -1172,12 +1429,28 @@ generate_lily_for_obj (DenemoProject * gui, GtkTextIter * iter, DenemoObject * c
 
   GString *dynamic_string = NULL;
 
-  gtk_text_buffer_insert_with_tags_by_name (Denemo.textbuffer, iter, " ", -1, INEDITABLE, HIGHLIGHT, NULL);     //A gray blank between objects
+  if (curobj->type == CHORD)
+    {
+      LilyCache *cache = (LilyCache *) curobj->lilycache;
+      sign_chord (v->signature, curobj, prevduration, prevnumdots, *pgrace_status, v->sbid);
+      if (cache && curobj->lilypond && (cache->signature_len == v->signature->len) && !memcmp (LILY_CACHE_SIGNATURE (cache), v->signature->data, v->signature->len))
+        {
+          replay_lily_for_obj (v, cache);
+          g_string_free (lily_for_obj, TRUE);
+          g_string_free (ret, TRUE);
+          *pprevduration = cache->prevduration;
+          *pprevnumdots = cache->prevnumdots;
+          *pgrace_status = cache->grace_status;
+          return cache->open_braces;
+        }
+      start_recording (v);
+    }
+
+  emit_text (v, " ", LILY_HIGHLIGHTED_TEXT);    //A gray blank between objects
   g_string_append (lily_for_obj, " ");
 
 
-#define NAVANC(type, offset)  place_navigation_anchor(curmark, (gpointer)curobjnode, movement_count, measurenum, voice_count, objnum, type, offset);\
-                                gtk_text_buffer_get_iter_at_mark (Denemo.textbuffer, iter, curmark);
+#define NAVANC(type, offset)  emit_navigation_anchor (v, type, offset);
 
 
   switch (curobj->type)
@@ -1202,7 +1475,7 @@ generate_lily_for_obj (DenemoProject * gui, GtkTextIter * iter, DenemoObject * c
                 g_string_append_printf (ret, "\\acciaccatura {");
             }
         /* prefix is before duration unless AFFIX override is set */
-        directives_insert_prefix_editable (pchord->directives, &open_braces, &prevduration, iter, !lily_override, lily_for_obj, TARGET_CHORD, movement_count, measurenum, voice_count, objnum, 0, sbid);
+        directives_insert_prefix_editable (pchord->directives, &open_braces, &prevduration, v, !lily_override, lily_for_obj, TARGET_CHORD, 0);
 
         if (!lily_override)
           {                     //all LilyPond is output for this chord
@@ -1215,7 +1488,7 @@ generate_lily_for_obj (DenemoProject * gui, GtkTextIter * iter, DenemoObject * c
 
                     NAVANC (TARGET_CHORD, 0);
                     outputret;
-                    directives_insert_prefix_editable (pchord->directives, &open_braces, &prevduration, iter, FALSE, lily_for_obj, TARGET_CHORD, movement_count, measurenum, voice_count, objnum, 0, sbid);
+                    directives_insert_prefix_editable (pchord->directives, &open_braces, &prevduration, v, FALSE, lily_for_obj, TARGET_CHORD, 0);
                     if (duration != prevduration || numdots != prevnumdots || duration < 0)
                       {
                         /* only in this case do we explicitly note the duration */
@@ -1253,7 +1526,7 @@ generate_lily_for_obj (DenemoProject * gui, GtkTextIter * iter, DenemoObject * c
                     g_string_append_printf (ret, "s");
                     NAVANC (TARGET_CHORD, 0);
                     outputret;
-                    directives_insert_prefix_editable (pchord->directives, &open_braces, &prevduration, iter, FALSE, lily_for_obj, TARGET_CHORD, movement_count, measurenum, voice_count, objnum, 0, sbid);
+                    directives_insert_prefix_editable (pchord->directives, &open_braces, &prevduration, v, FALSE, lily_for_obj, TARGET_CHORD, 0);
                     if (duration > 0)
                       g_string_append_printf (ret, "%d", duration);
                     prevduration = -1;
@@ -1263,7 +1536,7 @@ generate_lily_for_obj (DenemoProject * gui, GtkTextIter * iter, DenemoObject * c
                   }
 
                 outputret;
-                directives_insert_postfix_editable (pchord->directives, &open_braces, &prevduration, iter, FALSE, lily_for_obj, TARGET_CHORD, movement_count, measurenum, voice_count, objnum, 0, sbid);
+                directives_insert_postfix_editable (pchord->directives, &open_braces, &prevduration, v, FALSE, lily_for_obj, TARGET_CHORD, 0);
               }
             else                /* there are notes */
               {
@@ -1284,10 +1557,10 @@ generate_lily_for_obj (DenemoProject * gui, GtkTextIter * iter, DenemoObject * c
                     for (; g; g = g->next, num++)
                       {
                         DenemoDirective *directive = (DenemoDirective *) g->data;
-                        if (directive->prefix && (!(directive->override & DENEMO_ALT_OVERRIDE)) && (!(directive->override & DENEMO_OVERRIDE_AFFIX)) && !wrong_layout (directive, sbid))
+                        if (directive->prefix && (!(directive->override & DENEMO_ALT_OVERRIDE)) && (!(directive->override & DENEMO_OVERRIDE_AFFIX)) && !wrong_layout (directive, v->sbid))
                           {
                             prevduration = -1;
-                            insert_editable (&directive->prefix, directive->prefix->len ? directive->prefix->str : " ", iter, gui, lily_for_obj, TARGET_NOTE, movement_count, measurenum, voice_count, objnum, num, curnote->mid_c_offset);
+                            emit_editable (v, &directive->prefix, directive->prefix->len ? directive->prefix->str : " ", lily_for_obj, TARGET_NOTE, num, curnote->mid_c_offset);
                           }
                       }
 
@@ -1338,9 +1611,9 @@ generate_lily_for_obj (DenemoProject * gui, GtkTextIter * iter, DenemoObject * c
                         for (num = 0; g; g = g->next, num++)
                           {
                             DenemoDirective *directive = (DenemoDirective *) g->data;
-                            if (directive->postfix && !(directive->override & DENEMO_OVERRIDE_HIDDEN) && (directive->override & DENEMO_OVERRIDE_AFFIX) && !wrong_layout (directive, sbid))
+                            if (directive->postfix && !(directive->override & DENEMO_OVERRIDE_HIDDEN) && (directive->override & DENEMO_OVERRIDE_AFFIX) && !wrong_layout (directive, v->sbid))
                               {
-                                insert_editable (&directive->postfix, directive->postfix->len ? directive->postfix->str : " ", iter, gui, lily_for_obj, TARGET_NOTE, movement_count, measurenum, voice_count, objnum, num, curnote->mid_c_offset);
+                                emit_editable (v, &directive->postfix, directive->postfix->len ? directive->postfix->str : " ", lily_for_obj, TARGET_NOTE, num, curnote->mid_c_offset);
                                 prevduration = -1;
                               }
                             else if (notenode->next)
@@ -1362,9 +1635,9 @@ generate_lily_for_obj (DenemoProject * gui, GtkTextIter * iter, DenemoObject * c
                         for (num = 0; g; g = g->next, num++)
                           {
                             DenemoDirective *directive = (DenemoDirective *) g->data;
-                            if (directive->postfix && !(directive->override & DENEMO_OVERRIDE_HIDDEN) && (!(directive->override & DENEMO_OVERRIDE_AFFIX)) && !wrong_layout (directive, sbid))
+                            if (directive->postfix && !(directive->override & DENEMO_OVERRIDE_HIDDEN) && (!(directive->override & DENEMO_OVERRIDE_AFFIX)) && !wrong_layout (directive, v->sbid))
                               {
-                                insert_editable (&directive->postfix, directive->postfix->len ? directive->postfix->str : " ", iter, gui, lily_for_obj, TARGET_NOTE, movement_count, measurenum, voice_count, objnum, num, curnote->mid_c_offset);
+                                emit_editable (v, &directive->postfix, directive->postfix->len ? directive->postfix->str : " ", lily_for_obj, TARGET_NOTE, num, curnote->mid_c_offset);
                                 prevduration = -1;
                               }
                             else if (notenode->next)
@@ -1381,7 +1654,7 @@ generate_lily_for_obj (DenemoProject * gui, GtkTextIter * iter, DenemoObject * c
                     /* only in this case do we explicitly note the duration */
                     outputret;
 
-                    directives_insert_prefix_editable (pchord->directives, &open_braces, &prevduration, iter, FALSE, lily_for_obj, TARGET_CHORD, movement_count, measurenum, voice_count, objnum, 0, sbid);
+                    directives_insert_prefix_editable (pchord->directives, &open_braces, &prevduration, v, FALSE, lily_for_obj, TARGET_CHORD, 0);
                     if (duration > 0)
                       g_string_append_printf (ret, "%d", duration);
                     prevduration = duration;
@@ -1394,11 +1667,11 @@ generate_lily_for_obj (DenemoProject * gui, GtkTextIter * iter, DenemoObject * c
                 else
                   {
                     outputret;
-                    directives_insert_prefix_editable (pchord->directives, &open_braces, &prevduration, iter, FALSE, lily_for_obj, TARGET_CHORD, movement_count, measurenum, voice_count, objnum, 0, sbid);
+                    directives_insert_prefix_editable (pchord->directives, &open_braces, &prevduration, v, FALSE, lily_for_obj, TARGET_CHORD, 0);
                     outputret;
                   }
 
-                directives_insert_postfix_editable (pchord->directives, &open_braces, &prevduration, iter, FALSE, lily_for_obj, TARGET_CHORD, movement_count, measurenum, voice_count, objnum, 0, sbid);
+                directives_insert_postfix_editable (pchord->directives, &open_braces, &prevduration, v, FALSE, lily_for_obj, TARGET_CHORD, 0);
 //!!! dynamics like \cr have their own positional info in LilyPond - how to tell Denemo????
                 if (pchord->dynamics && (pchord->notes->next == NULL))
                   {
@@ -1447,7 +1720,7 @@ generate_lily_for_obj (DenemoProject * gui, GtkTextIter * iter, DenemoObject * c
                 outputret;
               }                 /* End of else chord with note(s) */
             //now output the postfix field of directives that have AFFIX set, which are not emitted
-            directives_insert_affix_postfix_editable (pchord->directives, &open_braces, &prevduration, iter, lily_for_obj, TARGET_CHORD, movement_count, measurenum, voice_count, objnum, 0, sbid);
+            directives_insert_affix_postfix_editable (pchord->directives, &open_braces, &prevduration, v, lily_for_obj, TARGET_CHORD, 0);
           }                     /* End of outputting LilyPond for this chord because LILYPOND_OVERRIDE not set in a chord directive, ie !lily_override */
         else
           {
@@ -1456,12 +1729,12 @@ generate_lily_for_obj (DenemoProject * gui, GtkTextIter * iter, DenemoObject * c
             for (num = 0; g; g = g->next, num++)
               {
                 DenemoDirective *directive = (DenemoDirective *) g->data;
-                if (directive->postfix && directive->postfix->len && (!(directive->override & DENEMO_OVERRIDE_HIDDEN)) && !wrong_layout (directive, sbid))
+                if (directive->postfix && directive->postfix->len && (!(directive->override & DENEMO_OVERRIDE_HIDDEN)) && !wrong_layout (directive, v->sbid))
 
                   {
                     prevduration = -1;
                     open_braces += brace_count (directive->postfix->str);
-                    insert_editable (&directive->postfix, directive->postfix->str, iter, gui, lily_for_obj, TARGET_CHORD, movement_count, measurenum, voice_count, objnum, num, 0);
+                    emit_editable (v, &directive->postfix, directive->postfix->str, lily_for_obj, TARGET_CHORD, num, 0);
                   }
               }
           }
@@ -1641,6 +1914,8 @@ generate_lily_for_obj (DenemoProject * gui, GtkTextIter * iter, DenemoObject * c
 
   outputret;
 
+  if (v->recording)
+    stop_recording (v, curobj, prevduration, prevnumdots, *pgrace_status, open_braces);
   g_free (curobj->lilypond);
   curobj->lilypond = g_string_free (lily_for_obj, FALSE);       //There is a scheme command d-GetLilyPondthat retrieves the LilyPond text associated with the current object
   *pprevduration = prevduration;
@@ -1885,17 +2160,18 @@ static gboolean needs_hyphen (gchar *str) {
 
 
 /**
- * Output a Denemo Staff in Lilypond syntax
- * A section is created in the Denemo.textbuffer and the music inserted into it.
- * each DenemoObject is given an anchor and a pointer to the object is stored with the anchor,
- * so that it will be possible to create LilyPond directives from within the buffer (not yet
- * implemented FIXME).
- * Any lyrics, chord symbols and figured basses are put in separate sections.
- *
+ * Generate the LilyPond for the voice v->staff into v->ops and v->text, and the text of its lyrics,
+ * figured bass and chord symbols sections, for insert_voice() to put in the Denemo.textbuffer.
+ * Only the voice and its objects are touched, so that voices can be generated in parallel.
+ * Each DenemoObject is given an op for its anchor, which stores a pointer to the object,
+ * so that LilyPond directives can be edited from within the buffer.
  */
 static void
-outputStaff (DenemoProject * gui, DenemoStaff * curstaffstruct, gint start, gint end, gchar * movement, gchar * voice, gint movement_count, gint voice_count, DenemoScoreblock * sb)
+generate_voice (LilyVoice * v)
 {
+  DenemoProject *gui = v->project;
+  DenemoStaff *curstaffstruct = v->staff;
+  gint start = v->start, end = v->end;
   gint cur_stime1 = curstaffstruct->timesig.time1;
   gint cur_stime2 = curstaffstruct->timesig.time2;
 
@@ -1911,60 +2187,17 @@ outputStaff (DenemoProject * gui, DenemoStaff * curstaffstruct, gint start, gint
   gint measurenum;              //count of measures from start of staff starting at 1
   gint objnum;                  //count of objects in measure starting at 1
   gint open_braces;             //Keep track of the number of open brace "{" chars in the music, in case of imbalance.
-  GString *staff_str = g_string_new ("");       //Bits of the music of the staff are accumulated here and then stored in the lilypond view buffer
-  GList *lyrics = NULL;
+  GString *staff_str = g_string_new ("");       //Bits of the music of the staff are accumulated here and then emitted
   GString *figures = g_string_new ("");
   GString *fakechords = g_string_new ("");
   prevduration = -1;
   prevnumdots = -1;
   gint grace_status = 0;
-  GtkTextIter iter;
-  GtkTextMark *curmark;         /* movable mark for insertion point of the music of the staff */
-  /* a button and mark for the music of this staff */
-
-
-  GString *voice_name = g_string_new (movement);
-  g_string_prepend (voice_name, "Notes for ");
-  g_string_append_printf (voice_name, " Voice %d", /* ABS */ (voice_count));
-  //g_debug("making %s\n", voice_name->str);
-  insert_music_section (gui, voice_name->str);
-  gtk_text_buffer_get_iter_at_mark (Denemo.textbuffer, &iter, gtk_text_buffer_get_mark (Denemo.textbuffer, voice_name->str));
-  curmark = gtk_text_buffer_create_mark (Denemo.textbuffer, NULL, &iter, FALSE);        //FIXME remove this mark at the end of the output of this staff...
 
-  /* a button and mark for the lyrics of this staff */
-  GString *lyrics_name = g_string_new (movement);
-  if ((!curstaffstruct->hide_lyrics) && curstaffstruct->verse_views)
-    {
-      g_string_prepend (lyrics_name, "Lyrics for ");
-      g_string_append_printf (lyrics_name, " Voice %d", voice_count);
-      insert_music_section (gui, lyrics_name->str);
-      GList *g;
-      for (g = curstaffstruct->verse_views; g; g = g->next)
-        {
-          lyrics = g_list_append (lyrics, get_text_from_view (g->data));
-        }
-    }
-
-  /* a button and mark for the figures of this staff */
-  GString *figures_name = g_string_new (movement);
   if (curstaffstruct->hasfigures)
-    {
-      g_string_prepend (figures_name, "Figured Bass for ");
-      g_string_append_printf (figures_name, " Voice %d", voice_count);
-      insert_music_section (gui, figures_name->str);
-      g_string_append (figures, "%figures follow\n\\set Staff.implicitBassFigures = #'(0)\n");
-    }
-  /* a button and mark for the chord symbols of this staff */
-  GString *fakechords_name = g_string_new (movement);
+    g_string_append (figures, "%figures follow\n\\set Staff.implicitBassFigures = #'(0)\n");
   if (curstaffstruct->hasfakechords)
-    {
-      g_string_prepend (fakechords_name, "Chord symbols for ");
-      g_string_append_printf (fakechords_name, " Voice %d", voice_count);
-      insert_music_section (gui, fakechords_name->str);
-      g_string_append (fakechords, "%chord symbols follow\n");
-    }
-
-  gtk_text_buffer_get_iter_at_mark (Denemo.textbuffer, &iter, curmark);
+    g_string_append (fakechords, "%chord symbols follow\n");
 
   {                             /* standard staff-prolog */
     /* Determine the key signature */
@@ -1980,10 +2213,8 @@ outputStaff (DenemoProject * gui, DenemoStaff * curstaffstruct, gint start, gint
     determineclef (curstaffstruct->clef.type, &clefname);
 
 
-    g_string_append_printf (staff_str, "%s%s = {\n", movement, voice);
-
-    gtk_text_buffer_get_iter_at_mark (Denemo.textbuffer, &iter, curmark);
-    gtk_text_buffer_insert_with_tags_by_name (Denemo.textbuffer, &iter, staff_str->str, -1, INEDITABLE, NULL);
+    g_string_append_printf (staff_str, "%s%s = {\n", v->movement, v->voice);
+    emit_text (v, staff_str->str, LILY_TEXT);
   }                             /*end standard staff-prolog */
 
   g_string_assign (staff_str, "");
@@ -2012,8 +2243,7 @@ outputStaff (DenemoProject * gui, DenemoStaff * curstaffstruct, gint start, gint
             g_string_append_printf (fakechords, "\n%%%d\n", curmeasurenum);
         }
       g_string_append_printf (staff_str, "%s", TAB);
-      gtk_text_buffer_get_iter_at_mark (Denemo.textbuffer, &iter, curmark);
-      gtk_text_buffer_insert_with_tags_by_name (Denemo.textbuffer, &iter, staff_str->str, -1, INEDITABLE, NULL);
+      emit_text (v, staff_str->str, LILY_TEXT);
       g_string_assign (staff_str, "");
       gint firstobj = 1, lastobj = G_MAXINT - 1;
       if (start && gui->movement->markstaffnum)
@@ -2026,6 +2256,9 @@ outputStaff (DenemoProject * gui, DenemoStaff * curstaffstruct, gint start, gint
            curobjnode = curobjnode->next, objnum++)
         {
           curobj = NULL;        //avoid random values for debugabililty
+          v->objnode = curobjnode;
+          v->measurenum = measurenum;
+          v->objnum = objnum;
           if ((measurenum > MAX (start, 1) && (measurenum < end)) || (start == end && measurenum == start && objnum >= firstobj && objnum <= lastobj) || (start != end && ((((measurenum == MAX (start, 1)) && (objnum >= firstobj))) || ((measurenum == end) && (objnum <= lastobj)))))
             {
 
@@ -2038,8 +2271,7 @@ outputStaff (DenemoProject * gui, DenemoStaff * curstaffstruct, gint start, gint
                   //Print rhythm notes with cross head. We ignore the case where someone reverts to real notes after rhythm only notes
                   if (curobj->type == CHORD && ((chord *) curobj->object)->notes && curobj->isinvisible && !nonprintingnotes)
                     {
-                      gtk_text_buffer_get_iter_at_mark (Denemo.textbuffer, &iter, curmark);
-                      gtk_text_buffer_insert_with_tags_by_name (Denemo.textbuffer, &iter, "\n" TAB "\\override NoteHead #'style = #'cross" "\n\\override NoteHead #'color = #darkyellow" "\n\\override Stem #'color = #darkyellow" "\n\\override Flag #'color = #darkyellow" "\n\\override Beam #'color = #darkyellow ", -1, INEDITABLE, NULL);
+                      emit_text (v, "\n" TAB "\\override NoteHead #'style = #'cross" "\n\\override NoteHead #'color = #darkyellow" "\n\\override Stem #'color = #darkyellow" "\n\\override Flag #'color = #darkyellow" "\n\\override Beam #'color = #darkyellow ", LILY_TEXT);
                       nonprintingnotes = TRUE;
                     }
 
@@ -2047,38 +2279,17 @@ outputStaff (DenemoProject * gui, DenemoStaff * curstaffstruct, gint start, gint
                     {
                       DenemoDirective *directive = ((lilydirective *) curobj->object);
 #define OUTPUT_LILY(what) \
-  if(directive->what && directive->what->len && !wrong_layout(directive, sb->id) \
+  if(directive->what && directive->what->len && !wrong_layout(directive, v->sbid) \
      && (!(directive->override & DENEMO_OVERRIDE_HIDDEN)) \
      ) {                                \
-      gtk_text_buffer_get_iter_at_mark (Denemo.textbuffer, &iter, curmark);\
-      GtkTextChildAnchor *objanc = gtk_text_buffer_create_child_anchor (Denemo.textbuffer, &iter);\
-      g_object_set_data(G_OBJECT(objanc), OBJECTNODE, (gpointer)curobjnode);\
-      g_object_set_data(G_OBJECT(objanc), MOVEMENTNUM, (gpointer)(intptr_t)ABS(movement_count));\
-      g_object_set_data(G_OBJECT(objanc), MEASURENUM, (gpointer)(intptr_t)measurenum);\
-      g_object_set_data(G_OBJECT(objanc), STAFFNUM, (gpointer)(intptr_t)ABS(voice_count));\
-      g_object_set_data(G_OBJECT(objanc), OBJECTNUM, (gpointer)(intptr_t)ABS(objnum));\
-      g_object_set_data(G_OBJECT(objanc), TARGETTYPE, (gpointer)(intptr_t)ABS(TARGET_OBJECT));\
-      GtkTextIter back;\
-      back = iter;\
-      (void)gtk_text_iter_backward_char(&back);\
-      gtk_text_buffer_apply_tag_by_name(Denemo.textbuffer, INEDITABLE, &back, &iter);\
-      gtk_text_buffer_apply_tag_by_name(Denemo.textbuffer, "system_invisible", &back, &iter);\
     open_braces += brace_count( directive->what->str);\
-    gtk_text_buffer_insert_with_tags_by_name (Denemo.textbuffer, &iter,  directive->what->str, -1, "bold", NULL); \
-        GtkTextChildAnchor *endanc  = gtk_text_buffer_create_child_anchor (Denemo.textbuffer, &iter);\
-    back = iter;\
-    (void)gtk_text_iter_backward_char(&back);\
-    gtk_text_buffer_apply_tag_by_name(Denemo.textbuffer, INEDITABLE, &back, &iter);\
-    gtk_text_buffer_apply_tag_by_name(Denemo.textbuffer, "system_invisible", &back, &iter);\
-    g_object_set_data(G_OBJECT(objanc), "end", (gpointer)endanc);\
-    g_object_set_data(G_OBJECT(objanc), GSTRINGP, (gpointer)&directive->what);\
-    gui->anchors = g_list_prepend(gui->anchors, objanc);\
+    emit_directive (v, &directive->what);\
   }
 
                       g_free (curobj->lilypond);
 
                       OUTPUT_LILY (prefix);
-                      gtk_text_buffer_insert_with_tags_by_name (Denemo.textbuffer, &iter, " ", -1, INEDITABLE, HIGHLIGHT, NULL);
+                      emit_text (v, " ", LILY_HIGHLIGHTED_TEXT);
                       OUTPUT_LILY (postfix);
                       curobj->lilypond = g_strconcat (directive->prefix ? directive->prefix->str : "", directive->postfix ? directive->postfix->str : "", NULL);
 #undef OUTPUT_LILY
@@ -2090,14 +2301,7 @@ outputStaff (DenemoProject * gui, DenemoStaff * curstaffstruct, gint start, gint
                     }
                   else
                     {
-
-#if 0
-                      place_navigation_anchor (curmark, (gpointer) curobjnode, ABS (movement_count), measurenum, ABS (voice_count), ABS (objnum), 0, 0);
-#endif
-
-
-
-                      open_braces += generate_lily_for_obj (gui, &iter, curobj, &prevduration, &prevnumdots, &clefname, &keyname, &cur_stime1, &cur_stime2, &grace_status, figures, fakechords, curmark, (gpointer) curobjnode, ABS (movement_count), measurenum, ABS (voice_count), ABS (objnum), sb->id);
+                      open_braces += generate_lily_for_obj (v, curobj, &prevduration, &prevnumdots, &clefname, &keyname, &cur_stime1, &cur_stime2, &grace_status, figures, fakechords);
                     }           // end not lilydirective
 
 
@@ -2110,8 +2314,7 @@ outputStaff (DenemoProject * gui, DenemoStaff * curstaffstruct, gint start, gint
                   if (empty_measure && (cur_stime1 < 256))      // measure has nothing to use up the duration, assume  SKIP, 256 means cadenza time, do not skip.
                     {
                       g_string_append_printf (endstr, " s1*%d/%d ", cur_stime1, cur_stime2);
-                      gtk_text_buffer_get_iter_at_mark (Denemo.textbuffer, &iter, curmark);
-                      gtk_text_buffer_insert_with_tags_by_name (Denemo.textbuffer, &iter, endstr->str, -1, NULL, NULL);
+                      emit_text (v, endstr->str, LILY_PLAIN_TEXT);
                       g_string_assign (endstr, "");
                       prevduration = -1;
                     }
@@ -2128,8 +2331,8 @@ outputStaff (DenemoProject * gui, DenemoStaff * curstaffstruct, gint start, gint
                         g_string_append_printf (endstr, "%s", " \\AutoEndMovementBarline\n");
                     }
 
-                  gtk_text_buffer_get_iter_at_mark (Denemo.textbuffer, &iter, curmark);
-                  gtk_text_buffer_insert_with_tags_by_name (Denemo.textbuffer, &iter, endstr->str, -1, INEDITABLE, NULL);
+                  emit_text (v, endstr->str, LILY_TEXT);
+                  g_string_free (endstr, TRUE);
                 }               //if end of measure
 
               if (curobjnode)
@@ -2174,75 +2377,275 @@ outputStaff (DenemoProject * gui, DenemoStaff * curstaffstruct, gint start, gint
       g_string_append_printf (staff_str, "%s", "\n} %% missing close brace\n");
     }
   g_string_append_printf (staff_str, "%s", "}\n");
-  gchar *voice_prolog_insert = get_postfix (curstaffstruct->voice_directives);
-
-
-
-  g_free (voice_prolog_insert);
-  gtk_text_buffer_get_iter_at_mark (Denemo.textbuffer, &iter, curmark);
-
-  gtk_text_buffer_insert_with_tags_by_name (Denemo.textbuffer, &iter, staff_str->str, -1, INEDITABLE, NULL);
+  emit_text (v, staff_str->str, LILY_TEXT);
 
-
-  if (lyrics)
+  if (v->verses)
     {
       GList *g;
       gint versenum;
-      for (versenum = 1, g = lyrics; g; g = g->next, versenum++)
+      for (versenum = 1, g = v->verses; g; g = g->next, versenum++)
         {
           GString *versename = g_string_new ("");
           GString *temp = g_string_new ("");
           g_string_printf (temp, "Verse%d", versenum);
           set_lily_name (temp, versename);
-          gtk_text_buffer_get_iter_at_mark (Denemo.textbuffer, &iter, gtk_text_buffer_get_mark (Denemo.textbuffer, lyrics_name->str));
-          g_string_printf (temp, "%s%sLyrics%s = \\lyricmode { \n", movement, voice, versename->str);
+          g_string_append_printf (v->lyrics_text, "%s%sLyrics%s = \\lyricmode { \n", v->movement, v->voice, versename->str);
           gboolean terminate_hyphens = needs_hyphen ((gchar *)g->data);
-          g_string_append_printf (temp, "%s%s \n}\n", (char *) g->data, terminate_hyphens?"\"\n%Odd number of double-qotes corrected\n":"");
-          gtk_text_buffer_insert_with_tags_by_name (Denemo.textbuffer, &iter, temp->str, -1, INEDITABLE, NULL);
+          g_string_append_printf (v->lyrics_text, "%s%s \n}\n", (char *) g->data, terminate_hyphens?"\"\n%Odd number of double-qotes corrected\n":"");
           g_string_free (temp, TRUE);
           g_string_free (versename, TRUE);
-          g_free (g->data);
         }
     }
-  g_string_free (lyrics_name, TRUE);
 
   if (figures->len)
     {
-      GString *temp = g_string_new ("");
-      gtk_text_buffer_get_iter_at_mark (Denemo.textbuffer, &iter, gtk_text_buffer_get_mark (Denemo.textbuffer, figures_name->str));
       /* output figures prolog */
+      g_string_printf (v->figures_text, "%s%sBassFiguresLine = \\figuremode {\n" "\\set figuredBassAlterationDirection = #1\n" "\\set figuredBassPlusDirection = #1\n" "\\override FiguredBass.BassFigure " "#'font-size = #-1\n", v->movement, v->voice);
+      g_string_append_printf (v->figures_text, "%s \n}\n", figures->str);
+    }
+
+  if (fakechords->len)
+    {
+      /* output fakechords prolog */
+      g_string_printf (v->fakechords_text, "%s%sChords = \\new ChordNames \\chordmode {\n", v->movement, v->voice);
+      g_string_append_printf (v->fakechords_text, "%s \n}\n" /* another definition here */ , fakechords->str);
+    }
+
+  g_string_free (staff_str, TRUE);
+  g_string_free (figures, TRUE);
+  g_string_free (fakechords, TRUE);
+}                               /* generate_voice */
+
+/* inserts the LilyPond text of a directive between anchors at curmark, for editing in the Denemo.textbuffer */
+static void
+insert_directive (DenemoProject * gui, GtkTextMark * curmark, GString ** pdirective, gpointer curobjnode, gint movement_count, gint measurenum, gint voice_count, gint objnum)
+{
+  GtkTextIter iter, back;
+  gtk_text_buffer_get_iter_at_mark (Denemo.textbuffer, &iter, curmark);
+  GtkTextChildAnchor *objanc = gtk_text_buffer_create_child_anchor (Denemo.textbuffer, &iter);
+  g_object_set_data (G_OBJECT (objanc), OBJECTNODE, curobjnode);
+  g_object_set_data (G_OBJECT (objanc), MOVEMENTNUM, (gpointer) (intptr_t) ABS (movement_count));
+  g_object_set_data (G_OBJECT (objanc), MEASURENUM, (gpointer) (intptr_t) measurenum);
+  g_object_set_data (G_OBJECT (objanc), STAFFNUM, (gpointer) (intptr_t) ABS (voice_count));
+  g_object_set_data (G_OBJECT (objanc), OBJECTNUM, (gpointer) (intptr_t) ABS (objnum));
+  g_object_set_data (G_OBJECT (objanc), TARGETTYPE, (gpointer) (intptr_t) ABS (TARGET_OBJECT));
+  back = iter;
+  (void) gtk_text_iter_backward_char (&back);
+  gtk_text_buffer_apply_tag_by_name (Denemo.textbuffer, INEDITABLE, &back, &iter);
+  gtk_text_buffer_apply_tag_by_name (Denemo.textbuffer, "system_invisible", &back, &iter);
+  gtk_text_buffer_insert_with_tags_by_name (Denemo.textbuffer, &iter, (*pdirective)->str, -1, "bold", NULL);
+  GtkTextChildAnchor *endanc = gtk_text_buffer_create_child_anchor (Denemo.textbuffer, &iter);
+  back = iter;
+  (void) gtk_text_iter_backward_char (&back);
+  gtk_text_buffer_apply_tag_by_name (Denemo.textbuffer, INEDITABLE, &back, &iter);
+  gtk_text_buffer_apply_tag_by_name (Denemo.textbuffer, "system_invisible", &back, &iter);
+  g_object_set_data (G_OBJECT (objanc), "end", (gpointer) endanc);
+  g_object_set_data (G_OBJECT (objanc), GSTRINGP, (gpointer) pdirective);
+  gui->anchors = g_list_prepend (gui->anchors, objanc);
+}
 
-      g_string_printf (temp, "%s%sBassFiguresLine = \\figuremode {\n" "\\set figuredBassAlterationDirection = #1\n" "\\set figuredBassPlusDirection = #1\n" "\\override FiguredBass.BassFigure " "#'font-size = #-1\n", movement, voice);
+/* inserts text at the mark called name */
+static void
+insert_at_mark (gchar * name, gchar * text)
+{
+  GtkTextIter iter;
+  gtk_text_buffer_get_iter_at_mark (Denemo.textbuffer, &iter, gtk_text_buffer_get_mark (Denemo.textbuffer, name));
+  gtk_text_buffer_insert_with_tags_by_name (Denemo.textbuffer, &iter, text, -1, INEDITABLE, NULL);
+}
 
-      gtk_text_buffer_insert_with_tags_by_name (Denemo.textbuffer, &iter, temp->str, -1, INEDITABLE, NULL);
+/**
+ * Output a voice generated by generate_voice() into the Denemo.textbuffer.
+ * A section is created for the music of the voice and any lyrics, chord symbols and figured basses
+ * are put in separate sections.
+ */
+static void
+insert_voice (DenemoProject * gui, LilyVoice * v)
+{
+  GtkTextIter iter;
+  GtkTextMark *curmark;         /* movable mark for insertion point of the music of the staff */
+  guint i;
+  gchar *voice_name = g_strdup_printf ("Notes for %s Voice %d", v->movement, /* ABS */ (v->voice_count));
+  gchar *lyrics_name = g_strdup_printf ("Lyrics for %s Voice %d", v->movement, v->voice_count);
+  gchar *figures_name = g_strdup_printf ("Figured Bass for %s Voice %d", v->movement, v->voice_count);
+  gchar *fakechords_name = g_strdup_printf ("Chord symbols for %s Voice %d", v->movement, v->voice_count);
+
+  insert_music_section (gui, voice_name);
+  gtk_text_buffer_get_iter_at_mark (Denemo.textbuffer, &iter, gtk_text_buffer_get_mark (Denemo.textbuffer, voice_name));
+  curmark = gtk_text_buffer_create_mark (Denemo.textbuffer, NULL, &iter, FALSE);        //FIXME remove this mark at the end of the output of this staff...
+  if (v->verses)
+    insert_music_section (gui, lyrics_name);
+  if (v->staff->hasfigures)
+    insert_music_section (gui, figures_name);
+  if (v->staff->hasfakechords)
+    insert_music_section (gui, fakechords_name);
 
-      g_string_printf (temp, "%s \n}\n", figures->str);
-      gtk_text_buffer_insert_with_tags_by_name (Denemo.textbuffer, &iter, temp->str, -1, INEDITABLE, NULL);
-      g_string_free (temp, TRUE);
+  for (i = 0; i < v->ops->len; i++)
+    {
+      LilyOp *op = &g_array_index (v->ops, LilyOp, i);
+      gchar *text = v->text->str + op->text;
+      gtk_text_buffer_get_iter_at_mark (Denemo.textbuffer, &iter, curmark);
+      switch (op->type)
+        {
+        case LILY_TEXT:
+          gtk_text_buffer_insert_with_tags_by_name (Denemo.textbuffer, &iter, text, op->index, INEDITABLE, NULL);
+          break;
+        case LILY_HIGHLIGHTED_TEXT:
+          gtk_text_buffer_insert_with_tags_by_name (Denemo.textbuffer, &iter, text, op->index, INEDITABLE, HIGHLIGHT, NULL);
+          break;
+        case LILY_PLAIN_TEXT:
+          gtk_text_buffer_insert_with_tags_by_name (Denemo.textbuffer, &iter, text, op->index, NULL, NULL);
+          break;
+        case LILY_NAVIGATION_ANCHOR:
+          place_navigation_anchor (curmark, op->objnode, ABS (v->movement_count), op->measurenum, ABS (v->voice_count), ABS (op->objnum), op->target, op->mid_c_offset);
+          break;
+        case LILY_EDITABLE:
+          insert_editable (op->pdirective, op->blank ? " " : (*op->pdirective)->str, &iter, gui, op->target, ABS (v->movement_count), op->measurenum, ABS (v->voice_count), ABS (op->objnum), op->index, op->mid_c_offset);
+          break;
+        case LILY_DIRECTIVE:
+          insert_directive (gui, curmark, op->pdirective, op->objnode, v->movement_count, op->measurenum, v->voice_count, op->objnum);
+          break;
+        }
     }
-  g_string_free (figures_name, TRUE);
 
-  if (fakechords->len)
+  if (v->lyrics_text->len)
+    insert_at_mark (lyrics_name, v->lyrics_text->str);
+  if (v->figures_text->len)
+    insert_at_mark (figures_name, v->figures_text->str);
+  if (v->fakechords_text->len)
+    insert_at_mark (fakechords_name, v->fakechords_text->str);
+
+  g_free (voice_name);
+  g_free (lyrics_name);
+  g_free (figures_name);
+  g_free (fakechords_name);
+}
+
+static LilyVoice *
+new_lily_voice (DenemoProject * gui, DenemoStaff * staff, gint start, gint end, gchar * movement, gchar * voice, gint movement_count, gint voice_count, guint sbid)
+{
+  LilyVoice *v = g_new0 (LilyVoice, 1);
+  v->project = gui;
+  v->staff = staff;
+  v->start = start;
+  v->end = end;
+  v->movement = g_strdup (movement);
+  v->voice = g_strdup (voice);
+  v->movement_count = movement_count;
+  v->voice_count = voice_count;
+  v->sbid = sbid;
+  if ((!staff->hide_lyrics) && staff_verse_count (staff))
     {
-      GString *temp = g_string_new ("");
-      gtk_text_buffer_get_iter_at_mark (Denemo.textbuffer, &iter, gtk_text_buffer_get_mark (Denemo.textbuffer, fakechords_name->str));
-      /* output fakechords prolog */
+      gint i, count = staff_verse_count (staff);
+      for (i = 0; i < count; i++)
+        v->verses = g_list_append (v->verses, staff_verse_text (staff, i));
+    }
+  v->ops = g_array_new (FALSE, FALSE, sizeof (LilyOp));
+  v->text = g_string_new ("");
+  v->lyrics_text = g_string_new ("");
+  v->figures_text = g_string_new ("");
+  v->fakechords_text = g_string_new ("");
+  v->signature = g_byte_array_new ();
+  return v;
+}
+
+static void
+free_lily_voice (LilyVoice * v)
+{
+  g_free (v->movement);
+  g_free (v->voice);
+  g_list_free_full (v->verses, g_free);
+  g_array_free (v->ops, TRUE);
+  g_string_free (v->text, TRUE);
+  g_string_free (v->lyrics_text, TRUE);
+  g_string_free (v->figures_text, TRUE);
+  g_string_free (v->fakechords_text, TRUE);
+  g_byte_array_free (v->signature, TRUE);
+  g_free (v);
+}
 
-      g_string_append_printf (temp, "%s%sChords = \\new ChordNames \\chordmode {\n", movement, voice);
+static void
+generate_voice_chain (LilyVoice * v)
+{
+  for (; v; v = v->chained)
+    generate_voice (v);
+}
 
-      gtk_text_buffer_insert_with_tags_by_name (Denemo.textbuffer, &iter, temp->str, -1, INEDITABLE, NULL);
+static void
+generate_voice_chain_in_pool (gpointer data, G_GNUC_UNUSED gpointer user_data)
+{
+  generate_voice_chain ((LilyVoice *) data);
+}
 
-      g_string_printf (temp, "%s \n}\n" /* another definition here */ , fakechords->str);
-      gtk_text_buffer_insert_with_tags_by_name (Denemo.textbuffer, &iter, temp->str, -1, INEDITABLE, NULL);
-      g_string_free (temp, TRUE);
+/* generates all the voices, in parallel (see run_jobs_in_pool (), DENEMO_LILYPOND_THREADS limits the threads).
+   The voices with figured bass or chord symbols are generated one after the other by one job,
+   as output_figured_bass() and output_fakechord() keep state in statics and use strtok() */
+static void
+generate_voices (GPtrArray * voices)
+{
+  GPtrArray *jobs = g_ptr_array_new ();
+  LilyVoice *last_chained = NULL;
+  guint i;
+  for (i = 0; i < voices->len; i++)
+    {
+      LilyVoice *v = g_ptr_array_index (voices, i);
+      if (v->staff->hasfigures || v->staff->hasfakechords)
+        {
+          if (last_chained)
+            last_chained->chained = v;
+          else
+            g_ptr_array_add (jobs, v);
+          last_chained = v;
+        }
+      else
+        g_ptr_array_add (jobs, v);
     }
-  g_string_free (fakechords_name, TRUE);
+  run_jobs_in_pool (jobs, generate_voice_chain_in_pool, "DENEMO_LILYPOND_THREADS");
+  g_ptr_array_free (jobs, TRUE);
+}
 
-  g_string_free (staff_str, TRUE);
-  //g_string_free(lyrics, TRUE);
-  g_string_free (figures, TRUE);
-  g_string_free (fakechords, TRUE);
-}                               /* outputStaff */
+/* the voices output_score_to_buffer() will output, in order, with their names and counts as it makes them */
+static GPtrArray *
+collect_voices (DenemoProject * gui, gboolean all_movements, DenemoScoreblock * sb)
+{
+  GPtrArray *voices = g_ptr_array_new_with_free_func ((GDestroyNotify) free_lily_voice);
+  GList *g;
+  gint movement_count;
+  for (g = gui->movements, movement_count = 1; g; g = g->next, movement_count++)
+    {
+      DenemoMovement *si = g->data;
+      staffnode *curstaff;
+      gint voice_count;
+      if (!(all_movements || (g->data == gui->movement)))
+        continue;
+      GString *movement_name = g_string_new ("");
+      GString *name = g_string_new ("");
+      g_string_printf (name, "Mvmnt%d", movement_count);
+      set_lily_name (name, movement_name);
+      for (curstaff = si->thescore, voice_count = 1; curstaff; curstaff = curstaff->next, voice_count++)
+        {
+          GString *voice_name = g_string_new ("");
+          gint start = 0, end = 0;
+          if (gui->movement->markstaffnum)
+            {
+              if (!(voice_count >= gui->movement->selection.firststaffmarked && voice_count <= gui->movement->selection.laststaffmarked))
+                {
+                  g_string_free (voice_name, TRUE);
+                  continue;
+                }
+              start = gui->movement->selection.firstmeasuremarked;
+              end = gui->movement->selection.lastmeasuremarked;
+            }
+          g_string_printf (name, "Voice%d", voice_count);
+          set_lily_name (name, voice_name);
+          g_ptr_array_add (voices, new_lily_voice (gui, (DenemoStaff *) curstaff->data, start, end, movement_name->str, voice_name->str, movement_count, voice_count, sb->id));
+          g_string_free (voice_name, TRUE);
+        }
+      g_string_free (name, TRUE);
+      g_string_free (movement_name, TRUE);
+    }
+  generate_voices (voices);
+  return voices;
+}
 
 /* Merge back any modified LilyPond text into the Denemo Score */
 void
@@ -2622,6 +3025,7 @@ generate_lilypond_part (void)
 static void
 output_score_to_buffer (DenemoProject * gui, gboolean all_movements, gchar * partname, gchar * instrumentation)
 {
+  PROFILE_BEGIN (mark, "output_score_to_buffer");
   GString *definitions = g_string_new ("");
   GString *staffdefinitions = g_string_new ("");
 
@@ -2657,6 +3061,7 @@ output_score_to_buffer (DenemoProject * gui, gboolean all_movements, gchar * par
       g_free (gui->namespec);
       gui->namespec = namespec;
       //g_debug("changecount=%d and lilysync= %d\n", gui->changecount, gui->lilysync);
+      PROFILE_END (mark);
       return;
     }
   g_free (gui->namespec);
@@ -2717,7 +3122,7 @@ output_score_to_buffer (DenemoProject * gui, gboolean all_movements, gchar * par
         if (wrong_layout (directive, Denemo.project->layout_id))
           continue;
         if (directive->prefix && (directive->override & (DENEMO_OVERRIDE_AFFIX)))       //This used to be (mistakenly) DENEMO_ALT_OVERRIDE
-          insert_editable (&directive->prefix, directive->prefix->str, &iter, gui, NULL, TARGET_OBJECT, 0, 0, 0, 0, 0, 0);
+          insert_editable (&directive->prefix, directive->prefix->str, &iter, gui, TARGET_OBJECT, 0, 0, 0, 0, 0, 0);
         //insert_section(&directive->prefix, directive->tag->str, NULL, &iter, gui);
       }
   }
@@ -2741,13 +3146,15 @@ output_score_to_buffer (DenemoProject * gui, gboolean all_movements, gchar * par
     insert_scoreblock_section (gui, scoreblock_tag, sb);
     gtk_text_buffer_get_iter_at_mark (Denemo.textbuffer, &iter, gtk_text_buffer_get_mark (Denemo.textbuffer, scoreblock_tag));
     if (sb->text_only)
-      insert_editable (&sb->lilypond, g_strchomp ((sb->lilypond)->str), &iter, gui, 0, 0, 0, 0, 0, 0, 0, 0);    //without strchomp a newline is appended each refresh.
+      insert_editable (&sb->lilypond, g_strchomp ((sb->lilypond)->str), &iter, gui, 0, 0, 0, 0, 0, 0, 0);    //without strchomp a newline is appended each refresh.
     else
       gtk_text_buffer_insert_with_tags_by_name (Denemo.textbuffer, &iter, (sb->lilypond)->str, -1, INEDITABLE, NULL);
   }
   /* insert standard scoreblock section */
   //insert_scoreblock_section(gui, STANDARD_SCOREBLOCK, NULL);
 
+  GPtrArray *voices = collect_voices (gui, all_movements, sb);  /* the music of the visible voices, generated in parallel */
+  guint next_voice = 0;
   GList *g;
   gint movement_count;
   gint visible_movement;        /* 1 for visible -1 for invisible */
@@ -2792,7 +3199,7 @@ output_score_to_buffer (DenemoProject * gui, gboolean all_movements, gchar * par
               end = gui->movement->selection.lastmeasuremarked;
             }
           if (visible_part > 0 && visible_movement > 0)
-            outputStaff (gui, curstaffstruct, start, end, movement_name->str, voice_name->str, movement_count * visible_movement, voice_count * visible_part, sb);
+            insert_voice (gui, g_ptr_array_index (voices, next_voice++));
           //g_debug("Music for staff is \n%s\n", visible_part>0?"visible":"NOT visible");
 
           //FIXME amalgamate movement and voice names below here...
@@ -2801,11 +3208,10 @@ output_score_to_buffer (DenemoProject * gui, gboolean all_movements, gchar * par
             {
               if (!(curstaffstruct->voicecontrol & DENEMO_SECONDARY))
                 {
-                  if ((!curstaffstruct->hide_lyrics) && curstaffstruct->verse_views)
+                  if ((!curstaffstruct->hide_lyrics) && staff_verse_count (curstaffstruct))
                     {
-                      GList *g;
-                      gint versenum;
-                      for (g = curstaffstruct->verse_views, versenum = 1; g; g = g->next, versenum++)
+                      gint versenum, count = staff_verse_count (curstaffstruct);
+                      for (versenum = 1; versenum <= count; versenum++)
                         {
                           GString *versename = g_string_new ("");
                           GString *temp = g_string_new ("");
@@ -2835,11 +3241,10 @@ output_score_to_buffer (DenemoProject * gui, gboolean all_movements, gchar * par
                 {
                   //g_string_append_printf(staffdefinitions, "%s"TAB TAB"\\%s%s\n"TAB TAB"\n"TAB TAB"\n", thestr->str, movement_name->str, voice_name->str);
 
-                  if ((!curstaffstruct->hide_lyrics) && curstaffstruct->verse_views)
+                  if ((!curstaffstruct->hide_lyrics) && staff_verse_count (curstaffstruct))
                     {
-                      GList *g;
-                      gint versenum;
-                      for (g = curstaffstruct->verse_views, versenum = 1; g; g = g->next, versenum++)
+                      gint versenum, count = staff_verse_count (curstaffstruct);
+                      for (versenum = 1; versenum <= count; versenum++)
                         {
                           GString *versename = g_string_new ("");
                           GString *temp = g_string_new ("");
@@ -2902,7 +3307,7 @@ output_score_to_buffer (DenemoProject * gui, gboolean all_movements, gchar * par
 
     }                           /* for each movement */
 
-
+  g_ptr_array_free (voices, TRUE);
   g_string_free (definitions, TRUE);
 
   // now go through gui->anchors, and to each anchor attach a copy of the original text, for checking when saving.
@@ -2933,7 +3338,7 @@ output_score_to_buffer (DenemoProject * gui, gboolean all_movements, gchar * par
   }
 
   gtk_text_buffer_set_modified (Denemo.textbuffer, FALSE);
-
+  PROFILE_END (mark);
 }                               /* output_score_to_buffer */
 
 
@@ -61,6 +61,7 @@
 #include "audio/instrumentname.h"
 #include "audio/audiointerface.h"
 #include "core/view.h"
+#include "core/profile.h"
 #include "printview/svgview.h"
 #include "smf.h"
 /*
@@ -710,18 +711,77 @@ is_status_byte(const unsigned char status)
     return (status & 0x80);
 }
 
+/*
+ * The track for each staff is generated on its own, possibly in parallel with the others,
+ * into a MidiStaffTrack: the events with their times in pulses, and the times of the objects
+ * relative to the events that sound them. The seconds depend on the tempo changes in all the
+ * tracks, so they are only known once the tracks are merged into the smf, see merge_tracks ().
+ */
+typedef struct MidiTrackEvent
+{
+  smf_event_t *event;
+  gint pulses;
+} MidiTrackEvent;
+
+typedef struct MidiObjectTiming
+{
+  DenemoObject *curobj;
+  smf_event_t *event;
+  gdouble earliest;             /* seconds from the event */
+  gdouble latest;
+} MidiObjectTiming;
+
+typedef struct MidiStaffTrack
+{
+  DenemoMovement *si;
+  DenemoStaff *staff;
+  gint tracknumber;             /* counting from 1 */
+  gint global_transposition;
+  gint pref_width;
+  gint pref_staccato;
+  gint pref_staccatissimo;
+  GArray *events;               /* MidiTrackEvent in order */
+  GArray *timings;              /* MidiObjectTiming in order */
+  gint pulses;                  /* the time of the last event */
+} MidiStaffTrack;
+
+/* appends event to the track delta pulses after the last event */
+static void
+track_add_event (MidiStaffTrack * t, smf_event_t * event, gint delta)
+{
+  MidiTrackEvent e;
+  t->pulses += delta;
+  e.event = event;
+  e.pulses = t->pulses;
+  g_array_append_val (t->events, e);
+}
+
+/* sets the times of curobj to those given relative to event once the seconds are known */
+static void
+time_object (MidiStaffTrack * t, DenemoObject * curobj, smf_event_t * event, gdouble earliest, gdouble latest)
+{
+  MidiObjectTiming timing;
+  if (event == NULL)
+    return;
+  timing.curobj = curobj;
+  timing.event = event;
+  timing.earliest = earliest;
+  timing.latest = latest;
+  g_array_append_val (t->timings, timing);
+}
+
 /* puts an event into track if buffer contains valid midi message.
    and frees buffer. Returns the event, or NULL if invalid buffer.
  */
 static smf_event_t *
-put_event (gchar * buffer, gint numbytes,  smf_track_t * track)
+put_event (gchar * buffer, gint numbytes, MidiStaffTrack * t)
 {
   smf_event_t *event = NULL;
   if (numbytes && is_status_byte (buffer[0]))
     event = smf_event_new_from_pointer (buffer, numbytes);
  if (event && smf_event_is_valid (event))
     {
-      smf_track_add_event_delta_pulses (track, event, 0);
+      track_add_event (t, event, 0);
     }
   g_free (buffer);
   return event;
@@ -952,25 +1012,16 @@ gdouble load_lilypond_midi (gchar * outfile, gboolean keep) {
     return 0.0;
 }
 
-/*
- * the main midi output system (somewhat large)
- */
-
-/****************************************************************/
-/****************************************************************/
-/****************************************************************/
-
 /**
- * the main midi output system (somewhat large)
- * return the duration in seconds of the music stored
+ * generate the MIDI for the staff t->staff into t, see MidiStaffTrack.
+ * Only the staff and its objects are touched, so that the staffs can be done in parallel.
  */
-gdouble
-exportmidi (gchar * thefilename, DenemoMovement * si)
+static void
+build_staff_track (MidiStaffTrack * t)
 {
   /* variables for reading and decoding the object list */
   smf_event_t *event = NULL;
-  staffnode *curstaff;
-  DenemoStaff *curstaffstruct;
+  DenemoStaff *curstaffstruct = t->staff;
   measurenode *curmeasure;
   objnode *curobjnode;
   DenemoObject *curobj;
@@ -980,12 +1031,10 @@ exportmidi (gchar * thefilename, DenemoMovement * si)
   gint enshift;
   gint mid_c_offset;
   GList *curtone;
-  //gdouble fraction;
 
   gint measurenum, last = 0;
 
   /* variables for generating music */
-  //int i;
   int d, n;
 
   long ticks_read;
@@ -995,10 +1044,8 @@ exportmidi (gchar * thefilename, DenemoMovement * si)
   gdouble master_volume;
   gboolean override_volume;
   int cur_transposition = 0;
-  int global_transposition = 0;
 
   int midi_channel = (-1);
-  int tracknumber = 0;
   int timesigupper = 4;
   int timesiglower = 4;
   int notenumber;
@@ -1017,150 +1064,88 @@ exportmidi (gchar * thefilename, DenemoMovement * si)
   //int rand_delta;
   //int beat = 0;
 
-  /* to handle user preferences */
-  char *envp;
-  int vel_randfact = 5;
-  int vel_beatfact = 10;
-  int pref_width = 100;
-  int pref_staccato = 25;
-  int pref_staccatissimo = 10;
-
   /* tuplets */
   int tuplet = 0;               //level of tuplet nesting only 0 and 1 are supported
   tupopen tupletnums;
   tupopen savedtuplet;
 
-  /* used to insert track sizes in the midi file */
-  //long track_start_pos[MAX_TRACKS];
-  //long track_end_pos[MAX_TRACKS];
+  /* track name */
+  event = midi_meta_text (3, curstaffstruct->lily_name->str);
+  track_add_event (t, event, 0);
 
-  /* statistics */
-  time_t starttime;
-  //time_t endtime;
-
-  call_out_to_guile ("(InitializeMidiGeneration)");
+  /* tempo */
+  gint cur_tempo = t->si->tempo;
 
-  /* get user preferences, if any */
-  envp = getenv ("EXP_MIDI_VEL");
-  if (envp)
-    {
-      sscanf (envp, "%d %d", &vel_randfact, &vel_beatfact);
-      fprintf (stderr, "VELOCITY parameters are: %d %d\n", vel_randfact, vel_beatfact);
+  if (t->tracknumber == 1)
+    {                       //Do not set the tempo for later tracks as there may be tempo directives at the start of the first measure which libsmf will muddle up with any done here
+      event = midi_tempo (cur_tempo);
+      track_add_event (t, event, 0);
     }
+  /* Midi Client/Port */
+//      track->user_pointer = (DevicePort *) device_manager_get_DevicePort(curstaffstruct->device_port->str);
 
-  envp = getenv ("EXP_MIDI_PERCENT");
-  if (envp)
+  /* The midi instrument */
+  if (curstaffstruct->midi_instrument && curstaffstruct->midi_instrument->len)
     {
-      sscanf (envp, "%d %d %d", &pref_width, &pref_staccato, &pref_staccatissimo);
-
-      fprintf (stderr, "PERCENT parameters are: normal=%d staccato=%d %d\n", pref_width, pref_staccato, pref_staccatissimo);
+      event = midi_meta_text (4, curstaffstruct->midi_instrument->str);
+      track_add_event (t, event, 0);
     }
+  midi_channel = curstaffstruct->midi_channel;
+  prognum = curstaffstruct->midi_prognum;
 
-  /* just curious */
-  time (&starttime);
-
-  smf_t *smf = smf_new ();
-  if(smf_set_ppqn (smf, MIDI_RESOLUTION))
-    g_debug("smf_set_ppqn failed");
+  /* set selected midi program */
+  g_message ("Using channel %d prognum %d", midi_channel, prognum);
+  event = midi_change_event (MIDI_PROG_CHANGE, midi_channel, prognum);
+  track_add_event (t, event, 0);
 
-/*
- * end of headers and meta events, now for some real actions
- */
+  /*key signature */
 
-  //fraction = 1 / g_list_length (si->thescore);
+  event = midi_keysig (curstaffstruct->keysig.number, curstaffstruct->keysig.isminor);
+  track_add_event (t, event, 0);
 
-  /* iterate over all tracks in file */
-  //printf ("\nsi->stafftoplay in exportmidi = %i", si->stafftoplay);
-  curstaff = si->thescore;
-  if (si->stafftoplay > 0)
-    {
-      int z = si->stafftoplay;
-      while (--z)
-        curstaff = curstaff->next;
-    }
-  if (Denemo.project->lilycontrol.directives)
-            {
-              GList *g = Denemo.project->lilycontrol.directives;
-              DenemoDirective *directive = NULL;
-              for (; g; g = g->next)
-                {
-                  directive = (DenemoDirective *) g->data;
-                  if (!strcmp(directive->tag->str, "TransposeOnPrint"))
-                    global_transposition = directive->minpixels;
-                }
-            }
-  //for (curstaff = si->thescore; curstaff; curstaff = curstaff->next)
-  while (curstaff)
-    {
-      /* handle one track */
-      curstaffstruct = (DenemoStaff *) curstaff->data;
+  /* Time signature */
+  timesigupper = curstaffstruct->timesig.time1;
+  //printf("\nstime1 = %i\n", timesigupper);
 
-      /* select a suitable track number */
-      tracknumber++;
-      smf_track_t *track = smf_track_new ();
-      smf_add_track (smf, track);
+  timesiglower = curstaffstruct->timesig.time2;
+  //printf("\nstime2 = %i\n", timesiglower);
 
-      /* track name */
-      event = midi_meta_text (3, curstaffstruct->lily_name->str);
-      smf_track_add_event_delta_pulses (track, event, 0);
+  event = midi_timesig (timesigupper, timesiglower);
+  track_add_event (t, event, 0);
 
-      /* tempo */
-      gint cur_tempo = si->tempo;
+  /* set a default velocity value */
+  cur_volume = curstaffstruct->volume;
 
-      if (tracknumber == 1)
-        {                       //Do not set the tempo for later tracks as there may be tempo directives at the start of the first measure which libsmf will muddle up with any done here
-          event = midi_tempo (cur_tempo);
-          smf_track_add_event_delta_pulses (track, event, 0);
-        }
-      /* Midi Client/Port */
-//      track->user_pointer = (DevicePort *) device_manager_get_DevicePort(curstaffstruct->device_port->str);
+  master_volume = curstaffstruct->volume / 127.0;   /* new semantic for staff volume as fractional master volume */
+  override_volume = curstaffstruct->override_volume;        /* force full volume output if set */
+  cur_transposition = t->global_transposition + curstaffstruct->transposition;
 
-      /* The midi instrument */
-      if (curstaffstruct->midi_instrument && curstaffstruct->midi_instrument->len)
+  //Now that we have the channel and volume we can interpret any score and staff-wide directives for midi
+  if (curstaffstruct->staff_directives)
+    {
+      GList *g = curstaffstruct->staff_directives;
+      DenemoDirective *directive = NULL;
+      for (; g; g = g->next)
         {
-          event = midi_meta_text (4, curstaffstruct->midi_instrument->str);
-          smf_track_add_event_delta_pulses (track, event, 0);
+          gint numbytes;
+          directive = (DenemoDirective *) g->data;
+          gint midi_override = directive_get_midi_override (directive);
+          gchar *buf = directive_get_midi_buffer (directive, &numbytes, midi_channel, cur_volume);
+          if (!(midi_override & DENEMO_OVERRIDE_HIDDEN))
+            if (buf)
+              if (NULL == put_event (buf, numbytes, t))
+                g_warning ("Invalid midi bytes in staff directive");
         }
-      midi_channel = curstaffstruct->midi_channel;
-      prognum = curstaffstruct->midi_prognum;
-
-      /* set selected midi program */
-      g_message ("Using channel %d prognum %d", midi_channel, prognum);
-      event = midi_change_event (MIDI_PROG_CHANGE, midi_channel, prognum);
-      smf_track_add_event_delta_pulses (track, event, 0);
-
-      /*key signature */
-
-      event = midi_keysig (curstaffstruct->keysig.number, curstaffstruct->keysig.isminor);
-      smf_track_add_event_delta_pulses (track, event, 0);
-
-      /* Time signature */
-      timesigupper = curstaffstruct->timesig.time1;
-      //printf("\nstime1 = %i\n", timesigupper);
-
-      timesiglower = curstaffstruct->timesig.time2;
-      //printf("\nstime2 = %i\n", timesiglower);
-
-      event = midi_timesig (timesigupper, timesiglower);
-      smf_track_add_event_delta_pulses (track, event, 0);
-
-      /* set a default velocity value */
-      cur_volume = curstaffstruct->volume;
-
-      master_volume = curstaffstruct->volume / 127.0;   /* new semantic for staff volume as fractional master volume */
-      override_volume = curstaffstruct->override_volume;        /* force full volume output if set */
-      cur_transposition = global_transposition + curstaffstruct->transposition;
-
+    }
 
-      if (tuplet > 0)
-        g_warning ("Unterminated tuplet at end of voice %d", tracknumber - 1);
-      //Reset to  tuplets nesting level 0, in case unbalanced tuplet start end in last staff
-      tuplet = 0;
-      //Now that we have the channel and volume we can interpret any score and staff-wide directives for midi
-      if (curstaffstruct->staff_directives)
+  if (t->tracknumber == 1)
+    {
+      if (Denemo.project->lilycontrol.directives)
         {
-          GList *g = curstaffstruct->staff_directives;
+          //FIXME repeated code
+          GList *g = Denemo.project->lilycontrol.directives;
           DenemoDirective *directive = NULL;
+
           for (; g; g = g->next)
             {
               gint numbytes;
@@ -1169,653 +1154,810 @@ exportmidi (gchar * thefilename, DenemoMovement * si)
               gchar *buf = directive_get_midi_buffer (directive, &numbytes, midi_channel, cur_volume);
               if (!(midi_override & DENEMO_OVERRIDE_HIDDEN))
                 if (buf)
-                  if (NULL == put_event (buf, numbytes, track))
-                    g_warning ("Invalid midi bytes in staff directive");
+                  if (NULL == put_event (buf, numbytes, t))
+                    g_warning ("Invalid midi bytes in score directive"); 
             }
         }
 
-      if (tracknumber == 1)
+      if (Denemo.project->movement->movementcontrol.directives)
         {
-          if (Denemo.project->lilycontrol.directives)
-            {
-              //FIXME repeated code
-              GList *g = Denemo.project->lilycontrol.directives;
-              DenemoDirective *directive = NULL;
-
-              for (; g; g = g->next)
-                {
-                  gint numbytes;
-                  directive = (DenemoDirective *) g->data;
-                  gint midi_override = directive_get_midi_override (directive);
-                  gchar *buf = directive_get_midi_buffer (directive, &numbytes, midi_channel, cur_volume);
-                  if (!(midi_override & DENEMO_OVERRIDE_HIDDEN))
-                    if (buf)
-                      if (NULL == put_event (buf, numbytes, track))
-                        g_warning ("Invalid midi bytes in score directive"); 
-                }
-            }
-
-          if (Denemo.project->movement->movementcontrol.directives)
+          GList *g = Denemo.project->movement->movementcontrol.directives;
+          DenemoDirective *directive = NULL;
+          for (; g; g = g->next)
             {
-              GList *g = Denemo.project->movement->movementcontrol.directives;
-              DenemoDirective *directive = NULL;
-              for (; g; g = g->next)
-                {
-                  gint numbytes;
-                  directive = (DenemoDirective *) g->data;
-                  gint midi_override = directive_get_midi_override (directive);
-                  gchar *buf = directive_get_midi_buffer (directive, &numbytes, midi_channel, cur_volume);
-                  if (!(midi_override & DENEMO_OVERRIDE_HIDDEN))
-                    if (buf)
-                      if (NULL == put_event (buf, numbytes,  track))
-                        g_warning ("Invalid midi bytes in movement directive");
-                }
+              gint numbytes;
+              directive = (DenemoDirective *) g->data;
+              gint midi_override = directive_get_midi_override (directive);
+              gchar *buf = directive_get_midi_buffer (directive, &numbytes, midi_channel, cur_volume);
+              if (!(midi_override & DENEMO_OVERRIDE_HIDDEN))
+                if (buf)
+                  if (NULL == put_event (buf, numbytes, t))
+                    g_warning ("Invalid midi bytes in movement directive");
             }
-
         }
 
+    }
+
 
 
 
 
-      /* reset measure */
-      curmeasurenum = 0;
-      curmeasure = curstaffstruct->themeasures;
+  /* reset measure */
+  curmeasurenum = 0;
+  curmeasure = curstaffstruct->themeasures;
 
-      /* reset tick counters */
-      ticks_read = 0;
-      ticks_written = 0;
+  /* reset tick counters */
+  ticks_read = 0;
+  ticks_written = 0;
 
-      /* reset slur system */
-      slur_erase (note_status, &slur_status);
+  /* reset slur system */
+  slur_erase (note_status, &slur_status);
 
-      /* set boundries */
+  /* set boundries */
 
-      last = g_list_length (curmeasure);
+  last = g_list_length (curmeasure);
 
 
-      /* iterate for over measures in track */
-      for (measurenum = 1; curmeasure && measurenum <= last; curmeasure = curmeasure->next, measurenum++)
+  /* iterate for over measures in track */
+  for (measurenum = 1; curmeasure && measurenum <= last; curmeasure = curmeasure->next, measurenum++)
+    {
+      /* start of measure */
+      curmeasurenum++;
+      measure_is_empty = TRUE;
+      measure_has_odd_tuplet = 0;
+      ticks_at_bar = ticks_read;
+
+      /* iterate over objects in measure */
+      for (curobjnode = (objnode *) ((DenemoMeasure*)curmeasure->data)->objects; curobjnode; curobjnode = curobjnode->next)
         {
-          /* start of measure */
-          curmeasurenum++;
-          measure_is_empty = TRUE;
-          measure_has_odd_tuplet = 0;
-          ticks_at_bar = ticks_read;
-
-          /* iterate over objects in measure */
-          for (curobjnode = (objnode *) ((DenemoMeasure*)curmeasure->data)->objects; curobjnode; curobjnode = curobjnode->next)
+          curobj = (DenemoObject *) curobjnode->data;
+          curobj->earliest_time = ticks_read * 60.0 / (cur_tempo * MIDI_RESOLUTION);        //smf_get_length_seconds(smf);
+          if (curobj->durinticks)
+              measure_is_empty = FALSE;
+
+    /*******************************************
+ *  huge switch:
+ *  here we handle every kind of object
+ *  that seems relevant to us
+ *******************************************/
+          int tmpstaccato = 0, tmpstaccatissimo = 0;
+          gboolean skip_midi = FALSE;
+
+          switch (curobj->type)
             {
-              curobj = (DenemoObject *) curobjnode->data;
-              curobj->earliest_time = ticks_read * 60.0 / (cur_tempo * MIDI_RESOLUTION);        //smf_get_length_seconds(smf);
-              if (curobj->durinticks)
-                  measure_is_empty = FALSE;
-
-        /*******************************************
-     *  huge switch:
-     *  here we handle every kind of object
-     *  that seems relevant to us
-     *******************************************/
-              int tmpstaccato = 0, tmpstaccatissimo = 0;
-              gboolean skip_midi = FALSE;
-
-              switch (curobj->type)
+            case CHORD:
+      /********************
+   * one or more notes
+   ********************/
+              if (debug)
+                fprintf (stderr, "=============================== chord at %s\n", fmt_ticks (ticks_read));
+              chordval = *(chord *) curobj->object;
+              if (chordval.directives)
                 {
-                case CHORD:
-          /********************
-       * one or more notes
-       ********************/
-                  if (debug)
-                    fprintf (stderr, "=============================== chord at %s\n", fmt_ticks (ticks_read));
-                  chordval = *(chord *) curobj->object;
-                  if (chordval.directives)
+                  GList *g = chordval.directives;
+                  DenemoDirective *directive = NULL;
+                  for (; g; g = g->next)
                     {
-                      GList *g = chordval.directives;
-                      DenemoDirective *directive = NULL;
-                      for (; g; g = g->next)
+                      gint numbytes;
+                      directive = (DenemoDirective *) g->data;
+                      gchar *buf = directive_get_midi_buffer (directive, &numbytes, midi_channel, cur_volume);
+                      gint midi_override = directive_get_midi_override (directive);
+                      gint midi_interpretation = directive_get_midi_interpretation (directive);
+                      gint midi_action = directive_get_midi_action (directive);
+                      gint midi_val = directive_get_midi_val (directive);
+                      /* handle all types of MIDI overrides attached to chord here */
+                      switch (midi_override)
                         {
-                          gint numbytes;
-                          directive = (DenemoDirective *) g->data;
-                          gchar *buf = directive_get_midi_buffer (directive, &numbytes, midi_channel, cur_volume);
-                          gint midi_override = directive_get_midi_override (directive);
-                          gint midi_interpretation = directive_get_midi_interpretation (directive);
-                          gint midi_action = directive_get_midi_action (directive);
-                          gint midi_val = directive_get_midi_val (directive);
-                          /* handle all types of MIDI overrides attached to chord here */
-                          switch (midi_override)
+                        case DENEMO_OVERRIDE_VOLUME:
+                          if (midi_val)
+                            change_volume (&cur_volume, midi_val, midi_interpretation, midi_action);
+                          else
+                            skip_midi = TRUE;
+                          break;
+                        case DENEMO_OVERRIDE_TRANSPOSITION:
+                          cur_transposition = t->global_transposition + midi_val;
+                          break;
+
+                        case DENEMO_OVERRIDE_CHANNEL:
+                          change_channel (&midi_channel, midi_val, midi_interpretation, midi_action);
+                          break;
+                        case DENEMO_OVERRIDE_TEMPO:
+                          change_tempo (&cur_tempo, midi_val, midi_interpretation, midi_action);
+                          if (cur_tempo)
                             {
-                            case DENEMO_OVERRIDE_VOLUME:
-                              if (midi_val)
-                                change_volume (&cur_volume, midi_val, midi_interpretation, midi_action);
-                              else
-                                skip_midi = TRUE;
-                              break;
-                            case DENEMO_OVERRIDE_TRANSPOSITION:
-                              cur_transposition = global_transposition + midi_val;
-                              break;
-
-                            case DENEMO_OVERRIDE_CHANNEL:
-                              change_channel (&midi_channel, midi_val, midi_interpretation, midi_action);
-                              break;
-                            case DENEMO_OVERRIDE_TEMPO:
-                              change_tempo (&cur_tempo, midi_val, midi_interpretation, midi_action);
-                              if (cur_tempo)
-                                {
-                                  event = midi_tempo (cur_tempo);
-                                  smf_track_add_event_delta_pulses (track, event, 0);
-                                }
-                              else
-                                g_warning ("Tempo change to 0 bpm is illegal");
-                              break;
-                              //etc
-                            default:
-                              if (!(midi_override & DENEMO_OVERRIDE_HIDDEN))
-                                if (buf)
-                                  {
-                                    if (NULL == put_event (buf, numbytes, track))
-                                      g_warning ("Invalid midi bytes in chord directive");
-                                  }
-                              break;
+                              event = midi_tempo (cur_tempo);
+                              track_add_event (t, event, 0);
                             }
-                        }       //for each directive attached to the chord
-                    }           //if there are directives
-                  /* FIXME sound grace notes either simultaneously for shorter duration or steal time .... */
-                  if (curobj->durinticks == 0) 
-                  //if (chordval.is_grace)
-                    {
-                        curobj->latest_time = curobj->earliest_time;
-                        break;
-                    }
+                          else
+                            g_warning ("Tempo change to 0 bpm is illegal");
+                          break;
+                          //etc
+                        default:
+                          if (!(midi_override & DENEMO_OVERRIDE_HIDDEN))
+                            if (buf)
+                              {
+                                if (NULL == put_event (buf, numbytes, t))
+                                  g_warning ("Invalid midi bytes in chord directive");
+                              }
+                          break;
+                        }
+                    }       //for each directive attached to the chord
+                }           //if there are directives
+              /* FIXME sound grace notes either simultaneously for shorter duration or steal time .... */
+              if (curobj->durinticks == 0) 
+              //if (chordval.is_grace)
+                {
+                    curobj->latest_time = curobj->earliest_time;
+                    break;
+                }
 
-          /***********************************
-       * compute nominal duration of note
-       ***********************************/
+      /***********************************
+   * compute nominal duration of note
+   ***********************************/
 
-                  numdots = chordval.numdots;
-                  duration = 0;
-                  if (chordval.baseduration >= 0)
+              numdots = chordval.numdots;
+              duration = 0;
+              if (chordval.baseduration >= 0)
+                {
+                  for (d = 0; d <= numdots; d++)
                     {
-                      for (d = 0; d <= numdots; d++)
-                        {
 
 
-                          duration += internaltoticks (chordval.baseduration) >> d;
-                        }
-                      if (tuplet >= 1)
+                      duration += internaltoticks (chordval.baseduration) >> d;
+                    }
+                  if (tuplet >= 1)
+                    {
+                      duration *= tupletnums.numerator;
+                      duration /= tupletnums.denominator;
+                      if (MIDI_RESOLUTION % tupletnums.denominator)
                         {
-                          duration *= tupletnums.numerator;
-                          duration /= tupletnums.denominator;
-                          if (MIDI_RESOLUTION % tupletnums.denominator)
-                            {
-                              measure_has_odd_tuplet = 1;
-                            }
+                          measure_has_odd_tuplet = 1;
                         }
+                    }
 
-                      if (tuplet >= 2)
+                  if (tuplet >= 2)
+                    {
+                      if (MIDI_RESOLUTION % tupletnums.denominator * savedtuplet.denominator)
                         {
-                          if (MIDI_RESOLUTION % tupletnums.denominator * savedtuplet.denominator)
-                            {
-                              measure_has_odd_tuplet = 1;
-                            }
-                          duration *= savedtuplet.numerator;
-                          duration /= savedtuplet.denominator;
+                          measure_has_odd_tuplet = 1;
                         }
+                      duration *= savedtuplet.numerator;
+                      duration /= savedtuplet.denominator;
                     }
-                  else
-                    duration = curobj->durinticks;
+                }
+              else
+                duration = curobj->durinticks;
 
-          /********************************
-       * compute real duration of note
-       ********************************/
+      /********************************
+   * compute real duration of note
+   ********************************/
 #if 0
-                  //this is not working - it causes the delta to be -ve later
-                  for (tmp = chordval.ornamentlist; tmp; tmp = tmp->next)
+              //this is not working - it causes the delta to be -ve later
+              for (tmp = chordval.ornamentlist; tmp; tmp = tmp->next)
+                {
+                  if (*(enum ornament *) tmp->data == (enum ornament) STACCATISSIMO)
                     {
-                      if (*(enum ornament *) tmp->data == (enum ornament) STACCATISSIMO)
-                        {
-                          tmpstaccatissimo = 1;
-                          width = percent (duration, pref_staccatissimo);
-                        }
-                      else if (*(enum ornament *) tmp->data == (enum ornament) STACCATO)
-                        {
-                          width = percent (duration, pref_staccato);
-                          tmpstaccato = 1;
-                        }
-
-                      else
-                        {
-                          width = percent (duration, pref_width);
-                        }
+                      tmpstaccatissimo = 1;
+                      width = percent (duration, t->pref_staccatissimo);
+                    }
+                  else if (*(enum ornament *) tmp->data == (enum ornament) STACCATO)
+                    {
+                      width = percent (duration, t->pref_staccato);
+                      tmpstaccato = 1;
+                    }
 
+                  else
+                    {
+                      width = percent (duration, t->pref_width);
                     }
-                  if (debug)
-                    fprintf (stderr, "duration is %s\n", fmt_ticks (duration));
+
+                }
+              if (debug)
+                fprintf (stderr, "duration is %s\n", fmt_ticks (duration));
 #else
-                  width = 0;
+              width = 0;
 #endif
 
-                  if (!chordval.notes)
-                    {
-                      //MUST GIVE OFF TIME FOR RESTS HERE
-                      curobj->latest_time = curobj->earliest_time + duration * 60.0 / (cur_tempo * MIDI_RESOLUTION);
-                      //g_debug("Adding Dummy event for rest %d %d %d\n", duration, ticks_read, ticks_written);
-                      event = midi_meta_text (1 /* comment */ , "rest");
-                      smf_track_add_event_delta_pulses (track, event, duration);
-
-                      ticks_written += duration;
-                      event->user_pointer = curobj;
-                      //g_debug("rest of %f seconds at %f\n", duration/(double)MIDI_RESOLUTION, curobj->latest_time);
-                    }
+              if (!chordval.notes)
+                {
+                  //MUST GIVE OFF TIME FOR RESTS HERE
+                  curobj->latest_time = curobj->earliest_time + duration * 60.0 / (cur_tempo * MIDI_RESOLUTION);
+                  //g_debug("Adding Dummy event for rest %d %d %d\n", duration, ticks_read, ticks_written);
+                  event = midi_meta_text (1 /* comment */ , "rest");
+                  track_add_event (t, event, duration);
 
-                  if (chordval.notes)
-                    {
+                  ticks_written += duration;
+                  event->user_pointer = curobj;
+                  //g_debug("rest of %f seconds at %f\n", duration/(double)MIDI_RESOLUTION, curobj->latest_time);
+                }
+
+              if (chordval.notes)
+                {
 
-                      gint tmp_channel = midi_channel;
-                      if (curobj->isinvisible)
-                        midi_channel = 9;
+                  gint tmp_channel = midi_channel;
+                  if (curobj->isinvisible)
+                    midi_channel = 9;
 
-            /**************************
-         * prepare for note output
-         **************************/
+        /**************************
+     * prepare for note output
+     **************************/
 
-                      notes_in_chord = 0;
-                      if (debug)
-                        fprintf (stderr, "this is a chord\n");
+                  notes_in_chord = 0;
+                  if (debug)
+                    fprintf (stderr, "this is a chord\n");
 
-                     // slur_update (&slur_status, chordval.slur_begin_p, chordval.slur_end_p);
+                 // slur_update (&slur_status, chordval.slur_begin_p, chordval.slur_end_p);
  slur_update (&slur_status, 0, 0);
 
-                      /* compute beat to add to note velocity */
-                      //beat = compute_beat (ticks_read - ticks_at_bar, beats2ticks (1, timesigupper, timesiglower), bars2ticks (1, timesigupper, timesiglower), duration, vel_beatfact);
+                  /* compute beat to add to note velocity */
+                  //beat = compute_beat (ticks_read - ticks_at_bar, beats2ticks (1, timesigupper, timesiglower), bars2ticks (1, timesigupper, timesiglower), duration, vel_beatfact);
 
-            /************************
-         * begin chord read loop
-         ************************/
+        /************************
+     * begin chord read loop
+     ************************/
 
-                      for (curtone = chordval.notes; curtone; curtone = curtone->next)
-                        {
-                          note *thenote = (note *) curtone->data;
+                  for (curtone = chordval.notes; curtone; curtone = curtone->next)
+                    {
+                      note *thenote = (note *) curtone->data;
 
 #ifdef NOTE_MIDI_OVERRIDES_IMPLEMENTED
-                          for (g = thenote->directives; g; g = g->next)
-                            {
-                              DenemoDirective *directive = g->data;
-                              gint midi_override = directive_get_midi_override (directive);
-                              if (midi_override)
-                                skip_midi = TRUE;       //TODO if it *is* overriden take action e.g. increase volume etc. For now we just drop it
-                            }
+                      for (g = thenote->directives; g; g = g->next)
+                        {
+                          DenemoDirective *directive = g->data;
+                          gint midi_override = directive_get_midi_override (directive);
+                          if (midi_override)
+                            skip_midi = TRUE;       //TODO if it *is* overriden take action e.g. increase volume etc. For now we just drop it
+                        }
 #endif
-                          if (!skip_midi)
+                      if (!skip_midi)
+                        {
+                          if (chordval.has_dynamic)
                             {
-                              if (chordval.has_dynamic)
-                                {
-                                  //g_debug ("\nThis chord has a dynamic marking attatched\n");
-                                  GList *dynamic = g_list_first (chordval.dynamics);
-                                  cur_volume = string_to_vol (((GString *) dynamic->data)->str, cur_volume);
-                                }
-                              mid_c_offset = thenote->mid_c_offset;
-                              enshift = thenote->enshift;
-                              notenumber = dia_to_midinote (mid_c_offset) + enshift;
-                              notenumber += cur_transposition;
-
-                              if (notenumber > 127)
-                                {
-                                  g_warning ("Note out of range: %d", notenumber = 60);
-                                }
-                              slur_note (note_status, slur_status, notenumber, tmpstaccato, tmpstaccatissimo, chordval.is_tied);
+                              //g_debug ("\nThis chord has a dynamic marking attatched\n");
+                              GList *dynamic = g_list_first (chordval.dynamics);
+                              cur_volume = string_to_vol (((GString *) dynamic->data)->str, cur_volume);
                             }
+                          mid_c_offset = thenote->mid_c_offset;
+                          enshift = thenote->enshift;
+                          notenumber = dia_to_midinote (mid_c_offset) + enshift;
+                          notenumber += cur_transposition;
 
+                          if (notenumber > 127)
+                            {
+                              g_warning ("Note out of range: %d", notenumber = 60);
+                            }
+                          slur_note (note_status, slur_status, notenumber, tmpstaccato, tmpstaccatissimo, chordval.is_tied);
                         }
-                      /* End chord read loop */
+
+                    }
+                  /* End chord read loop */
 #if slurdebug
-                      print_slurs (stderr, note_status, slur_status, ticks_read, ticks_written, "after chord read");
+                  print_slurs (stderr, note_status, slur_status, ticks_read, ticks_written, "after chord read");
 #endif
-            /****************************
-         * start note-on output loop
-         ****************************/
+        /****************************
+     * start note-on output loop
+     ****************************/
 
-                      /* kill old slurs and ties */
-                      /* start new notes */
+                  /* kill old slurs and ties */
+                  /* start new notes */
 
-                      notes_in_chord = 0;
-                      /* write delta */
-                      for (n = 0; n < 128; n++)
+                  notes_in_chord = 0;
+                  /* write delta */
+                  for (n = 0; n < 128; n++)
+                    {
+                      gint mididelta;
+                      if (slur_on_p (note_status, n) || slur_kill_p (note_status, n))
                         {
-                          gint mididelta;
-                          if (slur_on_p (note_status, n) || slur_kill_p (note_status, n))
+                          if (notes_in_chord++ == 0)
                             {
-                              if (notes_in_chord++ == 0)
-                                {
-                                  mididelta = ticks_read - ticks_written;
-                                  ticks_written = ticks_read;
-                                }
-                              else
-                                {
-                                  mididelta = 0;
-                                }
+                              mididelta = ticks_read - ticks_written;
+                              ticks_written = ticks_read;
                             }
-
-                          /* compute velocity delta */
-                          //rand_delta = i_random (&rand_sigma, vel_randfact);
-                          /* write note on/off */
-                          if (slur_on_p (note_status, n))
+                          else
                             {
-                              // int mix = cur_volume? compress(128, cur_volume + rand_delta + beat) : 0;
-                              // FIXME the function compress is returning large values.
-                              event = smf_event_new_from_bytes (MIDI_NOTE_ON | midi_channel, n,(curstaffstruct->mute)? 0: (override_volume ? 127 : (gint) (master_volume * cur_volume /*FIXME as above, mix */ )));
-                              smf_track_add_event_delta_pulses (track, event, mididelta);
-                              event->user_pointer = curobj;
+                              mididelta = 0;
+                            }
+                        }
 
-                              curobj->earliest_time = event->time_seconds;
-                              curobj->latest_time = curobj->earliest_time + duration * 60.0 / (cur_tempo * MIDI_RESOLUTION);
+                      /* compute velocity delta */
+                      //rand_delta = i_random (&rand_sigma, vel_randfact);
+                      /* write note on/off */
+                      if (slur_on_p (note_status, n))
+                        {
+                          // int mix = cur_volume? compress(128, cur_volume + rand_delta + beat) : 0;
+                          // FIXME the function compress is returning large values.
+                          event = smf_event_new_from_bytes (MIDI_NOTE_ON | midi_channel, n,(curstaffstruct->mute)? 0: (override_volume ? 127 : (gint) (master_volume * cur_volume /*FIXME as above, mix */ )));
+                          track_add_event (t, event, mididelta);
+                          event->user_pointer = curobj;
 
-                              //g_debug ("'%d len %d'", event->event_number, event->midi_buffer_length);
-                              //printf ("volume = %i\n", (override_volume ? 0:mix));
-                            }
-                          else if (slur_kill_p (note_status, n))
-                            {
-                              event = smf_event_new_from_bytes (MIDI_NOTE_OFF | midi_channel, n, 0);
-                              //g_debug("{%d}", event->event_number);
-                              smf_track_add_event_delta_pulses (track, event, mididelta);
-                              //g_debug("Note  off for track %x at delta (%d) %.1f for cur_tempo %d\n", track, mididelta, event->time_seconds, cur_tempo);
-                              event->user_pointer = curobj;
-
-                              curobj->latest_time = event->time_seconds;
-                              curobj->earliest_time = curobj->latest_time - duration * 60.0 / (cur_tempo * MIDI_RESOLUTION);
-                              //g_debug("event off lur kill %f\n", event->time_seconds);
-                            }
+                          time_object (t, curobj, event, 0.0, duration * 60.0 / (cur_tempo * MIDI_RESOLUTION));
+
+                          //g_debug ("'%d len %d'", event->event_number, event->midi_buffer_length);
+                          //printf ("volume = %i\n", (override_volume ? 0:mix));
+                        }
+                      else if (slur_kill_p (note_status, n))
+                        {
+                          event = smf_event_new_from_bytes (MIDI_NOTE_OFF | midi_channel, n, 0);
+                          //g_debug("{%d}", event->event_number);
+                          track_add_event (t, event, mididelta);
+                          //g_debug("Note  off for track %x at delta (%d) %.1f for cur_tempo %d\n", track, mididelta, event->time_seconds, cur_tempo);
+                          event->user_pointer = curobj;
+
+                          time_object (t, curobj, event, -duration * 60.0 / (cur_tempo * MIDI_RESOLUTION), 0.0);
+                          //g_debug("event off lur kill %f\n", event->time_seconds);
                         }
-                      /* end of first chord output loop */
+                    }
+                  /* end of first chord output loop */
 
 #if slurdebug
-                      print_slurs (stderr, note_status, slur_status, ticks_read, ticks_written, "after loop1");
+                  print_slurs (stderr, note_status, slur_status, ticks_read, ticks_written, "after loop1");
 #endif
-            /*****************************
-         * start note-off output loop
-         *****************************/
+        /*****************************
+     * start note-off output loop
+     *****************************/
 
-                      /* kill untied notes */
+                  /* kill untied notes */
 
-                      notes_in_chord = 0;
+                  notes_in_chord = 0;
 
-                      /* start second chord output loop */
+                  /* start second chord output loop */
 
-                      /* write delta */
-                      for (n = 0; n < 128; n++)
+                  /* write delta */
+                  for (n = 0; n < 128; n++)
+                    {
+                      if (slur_off_p (note_status, n))
                         {
-                          if (slur_off_p (note_status, n))
+                          gint mididelta;
+                          if (notes_in_chord++ == 0)
                             {
-                              gint mididelta;
-                              if (notes_in_chord++ == 0)
-                                {
-                                  width += ticks_read - ticks_written;
-                                  mididelta = duration + width;
-                                  ticks_written += duration + width;
-                                  if (ticks_written > ticks_read + duration)
-                                    {
-                                      fprintf (stderr, "BAD WIDTH %d so delta %d\n" "(should not happen!)", width, mididelta);
-                                      mididelta = 0;
-                                    }
-                                }
-                              else
+                              width += ticks_read - ticks_written;
+                              mididelta = duration + width;
+                              ticks_written += duration + width;
+                              if (ticks_written > ticks_read + duration)
                                 {
+                                  fprintf (stderr, "BAD WIDTH %d so delta %d\n" "(should not happen!)", width, mididelta);
                                   mididelta = 0;
                                 }
-                              /* write note off */
-                              event = smf_event_new_from_bytes (MIDI_NOTE_OFF | midi_channel, n, 60);
-                              //g_debug("smf length before %d %f mididelta %d",smf_get_length_pulses(smf), smf_get_length_seconds(smf),mididelta);
-                              smf_track_add_event_delta_pulses (track, event, mididelta);
-                              //g_debug("Note  off for track %x at delta (%d) %.1f for cur_tempo %d\n", track, mididelta, event->time_seconds, cur_tempo);
-                              //g_debug("smf length after %d %f mididelta %d", smf_get_length_pulses(smf), smf_get_length_seconds(smf),mididelta);
-                              event->user_pointer = curobj;
-
-                              curobj->latest_time = event->time_seconds;
-                              curobj->earliest_time = curobj->latest_time - duration * 60.0 / (cur_tempo * MIDI_RESOLUTION);
-                              //g_debug("event off %f mididelta %d duration %d for curobj->type = %d\n", event->time_seconds, mididelta, duration, curobj->type);
-
                             }
+                          else
+                            {
+                              mididelta = 0;
+                            }
+                          /* write note off */
+                          event = smf_event_new_from_bytes (MIDI_NOTE_OFF | midi_channel, n, 60);
+                          //g_debug("smf length before %d %f mididelta %d",smf_get_length_pulses(smf), smf_get_length_seconds(smf),mididelta);
+                          track_add_event (t, event, mididelta);
+                          //g_debug("Note  off for track %x at delta (%d) %.1f for cur_tempo %d\n", track, mididelta, event->time_seconds, cur_tempo);
+                          //g_debug("smf length after %d %f mididelta %d", smf_get_length_pulses(smf), smf_get_length_seconds(smf),mididelta);
+                          event->user_pointer = curobj;
+
+                          time_object (t, curobj, event, -duration * 60.0 / (cur_tempo * MIDI_RESOLUTION), 0.0);
+                          //g_debug("event off %f mididelta %d duration %d for curobj->type = %d\n", event->time_seconds, mididelta, duration, curobj->type);
+
                         }
-                      /* end of second chord output loop */
-                      midi_channel = tmp_channel;
-                    }           //end of for notes in chord. Note that rests have no MIDI representation, of course.
-                  width = 0;
+                    }
+                  /* end of second chord output loop */
+                  midi_channel = tmp_channel;
+                }           //end of for notes in chord. Note that rests have no MIDI representation, of course.
+              width = 0;
 #if slurdebug
-                  print_slurs (stderr, note_status, slur_status, ticks_read, ticks_written, "after loop2");
+              print_slurs (stderr, note_status, slur_status, ticks_read, ticks_written, "after loop2");
 #endif
-                  /* prepare for next event */
+              /* prepare for next event */
 
-                  ticks_read += duration;
-                  slur_shift (note_status);
+              ticks_read += duration;
+              slur_shift (note_status);
 #if slurdebug
-                  print_slurs (stderr, note_status, slur_status, ticks_read, ticks_written, "after shift");
+              print_slurs (stderr, note_status, slur_status, ticks_read, ticks_written, "after shift");
 #endif
-                  if (debug)
-                    fprintf (stderr, "chord end\n");
-                  break;
+              if (debug)
+                fprintf (stderr, "chord end\n");
+              break;
 
-                case TIMESIG:
+            case TIMESIG:
 
-          /************************
-       * time signature change
-       ************************/
+      /************************
+   * time signature change
+   ************************/
 
-                  if (ticks_read != ticks_at_bar)
-                    {
-                      fprintf (stderr, "error: can only change time" " signature at beginning of a measure\n");
-                    }
-                  timesigupper = ((timesig *) curobj->object)->time1;
-                  timesiglower = ((timesig *) curobj->object)->time2;
-                  if (debug)
-                    {
-                      fprintf (stderr, "timesig change to %d:%d\n", timesigupper, timesiglower);
-                    }
+              if (ticks_read != ticks_at_bar)
+                {
+                  fprintf (stderr, "error: can only change time" " signature at beginning of a measure\n");
+                }
+              timesigupper = ((timesig *) curobj->object)->time1;
+              timesiglower = ((timesig *) curobj->object)->time2;
+              if (debug)
+                {
+                  fprintf (stderr, "timesig change to %d:%d\n", timesigupper, timesiglower);
+                }
 
-                  event = midi_timesig (timesigupper, timesiglower);
-                  smf_track_add_event_delta_pulses (track, event, 0);
-                  event->user_pointer = curobj;
+              event = midi_timesig (timesigupper, timesiglower);
+              track_add_event (t, event, 0);
+              event->user_pointer = curobj;
 
-                  curobj->earliest_time = curobj->latest_time = event->time_seconds;    //= smf_get_length_seconds(smf);
-                  break;
+              time_object (t, curobj, event, 0.0, 0.0);    //= smf_get_length_seconds(smf);
+              break;
 
-                case TUPOPEN:
+            case TUPOPEN:
 
-          /***************
-       * tuplet begin
-       ***************/
+      /***************
+   * tuplet begin
+   ***************/
 
-                  switch (tuplet)
-                    {
-                    default:
-                      fprintf (stderr, "too complicated tuplets\n");
-                      break;
-                    case 1:
-                      savedtuplet.numerator = tupletnums.numerator;
-                      savedtuplet.denominator = tupletnums.denominator;
-                      tupletnums.numerator = ((tupopen *) curobj->object)->numerator;
-                      tupletnums.denominator = ((tupopen *) curobj->object)->denominator;
-                      break;
-                    case 0:
-                      tupletnums.numerator = ((tupopen *) curobj->object)->numerator;
-                      tupletnums.denominator = ((tupopen *) curobj->object)->denominator;
-                      break;
-                    }
-                  tuplet++;
-                  curobj->earliest_time = curobj->latest_time = event->time_seconds;    //the last event
+              switch (tuplet)
+                {
+                default:
+                  fprintf (stderr, "too complicated tuplets\n");
                   break;
-                case TUPCLOSE:
+                case 1:
+                  savedtuplet.numerator = tupletnums.numerator;
+                  savedtuplet.denominator = tupletnums.denominator;
+                  tupletnums.numerator = ((tupopen *) curobj->object)->numerator;
+                  tupletnums.denominator = ((tupopen *) curobj->object)->denominator;
+                  break;
+                case 0:
+                  tupletnums.numerator = ((tupopen *) curobj->object)->numerator;
+                  tupletnums.denominator = ((tupopen *) curobj->object)->denominator;
+                  break;
+                }
+              tuplet++;
+              time_object (t, curobj, event, 0.0, 0.0);    //the last event
+              break;
+            case TUPCLOSE:
 
-          /*************
-       * tuplet end
-       *************/
+      /*************
+   * tuplet end
+   *************/
 
-                  tuplet--;
-                  switch (tuplet)
-                    {
-                    case 2:
-                    case 3:
-                    case 4:
-                    case 5:
-                    case 6:
-                    case -1:
-                      fprintf (stderr, "too complicated tuplets\n");
-                      break;
-                    case 1:
-                      tupletnums.numerator = savedtuplet.numerator;
-                      tupletnums.denominator = savedtuplet.denominator;
-                      break;
-                    case 0:
-                      break;
-                    }
-                  curobj->earliest_time = curobj->latest_time = event->time_seconds;    //the last event
+              tuplet--;
+              switch (tuplet)
+                {
+                case 2:
+                case 3:
+                case 4:
+                case 5:
+                case 6:
+                case -1:
+                  fprintf (stderr, "too complicated tuplets\n");
                   break;
+                case 1:
+                  tupletnums.numerator = savedtuplet.numerator;
+                  tupletnums.denominator = savedtuplet.denominator;
+                  break;
+                case 0:
+                  break;
+                }
+              time_object (t, curobj, event, 0.0, 0.0);    //the last event
+              break;
 
-                case DYNAMIC:
+            case DYNAMIC:
 
-          /********************
-       * dynamic directive
-       ********************/
+      /********************
+   * dynamic directive
+   ********************/
 
-                  cur_volume = string_to_vol (((dynamic *) curobj->object)->type->str, cur_volume);
-                  curobj->earliest_time = curobj->latest_time = event->time_seconds;    //the last event
-                  break;
+              cur_volume = string_to_vol (((dynamic *) curobj->object)->type->str, cur_volume);
+              time_object (t, curobj, event, 0.0, 0.0);    //the last event
+              break;
 
-                case KEYSIG:
-                  // curobj->object
-                  //  ((keysig *) theobj->object)->number; referenced in src/measure.cpp
-                  //printf("\nKEYSIG type = %d\n", ((keysig *) curobj->object)->number);
-                  event = midi_keysig ((((keysig *) curobj->object)->number), curstaffstruct->keysig.isminor);
-                  smf_track_add_event_delta_pulses (track, event, 0);
-                  event->user_pointer = curobj;
+            case KEYSIG:
+              // curobj->object
+              //  ((keysig *) theobj->object)->number; referenced in src/measure.cpp
+              //printf("\nKEYSIG type = %d\n", ((keysig *) curobj->object)->number);
+              event = midi_keysig ((((keysig *) curobj->object)->number), curstaffstruct->keysig.isminor);
+              track_add_event (t, event, 0);
+              event->user_pointer = curobj;
 
-                  curobj->earliest_time = curobj->latest_time = event->time_seconds;    //= smf_get_length_seconds(smf);
-                  break;
+              time_object (t, curobj, event, 0.0, 0.0);    //= smf_get_length_seconds(smf);
+              break;
 
-                case CLEF:
+            case CLEF:
 
-          /***********
-       * ignored!
-       ***********/
+      /***********
+   * ignored!
+   ***********/
 
-                  break;
+              break;
 
-                case LILYDIRECTIVE:
+            case LILYDIRECTIVE:
+              {
+                gint theduration = curobj->durinticks;
+                if (!(((DenemoDirective *) curobj->object)->override & DENEMO_OVERRIDE_HIDDEN))
                   {
-                    gint theduration = curobj->durinticks;
-                    if (!(((DenemoDirective *) curobj->object)->override & DENEMO_OVERRIDE_HIDDEN))
+                    gint numbytes;
+                    gchar *buf = directive_get_midi_buffer (curobj->object, &numbytes, midi_channel, cur_volume);
+                    gint midi_override = directive_get_midi_override (curobj->object);
+                    gint midi_interpretation = directive_get_midi_interpretation (curobj->object);
+                    gint midi_action = directive_get_midi_action (curobj->object);
+                    gint midi_val = directive_get_midi_val (curobj->object);
+                    switch (midi_override)
                       {
-                        gint numbytes;
-                        gchar *buf = directive_get_midi_buffer (curobj->object, &numbytes, midi_channel, cur_volume);
-                        gint midi_override = directive_get_midi_override (curobj->object);
-                        gint midi_interpretation = directive_get_midi_interpretation (curobj->object);
-                        gint midi_action = directive_get_midi_action (curobj->object);
-                        gint midi_val = directive_get_midi_val (curobj->object);
-                        switch (midi_override)
+                      case DENEMO_OVERRIDE_VOLUME:
+                        change_volume (&cur_volume, midi_val, midi_interpretation, midi_action);
+                        break;
+                      case DENEMO_OVERRIDE_TRANSPOSITION:
+                        cur_transposition = t->global_transposition + midi_val;
+                        break;
+
+                      case DENEMO_OVERRIDE_CHANNEL:
+                        change_channel (&midi_channel, midi_val, midi_interpretation, midi_action);
+                        break;
+                      case DENEMO_OVERRIDE_TEMPO:
+                        change_tempo (&cur_tempo, midi_val, midi_interpretation, midi_action);
+                        if (cur_tempo)
                           {
-                          case DENEMO_OVERRIDE_VOLUME:
-                            change_volume (&cur_volume, midi_val, midi_interpretation, midi_action);
-                            break;
-                          case DENEMO_OVERRIDE_TRANSPOSITION:
-                            cur_transposition = global_transposition + midi_val;
-                            break;
-
-                          case DENEMO_OVERRIDE_CHANNEL:
-                            change_channel (&midi_channel, midi_val, midi_interpretation, midi_action);
-                            break;
-                          case DENEMO_OVERRIDE_TEMPO:
-                            change_tempo (&cur_tempo, midi_val, midi_interpretation, midi_action);
-                            if (cur_tempo)
-                              {
-                                event = midi_tempo (cur_tempo);
-                                smf_track_add_event_delta_pulses (track, event, 0);     //!!!!!!!!!! if rests precede this it is not at the right time...
-                              }
-                            else
-                              {
-                                g_warning ("Tempo change to 0 bpm is illegal - re-setting.");
-                                cur_tempo = 120;
-                              }
-                            break;
-                          case DENEMO_OVERRIDE_DURATION:
-                            theduration = midi_interpretation;
-                            //g_debug ("Duration is %d", theduration);
-                            break;
-                          default:
-                            if (!(midi_override & DENEMO_OVERRIDE_HIDDEN))
-                              if (buf)
-                                {g_print ("putting numbytes %d", numbytes);
-                                  if (NULL == put_event (buf, numbytes, track))
-                                    g_warning ("Directive has invalid MIDI bytes");
-                                }
-                            break;
+                            event = midi_tempo (cur_tempo);
+                            track_add_event (t, event, 0);     //!!!!!!!!!! if rests precede this it is not at the right time...
+                          }
+                        else
+                          {
+                            g_warning ("Tempo change to 0 bpm is illegal - re-setting.");
+                            cur_tempo = 120;
                           }
+                        break;
+                      case DENEMO_OVERRIDE_DURATION:
+                        theduration = midi_interpretation;
+                        //g_debug ("Duration is %d", theduration);
+                        break;
+                      default:
+                        if (!(midi_override & DENEMO_OVERRIDE_HIDDEN))
+                          if (buf)
+                            {g_print ("putting numbytes %d", numbytes);
+                              if (NULL == put_event (buf, numbytes, t))
+                                g_warning ("Directive has invalid MIDI bytes");
+                            }
+                        break;
                       }
+                  }
 
 
 
-                    curobj->earliest_time = event->time_seconds;        // taking the last one...
-                    curobj->latest_time = curobj->earliest_time + theduration * 60.0 / (cur_tempo * MIDI_RESOLUTION);
-                    ticks_read += theduration;
-                  }
-                  break;
-                default:
+                time_object (t, curobj, event, 0.0, theduration * 60.0 / (cur_tempo * MIDI_RESOLUTION));      // taking the last one...
+                ticks_read += theduration;
+              }
+              break;
+            default:
 #if DEBUG
-                  fprintf (stderr, "midi ignoring type %d\n", curobj->type);
+              fprintf (stderr, "midi ignoring type %d\n", curobj->type);
 #endif
-                  break;
-                }
+              break;
+            }
 
-              //g_debug("Object type  0x%x Starts at %f Finishes %f\n",curobj->type, curobj->earliest_time, curobj->latest_time);
-            }                   // end of objects
+          //g_debug("Object type  0x%x Starts at %f Finishes %f\n",curobj->type, curobj->earliest_time, curobj->latest_time);
+        }                   // end of objects
 
-      /*******************
-       * Do some checking
-       *******************/
+  /*******************
+   * Do some checking
+   *******************/
 
 
-          measurewidth = bars2ticks (1, timesigupper, timesiglower);
+      measurewidth = bars2ticks (1, timesigupper, timesiglower);
 
-          if (measure_is_empty) // was (((DenemoMeasure*)curmeasure->data)->objects == NULL) //An empty measure - treat as whole measure silence
-            ticks_read = ticks_at_bar + measurewidth;
-          if (ticks_at_bar + measurewidth != ticks_read)
+      if (measure_is_empty) // was (((DenemoMeasure*)curmeasure->data)->objects == NULL) //An empty measure - treat as whole measure silence
+        ticks_read = ticks_at_bar + measurewidth;
+      if (ticks_at_bar + measurewidth != ticks_read)
+        {
+          if ((!measure_is_empty) && curmeasure->next)
             {
-              if ((!measure_is_empty) && curmeasure->next)
-                {
-                  g_warning ("warning: overfull measure in %s " "measure %d from %ld to %ld " "\n%sdifference is %ld, measure began at %ld)", curstaffstruct->lily_name->str, measurenum, ticks_read, ticks_at_bar + measurewidth, measure_has_odd_tuplet ? "(after unusual tuplet: " : "(", ticks_at_bar + measurewidth - ticks_read, ticks_at_bar);
-                }
-              if (debug)
-                {
-                  printf ("\nmeasure is empty = %d", measure_is_empty);
-                  printf ("\nticks_at_bar %ld  + measurewidth %d != ticks_read %ld\n", ticks_at_bar, measurewidth, ticks_read);
-                  printf ("\ninternal ticks = %d\n", internaltoticks (0));
-                }
-
-              //ticks_read = ticks_at_bar + measurewidth;//+ internaltoticks (0);
+              g_warning ("warning: overfull measure in %s " "measure %d from %ld to %ld " "\n%sdifference is %ld, measure began at %ld)", curstaffstruct->lily_name->str, measurenum, ticks_read, ticks_at_bar + measurewidth, measure_has_odd_tuplet ? "(after unusual tuplet: " : "(", ticks_at_bar + measurewidth - ticks_read, ticks_at_bar);
             }
-          else
+          if (debug)
             {
-              ;                 //fprintf (stderr, "[%d]", measurenum);
+              printf ("\nmeasure is empty = %d", measure_is_empty);
+              printf ("\nticks_at_bar %ld  + measurewidth %d != ticks_read %ld\n", ticks_at_bar, measurewidth, ticks_read);
+              printf ("\ninternal ticks = %d\n", internaltoticks (0));
             }
-          fflush (stdout);
 
-      /*************************
-       * Done with this measure
-       *************************/
+          //ticks_read = ticks_at_bar + measurewidth;//+ internaltoticks (0);
+        }
+      else
+        {
+          ;                 //fprintf (stderr, "[%d]", measurenum);
+        }
+      fflush (stdout);
+
+  /*************************
+   * Done with this measure
+   *************************/
 
 
-        }                       /* Done with this staff */
+    }                       /* Done with this staff */
 
-    /***********************
-     * Done with this track
-     ***********************/
+/***********************
+ * Done with this track
+ ***********************/
 
-      //fprintf (stderr, "[%s done]\n", curstaffstruct->lily_name->str);
-      fflush (stdout);
-      /*gtk_progress_bar_set_fraction(GTK_PROGRESS_BAR(si->progressbar), fraction +
-         gtk_progress_bar_get_fraction(GTK_PROGRESS_BAR(si->progressbar))); */
-      if (si->stafftoplay == 0)
+  if (tuplet > 0)
+    g_warning ("Unterminated tuplet at end of voice %d", t->tracknumber);
+  //fprintf (stderr, "[%s done]\n", curstaffstruct->lily_name->str);
+  fflush (stdout);
+}
+
+static void
+build_staff_track_in_pool (gpointer data, G_GNUC_UNUSED gpointer user_data)
+{
+  build_staff_track ((MidiStaffTrack *) data);
+}
+
+/* builds all the tracks, in parallel (see run_jobs_in_pool (), DENEMO_MIDI_THREADS limits the threads) */
+static void
+build_staff_tracks (MidiStaffTrack * tracks, gint numtracks)
+{
+  GPtrArray *jobs = g_ptr_array_sized_new (numtracks);
+  gint i;
+  for (i = 0; i < numtracks; i++)
+    g_ptr_array_add (jobs, &tracks[i]);
+  run_jobs_in_pool (jobs, build_staff_track_in_pool, "DENEMO_MIDI_THREADS");
+  g_ptr_array_free (jobs, TRUE);
+}
+
+typedef struct MidiMergeEvent
+{
+  gint pulses;
+  gint track;
+  guint index;
+} MidiMergeEvent;
+
+static gint
+compare_merge_events (const MidiMergeEvent * a, const MidiMergeEvent * b)
+{
+  if (a->pulses != b->pulses)
+    return a->pulses < b->pulses ? -1 : 1;
+  if (a->track != b->track)
+    return a->track < b->track ? -1 : 1;
+  return (a->index > b->index) - (a->index < b->index);
+}
+
+/* adds the tracks to smf, then sets the times of the objects. The events of all the tracks
+   are added in time order, so that libsmf builds the tempo map in a single pass as it goes,
+   with each tempo change known before any event after it is timed. */
+static void
+merge_tracks (smf_t * smf, MidiStaffTrack * tracks, gint numtracks)
+{
+  GArray *merged = g_array_new (FALSE, FALSE, sizeof (MidiMergeEvent));
+  smf_track_t **smf_tracks = g_new (smf_track_t *, numtracks);
+  gint i;
+  guint j;
+  for (i = 0; i < numtracks; i++)
+    {
+      smf_tracks[i] = smf_track_new ();
+      smf_add_track (smf, smf_tracks[i]);
+      for (j = 0; j < tracks[i].events->len; j++)
+        {
+          MidiMergeEvent m;
+          m.pulses = g_array_index (tracks[i].events, MidiTrackEvent, j).pulses;
+          m.track = i;
+          m.index = j;
+          g_array_append_val (merged, m);
+        }
+    }
+  g_array_sort (merged, (GCompareFunc) compare_merge_events);
+  for (j = 0; j < merged->len; j++)
+    {
+      MidiMergeEvent *m = &g_array_index (merged, MidiMergeEvent, j);
+      MidiTrackEvent *e = &g_array_index (tracks[m->track].events, MidiTrackEvent, m->index);
+      smf_track_add_event_pulses (smf_tracks[m->track], e->event, e->pulses);
+    }
+  for (i = 0; i < numtracks; i++)
+    for (j = 0; j < tracks[i].timings->len; j++)
+      {
+        MidiObjectTiming *timing = &g_array_index (tracks[i].timings, MidiObjectTiming, j);
+        timing->curobj->earliest_time = timing->event->time_seconds + timing->earliest;
+        timing->curobj->latest_time = timing->event->time_seconds + timing->latest;
+      }
+  g_free (smf_tracks);
+  g_array_free (merged, TRUE);
+}
+
+/*
+ * the main midi output system (somewhat large)
+ */
+
+/****************************************************************/
+/****************************************************************/
+/****************************************************************/
+
+/**
+ * the main midi output system (somewhat large)
+ * return the duration in seconds of the music stored
+ */
+gdouble
+exportmidi (gchar * thefilename, DenemoMovement * si)
+{
+  PROFILE_BEGIN (mark, "exportmidi");
+  staffnode *curstaff;
+  MidiStaffTrack *tracks;
+  gint numtracks, i;
+  int global_transposition = 0;
+
+  /* to handle user preferences */
+  char *envp;
+  int vel_randfact = 5;
+  int vel_beatfact = 10;
+  int pref_width = 100;
+  int pref_staccato = 25;
+  int pref_staccatissimo = 10;
+
+  /* used to insert track sizes in the midi file */
+  //long track_start_pos[MAX_TRACKS];
+  //long track_end_pos[MAX_TRACKS];
+
+  /* statistics */
+  time_t starttime;
+  //time_t endtime;
+
+  call_out_to_guile ("(InitializeMidiGeneration)");
+
+  /* get user preferences, if any */
+  envp = getenv ("EXP_MIDI_VEL");
+  if (envp)
+    {
+      sscanf (envp, "%d %d", &vel_randfact, &vel_beatfact);
+      fprintf (stderr, "VELOCITY parameters are: %d %d\n", vel_randfact, vel_beatfact);
+    }
+
+  envp = getenv ("EXP_MIDI_PERCENT");
+  if (envp)
+    {
+      sscanf (envp, "%d %d %d", &pref_width, &pref_staccato, &pref_staccatissimo);
+
+      fprintf (stderr, "PERCENT parameters are: normal=%d staccato=%d %d\n", pref_width, pref_staccato, pref_staccatissimo);
+    }
+
+  /* just curious */
+  time (&starttime);
+
+  smf_t *smf = smf_new ();
+  if(smf_set_ppqn (smf, MIDI_RESOLUTION))
+    g_debug("smf_set_ppqn failed");
+
+/*
+ * end of headers and meta events, now for some real actions
+ */
+
+  /* iterate over all tracks in file */
+  //printf ("\nsi->stafftoplay in exportmidi = %i", si->stafftoplay);
+  curstaff = si->thescore;
+  numtracks = g_list_length (curstaff);
+  if (si->stafftoplay > 0)
+    {
+      int z = si->stafftoplay;
+      while (--z)
         curstaff = curstaff->next;
-      else
-        break;
+      numtracks = 1;
+    }
+  if (Denemo.project->lilycontrol.directives)
+            {
+              GList *g = Denemo.project->lilycontrol.directives;
+              DenemoDirective *directive = NULL;
+              for (; g; g = g->next)
+                {
+                  directive = (DenemoDirective *) g->data;
+                  if (!strcmp(directive->tag->str, "TransposeOnPrint"))
+                    global_transposition = directive->minpixels;
+                }
+            }
+  tracks = g_new0 (MidiStaffTrack, numtracks);
+  for (i = 0; i < numtracks; i++, curstaff = curstaff->next)
+    {
+      tracks[i].si = si;
+      tracks[i].staff = (DenemoStaff *) curstaff->data;
+      tracks[i].tracknumber = i + 1;
+      tracks[i].global_transposition = global_transposition;
+      tracks[i].pref_width = pref_width;
+      tracks[i].pref_staccato = pref_staccato;
+      tracks[i].pref_staccatissimo = pref_staccatissimo;
+      tracks[i].events = g_array_new (FALSE, FALSE, sizeof (MidiTrackEvent));
+      tracks[i].timings = g_array_new (FALSE, FALSE, sizeof (MidiObjectTiming));
+    }
+  build_staff_tracks (tracks, numtracks);
+  merge_tracks (smf, tracks, numtracks);
+  for (i = 0; i < numtracks; i++)
+    {
+      g_array_free (tracks[i].events, TRUE);
+      g_array_free (tracks[i].timings, TRUE);
     }
+  g_free (tracks);
 #if 0
 {
   smf_event_t *event;
@@ -1843,6 +1985,7 @@ exportmidi (gchar * thefilename, DenemoMovement * si)
   g_debug ("Start time %f end time %f\n", si->start_time, si->end_time);
 
   call_out_to_guile ("(FinalizeMidiGeneration)");
+  PROFILE_END (mark);
   return smf_get_length_seconds (smf);
 }
 
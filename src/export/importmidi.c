@@ -23,8 +23,12 @@
 #include "core/view.h"
 #include "core/utils.h"
 #include "export/file.h"
+#include "command/chord.h"
 #include "command/commandfuncs.h"
+#include "command/object.h"
 #include "command/processstaffname.h"
+#include "command/score.h"
+#include "command/select.h"
 
 #define TEXT            0x01
 #define COPYRIGHT       0X02
@@ -56,19 +60,6 @@ typedef struct harmonic
   gint enshift;
 } harmonic;
 
-
-static void
-note_from_int (char *buf, int note_number)
-{
-  int note, octave;
-  char *names[] = { "C", "C#", "D", "D#", "E", "F", "F#", "G", "G#", "A", "A#", "B" };
-
-  octave = note_number / 12 - 1;
-  note = note_number % 12;
-
-  sprintf (buf, "%s%d", names[note], octave);
-}
-
 static harmonic
 enharmonic (gint input, gint key)
 {
@@ -181,103 +172,6 @@ ConvertLength (gint ppqn, gint duration, notetype * pnotetype)
   pnotetype->numofdots = numofdots;
 }
 
-/**
- * Insert time signature into current staff
- *
- */
-static void
-dotimesig (gint numerator, gint denominator)
-{
-  DenemoProject *gui = Denemo.project;
-  /*only does initial TS */
-  DenemoStaff *curstaffstruct = (DenemoStaff *) gui->movement->currentstaff->data;
-
-  curstaffstruct->timesig.time1 = numerator;
-  curstaffstruct->timesig.time2 = denominator;
-}
-
-/**
- * Insert key signature into the current staff
- *
- */
-static void
-dokeysig (gint isminor, gint key)
-{
-  DenemoProject *gui = Denemo.project;
-  if (key > 7)
-    key = key - 256;            /*get flat key num, see keysigdialog.cpp */
-  g_debug ("\nkey = %d\n", key);
-  DenemoStaff *curstaffstruct = (DenemoStaff *) gui->movement->currentstaff->data;
-  curstaffstruct->keysig.number = key;
-  curstaffstruct->keysig.isminor = isminor;
-  dnm_setinitialkeysig (curstaffstruct, key, isminor);
-}
-
-static void
-dotempo (gint tempo)
-{
-  DenemoProject *gui = Denemo.project;
-  gui->movement->tempo = (gint) (6.0e7 / (double) tempo);
-}
-
-static void
-dotrackname (gchar * name)
-{
-  DenemoProject *gui = Denemo.project;
-  DenemoStaff *curstaffstruct = (DenemoStaff *) gui->movement->currentstaff->data;
-  if (name)
-    g_string_assign (curstaffstruct->denemo_name, name);
-}
-
-static void
-doinstrname (gchar * name)
-{
-  DenemoProject *gui = Denemo.project;
-  DenemoStaff *curstaffstruct = (DenemoStaff *) gui->movement->currentstaff->data;
-  if (name)
-    g_string_assign (curstaffstruct->midi_instrument, name);
-}
-
-static void
-insert_rest_into_score (notetype length)
-{
-  DenemoProject *gui = Denemo.project;
-  gint i;
-
-  switch (length.notetype)
-    {
-    case 0:
-      insert_rest_0key (NULL, NULL);
-      break;
-    case 1:
-      insert_rest_1key (NULL, NULL);
-      break;
-    case 2:
-      insert_rest_2key (NULL, NULL);
-      break;
-    case 3:
-      insert_rest_3key (NULL, NULL);
-      break;
-    case 4:
-      insert_rest_4key (NULL, NULL);
-      break;
-    case 5:
-      insert_rest_5key (NULL, NULL);
-      break;
-    case 6:
-      insert_rest_6key (NULL, NULL);
-      break;
-    default:
-      insert_rest_2key (NULL, NULL);
-      break;
-    }
-  displayhelper (gui);
-
-  /* add dots */
-  for (i = 0; i < length.numofdots; i++)
-    add_dot_key (NULL, NULL);
-}
-
 static gint
 ConvertNoteType2ticks (gint ppqn, notetype * gnotetype)
 {
@@ -294,98 +188,6 @@ ConvertNoteType2ticks (gint ppqn, notetype * gnotetype)
   return ticks;
 }
 
-static void
-AddRest (gint ppqn, gint duration)
-{
-  gint rest;
-  gint ticks;
-  if (duration == 0)
-    return;
-  rest = duration;
-
-  while (rest)
-    {
-      notetype length;
-      ConvertLength (ppqn, rest, &length);
-      insert_rest_into_score (length);
-      ticks = ConvertNoteType2ticks (ppqn, &length);
-      rest -= ticks;
-    }
-}
-
-static void
-insert_note_into_score (gint pitch, notetype length)
-{
-  DenemoProject *gui = Denemo.project;
-  DenemoStaff *curstaffstruct = (DenemoStaff *) gui->movement->currentstaff->data;
-  gint i;
-
-  /* 0-8 accepted bellow */
-  DenemoScriptParam param;
-  highlight_duration (gui, length.notetype);
-
-  switch (length.notetype)
-    {
-    case 0:
-      insert_chord_0key (NULL, NULL);
-      break;
-    case 1:
-      insert_chord_1key (NULL, NULL);
-      break;
-    case 2:
-      insert_chord_2key (NULL, NULL);
-      break;
-    case 3:
-      insert_chord_3key (NULL, NULL);
-      break;
-    case 4:
-      insert_chord_4key (NULL, NULL);
-      break;
-    case 5:
-      insert_chord_5key (NULL, NULL);
-      break;
-    case 6:
-      insert_chord_6key (NULL, NULL);
-      break;
-    case 7:
-      insert_chord_7key (NULL, NULL);
-      break;
-    default:
-      insert_chord_8key (NULL, NULL);
-      g_warning ("Cannot handle size %d", length.notetype);
-      break;
-    }
-
-  score_status (gui, TRUE);
-  displayhelper (gui);
-
-  g_debug ("DenemoScriptParam = %d", param.status);
-  /* get correct note name */
-  gint key = curstaffstruct->keysig.number;
-  harmonic enote = enharmonic (pitch, (gint) key);
-  gchar *name = mid_c_offsettolily (enote.pitch, enote.enshift);
-
-  /* Rename note to the correct note */
-  gchar *accidental = g_strdup_printf ("(d-ChangeChordNotes \"%s\")", name);
-  call_out_to_guile (accidental);
-  g_free (accidental);
-  /* Add dots */
-  for (i = 0; i < length.numofdots; i++)
-    add_dot_key (NULL, NULL);
-
-  displayhelper (gui);
-}
-
-static void
-AddMidiNote (gint ppqn, gint pitch, gint duration)
-{
-  if (duration == 0)
-    return;
-  notetype length;
-  ConvertLength (ppqn, duration, &length);
-  insert_note_into_score (pitch, length);
-}
-
 static smf_t *
 cmd_load (gchar * file_name)
 {
@@ -403,319 +205,485 @@ cmd_load (gchar * file_name)
   return smf;
 }
 
-#define BUFFER_SIZE 1024
-
-void
-decode_metadata (const smf_event_t * event)
+/**
+ * extremely simple quantizer that rounds
+ * to the closest granule size
+ */
+static gint
+round2granule (gint tick)
 {
-  int off = 0, mspqn, flats, isminor;
-  char *buf;
-/*
-  static const char *const major_keys[] = { "Fb", "Cb", "Gb", "Db", "Ab",
-    "Eb", "Bb", "F", "C", "G", "D", "A", "E", "B", "F#", "C#", "G#"
-  };
-
-  static const char *const minor_keys[] = { "Dbm", "Abm", "Ebm", "Bbm", "Fm",
-    "Cm", "Gm", "Dm", "Am", "Em", "Bm", "F#m", "C#m", "G#m", "D#m", "A#m", "E#m"
-  };
-*/
-  //assert(smf_event_is_metadata(event));
-
-  switch (event->midi_buffer[1])
-    {
-    case TEXT:
-      //return smf_event_decode_textual(event, "Text");
-
-    case COPYRIGHT:
-      //return smf_event_decode_textual(event, "Copyright");
-
-    case META_TRACK_NAME:
-      //return smf_event_decode_textual(event, "Sequence/Track Name");
-      dotrackname (smf_event_extract_text (event));
-
-    case META_INSTR_NAME:
-      //printf("\nInstrument text = %s\n", smf_string_from_event(event));
-      doinstrname (smf_event_extract_text (event));
-    case 0x05:
-      //return smf_event_decode_textual(event, "Lyric");
-
-    case 0x06:
-      //return smf_event_decode_textual(event, "Marker");
-
-    case 0x07:
-      //return smf_event_decode_textual(event, "Cue Point");
+  gint smallestgrain = 48;
+  gdouble div = ((gdouble) tick / (gdouble) smallestgrain);
+  return smallestgrain * (gint) round (div);
+}
 
-    case 0x08:
-      //return smf_event_decode_textual(event, "Program Name");
+/* The importer builds the staffs, measures and chords of the movement directly from
+ * the note on/off pairs of each track, without going through the keyboard commands.
+ * The time and key signatures, usually all on the first track, apply to every staff.
+ * The tracks are built independently of each other and of the movement, in parallel
+ * where there is more than one, and attached to the movement in one step. */
 
-    case 0x09:
-      //return smf_event_decode_textual(event, "Device (Port) Name");
+/* a note of a track, from its note on to its note off, in quantized pulses */
+typedef struct MidiNote
+{
+  gint start;
+  gint end;
+  gint pitch;
+} MidiNote;
 
-    default:
-      break;
-    }
+/* a time signature of the file, from the measure it starts in */
+typedef struct MidiMeter
+{
+  gint start;                   /* the pulse of the barline it starts at */
+  gint measurenum;              /* the measure it starts, from 0 */
+  gint length;                  /* of its measures, in pulses */
+  gint time1;
+  gint time2;
+} MidiMeter;
+
+/* a key signature of the file, from the pulse it starts at */
+typedef struct MidiKey
+{
+  gint time;
+  gint number;
+  gint isminor;
+} MidiKey;
 
-  buf = malloc (BUFFER_SIZE);
-  if (buf == NULL)
-    {
-      g_critical ("smf_event_decode_metadata: malloc failed.");
-    }
+/* the staff being built from one track */
+typedef struct MidiTrackBuild
+{
+  smf_track_t *track;
+  DenemoStaff *staff;
+  gint ppqn;
+  GArray *meters;               /* the MidiMeters of the file, shared by all the tracks */
+  GArray *keys;                 /* the MidiKeys of the file, shared by all the tracks */
+  guint nextmeter;              /* the first of meters not yet written to the staff */
+  guint nextkey;                /* the first of keys not yet written to the staff */
+  gint keynumber;               /* the key prevailing, for spelling the notes */
+  GList *measures;              /* the completed DenemoMeasures, last measure first */
+  GList *objects;               /* the objects of the measure being filled, last object first */
+  gint measurenum;              /* number of the measure being filled, from 0 */
+  gint nummeasures;
+} MidiTrackBuild;
 
-  switch (event->midi_buffer[1])
+/**
+ * Set the name and instrument of staff and the tempo of si from the meta events of track.
+ * The time and key signatures apply to all the tracks, see read_signatures ().
+ */
+static void
+read_track_metadata (smf_track_t * track, DenemoStaff * staff, DenemoMovement * si)
+{
+  gint i;
+  for (i = 1; i <= track->number_of_events; i++)
     {
-    case 0x00:
-      off += snprintf (buf + off, BUFFER_SIZE - off, "Sequence number");
-      break;
-
-      /* http://music.columbia.edu/pipermail/music-dsp/2004-August/061196.html */
-    case 0x20:
-      if (event->midi_buffer_length < 4)
-        {
-          g_critical ("smf_event_decode_metadata: truncated MIDI message.");
-          goto error;
-        }
-
-      off += snprintf (buf + off, BUFFER_SIZE - off, "Channel Prefix: %d.", event->midi_buffer[3]);
-      break;
-
-    case 0x21:
-      if (event->midi_buffer_length < 4)
-        {
-          g_critical ("smf_event_decode_metadata: truncated MIDI message.");
-          goto error;
-        }
-
-      off += snprintf (buf + off, BUFFER_SIZE - off, "Midi Port: %d.", event->midi_buffer[3]);
-      break;
-
-    case 0x2F:
-      off += snprintf (buf + off, BUFFER_SIZE - off, "End Of Track");
-      break;
-
-    case META_TEMPO:
-      if (event->midi_buffer_length < 6)
+      smf_event_t *event = smf_track_get_event_by_number (track, i);
+      gchar *text;
+      if (!smf_event_is_metadata (event) || event->midi_buffer_length < 2)
+        continue;
+      switch (event->midi_buffer[1])
         {
-          g_critical ("smf_event_decode_metadata: truncated MIDI message.");
-          goto error;
+        case META_TRACK_NAME:
+          text = smf_event_extract_text (event);
+          if (text)
+            {
+              g_string_assign (staff->denemo_name, text);
+              set_lily_name (staff->denemo_name, staff->lily_name);
+            }
+          free (text);
+          break;
+        case META_INSTR_NAME:
+          text = smf_event_extract_text (event);
+          if (text)
+            g_string_assign (staff->midi_instrument, text);
+          free (text);
+          break;
+        case META_TEMPO:
+          if (event->midi_buffer_length >= 6)
+            {
+              gint mspqn = (event->midi_buffer[3] << 16) + (event->midi_buffer[4] << 8) + event->midi_buffer[5];
+              if (mspqn)
+                si->tempo = (gint) (6.0e7 / (double) mspqn);
+            }
+          break;
+        default:
+          break;
         }
+    }
+}
 
-      mspqn = (event->midi_buffer[3] << 16) + (event->midi_buffer[4] << 8) + event->midi_buffer[5];
-
-      dotempo (mspqn);
-
-      break;
+static gint
+compare_midi_keys (gconstpointer a, gconstpointer b)
+{
+  return ((const MidiKey *) a)->time - ((const MidiKey *) b)->time;
+}
 
-    case 0x54:
-      off += snprintf (buf + off, BUFFER_SIZE - off, "SMPTE Offset");
-      break;
+static gint
+compare_midi_meters (gconstpointer a, gconstpointer b)
+{
+  return ((const MidiMeter *) a)->start - ((const MidiMeter *) b)->start;
+}
 
-    case META_TIMESIG:
-      if (event->midi_buffer_length < 7)
-        {
-          g_critical ("smf_event_decode_metadata: truncated MIDI message.");
-          goto error;
-        }
+/* returns the meter of meters prevailing at the pulse time */
+static const MidiMeter *
+meter_at (GArray * meters, gint time)
+{
+  guint i;
+  for (i = 1; i < meters->len && g_array_index (meters, MidiMeter, i).start <= time; i++)
+    ;
+  return &g_array_index (meters, MidiMeter, i - 1);
+}
 
-      dotimesig (event->midi_buffer[3], (int) pow (2, event->midi_buffer[4]));
-      break;
+/* returns the measure, from 0, that the pulse time falls in */
+static gint
+measure_at (GArray * meters, gint time)
+{
+  const MidiMeter *meter = meter_at (meters, time);
+  return meter->measurenum + (time - meter->start) / meter->length;
+}
 
-    case META_KEYSIG:
-      if (event->midi_buffer_length < 5)
+/**
+ * Collects the time and key signatures of all the tracks of smf, which in a MIDI file apply to every track,
+ * into meters and keys in the order they come, starting with those prevailing at the start (4/4 and C major if none).
+ * A time signature not on a barline of the one before it starts at the next barline, and one signature replaces another at the same place.
+ */
+static void
+read_signatures (smf_t * smf, GArray * meters, GArray * keys)
+{
+  MidiMeter initialmeter = { 0, 0, 4 * smf->ppqn, 4, 4 };
+  MidiKey initialkey = { 0, 0, 0 };
+  GArray *events = g_array_new (FALSE, FALSE, sizeof (MidiMeter));
+  gint track;
+  guint i;
+  g_array_append_val (meters, initialmeter);
+  g_array_append_val (keys, initialkey);
+  for (track = 1; track <= smf->number_of_tracks; track++)
+    {
+      smf_track_t *thetrack = smf_get_track_by_number (smf, track);
+      gint j;
+      for (j = 1; j <= thetrack->number_of_events; j++)
         {
-          g_critical ("smf_event_decode_metadata: truncated MIDI message.");
-          goto error;
+          smf_event_t *event = smf_track_get_event_by_number (thetrack, j);
+          if (!smf_event_is_metadata (event) || event->midi_buffer_length < 2)
+            continue;
+          if (event->midi_buffer[1] == META_TIMESIG && event->midi_buffer_length >= 7 && event->midi_buffer[3] && event->midi_buffer[4] <= 6)
+            {
+              MidiMeter meter = { event->time_pulses, 0, 0, event->midi_buffer[3], 1 << event->midi_buffer[4] };
+              meter.length = MAX (1, 4 * smf->ppqn * meter.time1 / meter.time2);
+              g_array_append_val (events, meter);
+            }
+          else if (event->midi_buffer[1] == META_KEYSIG && event->midi_buffer_length >= 5 && (event->midi_buffer[4] == 0 || event->midi_buffer[4] == 1))
+            {
+              MidiKey key = { round2granule (event->time_pulses), event->midi_buffer[3], event->midi_buffer[4] };
+              if (key.number > 7)
+                key.number = key.number - 256;  /*get flat key num, see keysigdialog.cpp */
+              g_array_append_val (keys, key);
+            }
         }
-
-      flats = event->midi_buffer[3];
-      isminor = event->midi_buffer[4];
-
-      if (isminor != 0 && isminor != 1)
+    }
+  g_array_sort (events, compare_midi_meters);     /* stable, so that of two at the same place the later one wins */
+  for (i = 0; i < events->len; i++)
+    {
+      MidiMeter *meter = &g_array_index (events, MidiMeter, i);
+      MidiMeter *last = &g_array_index (meters, MidiMeter, meters->len - 1);
+      meter->measurenum = last->measurenum + (meter->start - last->start + last->length - 1) / last->length;
+      meter->start = last->start + (meter->measurenum - last->measurenum) * last->length;
+      if (meter->measurenum == last->measurenum)
+        *last = *meter;
+      else if (meter->time1 != last->time1 || meter->time2 != last->time2)
+        g_array_append_val (meters, *meter);
+    }
+  g_array_free (events, TRUE);
+  g_array_sort (keys, compare_midi_keys);       /* stable, so the initial C major is replaced by a key at the start */
+  for (i = 1; i < keys->len;)
+    {
+      MidiKey *key = &g_array_index (keys, MidiKey, i);
+      MidiKey *last = &g_array_index (keys, MidiKey, i - 1);
+      if (key->time == last->time)
         {
-          g_critical ("smf_event_decode_metadata: last byte of the Key Signature event has invalid value %d.", isminor);
-          goto error;
+          *last = *key;
+          g_array_remove_index (keys, i);
         }
-
-      dokeysig (isminor, flats);
-      break;
-
-    case 0x7F:
-      off += snprintf (buf + off, BUFFER_SIZE - off, "Proprietary (aka Sequencer) Event, length %d", event->midi_buffer_length);
-      break;
-
-    default:
-      goto error;
+      else if (key->number == last->number && key->isminor == last->isminor)
+        g_array_remove_index (keys, i);
+      else
+        i++;
     }
-
-error:
-  free (buf);
 }
 
-/**
- * extremely simple quantizer that rounds
- * to the closest granule size
- */
 static gint
-round2granule (gint tick)
+compare_midi_notes (gconstpointer a, gconstpointer b)
 {
-  gint smallestgrain = 48;
-  gdouble div = ((gdouble) tick / (gdouble) smallestgrain);
-  return smallestgrain * (gint) round (div);
+  const MidiNote *n1 = (const MidiNote *) a;
+  const MidiNote *n2 = (const MidiNote *) b;
+  if (n1->start != n2->start)
+    return n1->start - n2->start;
+  return n1->pitch - n2->pitch;
 }
 
-/**
- * Process note off command
- */
-void
-donoteoff (const smf_event_t * event)
+/* returns the notes of track, quantized and sorted by start */
+static GArray *
+collect_track_notes (smf_track_t * track)
 {
-  gint duration;
-  gint ppqn;
-
-  ppqn = event->track->smf->ppqn;
-  duration = event->delta_time_pulses;
-  duration = round2granule (duration);
-  AddMidiNote (ppqn, event->midi_buffer[1], duration);
+  GArray *notes = g_array_new (FALSE, FALSE, sizeof (MidiNote));
+  gint on[128];
+  gint i;
+  for (i = 0; i < 128; i++)
+    on[i] = -1;
+  for (i = 1; i <= track->number_of_events; i++)
+    {
+      smf_event_t *event = smf_track_get_event_by_number (track, i);
+      gint status, pitch, time;
+      if (smf_event_is_metadata (event) || event->midi_buffer_length < 3)
+        continue;
+      status = event->midi_buffer[0] & SYS_EXCLUSIVE_MESSAGE1;
+      if (status != NOTE_ON && status != NOTE_OFF)
+        continue;
+      pitch = event->midi_buffer[1] & 0x7F;
+      time = round2granule (event->time_pulses);
+      if (on[pitch] >= 0)
+        {                       /* a note off, or a note struck again before its note off */
+          if (time > on[pitch])
+            {
+              MidiNote note = { on[pitch], time, pitch };
+              g_array_append_val (notes, note);
+            }
+          on[pitch] = -1;
+        }
+      if (status == NOTE_ON && event->midi_buffer[2])
+        on[pitch] = time;
+    }
+  g_array_sort (notes, compare_midi_notes);
+  return notes;
 }
 
-/**
- * Process note on command
- */
-void
-donoteon (const smf_event_t * event)
+static void
+end_track_measure (MidiTrackBuild * build)
 {
-  gint ppqn;
-  ppqn = event->track->smf->ppqn;
-  if (event->delta_time_pulses)
-    AddRest (ppqn, round2granule (event->delta_time_pulses));
+  DenemoMeasure *measure = (DenemoMeasure *) g_malloc0 (sizeof (DenemoMeasure));
+  measure->objects = g_list_reverse (build->objects);
+  build->measures = g_list_prepend (build->measures, measure);
+  build->objects = NULL;
+  build->measurenum++;
+  build->nummeasures++;
 }
 
-void
-decode_midi_event (const smf_event_t * event)
+/* moves on to the measure that the pulse time falls in and writes the time and key signatures that start by then */
+static void
+append_signatures (MidiTrackBuild * build, gint time)
 {
-  gint channel;
-  gchar note[5];
-
-  /* + 1, because user-visible channels used to be in range <1-16>. */
-  channel = (event->midi_buffer[0] & 0x0F) + 1;
-
-  switch (event->midi_buffer[0] & SYS_EXCLUSIVE_MESSAGE1)
+  gint measurenum = measure_at (build->meters, time);
+  for (;;)
     {
-    case NOTE_OFF:
-      note_from_int (note, event->midi_buffer[1]);
-      g_debug ("\nNote Off channel %d note %s velocity %d\n", channel, note, event->midi_buffer[2]);
-      donoteoff (event);
-      break;
-
-    case NOTE_ON:
-      note_from_int (note, event->midi_buffer[1]);
-      g_debug ("\nNote On channel %d note %s velocity %d\n", channel, note, event->midi_buffer[2]);
-
-      if (event->midi_buffer[2])
-        donoteon (event);
-      else
-        donoteoff (event);
-      break;
-
-    case AFTERTOUCH:
-      note_from_int (note, event->midi_buffer[1]);
-      g_debug ("\nAftertouch channel %d note %s velocity %d\n", channel, note, event->midi_buffer[2]);
-      break;
-
-    case CTRL_CHANGE:
-      g_debug ("\nController channel %d controller %d value %d\n", channel, event->midi_buffer[1], event->midi_buffer[2]);
-      break;
-
-    case PGM_CHANGE:
-      g_debug ("\nProgram Change channel %d controller %d\n", channel, event->midi_buffer[1]);
-      break;
-
-    case CHNL_PRESSURE:
-      g_debug ("\nChannel Pressure channel %d pressure %d\n", channel, event->midi_buffer[1]);
-      break;
-
-    case PCH_WHEEL:
-      g_debug ("\nPitch Wheel channel %d value %d\n", channel, ((int) event->midi_buffer[2] << 7) | (int) event->midi_buffer[2]);
-      break;
-
-    default:
-      break;
+      if (build->objects == NULL && build->nextmeter < build->meters->len)
+        {
+          MidiMeter *meter = &g_array_index (build->meters, MidiMeter, build->nextmeter);
+          if (meter->measurenum == build->measurenum)
+            {
+              build->objects = g_list_prepend (build->objects, dnm_newtimesigobj (meter->time1, meter->time2));
+              build->nextmeter++;
+            }
+        }
+      if (build->measurenum == measurenum)
+        break;
+      end_track_measure (build);
+    }
+  for (; build->nextkey < build->keys->len && g_array_index (build->keys, MidiKey, build->nextkey).time <= time; build->nextkey++)
+    {
+      MidiKey *key = &g_array_index (build->keys, MidiKey, build->nextkey);
+      build->objects = g_list_prepend (build->objects, dnm_newkeyobj (key->number, key->isminor, 0));
+      build->keynumber = key->number;
     }
 }
 
-static int
-process_midi (smf_event_t * event)
+/* appends a chord of the pitches from notes[first] to notes[last], or a rest if first > last,
+ * lasting from start to end pulses, split at the barlines and into note values tied together */
+static void
+append_track_chords (MidiTrackBuild * build, GArray * notes, gint first, gint last, gint start, gint end)
 {
-  if (smf_event_is_metadata (event))
-    decode_metadata (event);
-  else
-    decode_midi_event (event);
-
-  return 0;
+  while (start < end)
+    {
+      const MidiMeter *meter = meter_at (build->meters, start);
+      gint measurenum = meter->measurenum + (start - meter->start) / meter->length;
+      gint barline = meter->start + (measurenum - meter->measurenum + 1) * meter->length;
+      gint duration = MIN (end, barline) - start;
+      while (duration > 0)
+        {
+          notetype length;
+          DenemoObject *obj;
+          gint ticks, i;
+          append_signatures (build, start);
+          ConvertLength (build->ppqn, duration, &length);
+          if (length.notetype > 8)
+            break;              /* shorter than can be written, drop it */
+          if (length.numofdots > 1)
+            length.numofdots = 1;
+          ticks = ConvertNoteType2ticks (build->ppqn, &length);
+          if (ticks <= 0)
+            break;
+          obj = dnm_newchord (length.notetype, length.numofdots, (first <= last) && (ticks < duration || barline < end));
+          obj->clef = &build->staff->clef;
+          obj->keysig = &build->staff->keysig;
+          for (i = first; i <= last; i++)
+            {
+              harmonic enote = enharmonic (g_array_index (notes, MidiNote, i).pitch, build->keynumber);
+              addtone_with_enshift (obj, enote.pitch, enote.enshift);
+            }
+          build->objects = g_list_prepend (build->objects, obj);
+          duration -= ticks;
+          start += ticks;
+        }
+      start = MIN (end, barline);
+    }
 }
 
-gint
-process_track (smf_track_t * track)
+/* builds the measures of build->staff from the notes of build->track.
+ * Notes starting together become one chord, lasting until the last of them ends or the next note starts.
+ * Touches nothing outside build, so tracks can be built in parallel */
+static void
+build_track (MidiTrackBuild * build)
 {
-  smf_event_t *event;
-  smf_t *smf = track->smf;      //tracks can't be processed except inside an smf_t so create one if needed
-  gboolean delete_smf_after = FALSE;
-  if (smf == NULL)
+  GArray *notes = collect_track_notes (build->track);
+  gint now = 0, i = 0;
+  while (i < (gint) notes->len)
     {
-      delete_smf_after = TRUE;
-      smf = smf_new ();
-      smf_add_track (smf, track);
-      smf_rewind (smf);
+      gint start = g_array_index (notes, MidiNote, i).start;
+      gint end = g_array_index (notes, MidiNote, i).end;
+      gint last = i;
+      while (last + 1 < (gint) notes->len && g_array_index (notes, MidiNote, last + 1).start == start)
+        {
+          last++;
+          end = MAX (end, g_array_index (notes, MidiNote, last).end);
+        }
+      if (last + 1 < (gint) notes->len)
+        end = MIN (end, g_array_index (notes, MidiNote, last + 1).start);
+      if (start > now)
+        append_track_chords (build, notes, 1, 0, now, start);  /* a rest up to the chord */
+      append_track_chords (build, notes, i, last, start, end);
+      now = end;
+      i = last + 1;
     }
-  while ((event = smf_track_get_next_event (track)) && event)
-    process_midi (event);
-  if (delete_smf_after)
+  /* signatures after the last note still start where they do, in empty measures if need be */
+  while (build->nextmeter < build->meters->len || build->nextkey < build->keys->len)
     {
-      smf_track_remove_from_smf (track);
-      smf_delete (smf);
+      gint time = G_MAXINT;
+      if (build->nextmeter < build->meters->len)
+        time = g_array_index (build->meters, MidiMeter, build->nextmeter).start;
+      if (build->nextkey < build->keys->len)
+        time = MIN (time, g_array_index (build->keys, MidiKey, build->nextkey).time);
+      append_signatures (build, time);
     }
-  return 1;
+  if (build->objects)
+    end_track_measure (build);
+  build->measures = g_list_reverse (build->measures);
+  g_array_free (notes, TRUE);
 }
 
-void
-AddStaff ()
+static void
+build_track_in_pool (gpointer data, G_GNUC_UNUSED gpointer user_data)
 {
-  call_out_to_guile ("(d-AddAfter)");
+  build_track ((MidiTrackBuild *) data);
 }
 
-static gint
-readtrack (smf_t * smf)
+/* builds all the tracks, in parallel (see run_jobs_in_pool ()) */
+static void
+build_tracks (MidiTrackBuild * builds, gint numtracks)
 {
-  smf_track_t *selected_track;
-  gint track;
-
-  smf_rewind (smf);
+  GPtrArray *jobs = g_ptr_array_sized_new (numtracks);
+  gint i;
+  for (i = 0; i < numtracks; i++)
+    g_ptr_array_add (jobs, &builds[i]);
+  run_jobs_in_pool (jobs, build_track_in_pool, NULL);
+  g_ptr_array_free (jobs, TRUE);
+}
 
-  for (track = 1; track <= smf->number_of_tracks; track++)
-    {
-      selected_track = smf_get_track_by_number (smf, track);
-      process_track (selected_track);
-      if (track + 1 <= smf->number_of_tracks)
-        AddStaff ();
-    }
-  return 0;
+/* appends a staff for a track to si, copying the clef, key and time signature of the last staff */
+static DenemoStaff *
+new_track_staff (DenemoMovement * si)
+{
+  DenemoStaff *staff = staff_new (Denemo.project, ADDFROMLOAD, DENEMO_NONE);
+  g_list_free_full (staff->themeasures, g_free);
+  staff->themeasures = NULL;
+  staff->nummeasures = 0;
+  staff_invalidate_measure_index (staff);
+  si->currentmeasure = NULL;
+  return staff;
 }
 
 gint
 importMidi (gchar * filename)
 {
   smf_t *smf;
-  gint ret = 0;                 // (-1 on failure)
+  DenemoMovement *si = Denemo.project->movement;
+  DenemoStaff *blank;
+  MidiTrackBuild *builds;
+  GArray *meters, *keys;
+  gint track, previous_staffnum;
   gboolean save = Denemo.prefs.immediateplayback;
-  Denemo.prefs.immediateplayback = FALSE;
   /* load the file */
   smf = cmd_load (filename);
   if (!smf)
     return -1;
-  /* Read Track Data */
-  if (readtrack (smf))
-    return -1;
-  /* Delete data...Does it free it? */
+  if (smf->number_of_tracks < 1 || smf->ppqn <= 0)
+    {
+      smf_delete (smf);
+      return -1;
+    }
+  Denemo.prefs.immediateplayback = FALSE;
+  take_snapshot ();             /* the whole import is one undo step */
+  si->undo_guard++;
+  blank = movement_blank_staff (si);
+  previous_staffnum = g_list_length (si->thescore);
+
+  meters = g_array_new (FALSE, FALSE, sizeof (MidiMeter));
+  keys = g_array_new (FALSE, FALSE, sizeof (MidiKey));
+  read_signatures (smf, meters, keys);
+  builds = g_new0 (MidiTrackBuild, smf->number_of_tracks);
+  for (track = 0; track < smf->number_of_tracks; track++)
+    {
+      MidiTrackBuild *build = &builds[track];
+      MidiMeter *meter = &g_array_index (meters, MidiMeter, 0);
+      MidiKey *key = &g_array_index (keys, MidiKey, 0);
+      build->track = smf_get_track_by_number (smf, track + 1);
+      build->staff = new_track_staff (si);
+      build->ppqn = smf->ppqn;
+      build->meters = meters;
+      build->keys = keys;
+      build->nextmeter = build->nextkey = 1;    /* the first ones are the staff's initial signatures */
+      build->keynumber = key->number;
+      build->staff->timesig.time1 = meter->time1;
+      build->staff->timesig.time2 = meter->time2;
+      build->staff->keysig.number = key->number;
+      build->staff->keysig.isminor = key->isminor;
+      initkeyaccs (build->staff->keysig.accs, key->number);
+      read_track_metadata (build->track, build->staff, si);
+    }
+  build_tracks (builds, smf->number_of_tracks);
+  g_array_free (meters, TRUE);
+  g_array_free (keys, TRUE);
+  for (track = 0; track < smf->number_of_tracks; track++)
+    {
+      builds[track].staff->themeasures = builds[track].measures;
+      builds[track].staff->nummeasures = builds[track].nummeasures;
+      staff_invalidate_measure_index (builds[track].staff);
+    }
+  g_free (builds);
   smf_delete (smf);
+
+  if (blank)
+    {
+      si->currentstaff = si->thescore;
+      si->currentstaffnum = 1;
+      staff_delete (Denemo.project, FALSE);
+      previous_staffnum = 0;
+    }
+  pad_movement_measures (si);
+  recache_movement (si);
+  si->currentstaff = g_list_nth (si->thescore, previous_staffnum) ? g_list_nth (si->thescore, previous_staffnum) : si->thescore;
+  si->currentstaffnum = 1 + g_list_position (si->thescore, si->currentstaff);
+  si->currentmeasurenum = 1;
+  setcurrents (si);
+  si->undo_guard--;
+  score_status (Denemo.project, TRUE);
   Denemo.prefs.immediateplayback = save;
-  return ret;
+  return 0;
 }
@@ -4,5 +4,4 @@ AJAnderson
 
 */
 #include "smf.h"
-gint process_track (smf_track_t * track);
 gint importMidi (gchar * filename);
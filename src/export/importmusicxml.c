@@ -14,6 +14,15 @@
 #include "export/file.h"
 #include "core/utils.h"
 #include "core/view.h"
+#include "core/cache.h"
+#include "command/chord.h"
+#include "command/commandfuncs.h"
+#include "command/contexts.h"
+#include "command/object.h"
+#include "command/score.h"
+#include "command/staff.h"
+#include "command/tuplet.h"
+#include "display/calculatepositions.h"
 
 /* libxml includes: for libxml2 this should be <libxml.h> */
 #include <libxml/parser.h>
@@ -83,30 +92,205 @@ getXMLIntChild (xmlNodePtr elem)
 
 
 
-#define INSERT_REST(num, den, rest) \
-if(duration >= (num*divisions)/den)\
-  {\
-    g_string_append (script, "(d-InsertRest" rest ")(d-SetNonprinting)");\
-    return insert_invisible_rest (script, duration - (num*divisions)/den, divisions);\
-  } else
+/* The importer builds the staffs, measures and chords of the movement directly.
+ * Markings which are implemented as scripts (articulations, ornaments, dynamics,
+ * text and barlines) are collected as MxmlMarkup and applied once the score
+ * has been built, see markups_to_script (). These commands exist only in Scheme,
+ * as do the upbeat, repeat barline and whole measure rest tidying run after them,
+ * so that one script stays; it no longer builds any of the music itself. */
+
+/* one Denemo staff being filled from a MusicXML voice */
+typedef struct MxmlVoice
+{
+  DenemoStaff *staff;
+  GList *measures;              /* the completed DenemoMeasures, last measure first */
+  GList *objects;               /* the objects of the measure being filled, last object first */
+  gint length;                  /* number of objects in the measure being filled */
+  gint measurenum;              /* number of the measure being filled, from 1 */
+  gint timing;                  /* ticks (in MusicXML divisions) filled so far in this measure */
+  DenemoObject *lastchord;      /* the chord that notes marked <chord/> are added to */
+} MxmlVoice;
+
+/* the voices of one <part> */
+typedef struct MxmlPart
+{
+  MxmlVoice *voices;
+  gint numvoices;
+  gint *staff_for_voice;
+  gint divisions;
+} MxmlPart;
+
+/* a script to be run on an object of the built score */
+typedef struct MxmlMarkup
+{
+  DenemoStaff *staff;
+  gint staffnum;
+  gint measurenum;
+  gint position;                /* object position from 1, or 0 for the end of the measure */
+  gboolean inserts;             /* the script inserts an object before the one at position */
+  gchar *script;
+} MxmlMarkup;
+
+static GList *Markups = NULL;   /* MxmlMarkup, most recent first */
+
+static void
+add_markup (MxmlVoice * voice, gint measurenum, gint position, gboolean inserts, const gchar * script)
+{
+  GList *g;
+  /* the notes of a chord each carry the same notations, apply them once */
+  for (g = Markups; g; g = g->next)
+    {
+      MxmlMarkup *m = (MxmlMarkup *) g->data;
+      if ((m->staff != voice->staff) || (m->measurenum != measurenum) || (m->position != position))
+        break;
+      if (!strcmp (m->script, script))
+        return;
+    }
+  MxmlMarkup *markup = (MxmlMarkup *) g_malloc0 (sizeof (MxmlMarkup));
+  markup->staff = voice->staff;
+  markup->measurenum = measurenum;
+  markup->position = position;
+  markup->inserts = inserts;
+  markup->script = g_strdup (script);
+  Markups = g_list_prepend (Markups, markup);
+}
+
+/* adds a markup for the last object put in voice */
+static void
+add_markup_to_voice (MxmlVoice * voice, const gchar * script)
+{
+  if (voice->length)
+    add_markup (voice, voice->measurenum, voice->length, FALSE, script);
+}
 
 static gint
-insert_invisible_rest (GString * script, gint duration, gint divisions)
+markup_column (const MxmlMarkup * m)
 {
-  //g_assert (divisions);
-  if (duration == 0)
-    return TRUE;
-  //g_debug("invis rest  %d, %d\n",  duration, divisions);
-  INSERT_REST (4, 1, "0") INSERT_REST (2, 1, "1") INSERT_REST (1, 1, "2") INSERT_REST (1, 2, "3") INSERT_REST (1, 4, "4") INSERT_REST (1, 8, "5") INSERT_REST (1, 16, "6") INSERT_REST (1, 32, "7") INSERT_REST (1, 64, "8") g_warning ("Cannot cope with rest of %d/%d quarter notes", duration, divisions);
-  return FALSE;
+  return m->position ? m->position : G_MAXINT;
 }
 
-#undef INSERT_REST
+/* markups are applied staff by staff, measure by measure and right to left within the measure
+ * so that an inserted object does not move the positions still to be visited */
+static gint
+compare_markups (gconstpointer a, gconstpointer b)
+{
+  const MxmlMarkup *m1 = (const MxmlMarkup *) a;
+  const MxmlMarkup *m2 = (const MxmlMarkup *) b;
+  if (m1->staffnum != m2->staffnum)
+    return m1->staffnum - m2->staffnum;
+  if (m1->measurenum != m2->measurenum)
+    return m1->measurenum - m2->measurenum;
+  if (markup_column (m1) != markup_column (m2))
+    return markup_column (m1) > markup_column (m2) ? -1 : 1;
+  return m1->inserts - m2->inserts;
+}
 
+static void
+free_markup (MxmlMarkup * markup)
+{
+  g_free (markup->script);
+  g_free (markup);
+}
 
+static void
+markups_to_script (DenemoMovement * si, GString * script)
+{
+  GList *g;
+  Markups = g_list_reverse (Markups);
+  for (g = Markups; g; g = g->next)
+    {
+      MxmlMarkup *m = (MxmlMarkup *) g->data;
+      m->staffnum = 1 + g_list_index (si->thescore, m->staff);
+    }
+  Markups = g_list_sort (Markups, compare_markups);
+  for (g = Markups; g; g = g->next)
+    {
+      MxmlMarkup *m = (MxmlMarkup *) g->data;
+      if (m->position)
+        g_string_append_printf (script, "(if (d-GoToPosition #f %d %d %d) (begin %s))\n", m->staffnum, m->measurenum, m->position, m->script);
+      else
+        g_string_append_printf (script, "(if (d-GoToPosition #f %d %d 1) (begin (GoToMeasureEnd) %s))\n", m->staffnum, m->measurenum, m->script);
+    }
+  g_list_free_full (Markups, (GDestroyNotify) free_markup);
+  Markups = NULL;
+}
 
 static void
-parse_time (GString ** scripts, gint numvoices, gint measurenum, xmlNodePtr rootElem)
+append_object (MxmlVoice * voice, DenemoObject * obj)
+{
+  voice->objects = g_list_prepend (voice->objects, obj);
+  voice->length++;
+}
+
+/* returns the last object put in voice, with its measure number and position, or NULL if none */
+static DenemoObject *
+last_object (MxmlVoice * voice, gint * measurenum, gint * position)
+{
+  if (voice->objects)
+    {
+      *measurenum = voice->measurenum;
+      *position = voice->length;
+      return (DenemoObject *) voice->objects->data;
+    }
+  if (voice->measures && ((DenemoMeasure *) voice->measures->data)->objects)
+    {
+      GList *objects = ((DenemoMeasure *) voice->measures->data)->objects;
+      *measurenum = voice->measurenum - 1;
+      *position = g_list_length (objects);
+      return (DenemoObject *) g_list_last (objects)->data;
+    }
+  return NULL;
+}
+
+static void
+end_measure (MxmlVoice * voice)
+{
+  DenemoMeasure *measure = (DenemoMeasure *) g_malloc0 (sizeof (DenemoMeasure));
+  measure->objects = g_list_reverse (voice->objects);
+  voice->measures = g_list_prepend (voice->measures, measure);
+  voice->objects = NULL;
+  voice->length = 0;
+  voice->timing = 0;
+  voice->lastchord = NULL;
+  voice->measurenum++;
+}
+
+static DenemoObject *
+append_rest (MxmlVoice * voice, gint baseduration, gint numdots, gboolean invisible)
+{
+  DenemoObject *rest = dnm_newchord (baseduration, numdots, FALSE);
+  rest->isinvisible = invisible;
+  append_object (voice, rest);
+  return rest;
+}
+
+/* appends rests filling duration, returning the last one appended or NULL if none */
+static DenemoObject *
+append_rests (MxmlVoice * voice, gint duration, gint divisions, gboolean invisible)
+{
+  DenemoObject *rest = NULL;
+  gint baseduration;
+  //g_debug("Rest duration %d, divisions %d\n", duration, divisions);
+  for (baseduration = 0; (baseduration <= 8) && (duration > 0); baseduration++)
+    {
+      gint ticks = (4 * divisions) / (1 << baseduration);
+      if (ticks == 0)
+        break;
+      while (duration >= ticks)
+        {
+          rest = append_rest (voice, baseduration, 0, invisible);
+          duration -= ticks;
+        }
+    }
+  if (duration > 0)
+    g_warning ("Cannot cope with rest of %d/%d quarter notes", duration, divisions);
+  return rest;
+}
+
+
+
+static void
+parse_time (MxmlPart * part, gint measurenum, xmlNodePtr rootElem)
 {
   xmlNodePtr childElem;
   gint numerator = 0, denominator = 0;
@@ -120,70 +304,88 @@ parse_time (GString ** scripts, gint numvoices, gint measurenum, xmlNodePtr root
       denominator = getXMLIntChild (childElem);
   }
   if (numerator && denominator)
-    for (i = 0; i < numvoices; i++)
+    for (i = 0; i < part->numvoices; i++)
       if (measurenum == 1)
-        g_string_append_printf (scripts[i + 1], "(d-InitialTimeSig \"%d/%d\")", numerator, denominator);
+        {
+          timesig *initial = &part->voices[i].staff->timesig;
+          initial->time1 = numerator;
+          initial->time2 = denominator;
+        }
       else
-        g_string_append_printf (scripts[i + 1], "(d-InsertTimeSig \"%d/%d\")(if (not (Appending?))(d-MoveCursorRight))", numerator, denominator);
+        append_object (&part->voices[i], dnm_newtimesigobj (numerator, denominator));
 }
 
-const gchar *
+static enum clefs
 get_clef (gint line, gchar * sign)
 {
   switch (line)
     {
     case 1:
       if (*sign == 'G')
-        return "French";
+        return DENEMO_FRENCH_CLEF;
     case 2:
       if (*sign == 'G')
-        return "Treble";
+        return DENEMO_TREBLE_CLEF;
     case 3:
       if (*sign == 'C')
-        return "Alto";
+        return DENEMO_ALTO_CLEF;
     case 4:
       if (*sign == 'F')
-        return "Bass";
+        return DENEMO_BASS_CLEF;
       if (*sign == 'C')
-        return "Tenor";
+        return DENEMO_TENOR_CLEF;
     default:
-      return "Treble";
+      return DENEMO_TREBLE_CLEF;
     }
 
 }
 
 static void
-parse_key (GString ** scripts, gint numvoices, gint measurenum, xmlNodePtr rootElem)
+parse_key (MxmlPart * part, gint measurenum, xmlNodePtr rootElem)
 {
   xmlNodePtr childElem;
   gint fifths = 0;
-  gchar *mode = NULL;
+  gboolean has_fifths = FALSE;
+  gboolean isminor = FALSE;
   gint i;
   FOREACH_CHILD_ELEM (childElem, rootElem)
   {
 
     if (ELEM_NAME_EQ (childElem, "fifths"))
-      fifths = getXMLIntChild (childElem);
+      {
+        fifths = getXMLIntChild (childElem);
+        has_fifths = (fifths != G_MAXINT);
+      }
     if (ELEM_NAME_EQ (childElem, "mode"))
-      mode = xmlNodeListGetString (childElem->doc, childElem->xmlChildrenNode, 1);
+      {
+        gchar *mode = (gchar *) xmlNodeListGetString (childElem->doc, childElem->xmlChildrenNode, 1);
+        //Denemo keeps the number of sharps for a minor key too. The church modes are imported with the signature they are written with, as major keys.
+        isminor = (mode && !strcmp (mode, "minor"));
+        g_free (mode);
+      }
   }
-  if (mode)
-    for (i = 0; i < numvoices; i++)
+  if (has_fifths)
+    for (i = 0; i < part->numvoices; i++)
       if (measurenum == 1)
-        g_string_append_printf (scripts[i + 1], "(d-InitialKey \"C major\")(d-IncrementKeysig %d)", fifths);
+        {
+          keysig *initial = &part->voices[i].staff->keysig;
+          initial->number = fifths;
+          initial->isminor = isminor;
+          initkeyaccs (initial->accs, fifths);
+        }
       else
-        g_string_append_printf (scripts[i + 1], "(d-InsertKey \"C major\")(d-IncrementKeysig %d)", fifths);
- g_free (mode);
+        append_object (&part->voices[i], dnm_newkeyobj (fifths, isminor, 0));
 }
 
 static void
-parse_clef (GString ** scripts, gint division, gint * voice_timings, gint voicenum, gint numvoices, gint * staff_for_voice, gint divisions, gint measurenum, xmlNodePtr rootElem)
+parse_clef (MxmlPart * part, gint division, gint voicenum, gint measurenum, xmlNodePtr rootElem)
 {
   xmlNodePtr childElem;
   gint line = 0;
   gchar *sign = NULL;
   gchar *number = xmlGetProp (rootElem, (xmlChar *) "number");
   gint staffnum = 0;
+  MxmlVoice *voice = &part->voices[voicenum - 1];
   if (number)
     staffnum = atoi (number);
   if (staffnum == 0)
@@ -195,143 +397,102 @@ parse_clef (GString ** scripts, gint division, gint * voice_timings, gint voicen
     if (ELEM_NAME_EQ (childElem, "sign"))
       sign = xmlNodeListGetString (childElem->doc, childElem->xmlChildrenNode, 1);
   }                             //g_assert(voicenum>0);
-  if (division > voice_timings[voicenum - 1])
+  if (division > voice->timing)
     {
-      insert_invisible_rest (scripts[voicenum], division - voice_timings[voicenum - 1], divisions);
-      voice_timings[voicenum - 1] = division;
+      append_rests (voice, division - voice->timing, part->divisions, TRUE);
+      voice->timing = division;
     }
   if (sign)
     {
       gint i;
-      const gchar *clef = get_clef (line, sign);
-      for (i = 0; i < numvoices; i++)
+      enum clefs type = get_clef (line, sign);
+      for (i = 0; i < part->numvoices; i++)
         {
-          if (staff_for_voice[i] == staffnum)
+          if (part->staff_for_voice[i] == staffnum)
             if (measurenum == 1)
-              g_string_append_printf (scripts[i + 1], "(d-InitialClef \"%s\")", clef);
+              part->voices[i].staff->clef.type = type;
             else
-              g_string_append_printf (scripts[i + 1], "(d-InsertClef \"%s\")", clef);
+              append_object (&part->voices[i], clef_new (type));
         }
     }
     g_free (sign);
+    g_free (number);
 }
 
-static const gchar *
-alteration (gint alter)
-{
-  switch (alter)
-    {
-    case -2:
-      return "eses";
-    case -1:
-      return "es";
-    case 1:
-      return "is";
-    case 2:
-      return "isis";
-    default:
-      return "";
-    }
-}
-
-static const gchar *
-octave_string (gint octave)
-{
-
-  gchar *octavation;
-  switch (octave)
-    {
-    case 0:
-      octavation = ",,,";
-      break;
-    case 1:
-      octavation = ",,";
-      break;
-    case 2:
-      octavation = ",";
-      break;
-    case 3:
-      octavation = "";
-      break;
-    case 4:
-      octavation = "'";
-      break;
-    case 5:
-      octavation = "''";
-      break;
-
-    case 6:
-      octavation = "'''";
-      break;
-
-    case 7:
-      octavation = "''''";
-      break;
-
-    case 8:
-      octavation = "'''''";
-      break;
-
-    case 9:
-      octavation = "''''''";
-      break;
-
-    default:
-      octavation = "%{duration not implemented%}";
-      break;
-    }
-  return octavation;
-}
-
-static gchar *
-insert_note (gchar * type, gint octave, gchar * step, gint alter)
+/* returns the Denemo duration for a MusicXML note type, with breve and longa given as whole notes */
+static gint
+get_baseduration (gchar * type)
 {
-  if (step == NULL)
-    {
-      g_warning ("Note without step");
-      return g_strdup ("");
-    }
-  gchar *duration_text = "";
   if (!strcmp (type, "whole"))
-    duration_text = "\n(d-Set0)";
+    return 0;
   else if (!strcmp (type, "half"))
-    duration_text = "\n(d-Set1)";
+    return 1;
   else if (!strcmp (type, "quarter"))
-    duration_text = "\n(d-Set2)";
+    return 2;
   else if (!strcmp (type, "eighth"))
-    duration_text = "\n(d-Set3)";
+    return 3;
   else if (!strcmp (type, "16th"))
-    duration_text = "\n(d-Set4)";
+    return 4;
   else if (!strcmp (type, "32nd"))
-    duration_text = "\n(d-Set5)";
+    return 5;
   else if (!strcmp (type, "64th"))
-    duration_text = "\n(d-Set6)";
+    return 6;
   else if (!strcmp (type, "128th"))
-    duration_text = "\n(d-Set7)";
+    return 7;
   else if (!strcmp (type, "256th"))
-    duration_text = "\n(d-Set8)";
-  else if (!strcmp (type, "breve"))
-    duration_text = "\n(d-SetBreve)";
+    return 8;
+  else if (!strcmp (type, "breve") || !strcmp (type, "longa"))
+    return 0;
+  g_warning ("Note duration %s not implemented", type);
+  return 2;
+}
+
+/* marks the object just appended to voice as a breve or longa if type calls for it */
+static void
+mark_long_duration (MxmlVoice * voice, gchar * type)
+{
+  if (!strcmp (type, "breve"))
+    add_markup_to_voice (voice, "(d-ChangeBreve)");
   else if (!strcmp (type, "longa"))
-    duration_text = "\n(d-SetLonga)";
-  else
-    g_warning ("Note duration %s not implemented", type);
-  const gchar *octavation = octave_string (octave);
-  gchar *put_text = g_strdup_printf ("(d-InsertC)(d-PutNoteName \"%c%s%s\")", g_ascii_tolower (*step), alteration (alter), octavation);
-  GString *ret = g_string_new (duration_text);
-  g_string_append (ret, put_text);
+    add_markup_to_voice (voice, "(d-ChangeLonga)");
+}
 
-  return g_string_free (ret, FALSE);
+static gint
+mid_c_offset (gint octave, gchar * step)
+{
+  static const gchar *steps = "CDEFGAB";
+  const gchar *found = strchr (steps, g_ascii_toupper (*step));
+  return 7 * (octave - 4) + (found ? (found - steps) : 0);
 }
 
-static gchar *
-add_note (gint octave, gchar * step, gint alter)
-{                               // d-InsertNoteInChord lily (d-ShiftCursor is relative (d-MoveTo ????
-  const gchar *octavation = octave_string (octave);
-  gchar *text = g_strdup_printf ("(d-InsertNoteInChord \"%c%s%s\")", g_ascii_tolower (*step), alteration (alter), octavation);
-  GString *ret = g_string_new (text);
-  g_free (text);
-  return g_string_free (ret, FALSE);
+static DenemoObject *
+insert_note (MxmlVoice * voice, gchar * type, gint numdots, gint octave, gchar * step, gint alter)
+{
+  if (step == NULL)
+    {
+      g_warning ("Note without step");
+      return NULL;
+    }
+  DenemoObject *thechord = dnm_newchord (get_baseduration (type), numdots, FALSE);
+  thechord->clef = &voice->staff->clef;  //the note heights are fixed up when the movement is recached
+  thechord->keysig = &voice->staff->keysig;
+  addtone (thechord, mid_c_offset (octave, step), alter);
+  append_object (voice, thechord);
+  mark_long_duration (voice, type);
+  voice->lastchord = thechord;
+  return thechord;
+}
+
+static DenemoObject *
+add_note (MxmlVoice * voice, gint octave, gchar * step, gint alter)
+{
+  if ((step == NULL) || (voice->lastchord == NULL))
+    {
+      g_warning ("Chord note without a chord to add it to");
+      return NULL;
+    }
+  addtone (voice->lastchord, mid_c_offset (octave, step), alter);
+  return voice->lastchord;
 }
 
 static void
@@ -393,103 +554,16 @@ parseDuration (gint * current_voice, xmlNodePtr rootElem)
   return duration;
 }
 
-static void
-get_rest_for_duration (GString * ret, gint duration, gint divisions)
-{
-  //g_debug("Rest duration %d, divisions %d\n", duration, divisions);
-  if (duration >= 4 * divisions)
-    {
-      g_string_append (ret, "(d-InsertRest0)");
-      duration -= 4 * divisions;
-      return get_rest_for_duration (ret, duration, divisions);
-    }
-  else if (duration >= 2 * divisions)
-    {
-      g_string_append (ret, "(d-InsertRest1)");
-      duration -= 2 * divisions;
-      return get_rest_for_duration (ret, duration, divisions);
-    }
-  else if (duration >= 1 * divisions)
-    {
-      g_string_append (ret, "(d-InsertRest2)");
-      duration -= 1 * divisions;
-      return get_rest_for_duration (ret, duration, divisions);
-    }
-  else if (2 * duration >= divisions && (divisions / 2))
-    {
-      g_string_append (ret, "(d-InsertRest3)");
-      duration -= divisions / 2;
-      return get_rest_for_duration (ret, duration, divisions);
-    }
-  else if (4 * duration >= divisions && (divisions / 4))
-    {
-      g_string_append (ret, "(d-InsertRest4)");
-      duration -= divisions / 4;
-      return get_rest_for_duration (ret, duration, divisions);
-    }
-  else if (8 * duration >= divisions && (divisions / 8))
-    {
-      g_string_append (ret, "(d-InsertRest5)");
-      duration -= divisions / 8;
-      return get_rest_for_duration (ret, duration, divisions);
-    }
-  else if (16 * duration >= divisions && (divisions / 16))
-    {
-      g_string_append (ret, "(d-InsertRest6)");
-      duration -= divisions / 16;
-      return get_rest_for_duration (ret, duration, divisions);
-    }
-  else if (32 * duration >= divisions && (divisions / 32))
-    {
-      g_string_append (ret, "(d-InsertRest7)");
-      duration -= divisions / 32;
-      return get_rest_for_duration (ret, duration, divisions);
-    }
-  else if (duration == 0)
-    return;
-
-  g_string_append (ret, "\n;Duration of rest not recognized\n");
-}
-
-
-static gchar *
-add_rest (gchar * type, gint duration, gint divisions)
+static DenemoObject *
+add_rest (MxmlVoice * voice, gchar * type, gint numdots, gint duration, gint divisions)
 {
-  gchar *duration_text = "";
-  if (!strcmp (type, "whole"))
-    {
-      if (4 * divisions == duration)
-        duration_text = "(d-InsertRest0)";
-      else
-        {
-          GString *ret = g_string_new ("");
-          get_rest_for_duration (ret, duration, divisions);
-          return g_string_free (ret, FALSE);
-        }
-    }
-  else if (!strcmp (type, "half"))
-    duration_text = "(d-InsertRest1)";
-  else if (!strcmp (type, "quarter"))
-    duration_text = "(d-InsertRest2)";
-  else if (!strcmp (type, "eighth"))
-    duration_text = "(d-InsertRest3)";
-  else if (!strcmp (type, "16th"))
-    duration_text = "(d-InsertRest4)";
-  else if (!strcmp (type, "32nd"))
-    duration_text = "(d-InsertRest5)";
-  else if (!strcmp (type, "64th"))
-    duration_text = "(d-InsertRest6)";
-  else if (!strcmp (type, "128th"))
-    duration_text = "(d-InsertRest7)";
-  else if (!strcmp (type, "256th"))
-    duration_text = "(d-InsertRest8)";
-  else if (!strcmp (type, "breve"))
-    duration_text = "(d-InsertBreveRest)";
-  else if (!strcmp (type, "longa"))
-    duration_text = "(d-InsertLongaRest)";
-  else
-    g_warning ("Restduration %s not implemented", type);
-  return g_strdup (duration_text);
+  gint baseduration;
+  if (!strcmp (type, "whole") && (4 * divisions != duration))
+    return append_rests (voice, duration, divisions, FALSE);
+  baseduration = get_baseduration (type);
+  DenemoObject *rest = append_rest (voice, baseduration, numdots, FALSE);
+  mark_long_duration (voice, type);
+  return rest;
 }
 
 static void
@@ -509,85 +583,86 @@ modify_time (xmlNodePtr rootElem, gint * actual_notes, gint * normal_notes)
 
 
 static void
-parse_ornaments (GString * notations, xmlNodePtr rootElem)
+parse_ornaments (MxmlVoice * voice, xmlNodePtr rootElem)
 {
   xmlNodePtr childElem;
   FOREACH_CHILD_ELEM (childElem, rootElem)
   {
     if (ELEM_NAME_EQ (childElem, "trill-mark"))
       {
-        g_string_append (notations, "(d-ToggleTrill)");
+        add_markup_to_voice (voice, "(d-ToggleTrill)");
       }
     if (ELEM_NAME_EQ (childElem, "turn"))
       {
-        g_string_append (notations, "(d-ToggleTurn)");
+        add_markup_to_voice (voice, "(d-ToggleTurn)");
       }
   }
 }
 
 static void
-parse_articulations (GString * notations, xmlNodePtr rootElem)
+parse_articulations (MxmlVoice * voice, xmlNodePtr rootElem)
 {
   xmlNodePtr childElem;
   FOREACH_CHILD_ELEM (childElem, rootElem)
   {
     if (ELEM_NAME_EQ (childElem, "staccato"))
-      g_string_append (notations, "(d-ToggleStaccato)");
+      add_markup_to_voice (voice, "(d-ToggleStaccato)");
     if (ELEM_NAME_EQ (childElem, "staccatissimo"))
-      g_string_append (notations, "(d-ToggleStaccatissimo)");
+      add_markup_to_voice (voice, "(d-ToggleStaccatissimo)");
   }
 }
 
+/* applies the notations to thechord, which is the last object in voice */
 static void
-parse_notations (GString * notations, xmlNodePtr rootElem)
+parse_notations (MxmlVoice * voice, chord * thechord, xmlNodePtr rootElem)
 {
   xmlNodePtr childElem;
   FOREACH_CHILD_ELEM (childElem, rootElem)
   {
     if (ELEM_NAME_EQ (childElem, "articulations"))
       {
-        parse_articulations (notations, childElem);
+        parse_articulations (voice, childElem);
       }
     if (ELEM_NAME_EQ (childElem, "slur"))
       {
         gchar *type = xmlGetProp (childElem, (xmlChar *) "type");
 
         if (type && (!strcmp (type, "start")))
-          g_string_append (notations, "(d-ToggleBeginSlur)");
+          thechord->slur_begin_p = TRUE;
         if (type && (!strcmp (type, "stop")))
-          g_string_append (notations, "(d-ToggleEndSlur)");
+          thechord->slur_end_p = TRUE;
+        g_free (type);
       }
 
     if (ELEM_NAME_EQ (childElem, "fermata"))
       {
-        g_string_append (notations, "(d-ToggleFermata)");
+        add_markup_to_voice (voice, "(d-ToggleFermata)");
       }
-    //  I think we need functions to apply that aren't toggles.
 //note tuplets will be ignored, we will depend on the timing changes (as at present), since tuplet start/end is a separate object which once inserted prevents us seeing the note/chord
 
     if (ELEM_NAME_EQ (childElem, "ornaments"))
-      parse_ornaments (notations, childElem);
+      parse_ornaments (voice, childElem);
   }
 }
 
 
 // *division is the current position of the tick counter from the start of the measure
 static gchar *
-parse_note (xmlNodePtr rootElem, GString ** scripts, gint * staff_for_voice, gint * division, gint divisions, gint * voice_timings, gint * current_voice, gint * actual_notes, gint * normal_notes, gboolean is_nonprinting)
+parse_note (xmlNodePtr rootElem, MxmlPart * part, gint * division, gint * current_voice, gint * actual_notes, gint * normal_notes, gboolean is_nonprinting)
 {
   GString *ret = g_string_new ("");
   xmlNodePtr childElem;
-  gint octave, alter = 0;
+  gint octave = 4, alter = 0;
   gchar *step = NULL;
   gchar *type = NULL;
-  gboolean in_chord = FALSE, is_dotted = FALSE, is_double_dotted = FALSE, is_rest = FALSE, is_whole_measure_rest = FALSE, is_grace = FALSE, is_tied = FALSE;
-  GString *notations = g_string_new ("");
+  gboolean in_chord = FALSE, is_rest = FALSE, is_grace = FALSE, is_tied = FALSE;
+  gint numdots = 0;
   gint voicenum = 1, staffnum = 1;
   gint duration = 0;
   gint initial_actual_notes = *actual_notes;
   gint initial_normal_notes = *normal_notes;
   gboolean timing_set = FALSE;  //for case where one voice ends during a tuplet and the next one starts during a tuplet
-  GString *text = g_string_new ("");
+  DenemoObject *obj = NULL;
   FOREACH_CHILD_ELEM (childElem, rootElem)
   {
     if (ELEM_NAME_EQ (childElem, "pitch"))
@@ -614,14 +689,10 @@ parse_note (xmlNodePtr rootElem, GString ** scripts, gint * staff_for_voice, gin
     if (ELEM_NAME_EQ (childElem, "rest"))
       {
         is_rest = TRUE;
-        gchar *whole  = xmlGetProp (childElem, (xmlChar *) "measure");
-        is_whole_measure_rest = !g_strcmp0 (whole , "yes");
       }
     if (ELEM_NAME_EQ (childElem, "dot"))
       {
-        if (is_dotted)
-          is_double_dotted = TRUE;
-        is_dotted = TRUE;
+        numdots++;
       }
 
     if (ELEM_NAME_EQ (childElem, "tie"))
@@ -629,6 +700,7 @@ parse_note (xmlNodePtr rootElem, GString ** scripts, gint * staff_for_voice, gin
         gchar *start = xmlGetProp (childElem, (xmlChar *) "type");
         if (start && !strcmp ("start", start))
           is_tied = TRUE;
+        g_free (start);
       }
 
     if (ELEM_NAME_EQ (childElem, "type"))
@@ -642,15 +714,6 @@ parse_note (xmlNodePtr rootElem, GString ** scripts, gint * staff_for_voice, gin
       voicenum = getXMLIntChild (childElem);
     if (ELEM_NAME_EQ (childElem, "staff"))
       staffnum = getXMLIntChild (childElem);
-/*
-               <notations>
-                <tuplet number="1" type="stop"/>
-                </notations>
-*/
-    if (ELEM_NAME_EQ (childElem, "notations"))
-      {
-        parse_notations (notations, childElem);
-      }
 
     if (ELEM_NAME_EQ (childElem, "time-modification"))
       {
@@ -658,9 +721,9 @@ parse_note (xmlNodePtr rootElem, GString ** scripts, gint * staff_for_voice, gin
         modify_time (childElem, actual_notes, normal_notes);
       }
   }
-  if (voicenum < 1)
+  if ((voicenum < 1) || (voicenum > part->numvoices))
     {
-      g_warning ("Bad MusicXML file voice 0 encountered");
+      g_warning ("Bad MusicXML file voice %d encountered", voicenum);
       voicenum = 1;
     }
   if (staffnum < 1)
@@ -668,64 +731,21 @@ parse_note (xmlNodePtr rootElem, GString ** scripts, gint * staff_for_voice, gin
       g_warning ("Bad MusicXML file staff 0 encountered");
       staffnum = 1;
     }
-  if (staff_for_voice[voicenum - 1] == 0)
-    staff_for_voice[voicenum - 1] = staffnum;
+  if (part->staff_for_voice[voicenum - 1] == 0)
+    part->staff_for_voice[voicenum - 1] = staffnum;
+  MxmlVoice *voice = &part->voices[voicenum - 1];
 
-#ifdef FIXED_PROBLEM_WITH_VOICE_CHANGE_IN_CHORDS
-// PROBLEM - this inserts an object which will come before inserting notes in a chord...
-// Do we need a command to add a note to a chord which works in this position???? otherwise it's like tuplets.
-  if (!in_chord && (staff_for_voice[voicenum - 1] != staffnum))
-    {
-      g_string_append_printf (scripts[voicenum], "(d-ChangeStaff \"voice %d\")(d-MoveCursorRight)", staffnum + InitialVoiceNum);        //always at end of bar !!!!!!!!!!! voice 1 staff 1 in debmand example.
-      staff_for_voice[voicenum - 1] = staffnum;
-      // g_warning("Voice %d in staff %d + %d need a staff change directive", voicenum, staffnum, InitialVoiceNum);
-    }
-#else
-  if (!in_chord && (staff_for_voice[voicenum - 1] != staffnum))
+  if (!in_chord && (part->staff_for_voice[voicenum - 1] != staffnum))
     {
       g_string_append (ret, "Change Staff Omitted ");
     }
-#endif
 
-
-  if (*division > voice_timings[voicenum - 1])
-    {
-      insert_invisible_rest (scripts[voicenum], *division - voice_timings[voicenum - 1], divisions);
-      voice_timings[voicenum - 1] = *division;
-    }
-
-  if (type)
+  if (*division > voice->timing)
     {
-
-            g_string_append (text, in_chord ? add_note (octave, step, alter) : (is_rest ? add_rest (type, duration, divisions) : insert_note (type, octave, step, alter)));
-
-      if (is_nonprinting)
-        g_string_append (text, "(d-SetNonprinting)");
-      if (!(in_chord || is_grace))
-        voice_timings[voicenum - 1] += duration;
-      if (is_tied && !in_chord)
-        g_string_append (text, "(d-ToggleTie)");
-      if (is_grace)
-        g_string_append (text, "(d-ToggleGrace)");
-      if ((!in_chord) && is_dotted)
-        g_string_append (text, "(d-AddDot)");
-      if (is_double_dotted)
-        g_string_append (text, "(d-AddDot)");
-
-
-    }
-  else if (is_rest)
-    {                           //for the case where a rest is given without a type, just a duration.
-     if(is_whole_measure_rest)
-            g_string_append (text, "(d-InsertWholeMeasureRest)(d-MoveCursorLeft)");
-     else
-            get_rest_for_duration (text, duration, divisions);
-
-    voice_timings[voicenum - 1] += duration;
-
+      append_rests (voice, *division - voice->timing, part->divisions, TRUE);
+      voice->timing = *division;
     }
 
-
   if (!timing_set)
     {
       *actual_notes = 1;
@@ -734,7 +754,7 @@ parse_note (xmlNodePtr rootElem, GString ** scripts, gint * staff_for_voice, gin
 
   if (((*current_voice != voicenum) && !(((initial_actual_notes) == 1) && (initial_normal_notes == 1))))
     {                           /* an unterminated tuplet in the last voice *///g_assert(*current_voice>0);
-      g_string_append (scripts[*current_voice], "\n;Voice terminated during a tuplet\n(d-EndTuplet)");
+      append_object (&part->voices[*current_voice - 1], tuplet_close_new ());
 
       initial_actual_notes = 1;
       initial_normal_notes = 1;
@@ -742,27 +762,42 @@ parse_note (xmlNodePtr rootElem, GString ** scripts, gint * staff_for_voice, gin
 
   if (((initial_actual_notes != *actual_notes) || (initial_normal_notes != *normal_notes)))
     {
-      gchar *str;
-      if ((initial_actual_notes) == 1 && (initial_normal_notes == 1))
-        str = g_strdup_printf ("(d-StartTuplet \"%d/%d\")", *normal_notes, *actual_notes);
-      //str = g_strdup_printf("\n;not end tuplet and entered with normal timings %d  \n(d-StartTuplet \"%d/%d\")", in_chord, *normal_notes, *actual_notes);
-      else
-        {
-        if (*normal_notes==1 && *actual_notes==1)
-            str = g_strdup_printf ("\n;Leaving tuplet timing\n(d-EndTuplet)");
-        else
-            str = g_strdup_printf ("\n;Changed timings\n(d-EndTuplet)(d-StartTuplet \"%d/%d\")", *normal_notes, *actual_notes);
-        }
-      g_string_append (scripts[voicenum], str);
-      g_free (str);
+      if (!((initial_actual_notes) == 1 && (initial_normal_notes == 1)))
+        append_object (voice, tuplet_close_new ());     //leaving tuplet timing or changing it
+      if (!(*normal_notes == 1 && *actual_notes == 1))
+        append_object (voice, tuplet_open_new (*normal_notes, *actual_notes));
     }
 
+  if (type)
+    {
+      obj = in_chord ? add_note (voice, octave, step, alter) : (is_rest ? add_rest (voice, type, numdots, duration, part->divisions) : insert_note (voice, type, numdots, octave, step, alter));
+      if (!(in_chord || is_grace))
+        voice->timing += duration;
+    }
+  else if (is_rest)
+    {                           //for the case where a rest is given without a type, just a duration, e.g. a whole measure rest
+      obj = append_rests (voice, duration, part->divisions, FALSE);
+      voice->timing += duration;
+    }
 
-
-  g_string_append (scripts[voicenum], text->str);
-  g_string_append (scripts[voicenum], notations->str);
-  g_string_free (notations, TRUE);
-  g_string_free (text, TRUE);
+  if (obj)
+    {
+      if (is_nonprinting)
+        obj->isinvisible = TRUE;
+      if (obj->type == CHORD)
+        {
+          chord *thechord = (chord *) obj->object;
+          if (is_tied)
+            thechord->is_tied = TRUE;
+          if (is_grace)
+            thechord->is_grace = GRACED_NOTE;
+          FOREACH_CHILD_ELEM (childElem, rootElem)
+          {
+            if (ELEM_NAME_EQ (childElem, "notations"))
+              parse_notations (voice, thechord, childElem);
+          }
+        }
+    }
 
   if (!(in_chord || is_grace))
     *division = *division + duration;
@@ -773,7 +808,7 @@ parse_note (xmlNodePtr rootElem, GString ** scripts, gint * staff_for_voice, gin
 }
 
 static void
-get_staff_for_voice_note (xmlNodePtr rootElem, gint * staff_for_voice)
+get_staff_for_voice_note (xmlNodePtr rootElem, gint * staff_for_voice, gint numvoices)
 {
   xmlNodePtr childElem;
   gint voicenum = 1, staffnum = 1;
@@ -784,9 +819,9 @@ get_staff_for_voice_note (xmlNodePtr rootElem, gint * staff_for_voice)
     if (ELEM_NAME_EQ (childElem, "staff"))
       staffnum = getXMLIntChild (childElem);
   }
-  if (voicenum < 1)
+  if ((voicenum < 1) || (voicenum > numvoices))
     {
-      g_warning ("Bad MusicXML file voice 0 encountered");
+      g_warning ("Bad MusicXML file voice %d encountered", voicenum);
       voicenum = 1;
     }
   if (staffnum < 1)
@@ -799,19 +834,19 @@ get_staff_for_voice_note (xmlNodePtr rootElem, gint * staff_for_voice)
 }
 
 static void
-parse_attributes (xmlNodePtr rootElem, GString ** scripts, gint numvoices, gint * staff_for_voice, gint division, gint * voice_timings, gint * divisions, gint * current_voice, gint measurenum)
+parse_attributes (xmlNodePtr rootElem, MxmlPart * part, gint division, gint current_voice, gint measurenum)
 {
   xmlNodePtr childElem;
   FOREACH_CHILD_ELEM (childElem, rootElem)
   {                             //g_debug("attribute %s at division %d\n", childElem->name, division);
     if (ELEM_NAME_EQ (childElem, "time"))
-      parse_time (scripts, numvoices, measurenum, childElem);
+      parse_time (part, measurenum, childElem);
     if (ELEM_NAME_EQ (childElem, "key"))
-      parse_key (scripts, numvoices, measurenum, childElem);
+      parse_key (part, measurenum, childElem);
     if (ELEM_NAME_EQ (childElem, "clef"))
-      parse_clef (scripts, division, voice_timings, *current_voice, numvoices, staff_for_voice, *divisions, measurenum, childElem);
+      parse_clef (part, division, current_voice, measurenum, childElem);
     if (ELEM_NAME_EQ (childElem, "divisions"))
-      *divisions = getXMLIntChild (childElem);
+      part->divisions = getXMLIntChild (childElem);
   }
 
 }
@@ -819,7 +854,7 @@ parse_attributes (xmlNodePtr rootElem, GString ** scripts, gint numvoices, gint
 
 
 static void
-parse_barline (xmlNodePtr rootElem, GString ** scripts, gint numvoices)
+parse_barline (xmlNodePtr rootElem, MxmlPart * part)
 {
   xmlNodePtr childElem;
   gchar *text = NULL;
@@ -849,9 +884,10 @@ parse_barline (xmlNodePtr rootElem, GString ** scripts, gint numvoices)
         text = "(d-ClosingBarline)";
     }
   if (text)
-    for (i = 0; i < numvoices; i++)
-      g_string_append (scripts[i + 1], text);
+    for (i = 0; i < part->numvoices; i++)
+      add_markup (&part->voices[i], part->voices[i].measurenum, 0, TRUE, text);
  g_free (style);
+ g_free (repeat);
 }
 
 
@@ -863,37 +899,41 @@ parse_barline (xmlNodePtr rootElem, GString ** scripts, gint numvoices)
     </direction>
   */
 static gchar *
-parse_direction_type (xmlNodePtr rootElem, GString * script, gchar *placement)
+parse_direction_type (xmlNodePtr rootElem, MxmlVoice * voice, gchar *placement)
 {
   xmlNodePtr childElem;
   gchar *pending = NULL;
+  gint measurenum, position;
+  DenemoObject *obj = last_object (voice, &measurenum, &position);
   FOREACH_CHILD_ELEM (childElem, rootElem)
   {
     if (ELEM_NAME_EQ (childElem, "wedge"))
       {
         gchar *type = xmlGetProp (childElem, (xmlChar *) "type");
         gchar *spread = xmlGetProp (childElem, (xmlChar *) "spread");
-        if (type && spread)
+        if (type && spread && obj && (obj->type == CHORD))
           {
+            chord *thechord = (chord *) obj->object;
             if (!strcmp (type, "crescendo"))
-              g_string_append (script, "(if (Appending?)(d-MoveCursorLeft))(d-ToggleStartCrescendo)(GoToMeasureEnd)");
+              thechord->crescendo_begin_p = TRUE;
             if (!strcmp (type, "diminuendo"))
-              g_string_append (script, "(if (Appending?)(d-MoveCursorLeft))(d-ToggleStartDiminuendo)(GoToMeasureEnd)");
+              thechord->diminuendo_begin_p = TRUE;
 
             if (!strcmp (type, "stop"))
               {
                 if (!strcmp (spread, "0"))
-                  g_string_append (script, "(if (Appending?)(d-MoveCursorLeft))(d-ToggleEndDiminuendo)(GoToMeasureEnd)");
+                  thechord->diminuendo_end_p = TRUE;
                 else
-                  g_string_append (script, "(if (Appending?)(d-MoveCursorLeft))(d-ToggleEndCrescendo)(GoToMeasureEnd)");
+                  thechord->crescendo_end_p = TRUE;
               }
           }
+        g_free (type);
+        g_free (spread);
       }
      if (ELEM_NAME_EQ (childElem, "words"))
       {
           //FIXME get italic etc here xmlGetProp
           gchar *words = xmlNodeListGetString (childElem->doc, childElem->xmlChildrenNode, 1);
-          //pending = g_strdup_printf ("(d-TextAnnotation \"%s\")(GoToMeasureEnd)", g_strescape(words, NULL));
           gchar *font_style = xmlGetProp (childElem, "font-style");
           if(font_style)
             {
@@ -915,12 +955,14 @@ parse_direction_type (xmlNodePtr rootElem, GString * script, gchar *placement)
             }
           else
             placement = "-";
-        //if(pending==NULL)
-         //   pending = "";
-         gchar *thewords = escape_scheme (words);
-        pending = g_strdup_printf ("(StandaloneText \"TextAnnotation\" \"%s\" \"%s\" \"%s\")(GoToMeasureEnd)", /*words g_strescape(words, NULL)*/ escape_scheme (words), placement, font_style);
-        g_free (thewords);
-        g_free (words);
+        if (words)
+          {
+            gchar *thewords = escape_scheme (words);
+            g_free (pending);
+            pending = g_strdup_printf ("(StandaloneText \"TextAnnotation\" \"%s\" \"%s\" \"%s\")", thewords, placement, font_style);
+            g_free (thewords);
+            g_free (words);
+          }
 
       }
 
@@ -937,27 +979,24 @@ parse_direction_type (xmlNodePtr rootElem, GString * script, gchar *placement)
         <sound dynamics="98"/>
       </direction>
    */
-    if (ELEM_NAME_EQ (childElem, "dynamics"))
+    if (ELEM_NAME_EQ (childElem, "dynamics") && childElem->xmlChildrenNode && obj)
       {
-       // if(pending==NULL)
-       //     pending = "";
-       // pending = g_strdup_printf ("%s(d-DynamicText \"%s\")(GoToMeasureEnd)", pending, childElem->xmlChildrenNode->name);
-
-       g_string_append_printf (script, "(if (Appending?)(d-MoveCursorLeft))(d-DynamicText \"%s\")(GoToMeasureEnd)", childElem->xmlChildrenNode->name);
-
+        gchar *dynamic = g_strdup_printf ("(d-DynamicText \"%s\")", childElem->xmlChildrenNode->name);
+        add_markup (voice, measurenum, position, FALSE, dynamic);
+        g_free (dynamic);
       }
   }
   return pending;
 }
 
 static gchar *
-parse_direction (xmlNodePtr rootElem, GString * script, gchar *placement)
+parse_direction (xmlNodePtr rootElem, MxmlVoice * voice, gchar *placement)
 {
   xmlNodePtr childElem;
   FOREACH_CHILD_ELEM (childElem, rootElem)
   {
     if (ELEM_NAME_EQ (childElem, "direction-type"))
-      return parse_direction_type (childElem, script, placement);
+      return parse_direction_type (childElem, voice, placement);
 
 
 
@@ -966,22 +1005,20 @@ parse_direction (xmlNodePtr rootElem, GString * script, gchar *placement)
 }
 
 static void
-get_staff_for_voice_measure (xmlNodePtr rootElem, gint * staff_for_voice)
+get_staff_for_voice_measure (xmlNodePtr rootElem, gint * staff_for_voice, gint numvoices)
 {
   xmlNodePtr childElem;
-  gint division = 0;
-  gint current_voice = 1;
   FOREACH_CHILD_ELEM (childElem, rootElem)
   {
     if (ELEM_NAME_EQ (childElem, "note"))
       {
-        get_staff_for_voice_note (childElem, staff_for_voice);
+        get_staff_for_voice_note (childElem, staff_for_voice, numvoices);
       }
   }
 }
 
 static gchar *
-parse_measure (xmlNodePtr rootElem, GString ** scripts, gint * staff_for_voice, gint * divisions, gint * voice_timings, gint numvoices, gint measurenum)
+parse_measure (xmlNodePtr rootElem, MxmlPart * part, gint measurenum)
 {
   GString *ret = g_string_new ("");
   gint note_count = 0;
@@ -990,12 +1027,12 @@ parse_measure (xmlNodePtr rootElem, GString ** scripts, gint * staff_for_voice,
   gint current_voice = 1;
   gint actual_notes = 1, normal_notes = 1;      /* for tuplets */
   gint last_voice_with_notes = 1;       /* in case a voice with not "note" elements moves the current voice on while unfinished stuff in last voice */
-  GString *pendings = g_string_new("");
+  GList *pendings = NULL;       /* text to be placed before the next note */
   FOREACH_CHILD_ELEM (childElem, rootElem)
   {
     //g_debug("name %s at voicenumber %d at division %d\n", childElem->name, current_voice, division);
     if (ELEM_NAME_EQ (childElem, "attributes"))
-      parse_attributes (childElem, scripts, numvoices, staff_for_voice, division, voice_timings, divisions, &current_voice, measurenum);
+      parse_attributes (childElem, part, division, current_voice, measurenum);
 
     if (ELEM_NAME_EQ (childElem, "backup"))
       {
@@ -1005,23 +1042,33 @@ parse_measure (xmlNodePtr rootElem, GString ** scripts, gint * staff_for_voice,
       {
         division += parseDuration (&current_voice, childElem);  //g_debug("forward arrives at %d\n", division);
       }
+    if ((current_voice < 1) || (current_voice > part->numvoices))
+      {
+        g_warning ("Bad MusicXML file voice %d encountered", current_voice);
+        current_voice = 1;
+      }
     if (ELEM_NAME_EQ (childElem, "note"))
       {
         gchar *printing = xmlGetProp (childElem, "print-object");
         gboolean is_nonprinting = FALSE;
         if (printing && !strcmp (printing, "no"))
           is_nonprinting = TRUE;
+        g_free (printing);
 
-        gchar *warning = parse_note (childElem, scripts, staff_for_voice, &division, *divisions, voice_timings, &current_voice, &actual_notes, &normal_notes, is_nonprinting);
-        if(pendings->len)
+        gchar *warning = parse_note (childElem, part, &division, &current_voice, &actual_notes, &normal_notes, is_nonprinting);
+        if (pendings)
             {
-                g_string_prepend (pendings, "(d-MoveCursorLeft)");
-                g_string_append (scripts[current_voice], pendings->str);
-                g_string_assign(pendings, "");
+                MxmlVoice *voice = &part->voices[current_voice - 1];
+                GList *g;
+                for (g = pendings; voice->length && g; g = g->next)
+                  add_markup (voice, voice->measurenum, voice->length, TRUE, (gchar *) g->data);
+                g_list_free_full (pendings, g_free);
+                pendings = NULL;
             }
         note_count++;
         if (*warning)
           g_string_append_printf (ret, "%s at note number %d, ", warning, note_count);
+        g_free (warning);
         last_voice_with_notes = current_voice;
       }
 
@@ -1029,30 +1076,49 @@ parse_measure (xmlNodePtr rootElem, GString ** scripts, gint * staff_for_voice,
     if (ELEM_NAME_EQ (childElem, "direction"))
       {                         //g_assert(current_voice>0);
         gchar *placement = xmlGetProp (childElem, "placement");
-        gchar *text = parse_direction (childElem, scripts[current_voice], placement);
+        gchar *text = parse_direction (childElem, &part->voices[current_voice - 1], placement);
         if(text)
-            g_string_append(pendings, text);
+            pendings = g_list_append (pendings, text);
+        g_free (placement);
       }
     if (ELEM_NAME_EQ (childElem, "barline"))
       {
-        parse_barline (childElem, scripts, numvoices);
+        parse_barline (childElem, part);
       }
   }
   //g_assert(last_voice_with_notes>0);
   if ((actual_notes != 1) || (normal_notes != 1))
-    g_string_append_printf (scripts[last_voice_with_notes], "\n;measure end with tuplet still active in voice %d\n(d-EndTuplet)", current_voice);
-  g_string_free(pendings, TRUE);
+    append_object (&part->voices[last_voice_with_notes - 1], tuplet_close_new ());    //measure end with tuplet still active
+  g_list_free_full (pendings, g_free);
   return g_string_free (ret, FALSE);
 }
 
-static gchar *
-parse_part (xmlNodePtr rootElem)
+/* creates a staff for a MusicXML voice, with no measures */
+static DenemoStaff *
+new_voice_staff (DenemoMovement * si, gboolean is_secondary)
+{
+  DenemoStaff *staff = staff_new (Denemo.project, ADDFROMLOAD, DENEMO_NONE);
+  g_list_free_full (staff->themeasures, g_free);
+  staff->themeasures = NULL;
+  staff->nummeasures = 0;
+  staff_invalidate_measure_index (staff);
+  si->currentmeasure = NULL;
+  if (is_secondary)
+    staff->voicecontrol = DENEMO_SECONDARY;
+  staff->keysig.number = 0;     //a part without a <key> is in C major
+  staff->keysig.isminor = FALSE;
+  initkeyaccs (staff->keysig.accs, 0);
+  return staff;
+}
+
+static void
+parse_part (xmlNodePtr rootElem, DenemoMovement * si)
 {
   GString *warnings = g_string_new ("");
   gint i, j;
   xmlNodePtr childElem;
   gint numstaffs = 1, numvoices = 1;
-  gint divisions = 384;         //will be overriden anyway.
+  MxmlPart part;
 
   FOREACH_CHILD_ELEM (childElem, rootElem)
   {
@@ -1067,51 +1133,38 @@ parse_part (xmlNodePtr rootElem)
       }
   }
   g_info ("Number of staffs %d, voices %d\n", numstaffs, numvoices);
-  gint *staff_for_voice = (gint *) g_malloc0 (numvoices * sizeof (gint));
-
-  GString **scripts = (GString **) g_malloc0 ((1 + numvoices) * sizeof (GString *));
-  for (i = 0; i <= numvoices; i++)
-    scripts[i] = g_string_new ("\n");
-  gint *voice_timings = (gint *) g_malloc0 (numvoices * sizeof (gint));
-
+  part.numvoices = numvoices;
+  part.divisions = 384;         //will be overriden anyway.
+  part.staff_for_voice = (gint *) g_malloc0 (numvoices * sizeof (gint));
+  part.voices = (MxmlVoice *) g_malloc0 (numvoices * sizeof (MxmlVoice));
 
   FOREACH_CHILD_ELEM (childElem, rootElem)
   {
     if (ELEM_NAME_EQ (childElem, "measure"))
       {
-        get_staff_for_voice_measure (childElem, staff_for_voice);
+        get_staff_for_voice_measure (childElem, part.staff_for_voice, numvoices);
       }
   }
   for (i = 0; i < numvoices; i++)
-    if (staff_for_voice[i] == 0)
+    if ((part.staff_for_voice[i] == 0) || (part.staff_for_voice[i] > numstaffs))
       {
         g_info ("Voicenum %d was not actually used", i + 1);
-        staff_for_voice[i] = 1; //if a voice was not actually used, assign it to the first staff
+        part.staff_for_voice[i] = 1;    //if a voice was not actually used, assign it to the first staff
       }
 
-  gint *numvoices_for_staff = (gint *) g_malloc0 (numstaffs * sizeof (gint));
-
-  for (i = 0; i < numvoices; i++)
-    {                           //g_assert(staff_for_voice[i]>0);
-      numvoices_for_staff[staff_for_voice[i] - 1]++;
-    }
-
-/* create script to make enough staffs and voices, we are already in staff 1 voice 1 */
-  g_string_append (scripts[0], "(d-PushPosition)");
-  for (i = 0; i < numstaffs; i++)
+/* create the Denemo staffs, staff by staff with the voices of each staff following its primary */
+  for (i = 1; i <= numstaffs; i++)
     {
-      //g_debug("Staff %d with %d voices\n", i, numvoices_for_staff[i]);
-      if (i > 0)                /*already have first staff */
-        g_string_append (scripts[0], "(d-AddAfter)");
-      for (j = 1 /*already have first voice */ ; j < numvoices_for_staff[i]; j++)
-        {
-          //g_debug("Voice %d on Staff %d\n", j, i);
-          g_string_append (scripts[0], "(d-AddAfter)(d-SetCurrentStaffAsVoice)");
-        }
+      gboolean is_secondary = FALSE;
+      for (j = 0; j < numvoices; j++)
+        if (part.staff_for_voice[j] == i)
+          {
+            part.voices[j].staff = new_voice_staff (si, is_secondary);
+            part.voices[j].measurenum = 1;
+            is_secondary = TRUE;
+          }
     }
-  g_string_append (scripts[0], "(d-PopPosition)");
 
-  g_string_append (scripts[0], "(d-PushPosition)");
   gint measure_count = 1;
   FOREACH_CHILD_ELEM (childElem, rootElem)
   {
@@ -1119,76 +1172,79 @@ parse_part (xmlNodePtr rootElem)
     if (ELEM_NAME_EQ (childElem, "measure"))
       {
         gint maxduration = 0;
-        memset (voice_timings, 0, numvoices * sizeof (gint));
-        gchar *warning = parse_measure (childElem, scripts, staff_for_voice, &divisions, voice_timings, numvoices, measure_count);
+        gchar *warning = parse_measure (childElem, &part, measure_count);
         if (*warning)
           g_string_append_printf (warnings, "%s in bar %d.\n", warning, measure_count);
+        g_free (warning);
         for (i = 0; i < numvoices; i++)
-          if (maxduration < voice_timings[i])
-            maxduration = voice_timings[i];
+          if (maxduration < part.voices[i].timing)
+            maxduration = part.voices[i].timing;
         for (i = 0; i < numvoices; i++)
           {
-            if (voice_timings[i] < maxduration)
+            if (part.voices[i].timing < maxduration)
               {
-                insert_invisible_rest (scripts[i + 1], maxduration - voice_timings[i], divisions);
+                append_rests (&part.voices[i], maxduration - part.voices[i].timing, part.divisions, TRUE);
               }
-            g_string_append (scripts[0], scripts[i + 1]->str);
-            g_string_assign (scripts[i + 1], "");
-            g_string_append_printf (scripts[0], "%s\n;;;;;;;finished voice %d\n", "(d-MoveToStaffDown)", i + 1);
-            voice_timings[i] = 0;
+            end_measure (&part.voices[i]);
           }
-        g_string_append_printf (scripts[0], "(d-PopPosition)(if (not (d-MoveToMeasureRight))(d-AddMeasure))(d-PushPosition)\n;;;;;;;;;End of measure %d\n ", measure_count);
         measure_count++;
       }
   }
-  g_string_append (scripts[0], "(d-PopPosition)");
 
   for (i = 0; i < numvoices; i++)
     {
-
-      g_string_append (scripts[0], "(d-MoveToBeginning)(d-MoveToStaffDown)");
+      DenemoStaff *staff = part.voices[i].staff;
+      staff->themeasures = g_list_reverse (part.voices[i].measures);
+      staff->nummeasures = g_list_length (staff->themeasures);
+      staff_invalidate_measure_index (staff);
     }
-  g_string_append (scripts[0], "(d-AddAfter)(d-InitialKey \"C major\")");
   if (warnings->len)
     g_warning ("Parsing MusicXML gave these warnings:\n%s", warnings->str);
   g_string_free (warnings, TRUE);
   InitialVoiceNum += numvoices;
 
-  g_free (numvoices_for_staff);
-  g_free (staff_for_voice);
-  g_free (voice_timings);
-  return g_string_free (scripts[0], FALSE);
+  g_free (part.staff_for_voice);
+  g_free (part.voices);
 }
 
 static void
 parse_identification (xmlNodePtr rootElem, GString *script)
 {
-  gchar *title = NULL;
   xmlNodePtr childElem;
    FOREACH_CHILD_ELEM (childElem, rootElem)
   {
     if (ELEM_NAME_EQ (childElem, "creator"))
         {
-            title = xmlNodeListGetString (childElem->doc, childElem->xmlChildrenNode, 1);
-            g_string_append_printf (script, "(d-BookComposer \"%s\")", title);
+            gchar *title = xmlNodeListGetString (childElem->doc, childElem->xmlChildrenNode, 1);
+            if (title)
+              {
+                gchar *escaped = escape_scheme (title);
+                g_string_append_printf (script, "(d-BookComposer \"%s\")", escaped);
+                g_free (escaped);
+              }
+            g_free (title);
         }
     if (ELEM_NAME_EQ (childElem, "rights"))
         {
-            title = xmlNodeListGetString (childElem->doc, childElem->xmlChildrenNode, 1);
-            g_string_append_printf (script, "(d-BookCopyright \"%s\")", title);
+            gchar *title = xmlNodeListGetString (childElem->doc, childElem->xmlChildrenNode, 1);
+            if (title)
+              {
+                gchar *escaped = escape_scheme (title);
+                g_string_append_printf (script, "(d-BookCopyright \"%s\")", escaped);
+                g_free (escaped);
+              }
+            g_free (title);
         }
   }
-  g_free (title);
 }
 
 gint
 mxmlinput (gchar * filename)
 {
-  GError *err = NULL;
   gint ret = 0;
   xmlDocPtr doc = NULL;
-  xmlNsPtr ns;
   xmlNodePtr rootElem;
+  DenemoMovement *si = Denemo.project->movement;
   gboolean spillover = Denemo.prefs.spillover;
   Denemo.prefs.spillover = FALSE;
 
@@ -1206,20 +1262,26 @@ mxmlinput (gchar * filename)
 
   rootElem = xmlDocGetRootElement (doc);
   xmlNodePtr childElem;
-  GString *script = g_string_new (";Score\n\n(d-MasterVolume 0) (d-IncreaseGuard) (d-StaffProperties \"denemo_name=voice 1\")");
-  gint part_count = 1;
+  GString *script = g_string_new (";Score\n\n(d-MasterVolume 0)");
+  DenemoStaff *blank = movement_blank_staff (si);
+  gint previous_staffnum = g_list_length (si->thescore);
   InitialVoiceNum = 0;
   if (Warnings == NULL)
     Warnings = g_string_new ("");
   else
     g_string_assign (Warnings, "");
+  si->undo_guard++;
   FOREACH_CHILD_ELEM (childElem, rootElem)
   {
        if (ELEM_NAME_EQ (childElem, "movement-title"))
         {
             gchar *title = xmlNodeListGetString (childElem->doc, childElem->xmlChildrenNode, 1);
             if(title)
-                g_string_append_printf (script, "(d-BookTitle \"%s\")", escape_scheme(title));
+              {
+                gchar *escaped = escape_scheme (title);
+                g_string_append_printf (script, "(d-BookTitle \"%s\")", escaped);
+                g_free (escaped);
+              }
             g_free (title);
         }
      if (ELEM_NAME_EQ (childElem, "identification"))   {
@@ -1227,22 +1289,38 @@ mxmlinput (gchar * filename)
     }
     if (ELEM_NAME_EQ (childElem, "part"))
       {
-        g_string_append_printf (script, "\n;;-------------------------Part (ie Instrument) %d ----------------------\n", part_count++);
-        g_string_append (script, parse_part (childElem));
+        parse_part (childElem, si);
       }
   }
-  g_string_append (script, "(d-DeleteStaff)(d-MoveToEnd)(if (None?) (d-DeleteMeasureAllStaffs))(d-MasterVolume 1)(d-MoveToBeginning)(if (and (not (None?))(UnderfullMeasure?))(d-Upbeat)) (d-AmalgamateRepeatBarlines) (d-ConvertToWholeMeasureRests) (d-DecreaseGuard)  ");
+  xmlFreeDoc (doc);
+  if (blank && (g_list_length (si->thescore) > previous_staffnum))
+    {
+      si->currentstaff = si->thescore;
+      si->currentstaffnum = 1;
+      staff_delete (Denemo.project, FALSE);
+      previous_staffnum = 0;
+    }
+  pad_movement_measures (si);
+  recache_movement (si);
+  si->currentstaff = g_list_nth (si->thescore, previous_staffnum) ? g_list_nth (si->thescore, previous_staffnum) : si->thescore;
+  si->currentstaffnum = 1 + g_list_position (si->thescore, si->currentstaff);
+  si->currentmeasurenum = 1;
+  setcurrents (si);
+
+  markups_to_script (si, script);
+  g_string_append (script, "(d-MasterVolume 1)(d-MoveToBeginning)(if (and (not (None?))(UnderfullMeasure?))(d-Upbeat)) (d-AmalgamateRepeatBarlines) (d-ConvertToWholeMeasureRests)");
 #ifdef DEVELOPER
   {
     FILE *fp = fopen ("/home/rshann/junk.scm", "w");
     if (fp)
       {
-        fprintf (fp, ";Parser not yet finished upbeat bug present:\n %s", script->str);
+        fprintf (fp, ";Markings applied after import:\n %s", script->str);
         fclose (fp);
       }
   }
 #endif
   call_out_to_guile (script->str);
+  si->undo_guard--;
   g_string_free (script, TRUE);
   Denemo.prefs.spillover = spillover;
   return ret;
@@ -533,6 +533,10 @@ if (Denemo.non_interactive)
                  &lilypond_launch_success,
                  &lily_err);
 else
+  {
+#ifdef USE_EVINCE
+  thumbnail_pool_pause ();      //typesetting the user is waiting for comes before thumbnails
+#endif
   lilypond_launch_success = g_spawn_async_with_pipes (locateprintdir (),       /* dir */
                                                                arguments,
                                                                NULL,    /* env */
@@ -544,6 +548,7 @@ else
                                                                NULL,    /* stdout */
                                                                NULL, /* stderr */
                                                                &lily_err);
+  }
 
   if (lily_err)
     {
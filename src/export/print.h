@@ -125,6 +125,8 @@ void export_pdf (gchar * filename, DenemoProject * gui);
 void export_png (gchar * filename, GChildWatchFunc finish, DenemoProject * gui);
 void printpng_finished (GPid pid, gint status, GList * filelist);
 gboolean create_thumbnail (gboolean async, gchar* thumbnail_path);
+void thumbnail_pool_pause (void);
+void thumbnail_pool_shutdown (void);
 gchar *large_thumbnail_name (gchar * filepath);
 gboolean stop_lilypond ();
 void process_lilypond_errors (gchar * filename);
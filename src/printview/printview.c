@@ -2,6 +2,11 @@
 #include <errno.h>
 #include <math.h>
 #include <glib/gstdio.h>
+#ifndef G_OS_WIN32
+#include <signal.h>
+#include <sys/resource.h>
+#include <unistd.h>
+#endif
 
 #include "printview/printview.h"
 #include "export/print.h"
@@ -731,6 +736,41 @@ get_thumbname (gchar * uri)
   return thumbname;
 }
 
+/* save the normal and large thumbnails of the score filename under thumbname, tagged with its uri and
+ * the modification time of the contents they were made from */
+static void
+save_thumbnails (GdkPixbuf * pbN, GdkPixbuf * pbL, const gchar * filename, const gchar * thumbname, unsigned mtime)
+{
+  GError *err = NULL;
+  gchar *uri = g_strdup_printf ("file://%s", filename);
+
+  gchar *thumbpathN = g_build_filename (thumbnailsdirN, thumbname, NULL);
+  gchar *thumbpathL = g_build_filename (thumbnailsdirL, thumbname, NULL);
+  gchar *mt = g_strdup_printf ("%u", mtime);
+
+  if (gdk_pixbuf_save (pbN, thumbpathN, "png", &err, "tEXt::Thumb::URI", uri, "tEXt::Thumb::MTime", mt, NULL))
+    g_info ("Thumbnail generated at %s", thumbpathN);
+  else
+    {
+      g_critical ("Could not save normal thumbnail: %s", err->message);
+      g_error_free (err);
+    }
+
+  err = NULL;
+  if (gdk_pixbuf_save (pbL, thumbpathL, "png", &err, "tEXt::Thumb::URI", uri, "tEXt::Thumb::MTime", mt, NULL))
+    g_info ("Large thumbnail generated at %s", thumbpathL);
+  else
+    {
+      g_critical ("Could not save large thumbnail: %s", err->message);
+      g_error_free (err);
+    }
+
+  g_free (uri);
+  g_free (mt);
+  g_free (thumbpathN);
+  g_free (thumbpathL);
+}
+
 /*call back to finish thumbnail processing. */
 static void
 thumb_finished (gchar * thumbname)
@@ -759,32 +799,13 @@ thumb_finished (gchar * thumbname)
 
   //FIXME if pb->height>128 or 256 scale it down...
   if (pbN && pbL)
-    {
-      gchar *uri = g_strdup_printf ("file://%s", Denemo.project->filename->str);
-      unsigned mtime = file_get_mtime (Denemo.project->filename->str);
-
-      gchar *thumbpathN = g_build_filename (thumbnailsdirN, thumbname, NULL);
-      gchar *thumbpathL = g_build_filename (thumbnailsdirL, thumbname, NULL);
-      gchar *mt = g_strdup_printf ("%u", mtime);
-
-      if (gdk_pixbuf_save (pbN, thumbpathN, "png", &err, "tEXt::Thumb::URI", uri, "tEXt::Thumb::MTime", mt, NULL))
-        g_info ("Thumbnail generated at %s", thumbpathN);
-      else
-        g_critical ("Could not save normal thumbnail: %s", err->message);
-
-      err = NULL;
-      if (gdk_pixbuf_save (pbL, thumbpathL, "png", &err, "tEXt::Thumb::URI", uri, "tEXt::Thumb::MTime", mt, NULL))
-        g_info ("Large thumbnail generated at %s", thumbpathL);
-      else
-        g_critical ("Could not save large thumbnail: %s", err->message);
-
-      //FIXME do the pbN L need freeing???
-      g_free (uri);
-      g_free (mt);
-      g_free (thumbname);
-      g_free (thumbpathN);
-      g_free (thumbpathL);
-    }
+    save_thumbnails (pbN, pbL, Denemo.project->filename->str, thumbname, file_get_mtime (Denemo.project->filename->str));
+  if (pbN)
+    g_object_unref (pbN);
+  if (pbL)
+    g_object_unref (pbL);
+  g_free (thumbname);
+  g_free (printpng);
   g_free (printname);
   Denemo.printstatus->printpid = GPID_NONE;
   progressbar_stop ();
@@ -800,11 +821,362 @@ large_thumbnail_name (gchar * filepath)
   return g_build_filename (get_thumb_directory (), ret, NULL);
 }
 
+/* Thumbnails for scores being closed are made in the background by a pool of headless Denemo
+ * processes, run at low priority and separately from the print process used for typesetting.
+ * Each job renders a score once into the thumbnail store, named by the checksum of the score's
+ * contents, and the normal and large thumbnails of every score waiting on it are then scaled from
+ * that render, so identical files (copies, or a file reverted to a version already seen) reuse it.
+ * The contents are snapshotted into the store when the job is queued and the snapshot is what gets
+ * rendered, so a score saved again before its job launches cannot put new music under the old checksum,
+ * and the thumbnails carry the modification time of the contents they show.
+ * Interactive typesetting always comes first: while it runs the pool's processes are stopped
+ * and no new job is started. */
+
+typedef struct ThumbnailTarget
+{
+  gchar *filename;              /* the score */
+  gchar *thumbname;             /* name of its thumbnails in thumbnailsdirN and thumbnailsdirL */
+  unsigned mtime;               /* of the score when its contents were read */
+} ThumbnailTarget;
+
+typedef struct ThumbnailJob
+{
+  gchar *checksum;              /* of the contents of the scores in targets */
+  gchar *render;                /* the png in the thumbnail store */
+  gchar *snapshot;              /* copy of the contents that were checksummed, which is what is rendered */
+  GList *targets;
+  GPid pid;                     /* GPID_NONE until launched */
+  guint watch;                  /* child watch on pid */
+} ThumbnailJob;
+
+static struct
+{
+  GHashTable *jobs;             /* ThumbnailJob queued or running, keyed by checksum */
+  GQueue *waiting;              /* jobs not yet launched, oldest first */
+  guint running;
+  gboolean stopped;             /* the running jobs are stopped for interactive typesetting */
+  guint resume_id;
+} ThumbnailPool;
+
+static gchar *
+get_thumbnail_store (void)
+{
+  static gchar *store = NULL;
+  if (store == NULL)
+    {
+      store = g_build_filename (get_user_data_dir (TRUE), "thumbnails", NULL);
+      g_mkdir_with_parents (store, 0700);
+    }
+  return store;
+}
+
+static guint
+thumbnail_pool_size (void)
+{
+  return MAX (1, g_get_num_processors () / 2);
+}
+
+static void
+free_thumbnail_job (ThumbnailJob * job)
+{
+  GList *g;
+  for (g = job->targets; g; g = g->next)
+    {
+      ThumbnailTarget *target = (ThumbnailTarget *) g->data;
+      g_free (target->filename);
+      g_free (target->thumbname);
+      g_free (target);
+    }
+  g_list_free (job->targets);
+  if (job->snapshot)
+    g_unlink (job->snapshot);
+  g_free (job->snapshot);
+  g_free (job->checksum);
+  g_free (job->render);
+  g_free (job);
+}
+
+/* make the thumbnails of filename from a render of the same contents, which it had at mtime, returns FALSE if the render could not be read */
+static gboolean
+thumbnails_from_render (const gchar * render, const gchar * filename, const gchar * thumbname, unsigned mtime)
+{
+  GdkPixbuf *pbN = gdk_pixbuf_new_from_file_at_scale (render, 128, -1, TRUE, NULL);
+  GdkPixbuf *pbL = gdk_pixbuf_new_from_file_at_scale (render, 256, -1, TRUE, NULL);
+  gboolean ret = (pbN && pbL);
+  if (ret)
+    save_thumbnails (pbN, pbL, filename, thumbname, mtime);
+  if (pbN)
+    g_object_unref (pbN);
+  if (pbL)
+    g_object_unref (pbL);
+  return ret;
+}
+
+#ifndef G_OS_WIN32
+/* child setup for thumbnailers: besides lowering the priority it puts the thumbnailer in a process group
+ * of its own, which the LilyPond it runs joins, so that signal_thumbnail_jobs () reaches the typesetting too */
 static void
-thumbnail_finished (GPid pid, gint status, gpointer data)
+lower_priority (gpointer data)
 {
+  setpgid (0, 0);
+  setpriority (PRIO_PROCESS, 0, 19);
+}
+#endif
+
+/* launch a thumbnailer for filename that writes its thumbnails itself, for when no one will wait for it */
+static void
+spawn_thumbnailer (const gchar * filename)
+{
+  GError *err = NULL;
+  gchar *denemo = g_build_filename (get_system_bin_dir (), "denemo", NULL);
+  gchar *arguments[] = {
+    denemo,
+    "-n", "-a", "(d-CreateThumbnail #f)(d-Exit)",
+    (gchar *) filename,
+    NULL
+  };
+  if (!g_spawn_async (NULL, arguments, NULL, G_SPAWN_SEARCH_PATH,
+#ifndef G_OS_WIN32
+                      lower_priority,
+#else
+                      NULL,
+#endif
+                      NULL, NULL, &err))
+    {
+      g_critical ("An error happened during thumbnail generation: %s", err->message);
+      g_error_free (err);
+    }
+  g_free (denemo);
+}
+
+static void launch_thumbnail_jobs (void);
+
+static void
+thumbnail_job_finished (GPid pid, gint status, ThumbnailJob * job)
+{
+  GList *g;
+  g_spawn_close_pid (pid);
+  ThumbnailPool.running--;
+  g_hash_table_remove (ThumbnailPool.jobs, job->checksum);
   if (status)
-    g_warning ("Thumbnailer: Lilyond did not end successfully");
+    g_warning ("Thumbnailer: LilyPond did not end successfully");
+  else
+    for (g = job->targets; g; g = g->next)
+      {
+        ThumbnailTarget *target = (ThumbnailTarget *) g->data;
+        if (!thumbnails_from_render (job->render, target->filename, target->thumbname, target->mtime))
+          g_warning ("Thumbnailer: no image was made for %s", target->filename);
+      }
+  free_thumbnail_job (job);
+  launch_thumbnail_jobs ();
+}
+
+/* start waiting jobs while there is room in the pool and no typesetting in progress */
+static void
+launch_thumbnail_jobs (void)
+{
+  while (!ThumbnailPool.stopped && (Denemo.printstatus->printpid == GPID_NONE) && (ThumbnailPool.running < thumbnail_pool_size ()) && !g_queue_is_empty (ThumbnailPool.waiting))
+    {
+      ThumbnailJob *job = (ThumbnailJob *) g_queue_pop_head (ThumbnailPool.waiting);
+      GError *err = NULL;
+      gchar *denemo = g_build_filename (get_system_bin_dir (), "denemo", NULL);
+      gchar *scheme = g_strdup_printf ("(d-CreateThumbnail #f \"%s\")(d-Exit)", job->render);
+      gchar *arguments[] = {
+        denemo,
+        "-n", "-a", scheme,
+        job->snapshot,
+        NULL
+      };
+      if (g_spawn_async (NULL, arguments, NULL, G_SPAWN_SEARCH_PATH | G_SPAWN_DO_NOT_REAP_CHILD,
+#ifndef G_OS_WIN32
+                         lower_priority,
+#else
+                         NULL,
+#endif
+                         NULL, &job->pid, &err))
+        {
+          g_info ("Launched thumbnail subprocess for %s", ((ThumbnailTarget *) job->targets->data)->filename);
+          ThumbnailPool.running++;
+          job->watch = g_child_watch_add (job->pid, (GChildWatchFunc) thumbnail_job_finished, job);
+        }
+      else
+        {
+          g_critical ("An error happened during thumbnail generation: %s", err->message);
+          g_error_free (err);
+          g_hash_table_remove (ThumbnailPool.jobs, job->checksum);
+          free_thumbnail_job (job);
+        }
+      g_free (scheme);
+      g_free (denemo);
+    }
+}
+
+static void
+signal_thumbnail_jobs (gint sig)
+{
+#ifndef G_OS_WIN32
+  GHashTableIter iter;
+  gpointer value;
+  g_hash_table_iter_init (&iter, ThumbnailPool.jobs);
+  while (g_hash_table_iter_next (&iter, NULL, &value))
+    if (((ThumbnailJob *) value)->pid != GPID_NONE)
+      kill (-((ThumbnailJob *) value)->pid, sig);    //the whole process group, see lower_priority ()
+#endif
+}
+
+static gboolean
+resume_thumbnail_pool (void)
+{
+  if (Denemo.printstatus->printpid != GPID_NONE)
+    return TRUE;                //still typesetting, check again later
+  ThumbnailPool.resume_id = 0;
+  ThumbnailPool.stopped = FALSE;
+#ifndef G_OS_WIN32
+  signal_thumbnail_jobs (SIGCONT);
+#endif
+  launch_thumbnail_jobs ();
+  return FALSE;
+}
+
+/* stop the thumbnail pool while an interactive typeset runs, it resumes by itself once the print process has finished */
+void
+thumbnail_pool_pause (void)
+{
+  if (ThumbnailPool.jobs == NULL || ThumbnailPool.stopped)
+    return;
+  ThumbnailPool.stopped = TRUE;
+#ifndef G_OS_WIN32
+  signal_thumbnail_jobs (SIGSTOP);
+#endif
+  ThumbnailPool.resume_id = g_timeout_add (250, (GSourceFunc) resume_thumbnail_pool, NULL);
+}
+
+/* give each score waiting on job a thumbnailer of its own that writes its thumbnails directly, and drop the job */
+static void
+requeue_thumbnail_job (ThumbnailJob * job)
+{
+  GList *g;
+  for (g = job->targets; g; g = g->next)
+    {
+      ThumbnailTarget *target = (ThumbnailTarget *) g->data;
+      spawn_thumbnailer (target->filename);
+    }
+  g_hash_table_remove (ThumbnailPool.jobs, job->checksum);
+  free_thumbnail_job (job);
+}
+
+/* on exit nothing will be left to scale the renders of the pool, so the running jobs are ended and
+ * the scores of every job, running or not yet started, are given thumbnailers of their own */
+void
+thumbnail_pool_shutdown (void)
+{
+  ThumbnailJob *job;
+  GList *running, *g;
+  if (ThumbnailPool.jobs == NULL)
+    return;
+  if (ThumbnailPool.resume_id)
+    g_source_remove (ThumbnailPool.resume_id);
+  ThumbnailPool.resume_id = 0;
+#ifndef G_OS_WIN32
+  if (ThumbnailPool.stopped)
+    signal_thumbnail_jobs (SIGCONT);
+#endif
+  while ((job = (ThumbnailJob *) g_queue_pop_head (ThumbnailPool.waiting)))
+    requeue_thumbnail_job (job);
+  running = g_hash_table_get_values (ThumbnailPool.jobs);
+  for (g = running; g; g = g->next)
+    {
+      job = (ThumbnailJob *) g->data;
+      g_source_remove (job->watch);
+#ifndef G_OS_WIN32
+      kill (-job->pid, SIGTERM);        //the whole process group, see lower_priority ()
+#endif
+      g_spawn_close_pid (job->pid);
+      ThumbnailPool.running--;
+      requeue_thumbnail_job (job);
+    }
+  g_list_free (running);
+}
+
+/* queue making the thumbnails of filename under thumbname, reusing a render of identical contents if there is one */
+static void
+thumbnail_pool_add (const gchar * filename, const gchar * thumbname)
+{
+  gchar *contents;
+  gsize length;
+  gchar *checksum;
+  gchar *rendername;
+  gchar *render;
+  gchar *snapshot;
+  unsigned mtime;
+  ThumbnailJob *job;
+  ThumbnailTarget *target;
+  mtime = file_get_mtime ((gchar *) filename);  //before reading, so a save during the read leaves the thumbnails looking stale
+  if (!g_file_get_contents (filename, &contents, &length, NULL))
+    return;
+  checksum = g_compute_checksum_for_data (G_CHECKSUM_SHA256, (const guchar *) contents, length);
+  rendername = g_strconcat (checksum, ".png", NULL);
+  render = g_build_filename (get_thumbnail_store (), rendername, NULL);
+  g_free (rendername);
+  if (g_file_test (render, G_FILE_TEST_EXISTS) && thumbnails_from_render (render, filename, thumbname, mtime))
+    {
+      g_info ("Thumbnail for %s reused from %s", filename, render);
+      g_free (contents);
+      g_free (render);
+      g_free (checksum);
+      return;
+    }
+  if (Denemo.non_interactive)
+    {                           //there is no main loop to see the job finish
+      spawn_thumbnailer (filename);
+      g_free (contents);
+      g_free (render);
+      g_free (checksum);
+      return;
+    }
+  if (ThumbnailPool.jobs == NULL)
+    {
+      ThumbnailPool.jobs = g_hash_table_new (g_str_hash, g_str_equal);
+      ThumbnailPool.waiting = g_queue_new ();
+    }
+  job = (ThumbnailJob *) g_hash_table_lookup (ThumbnailPool.jobs, checksum);
+  snapshot = NULL;
+  if (job == NULL)
+    {
+      rendername = g_strconcat (checksum, ".denemo", NULL);
+      snapshot = g_build_filename (get_thumbnail_store (), rendername, NULL);
+      g_free (rendername);
+      if (!g_file_set_contents (snapshot, contents, length, NULL))
+        {
+          g_warning ("Thumbnailer: could not snapshot %s", filename);
+          g_free (snapshot);
+          g_free (contents);
+          g_free (render);
+          g_free (checksum);
+          return;
+        }
+    }
+  g_free (contents);
+  target = (ThumbnailTarget *) g_malloc (sizeof (ThumbnailTarget));
+  target->filename = g_strdup (filename);
+  target->thumbname = g_strdup (thumbname);
+  target->mtime = mtime;
+  if (job)
+    {                           //the same contents are already queued or being rendered
+      job->targets = g_list_append (job->targets, target);
+      g_free (render);
+      g_free (checksum);
+      return;
+    }
+  job = (ThumbnailJob *) g_malloc0 (sizeof (ThumbnailJob));
+  job->checksum = checksum;
+  job->render = render;
+  job->snapshot = snapshot;
+  job->targets = g_list_append (NULL, target);
+  job->pid = GPID_NONE;
+  g_hash_table_insert (ThumbnailPool.jobs, job->checksum, job);
+  g_queue_push_tail (ThumbnailPool.waiting, job);
+  launch_thumbnail_jobs ();
 }
 
 /***
@@ -817,11 +1189,10 @@ create_thumbnail (gboolean async, gchar * thumbnail_path)
   return FALSE;
 #endif
 
-  GError *err = NULL;
   gchar *thumbpathN = NULL;
   gchar *thumbname = NULL;
 
-  if (Denemo.printstatus->printpid != GPID_NONE)
+  if (!async && (Denemo.printstatus->printpid != GPID_NONE))
     return FALSE;
 
   if (!Denemo.project->filename->len)
@@ -878,6 +1249,13 @@ create_thumbnail (gboolean async, gchar * thumbnail_path)
 
   g_info ("Attempt to create thumbnail %s", thumbpathN);
 
+  if (async)
+    {
+      thumbnail_pool_add (Denemo.project->filename->str, thumbname);
+      g_free (thumbname);
+      return TRUE;
+    }
+
   gint saved = g_list_index (Denemo.project->movements, Denemo.project->movement);
   Denemo.project->movement = Denemo.project->movements->data;   //Thumbnail is from first movement
   //set selection to thumbnailselection, if not set, to the selection, if not set to first three measures of staff 1
@@ -899,35 +1277,8 @@ create_thumbnail (gboolean async, gchar * thumbnail_path)
   gchar *printname = get_thumb_printname ();
   Denemo.project->lilycontrol.excerpt = TRUE;
 
-  if (async)
-    {
-      gchar *arguments[] = {
-        g_build_filename (get_system_bin_dir (), "denemo", NULL),
-        "-n", "-a", "(d-CreateThumbnail #f)(d-Exit)",
-        Denemo.project->filename->str,
-        NULL
-      };
-      GPid pid;
-      gboolean success = g_spawn_async_with_pipes (NULL,        /* any dir */
-                                                   arguments, NULL,     /* env */
-                                                   G_SPAWN_SEARCH_PATH, NULL,   /* child setup func */
-                                                   NULL,        /* user data */
-                                                   &pid,        /* pid */
-                                                   NULL,        /* stdin */
-                                                   NULL,        /* stdout */
-                                                   NULL,        /* stderr */
-                                                   &err);
-      if (success)
-        g_info ("Launched thumbnail subprocess");
-      else
-        g_critical ("An error happened during thumbnail generation: %s", err->message);
-      g_child_watch_add (pid, thumbnail_finished, NULL);
-    }
-  else
-    {
-      export_png (printname, NULL, Denemo.project);
-      thumb_finished (thumbname);
-    }
+  export_png (printname, NULL, Denemo.project);
+  thumb_finished (thumbname);
 
   g_free (printname);
   Denemo.project->movement = g_list_nth_data (Denemo.project->movements, saved);
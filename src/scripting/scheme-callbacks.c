@@ -16,10 +16,12 @@
 #include "core/view.h"
 #include "core/graphicseditor.h"
 #include "core/keymapio.h"
+#include "core/profile.h"
 #include "audio/pitchentry.h"
 #include "command/lilydirectives.h"
 #include "audio/playback.h"
 #include "audio/audiointerface.h"
+#include "audio/audiotelemetry.h"
 
 #include "export/audiofile.h"
 #include "export/guidedimportmidi.h"
@@ -35,6 +37,7 @@
 #include "printview/printview.h"
 #include "printview/markupview.h"
 #include "display/calculatepositions.h"
+#include "display/draw.h"
 #include "source/source.h"
 #include "source/sourceaudio.h"
 
@@ -851,6 +854,100 @@ scheme_load_command (SCM command)
   return SCM_BOOL (ret);
 }
 
+/* load a file of scheme code, via a compiled copy where possible */
+SCM
+scheme_load_compiled (SCM filename)
+{
+  gboolean ret = FALSE;
+  if (scm_is_string (filename))
+    {
+      char *name = scm_to_locale_string (filename);
+      ret = !load_compiled_with_catch (name);
+      free (name);
+    }
+  return SCM_BOOL (ret);
+}
+
+SCM
+scheme_profile_start (SCM trace_file)
+{
+  gboolean ret;
+  if (scm_is_string (trace_file))
+    {
+      char *name = scm_to_locale_string (trace_file);
+      ret = profile_start (name);
+      free (name);
+    }
+  else
+    ret = profile_start (NULL);
+  return SCM_BOOL (ret);
+}
+
+SCM
+scheme_profile_stop (SCM optional)
+{
+  profile_stop ();
+  return SCM_BOOL_T;
+}
+
+SCM
+scheme_profile_dump (SCM optional)
+{
+  gchar *text = profile_dump ();
+  SCM ret = scm_from_locale_string (text);
+  g_free (text);
+  return ret;
+}
+
+SCM
+scheme_heap_in_use (SCM optional)
+{
+  glong heap = profile_heap_in_use ();
+  if (heap < 0)
+    return SCM_BOOL_F;
+  return scm_from_long (heap);
+}
+
+SCM
+scheme_audio_telemetry (SCM optional)
+{
+  gchar *text = audio_telemetry_report ();
+  SCM ret = scm_from_locale_string (text);
+  g_free (text);
+  return ret;
+}
+
+SCM
+scheme_audio_telemetry_reset (SCM optional)
+{
+  audio_telemetry_reset ();
+  return SCM_BOOL_T;
+}
+
+SCM
+scheme_audio_telemetry_record (SCM filename)
+{
+  gboolean ret;
+  if (scm_is_string (filename))
+    {
+      char *name = scm_to_locale_string (filename);
+      ret = audio_telemetry_record (name);
+      free (name);
+    }
+  else
+    ret = audio_telemetry_record (NULL);
+  return SCM_BOOL (ret);
+}
+
+SCM
+scheme_audio_diagnostics (SCM optional)
+{
+  if (Denemo.non_interactive)
+    return SCM_BOOL_F;
+  audio_telemetry_dialog ();
+  return SCM_BOOL_T;
+}
+
 SCM
 scheme_activate_menu_item (SCM menupath)
 {
@@ -961,15 +1058,12 @@ scheme_script_callback (SCM script, SCM params)
         {
           if (!is_action_name_builtin (name))
             {
-              gchar *paramvar = g_strdup_printf ("%s::params", name);
-              scm_c_define (paramvar, params);
-
               gchar *text = get_scheme_from_idx (idx);
               if (text)
                 {
                   //undo is a queue so this is the end :)
                   stage_undo (Denemo.project->movement, ACTION_STAGE_END);
-                  ret = SCM_BOOL (!call_out_to_guile (text));
+                  ret = SCM_BOOL (!call_out_to_script (idx, params));
                   stage_undo (Denemo.project->movement, ACTION_STAGE_START);
                 }
               else if (!Denemo.non_interactive)
@@ -979,8 +1073,6 @@ scheme_script_callback (SCM script, SCM params)
                 }
               else
                 g_warning ("Could not execute %s script", name);
-              scm_c_define (paramvar, SCM_BOOL_F);
-              g_free (paramvar);
             }
           if (name)
             free (name);
@@ -1284,6 +1376,19 @@ scheme_create_layout (SCM name)
     }
   return ret;
 }
+
+SCM
+scheme_check_standard_layouts (SCM optional)
+{
+  gchar *report = check_standard_scoreblocks ();
+  SCM ret;
+  if (report == NULL)
+    return SCM_BOOL_F;
+  ret = scm_from_locale_string (report);
+  g_free (report);
+  return ret;
+}
+
 SCM
 scheme_set_pending_layout (SCM name)
 {
@@ -2792,6 +2897,14 @@ scheme_syllable_count (void)
   return SCM_BOOL_F;
 }
 
+SCM
+scheme_syllables_before_measure (SCM measure)
+{
+  if (!scm_is_integer (measure))
+    return SCM_BOOL_F;
+  return scm_from_int (staff_syllables_before (Denemo.project->movement, Denemo.project->movement->currentstaff, scm_to_int (measure)));
+}
+
 SCM
 scheme_typeset_lyrics_for_staff (SCM on)
 {
@@ -6629,6 +6742,21 @@ scheme_adjust_xes (SCM optional)
   return SCM_BOOL_T;
 }
 
+SCM
+scheme_draw_offscreen (SCM width, SCM height)
+{
+  cairo_surface_t *surface;
+  cairo_t *cr;
+  if (!scm_is_integer (width) || !scm_is_integer (height) || scm_to_int (width) <= 0 || scm_to_int (height) <= 0)
+    return SCM_BOOL_F;
+  surface = cairo_image_surface_create (CAIRO_FORMAT_ARGB32, scm_to_int (width), scm_to_int (height));
+  cr = cairo_create (surface);
+  draw_score_offscreen (cr, scm_to_int (width), scm_to_int (height));
+  cairo_destroy (cr);
+  cairo_surface_destroy (surface);
+  return SCM_BOOL_T;
+}
+
 static gint
 flash_cursor (void)
 {
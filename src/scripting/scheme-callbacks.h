@@ -53,6 +53,15 @@ SCM scheme_get_padding (void);
 SCM scheme_get_relative_font_size (void);
 SCM scheme_initialize_script (SCM);
 SCM scheme_load_command (SCM);
+SCM scheme_load_compiled (SCM filename);
+SCM scheme_profile_start (SCM trace_file);
+SCM scheme_profile_stop (SCM optional);
+SCM scheme_profile_dump (SCM optional);
+SCM scheme_heap_in_use (SCM optional);
+SCM scheme_audio_telemetry (SCM optional);
+SCM scheme_audio_telemetry_reset (SCM optional);
+SCM scheme_audio_telemetry_record (SCM filename);
+SCM scheme_audio_diagnostics (SCM optional);
 SCM scheme_activate_menu_item (SCM);
 SCM scheme_locate_dotdenemo (SCM);
 SCM scheme_get_type (SCM);
@@ -80,6 +89,7 @@ SCM scheme_staff_to_voice (SCM);
 SCM scheme_voice_to_staff (SCM);
 SCM scheme_is_voice (void);
 SCM scheme_adjust_xes (SCM);
+SCM scheme_draw_offscreen (SCM width, SCM height);
 SCM scheme_highlight_cursor (SCM);
 SCM scheme_get_nonprinting (SCM);
 SCM scheme_set_nonprinting (SCM);
@@ -327,6 +337,7 @@ SCM scheme_take_snapshot (SCM);
 SCM scheme_select_default_layout (void);
 SCM scheme_delete_layout (SCM name);
 SCM scheme_create_layout (SCM name);
+SCM scheme_check_standard_layouts (SCM optional);
 SCM scheme_set_pending_layout (SCM name);
 SCM scheme_get_layout_id (void);
 SCM scheme_get_current_staff_layout_id (void);
@@ -383,6 +394,7 @@ SCM scheme_synchronize_lyric_cursor (SCM offset);
 SCM scheme_insert_text_in_verse (SCM);
 SCM scheme_typeset_lyrics_for_staff (SCM);
 SCM scheme_syllable_count ();
+SCM scheme_syllables_before_measure (SCM measure);
 SCM scheme_get_verse (SCM);
 SCM scheme_get_verse_number (SCM number);
 SCM scheme_put_verse (SCM);
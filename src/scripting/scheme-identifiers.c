@@ -76,6 +76,15 @@ create_scheme_identfiers (void)
   /* install the scheme functions for calling extra Denemo functions created for the scripting interface */
   install_scm_function (1, "Takes a command name. called by a script if it requires initialization the initialization script is expected to be in init.scm in the menupath of the command passed in.", DENEMO_SCHEME_PREFIX "InitializeScript", scheme_initialize_script);
   install_scm_function (1, " pass in a path (from below menus) to a command script. Loads the command from .denemo or system if it can be found. It is used at startup in .denemo files like ReadingNoteNames.denemo which executes (d-LoadCommand \"MainMenu/Educational/ReadingNoteNames\") to ensure that the command it needs is in the command set.", DENEMO_SCHEME_PREFIX "LoadCommand", scheme_load_command);
+  install_scm_function (0, "Takes the path to a file of scheme code and loads it, from a compiled copy kept in the user's .denemo directory where Guile can compile it, recompiling the copy if the file has changed. Returns #f if the file could not be loaded.", DENEMO_SCHEME_PREFIX "LoadCompiled", scheme_load_compiled);
+  install_scm_function (0, "Starts profiling, forgetting any profile taken before. The commands run and the busiest parts of Denemo (drawing, layout, export, the scheme interpreter and the audio callbacks) are counted and timed until d-ProfileStop. Takes an optional file name to which each call is written as it ends, in the Chrome trace event format. Returns #f if the file could not be opened.", DENEMO_SCHEME_PREFIX "ProfileStart", scheme_profile_start);
+  install_scm_function (0, "Stops profiling started by d-ProfileStart, closing the trace file if any. The profile is kept for d-ProfileDump.", DENEMO_SCHEME_PREFIX "ProfileStop", scheme_profile_stop);
+  install_scm_function (0, "Returns a description of the profile taken since d-ProfileStart as a string: for each command or part of Denemo the number of calls, the wall clock and processor time taken in total, on average and at most, the heap left allocated and histograms of the times.", DENEMO_SCHEME_PREFIX "ProfileDump", scheme_profile_dump);
+  install_scm_function (0, "Returns the number of bytes of heap in use, or #f if they cannot be measured on this system. Unlike d-ProfileDump it does not need profiling to be on.", DENEMO_SCHEME_PREFIX "HeapInUse", scheme_heap_in_use);
+  install_scm_function (0, "Returns a description of the audio and MIDI callbacks made since Denemo started or d-AudioTelemetryReset as a string: for each driver how long its callbacks took (percentiles, the longest and a histogram) against the period of audio they had to produce, the xruns reported, the events dispatched, how full the playback queue was and the rubberband backlog; and for each queue the immediate events dropped and the times there was too little source audio to mix.", DENEMO_SCHEME_PREFIX "AudioTelemetry", scheme_audio_telemetry);
+  install_scm_function (0, "Forgets the audio telemetry collected so far, see d-AudioTelemetry.", DENEMO_SCHEME_PREFIX "AudioTelemetryReset", scheme_audio_telemetry_reset);
+  install_scm_function (0, "Takes a file name and writes a line for each audio or MIDI callback to it, giving the time, driver, duration and period in microseconds, frames, events dispatched, playback queue fill, rubberband backlog and whether there was an xrun. Without a file name stops the recording. Returns #f if the file could not be opened.", DENEMO_SCHEME_PREFIX "AudioTelemetryRecord", scheme_audio_telemetry_record);
+  install_scm_function (0, "Opens a dialog showing the audio telemetry (see d-AudioTelemetry), refreshed while it is open.", DENEMO_SCHEME_PREFIX "AudioDiagnostics", scheme_audio_diagnostics);
 
   install_scm_function (1, "Takes a string, a menu path (from below menus). It executes the command for that menu item. Returns #f for no menu item.", DENEMO_SCHEME_PREFIX "ActivateMenuItem", scheme_activate_menu_item);
 
@@ -115,6 +124,7 @@ create_scheme_identfiers (void)
   install_scm_function (0, "Returns #f if the current staff is not a voice else true", DENEMO_SCHEME_PREFIX "IsVoice", scheme_is_voice);
 
   install_scm_function (0, "Adjusts the horizontal (x-) positioning of notes etc after paste", DENEMO_SCHEME_PREFIX "AdjustXes", scheme_adjust_xes);
+  install_scm_function (2, "Takes a width and height in pixels and draws the score as the Denemo Display would show it onto an image of that size, without needing a window. The image is discarded; this is for timing the drawing. Returns #f if the size is not valid.", DENEMO_SCHEME_PREFIX "DrawOffscreen", scheme_draw_offscreen);
 
   install_scm_function (0, "Turn highlighting of cursor off/on returning #t, or given a boolean parameter sets the highlighting returning the previous value", DENEMO_SCHEME_PREFIX "HighlightCursor", scheme_highlight_cursor);
 
@@ -1200,6 +1210,7 @@ create_scheme_identfiers (void)
   install_scm_function (0, "Creates the default layout.", DENEMO_SCHEME_PREFIX "SelectDefaultLayout", scheme_select_default_layout);
   install_scm_function (1, "Sets the pending layout id to the layout name passed - resets to no pending layout if no name passed. Conditional directives will apply depending on the pending layout when set.", DENEMO_SCHEME_PREFIX "SetPendingLayout", scheme_set_pending_layout);
   install_scm_function (1, "Creates a custom layout from the currently selected (standard). Uses the passed name for the new layout. Returns #f if nothing happened.", DENEMO_SCHEME_PREFIX "CreateLayout", scheme_create_layout);
+  install_scm_function (0, "Checks that the LilyPond generated from the score for each standard layout is the same as that held by the widgets of the layout in the Score Layout window, building them if need be. Returns an empty string if they agree, otherwise a description of the differences, or #f if the widgets cannot be built.", DENEMO_SCHEME_PREFIX "CheckStandardLayouts", scheme_check_standard_layouts);
   install_scm_function (1, "Deletes a custom layout of the passed name. Returns #f if no layout with passed name.", DENEMO_SCHEME_PREFIX "DeleteLayout", scheme_delete_layout);
   install_scm_function (0, "Returns the id of the currently selected score layout (see View->Score Layout). Returns #f if no layout is selected.", DENEMO_SCHEME_PREFIX "GetLayoutId", scheme_get_layout_id);
   install_scm_function (0, "Returns the id of a score layout for typesetting the part for the current staff. Returns #f if not a primary voice.", DENEMO_SCHEME_PREFIX "GetCurrentStaffLayoutId", scheme_get_current_staff_layout_id);
@@ -1278,6 +1289,7 @@ create_scheme_identfiers (void)
 
   install_scm_function (0, "Gets the number of current verse of the current staff or #f if none. With an integer parameter sets the verse to that number.", DENEMO_SCHEME_PREFIX "GetVerseNumber", scheme_get_verse_number);
   install_scm_function (0, "Gets the number of lyric syllables in the current staff up to the cursor position.", DENEMO_SCHEME_PREFIX "SyllableCount", scheme_syllable_count);
+  install_scm_function (1, "Takes a measure number, returns the number of lyric syllables in the current staff before that measure as used for placing the lyrics in the display, negated if the measure starts inside a slur.", DENEMO_SCHEME_PREFIX "SyllablesBeforeMeasure", scheme_syllables_before_measure);
   install_scm_function (0, "Moves the lyric cursor to match the current Denemo Cursor position (offset by an optional integer parameter), switching the keyboard input to the lyrics pane", DENEMO_SCHEME_PREFIX "SynchronizeLyricCursor", scheme_synchronize_lyric_cursor);
   install_scm_function (1, "Inserts passed text at the lyric cursor in the lyrics pane, returns #f if no verse at cursor", DENEMO_SCHEME_PREFIX "InsertTextInVerse", scheme_insert_text_in_verse);
   install_scm_function (0, "Puts the passed string as the current verse of the current staff", DENEMO_SCHEME_PREFIX "PutVerse", scheme_put_verse);
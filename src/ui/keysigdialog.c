@@ -148,7 +148,7 @@ insert_keysig (keysig_data * kdata)
         {
           for (curstaff = si->thescore; curstaff; curstaff = curstaff->next)
             {
-              curmeasure = g_list_nth (staff_first_measure_node (curstaff), si->currentmeasurenum - 1);
+              curmeasure = staff_nth_measure_node (curstaff, si->currentmeasurenum - 1);
               if (curmeasure)
                 {
                     if (curmeasure == si->currentmeasure)
@@ -161,21 +161,15 @@ insert_keysig (keysig_data * kdata)
                             ((DenemoMeasure*)curmeasure->data)->objects = g_list_append ((objnode *) ((DenemoMeasure*)curmeasure->data)->objects, newkey = dnm_newkeyobj ((tokey - mode), isminor, mode));
                     }
                     newkey->keysig = newkey->object;
-                    cache_measure (curmeasure); //to give the new keysig cached values
-                    update_keysig_cache (curmeasure, g_list_find (((DenemoMeasure*)curmeasure->data)->objects, newkey));  //to update everything beyond the newkey
+                    staff_update_context (curstaff, curmeasure); //cache the new keysig up to the next one
                     if (curmeasure == si->currentmeasure)
                         si->currentobject = g_list_nth ((objnode *) ((DenemoMeasure*)curmeasure->data)->objects, si->cursor_x);
-                    staff_show_which_accidentals ((DenemoStaff *) curstaff->data);
                 }
             }                   /* End for all staffs*/
         }                       /* End if check button all staffs*/
       else
         {
-          object_insert (Denemo.project, newkey = dnm_newkeyobj (tokey - mode, isminor, mode));
-          newkey->keysig = newkey->object;
-          cache_measure (si->currentmeasure); //to give the new keysig cached values
-          update_keysig_cache (si->currentmeasure, g_list_find (((DenemoMeasure*)si->currentmeasure->data)->objects, newkey)); //to update everything beyond the newkey
-          staff_show_which_accidentals ((DenemoStaff *) si->currentstaff->data);
+          object_insert (Denemo.project, newkey = dnm_newkeyobj (tokey - mode, isminor, mode));//this updates the cached context up to the next keysig
         }
       si->cursor_appending = FALSE;
       if (newkey)
@@ -355,14 +349,16 @@ button_response (GtkWidget * dialog, gint response_id, keysig_data * data)
   if (response_id == GTK_RESPONSE_ACCEPT)
     {
       if (data->initial)
-        set_keysig (data);
+        {
+          set_keysig (data);
+          cache_all ();
+        }
       else
         {
           if (gui->movement->currentobject && ((DenemoObject *) gui->movement->currentobject->data)->type == KEYSIG)
             gui->movement->cursor_appending?deletepreviousobject(NULL, NULL):deleteobject (NULL, NULL);
           insert_keysig (data);
         }
-      cache_all ();// this may be overkill, but if a keysig change is being placed immediately after a clef change then the object does not have a clef cached on it.        
       score_status (gui, TRUE);
       displayhelper (gui);
     }
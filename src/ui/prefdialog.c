@@ -143,6 +143,7 @@ struct callbackdata
   GtkWidget *overlays;
   GtkWidget *enable_thumbnails;
   GtkWidget *opensources;
+  GtkWidget *project_cache;
   GtkWidget *ignorescripts;
   GtkWidget *continuous;
 
@@ -284,6 +285,7 @@ set_preferences (struct callbackdata *cbdata)
     ASSIGNBOOLEAN (overlays)
     ASSIGNBOOLEAN (enable_thumbnails)
     ASSIGNBOOLEAN (opensources)
+    ASSIGNBOOLEAN (project_cache)
     ASSIGNBOOLEAN (ignorescripts)
     ASSIGNBOOLEAN (continuous)
     ASSIGNINT (resolution)
@@ -649,6 +651,7 @@ preferences_change (GtkAction * action, DenemoScriptParam * param)
   INTENTRY_LIMITS (_("Excerpt Resolution"), resolution, 72, 600);
   BOOLEANENTRY (_("Enable Thumbnails"), enable_thumbnails);
   BOOLEANENTRY (_("Auto Open Sources on File Load"), opensources);
+  BOOLEANENTRY (_("Keep a Cache Beside Scores to Open Them Faster"), project_cache);
   BOOLEANENTRY (_("Ignore Scheme Scripts on File Load"), ignorescripts);
   INTENTRY_LIMITS (_("Max recent files"), maxhistory, 0, 100);
   TEXTENTRY (_("User Name"), username)
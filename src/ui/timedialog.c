@@ -109,7 +109,7 @@ insert_timesig (DenemoMovement * si, DenemoStaff * curstaffstruct, gint time1, g
       if (((DenemoStaff *) curstaff->data)->is_parasite)
         continue;
 
-      curmeasure = g_list_nth (staff_first_measure_node (curstaff), si->currentmeasurenum - 1);
+      curmeasure = staff_nth_measure_node (curstaff, si->currentmeasurenum - 1);
       /* First, look to see if there already is a time signature change at
          the beginning of this measure. If so, delete it first. */
       if (!curmeasure)
@@ -142,8 +142,7 @@ insert_timesig (DenemoMovement * si, DenemoStaff * curstaffstruct, gint time1, g
           else
             si->currentobject = g_list_nth ((objnode *) ((DenemoMeasure *)curmeasure->data)->objects, si->cursor_x);
         }
-      staff_beams_and_stems_dirs ((DenemoStaff *) curstaff->data);
-      update_timesig_cache (curmeasure);
+      staff_update_context (curstaff, curmeasure);
     }
 
 }
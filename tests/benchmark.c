@@ -0,0 +1,495 @@
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <string.h>
+#include <config.h>
+#include "common.h"
+
+/* Benchmarks time the main operations of Denemo on large scores generated
+ * here, so that no fixture has to be kept for them. The scores are the same
+ * from one run to the next, so the times can be compared over time: they are
+ * written as JSON (to benchmark.json, or the file given by --json FILE) for
+ * tracking. A small score is checked in the normal test run, the large ones
+ * are only timed in performance mode (./benchmark -m perf).
+ *
+ * Each operation also records the change in the heap in use, so open-xml
+ * gives the memory taken by the score. To compare a change with the tree
+ * before it, run the benchmark on a build of the old tree with --json FILE,
+ * then on the new one with --baseline FILE: the time and heap of each
+ * operation are reported beside those of the baseline. --denemo PATH runs
+ * another build of Denemo; operations it has no command for are left out.
+ */
+
+static gchar* fixtures_dir = NULL;
+static gchar* temp_dir = NULL;
+static gchar* json_file = NULL;
+static GString* json_results = NULL;
+static const gchar* denemo = DENEMO;
+static GHashTable* baseline = NULL;     /* "score operation" to BaselineResult, from --baseline FILE */
+
+typedef struct
+{
+  gdouble seconds;              /* negative if not timed */
+  gint64 heap;                  /* bytes, G_MININT64 if not measured */
+} BaselineResult;
+
+typedef struct
+{
+  const gchar* name;
+  gint staffs;
+  gint measures;
+  gint density;                 /* chords per beat: 1, 2 or 4 */
+  const gchar* musicxml;        /* fixture imported to time the MusicXML import */
+} BenchmarkScore;
+
+static const BenchmarkScore small_score = {"small", 2, 8, 2, "trivial.mxml"};
+static const BenchmarkScore large_scores[] = {
+  {"medium", 4, 64, 2, "MozaVeilSample.mxml"},
+  {"large", 8, 128, 4, "ActorPreludeSample.mxml"},
+  {"orchestral", 24, 128, 2, "ActorPreludeSample.mxml"},
+  /* as many measures on many staffs as on one: the staffs are exported in parallel,
+     so the ratio of the export times is the speedup, as is that of export-midi-serial
+     to export-midi on the same score */
+  {"many-staffs", 96, 32, 2, "ActorPreludeSample.mxml"},
+  {"one-staff", 1, 3072, 2, "ActorPreludeSample.mxml"}
+};
+
+/* the operations timed, in the order they are run */
+static const gchar* operations[] = {
+  "open-xml", "find-xes", "draw-score", "save-xml", "export-lilypond",
+  "export-midi", "export-midi-serial", "take-snapshot", "undo", "copy", "paste",
+  "import-musicxml"
+};
+
+/*******************************************************************************
+ * GENERATOR
+ ******************************************************************************/
+
+static guint32 seed;
+
+/* a pseudo-random number below n, the same sequence on every platform */
+static guint
+next_random(guint n)
+{
+  seed = seed * 1103515245 + 12345;
+  return ((seed >> 16) & 0x7fff) % n;
+}
+
+static void
+write_chord(GString* xml, guint* id, const gchar* base, gint lowest, guint chords)
+{
+  gint pitch = lowest + next_random(10);
+  gint notes = 1 + next_random(3);
+  gint i;
+
+  g_string_append_printf(xml, "            <chord show=\"true\" id=\"id%u\">\n", (*id)++);
+  g_string_append_printf(xml, "              <duration base=\"%s\"></duration>\n", base);
+  if(chords % 4 == 3)
+    g_string_append(xml,
+      "              <directives>\n"
+      "                <directive>\n"
+      "                  <tag>ToggleStaccato</tag>\n"
+      "                  <postfix>-.</postfix>\n"
+      "                  <display>.</display>\n"
+      "                </directive>\n"
+      "              </directives>\n");
+  g_string_append(xml, "              <notes>\n");
+  for(i = 0; i < notes; i++){
+    g_string_append_printf(xml, "                <note id=\"id%u\">\n", (*id)++);
+    g_string_append_printf(xml, "                  <middle-c-offset>%d</middle-c-offset>\n", pitch + 2 * i);
+    if(i == 0 && chords % 5 == 0)
+      g_string_append_printf(xml,
+        "                  <directives>\n"
+        "                    <directive>\n"
+        "                      <tag>Fingering</tag>\n"
+        "                      <postfix>-%u </postfix>\n"
+        "                      <display>%u</display>\n"
+        "                    </directive>\n"
+        "                  </directives>\n", 1 + chords % 5, 1 + chords % 5);
+    g_string_append(xml, "                </note>\n");
+  }
+  g_string_append(xml, "              </notes>\n            </chord>\n");
+}
+
+/** write_generated_score
+ * Writes a score of the given size in 4/4 time to filename: every beat has
+ * density chords of one to three notes, with a triplet in place of one beat
+ * in four, staccatos and fingerings scattered over the chords, and a verse of
+ * lyrics on every fourth staff. Returns the number of chords written.
+ */
+static guint
+write_generated_score(const gchar* filename, const BenchmarkScore* score)
+{
+  static const gchar* bases[] = {"quarter", "eighth", "eighth", "sixteenth", "sixteenth"};
+  GString* xml = g_string_new("");
+  guint id = 0, total = 0;
+  gint staff, measure, beat, i;
+
+  seed = 1;
+  g_string_append(xml,
+    "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+    "<score xmlns=\"http://denemo.org/xmlns/Denemo\" version=\"8\">\n"
+    "  <lilycontrol>\n"
+    "    <papersize>a4</papersize>\n"
+    "    <fontsize>18</fontsize>\n"
+    "    <orientation>1</orientation>\n"
+    "    <total-edit-time>0</total-edit-time>\n"
+    "  </lilycontrol>\n"
+    "  <movement-number>1</movement-number>\n"
+    "  <movement>\n"
+    "    <edit-info>\n"
+    "      <staffno>1</staffno>\n"
+    "      <measureno>1</measureno>\n"
+    "      <cursorposition>0</cursorposition>\n"
+    "      <tonalcenter>0</tonalcenter>\n"
+    "      <zoom>100</zoom>\n"
+    "      <system-height>100</system-height>\n"
+    "      <page-zoom>100</page-zoom>\n"
+    "      <page-system-height>100</page-system-height>\n"
+    "    </edit-info>\n"
+    "    <score-info>\n"
+    "      <tempo>\n"
+    "        <duration>\n"
+    "          <numerator>1</numerator>\n"
+    "          <denominator>4</denominator>\n"
+    "        </duration>\n"
+    "        <bpm>120</bpm>\n"
+    "      </tempo>\n"
+    "    </score-info>\n"
+    "    <staves>\n");
+  for(staff = 0; staff < score->staffs; staff++)
+    g_string_append_printf(xml, "      <staff id=\"staff%d\"></staff>\n", staff);
+  g_string_append(xml, "    </staves>\n    <voices>\n");
+
+  for(staff = 0; staff < score->staffs; staff++){
+    gboolean bass = staff % 2;
+    GString* verse = g_string_new("");
+    guint chords = 0;
+    GString* measures = g_string_new("");
+
+    for(measure = 0; measure < score->measures; measure++){
+      g_string_append(measures, "          <measure>\n");
+      for(beat = 0; beat < 4; beat++){
+        if(score->density > 1 && (measure + staff + beat) % 4 == 3){
+          g_string_append(measures,
+            "            <tuplet-start>\n"
+            "              <multiplier>\n"
+            "                <numerator>2</numerator>\n"
+            "                <denominator>3</denominator>\n"
+            "              </multiplier>\n"
+            "            </tuplet-start>\n");
+          for(i = 0; i < 3; i++){
+            write_chord(measures, &id, "eighth", bass ? -12 : 0, chords++);
+            g_string_append(verse, "la ");
+          }
+          g_string_append(measures, "            <tuplet-end></tuplet-end>\n");
+        }
+        else{
+          for(i = 0; i < score->density; i++){
+            write_chord(measures, &id, bases[score->density], bass ? -12 : 0, chords++);
+            g_string_append(verse, i % 2 ? "li " : "la ");
+          }
+        }
+      }
+      g_string_append(measures, "          </measure>\n");
+    }
+
+    g_string_append_printf(xml,
+      "      <voice id=\"voice%d\">\n"
+      "        <voice-info>\n"
+      "          <voice-name>Staff %d</voice-name>\n"
+      "          <first-measure-number>1</first-measure-number>\n"
+      "        </voice-info>\n"
+      "        <initial-voice-params>\n"
+      "          <staff-ref staff=\"staff%d\"></staff-ref>\n"
+      "          <clef name=\"%s\"></clef>\n"
+      "          <key-signature>\n"
+      "            <modal-key-signature note-name=\"%s\" mode=\"major\"></modal-key-signature>\n"
+      "          </key-signature>\n"
+      "          <time-signature>\n"
+      "            <simple-time-signature>\n"
+      "              <numerator>4</numerator>\n"
+      "              <denominator>4</denominator>\n"
+      "            </simple-time-signature>\n"
+      "          </time-signature>\n"
+      "        </initial-voice-params>\n"
+      "        <voice-props>\n"
+      "          <number-of-lines>5</number-of-lines>\n"
+      "          <voice-control>1</voice-control>\n"
+      "          <transpose>0</transpose>\n"
+      "          <instrument></instrument>\n"
+      "          <device-port>NONE</device-port>\n"
+      "          <volume>127</volume>\n"
+      "          <override_volume>0</override_volume>\n"
+      "          <mute>0</mute>\n"
+      "          <midi_prognum>0</midi_prognum>\n"
+      "          <midi_channel>%d</midi_channel>\n"
+      "          <hasfigures>0</hasfigures>\n"
+      "          <hasfakechords>0</hasfakechords>\n",
+      staff, staff + 1, staff, bass ? "bass" : "treble", staff % 3 ? "G" : "D", staff % 16);
+    if(staff % 4 == 0)
+      g_string_append_printf(xml, "          <verses>\n            <verse>%s</verse>\n          </verses>\n", verse->str);
+    g_string_append_printf(xml, "        </voice-props>\n        <measures>\n%s        </measures>\n      </voice>\n", measures->str);
+    total += chords;
+    g_string_free(measures, TRUE);
+    g_string_free(verse, TRUE);
+  }
+  g_string_append(xml, "    </voices>\n  </movement>\n</score>\n");
+
+  g_assert(g_file_set_contents(filename, xml->str, xml->len, NULL));
+  g_string_free(xml, TRUE);
+  return total;
+}
+
+/*******************************************************************************
+ * SETUP AND TEARDOWN
+ ******************************************************************************/
+
+static void
+setup(gpointer fixture, gconstpointer data)
+{
+  if(!g_file_test(temp_dir, G_FILE_TEST_EXISTS)){
+    if(g_mkdir(temp_dir, 0777) < 0)
+      g_warning("Could not create %s", temp_dir);
+  }
+}
+
+static void
+teardown(gpointer fixture, gconstpointer data)
+{
+  delete_if_exists(temp_dir);
+}
+
+/*******************************************************************************
+ * TEST FUNCTIONS
+ ******************************************************************************/
+
+/** report_against_baseline
+ * Prints the time and heap change of an operation beside those recorded for
+ * it in the baseline, if there are any.
+ */
+static void
+report_against_baseline(const BenchmarkScore* score, const gchar* operation, gdouble seconds, gint64 heap)
+{
+  gchar* key = g_strdup_printf("%s %s", score->name, operation);
+  BaselineResult* before = g_hash_table_lookup(baseline, key);
+
+  if(before && before->seconds > 0)
+    g_test_print("%s on %s: %.3f seconds against %.3f in the baseline (%.0f%%)\n",
+                 operation, score->name, seconds, before->seconds, 100.0 * seconds / before->seconds);
+  if(before && before->heap != G_MININT64 && heap != G_MININT64)
+    g_test_print("%s on %s: heap changed by %" G_GINT64_FORMAT " bytes against %" G_GINT64_FORMAT " in the baseline (%+" G_GINT64_FORMAT " bytes)\n",
+                 operation, score->name, heap, before->heap, heap - before->heap);
+  g_free(key);
+}
+
+/** test_generated_score
+ * Generates a score and runs each operation on it in one Denemo, which times
+ * them itself so that startup is left out. Checks that every operation was
+ * run and wrote what it should, and records the times.
+ */
+static void
+test_generated_score(gpointer fixture, gconstpointer data)
+{
+  const BenchmarkScore* score = (const BenchmarkScore*) data;
+  gchar* input = g_build_filename(temp_dir, "generated.denemo", NULL);
+  gchar* output = g_build_filename(temp_dir, "output", NULL);
+  gchar* times = g_build_filename(temp_dir, "times", NULL);
+  gchar* musicxml = g_build_filename(fixtures_dir, "mxml", score->musicxml, NULL);
+  gchar* scheme = g_strdup_printf(
+    "(define benchmark-port (open-output-file \"%s\"))"
+    "(define (heap-in-use) (and (defined? 'd-HeapInUse) (d-HeapInUse)))"
+    "(define (benchmark name command thunk)"
+    "  (if (defined? command)"
+    "    (let* ((heap (heap-in-use)) (start (get-internal-real-time)) (seconds (begin (thunk) (exact->inexact (/ (- (get-internal-real-time) start) internal-time-units-per-second)))) (after (heap-in-use)))"
+    "      (format benchmark-port \"~a\\t~a\\t~a\\n\" name seconds (if (and heap after) (- after heap) #f)))"
+    "    (format benchmark-port \"~a\\t#f\\t#f\\n\" name)))"
+    "(benchmark \"open-xml\" 'd-Open (lambda () (d-Open \"%s\")))"
+    "(benchmark \"find-xes\" 'd-AdjustXes (lambda () (d-AdjustXes)))"
+    "(benchmark \"draw-score\" 'd-DrawOffscreen (lambda () (d-DrawOffscreen 1600 1200)))"
+    "(benchmark \"save-xml\" 'd-SaveAs (lambda () (d-SaveAs \"%s.denemo\")))"
+    "(benchmark \"export-lilypond\" 'd-ExportMUDELA (lambda () (d-ExportMUDELA \"%s.ly\")))"
+    "(benchmark \"export-midi\" 'd-ExportMIDI (lambda () (d-ExportMIDI \"%s.mid\")))"
+    "(setenv \"DENEMO_MIDI_THREADS\" \"1\")"
+    "(benchmark \"export-midi-serial\" 'd-ExportMIDI (lambda () (d-ExportMIDI \"%s-serial.mid\")))"
+    "(unsetenv \"DENEMO_MIDI_THREADS\")"
+    "(benchmark \"take-snapshot\" 'd-TakeSnapshot (lambda () (d-TakeSnapshot)))"
+    "(benchmark \"undo\" 'd-Undo (lambda () (d-Undo)))"
+    "(d-MoveToBeginning)(d-SetMark)(d-MoveToEnd)"
+    "(benchmark \"copy\" 'd-Copy (lambda () (d-Copy)))"
+    "(benchmark \"paste\" 'd-Paste (lambda () (d-Paste)))"
+    "(d-SetSaved #t)"
+    "(benchmark \"import-musicxml\" 'd-ImportMusicXml (lambda () (d-ImportMusicXml \"%s\")))"
+    "(close-port benchmark-port)"
+    "(d-SetSaved #t)(d-Quit)",
+    times, input, output, output, output, output, musicxml);
+  gchar* argv[] = {(gchar*) denemo, "-n", "-e", "-a", scheme, NULL};
+  gchar* contents = NULL;
+  gchar* midi = NULL;
+  gchar* serial_midi = NULL;
+  gsize midi_length, serial_midi_length;
+  gchar** lines;
+  guint chords, i;
+  gint status;
+
+  chords = write_generated_score(input, score);
+  g_assert(g_spawn_sync(NULL, argv, NULL, G_SPAWN_STDOUT_TO_DEV_NULL | G_SPAWN_STDERR_TO_DEV_NULL, NULL, NULL, NULL, NULL, &status, NULL));
+  g_assert(g_spawn_check_exit_status(status, NULL));
+
+  for(i = 0; i < 4; i++){
+    static const gchar* extensions[] = {".denemo", ".ly", ".mid", "-serial.mid"};
+    gchar* written = g_strconcat(output, extensions[i], NULL);
+    g_assert(g_file_test(written, G_FILE_TEST_EXISTS));
+    if(i == 2)
+      g_assert(g_file_get_contents(written, &midi, &midi_length, NULL));
+    else if(i == 3)
+      g_assert(g_file_get_contents(written, &serial_midi, &serial_midi_length, NULL));
+    g_free(written);
+  }
+  /* the tracks built on one thread must make the same file as on the pool */
+  g_assert_cmpuint(midi_length, ==, serial_midi_length);
+  g_assert(memcmp(midi, serial_midi, midi_length) == 0);
+  g_free(serial_midi);
+  g_free(midi);
+
+  g_assert(g_file_get_contents(times, &contents, NULL, NULL));
+  lines = g_strsplit(contents, "\n", -1);
+  g_assert_cmpuint(g_strv_length(lines), ==, G_N_ELEMENTS(operations) + 1);
+  for(i = 0; i < G_N_ELEMENTS(operations); i++){
+    gchar** fields = g_strsplit(lines[i], "\t", 3);
+    gchar* heap_json;
+    gdouble seconds;
+    gint64 heap;
+    g_assert_cmpuint(g_strv_length(fields), ==, 3);
+    g_assert_cmpstr(fields[0], ==, operations[i]);
+    if(!strcmp(fields[1], "#f")){
+      /* only another build of Denemo may lack the command for an operation */
+      g_assert(strcmp(denemo, DENEMO) != 0);
+      g_test_message("%s is not available in %s", operations[i], denemo);
+      g_strfreev(fields);
+      continue;
+    }
+    seconds = g_ascii_strtod(fields[1], NULL);
+    heap = strcmp(fields[2], "#f") ? g_ascii_strtoll(fields[2], NULL, 10) : G_MININT64;
+    heap_json = heap == G_MININT64 ? g_strdup("null") : g_strdup_printf("%" G_GINT64_FORMAT, heap);
+    if(g_test_perf ())
+      g_test_minimized_result(seconds, "%s on %s (%d staffs, %d measures, %u chords) took %.3f seconds, heap changed by %s bytes", operations[i], score->name, score->staffs, score->measures, chords, seconds, heap_json);
+    if(baseline)
+      report_against_baseline(score, operations[i], seconds, heap);
+    g_string_append_printf(json_results,
+      "%s    {\"score\": \"%s\", \"staffs\": %d, \"measures\": %d, \"density\": %d, \"chords\": %u, \"operation\": \"%s\", \"seconds\": %.6f, \"heap_bytes\": %s}",
+      json_results->len ? ",\n" : "", score->name, score->staffs, score->measures, score->density, chords, operations[i], seconds, heap_json);
+    g_free(heap_json);
+    g_strfreev(fields);
+  }
+
+  g_strfreev(lines);
+  g_free(contents);
+  g_free(scheme);
+  g_free(musicxml);
+  g_free(times);
+  g_free(output);
+  g_free(input);
+}
+
+/** read_baseline
+ * Reads the results written with --json by an earlier run, one to a line as
+ * write_json_results() writes them, into baseline. Results written before the
+ * heap was recorded have no heap_bytes.
+ */
+static void
+read_baseline(const gchar* filename)
+{
+  GRegex* result = g_regex_new("\"score\": \"([^\"]*)\".*\"operation\": \"([^\"]*)\", \"seconds\": ([0-9.]+)(, \"heap_bytes\": (-?[0-9]+))?", 0, 0, NULL);
+  gchar* contents = NULL;
+  gchar** lines;
+  gint i;
+
+  if(!g_file_get_contents(filename, &contents, NULL, NULL))
+    g_error("Could not read the baseline %s", filename);
+  baseline = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free);
+  lines = g_strsplit(contents, "\n", -1);
+  for(i = 0; lines[i]; i++){
+    GMatchInfo* match = NULL;
+    if(g_regex_match(result, lines[i], 0, &match)){
+      BaselineResult* before = g_new(BaselineResult, 1);
+      gchar* score = g_match_info_fetch(match, 1);
+      gchar* operation = g_match_info_fetch(match, 2);
+      gchar* seconds = g_match_info_fetch(match, 3);
+      gchar* heap = g_match_info_fetch(match, 5);
+      before->seconds = g_ascii_strtod(seconds, NULL);
+      before->heap = (heap && *heap) ? g_ascii_strtoll(heap, NULL, 10) : G_MININT64;
+      g_hash_table_insert(baseline, g_strdup_printf("%s %s", score, operation), before);
+      g_free(heap);
+      g_free(seconds);
+      g_free(operation);
+      g_free(score);
+    }
+    g_match_info_free(match);
+  }
+  g_strfreev(lines);
+  g_free(contents);
+  g_regex_unref(result);
+}
+
+/** write_json_results
+ * Writes the times recorded by the tests to json_file.
+ */
+static void
+write_json_results(void)
+{
+  GDateTime* now = g_date_time_new_now_utc();
+  gchar* date = g_date_time_format(now, "%Y-%m-%dT%H:%M:%SZ");
+  gchar* json = g_strdup_printf("{\n  \"version\": \"%s\",\n  \"date\": \"%s\",\n  \"perf\": %s,\n  \"results\": [\n%s\n  ]\n}\n",
+                                PACKAGE_VERSION, date, g_test_perf () ? "true" : "false", json_results->str);
+
+  if(!g_file_set_contents(json_file, json, -1, NULL))
+    g_warning("Could not write %s", json_file);
+  g_free(json);
+  g_free(date);
+  g_date_time_unref(now);
+}
+
+int
+main (int argc, char *argv[])
+{
+  gint i, result;
+
+  g_test_init (&argc, &argv, NULL);
+
+  for(i = 1; i < argc - 1; i++){
+    if(!strcmp(argv[i], "--json"))
+      json_file = g_strdup(argv[i + 1]);
+    else if(!strcmp(argv[i], "--baseline"))
+      read_baseline(argv[i + 1]);
+    else if(!strcmp(argv[i], "--denemo"))
+      denemo = argv[i + 1];
+  }
+
+  if(!g_file_test(denemo, G_FILE_TEST_EXISTS))
+    g_error("Denemo has not been compiled successfully");
+
+  if(!fixtures_dir)
+    fixtures_dir = g_build_filename(PACKAGE_SOURCE_DIR, "tests", FIXTURES_DIR, NULL);
+
+  if(!temp_dir)
+    temp_dir = g_build_filename(g_get_current_dir (), "benchmark-" TEMP_DIR, NULL);
+
+  if(!json_file)
+    json_file = g_build_filename(g_get_current_dir (), "benchmark.json", NULL);
+
+  json_results = g_string_new("");
+
+  g_test_add ("/benchmark/generated-small", void, &small_score, setup, test_generated_score, teardown);
+
+  if(g_test_perf ()){
+    for(i = 0; i < G_N_ELEMENTS(large_scores); i++){
+      gchar* test_case_path = g_strdup_printf("/benchmark/generated-%s", large_scores[i].name);
+      g_test_add (test_case_path, void, &large_scores[i], setup, test_generated_score, teardown);
+      g_free(test_case_path);
+    }
+  }
+
+  result = g_test_run ();
+  write_json_results();
+  return result;
+}
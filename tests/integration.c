@@ -1,6 +1,9 @@
 #include <glib.h>
 #include <glib/gstdio.h>
 #include <unistd.h>
+#include <utime.h>
+#include <string.h>
+#include <sys/wait.h>
 #include <config.h>
 #include "common.h"
 
@@ -64,6 +67,54 @@ get_basename(gchar* input){
   return basename;
 }
 
+static guint
+count_occurrences(const gchar* haystack, const gchar* needle){
+  guint count = 0;
+  const gchar* found = haystack;
+  while ((found = strstr(found, needle))){
+    count++;
+    found += strlen(needle);
+  }
+  return count;
+}
+
+/* MusicXML files may be in UTF-16, the saved files are in UTF-8 */
+static gchar*
+get_utf8_contents(const gchar* filename){
+  gchar* contents = NULL;
+  gsize length = 0;
+  g_assert(g_file_get_contents(filename, &contents, &length, NULL));
+  if(length >= 2 && (((guchar) contents[0] == 0xFE && (guchar) contents[1] == 0xFF) || ((guchar) contents[0] == 0xFF && (guchar) contents[1] == 0xFE))){
+    gchar* converted = g_convert(contents, length, "UTF-8", "UTF-16", NULL, NULL, NULL);
+    g_assert(converted != NULL);
+    g_free(contents);
+    contents = converted;
+  }
+  return contents;
+}
+
+/* the number of <note> elements of a MusicXML file with both a pitch and a
+ * type, which are the notes the importer keeps */
+static guint
+count_musicxml_notes(const gchar* contents){
+  guint count = 0;
+  const gchar* start = contents;
+  while ((start = strstr(start, "<note"))){
+    start += strlen("<note");
+    if(*start != ' ' && *start != '>')
+      continue;
+    const gchar* end = strstr(start, "</note>");
+    if(end == NULL)
+      break;
+    gchar* note = g_strndup(start, end - start);
+    if(strstr(note, "<pitch>") && strstr(note, "<type"))
+      count++;
+    g_free(note);
+    start = end;
+  }
+  return count;
+}
+
 static gboolean
 mkdir_if_not_exists(gchar* dir){
   if(!g_file_test(dir, G_FILE_TEST_EXISTS)){
@@ -74,6 +125,33 @@ mkdir_if_not_exists(gchar* dir){
   return TRUE;
 }
 
+/** spawn_denemo_with_environment
+ * Runs Denemo with the given arguments and environment and waits for it.
+ */
+static void
+spawn_denemo_with_environment(gchar** envp, gchar** argv)
+{
+  gint status;
+
+  g_assert(g_spawn_sync(NULL, argv, envp, G_SPAWN_STDOUT_TO_DEV_NULL | G_SPAWN_STDERR_TO_DEV_NULL, NULL, NULL, NULL, NULL, &status, NULL));
+  g_assert(g_spawn_check_exit_status(status, NULL));
+}
+
+/** spawn_denemo_at_home
+ * Runs Denemo with the given arguments and waits for it, with HOME set to
+ * home if that is not NULL, so that it keeps its user data there.
+ */
+static void
+spawn_denemo_at_home(const gchar* home, gchar** argv)
+{
+  gchar** envp = g_get_environ();
+
+  if(home)
+    envp = g_environ_setenv(envp, "HOME", home, TRUE);
+  spawn_denemo_with_environment(envp, argv);
+  g_strfreev(envp);
+}
+
 /*******************************************************************************
  * SETUP AND TEARDOWN
  ******************************************************************************/
@@ -224,10 +302,1279 @@ test_open_save_complex_file(gpointer fixture, gconstpointer data)
   g_free(filename);
 }
 
+/** test_export_lilypond
+ * Opens a file without the GUI and exports it as LilyPond, which generates the
+ * default score layout without building the Score Layout window.
+ */
+static void
+test_export_lilypond(gpointer fixture, gconstpointer data)
+{
+  const gchar* input = (const gchar*) data;
+  gchar* filename = g_path_get_basename(input);
+  gchar* base_name = get_basename(filename);
+  gchar* output_filename = g_strconcat(base_name, ".ly", NULL);
+  gchar* output = g_build_filename(temp_dir, output_filename, NULL);
+  gchar* contents = NULL;
+
+  g_test_print("Exporting %s to %s\n", input, output);
+  if (g_test_subprocess ())
+    {
+      gchar* scheme = g_strdup_printf("(d-ExportMUDELA \"%s\")(d-Quit)", output);
+      execl(DENEMO, DENEMO, "-n", "-e", "-a", scheme, input, NULL);
+      g_warn_if_reached ();
+    }
+  g_test_trap_subprocess (NULL, 0, 0);
+  g_test_trap_assert_passed ();
+
+  g_assert(g_file_get_contents(output, &contents, NULL, NULL));
+  g_assert(g_strstr_len(contents, -1, "\\score") != NULL);
+  g_free(contents);
+  g_remove(output);
+  g_free(output);
+  g_free(output_filename);
+  g_free(base_name);
+  g_free(filename);
+}
+
+/** test_import_mxml
+ * Imports a MusicXML file without the GUI, saves it and reopens the saved
+ * file. The saved file is compared to the reference if there is one; in any
+ * case it must have a staff for each part, the measures of the parts, and
+ * every pitched note of the MusicXML file.
+ */
+static void
+test_import_mxml(gpointer fixture, gconstpointer data)
+{
+  const gchar* input = (const gchar*) data;
+  gchar* filename = g_path_get_basename(input);
+  gchar* base_name = get_basename(filename);
+  gchar* output_filename = g_strconcat(base_name, ".denemo", NULL);
+  gchar* output = g_build_filename(temp_dir, "mxml", output_filename, NULL);
+  gchar* reference = g_build_filename(ref_dir, "mxml", output_filename, NULL);
+
+  g_test_print("Importing %s\n", input);
+  if (g_test_subprocess ())
+    {
+      gchar* scheme = g_strdup_printf("(d-SaveAs \"%s\")(d-Quit)", output);
+      execl(DENEMO, DENEMO, "-n", "-e", "-a", scheme, input, NULL);
+      g_warn_if_reached ();
+    }
+  g_test_trap_subprocess (NULL, 0, 0);
+  g_test_trap_assert_passed ();
+
+  g_assert(g_file_test(output, G_FILE_TEST_EXISTS));
+  if (g_test_subprocess ())
+    {
+      execl(DENEMO, DENEMO, "-n", "-e", output, NULL);
+      g_warn_if_reached ();
+    }
+  g_test_trap_subprocess (NULL, 0, 0);
+  g_test_trap_assert_passed ();
+
+  if(g_file_test(reference, G_FILE_TEST_EXISTS)){
+    g_test_print("Comparing %s with the reference %s\n", output, reference);
+    g_assert(compare_denemo_files(output, reference));
+  }
+
+  gchar* mxml = get_utf8_contents(input);
+  gchar* saved = get_utf8_contents(output);
+  guint parts = count_occurrences(mxml, "<score-part ");
+  guint part_measures = count_occurrences(mxml, "<measure ") / MAX(parts, 1);
+  guint staffs = count_occurrences(saved, "<voice id=");
+  guint measures = count_occurrences(saved, "<measure>") + count_occurrences(saved, "<measure ") + count_occurrences(saved, "<measure/>");
+  g_assert_cmpuint(parts, >, 0);
+  g_assert_cmpuint(staffs, >=, parts);
+  g_assert_cmpuint(measures, ==, staffs * part_measures);
+  g_assert_cmpuint(count_occurrences(saved, "<note id="), ==, count_musicxml_notes(mxml));
+
+  g_free(saved);
+  g_free(mxml);
+  g_remove(output);
+  g_free(reference);
+  g_free(output);
+  g_free(output_filename);
+  g_free(base_name);
+  g_free(filename);
+}
+
+/** test_import_mxml_keys
+ * Imports a MusicXML file in minor keys with a change to another minor key
+ * and then to a major key, and lists the key prevailing in each measure.
+ */
+static void
+test_import_mxml_keys(gpointer fixture, gconstpointer data)
+{
+  const gchar* input = (const gchar*) data;
+  gchar* report = g_build_filename(temp_dir, "keys.txt", NULL);
+  gchar* report_contents = NULL;
+  gchar* scheme = g_strdup_printf("(with-output-to-file \"%s\" (lambda () (write (map (lambda (n) (d-GoToPosition #f 1 n 1) (d-GetPrevailingKeysigName)) '(1 2 3)))))(d-Quit)", report);
+  gchar* argv[] = {DENEMO, "-n", "-e", "-a", scheme, (gchar*) input, NULL};
+
+  spawn_denemo_at_home(NULL, argv);
+  g_assert(g_file_get_contents(report, &report_contents, NULL, NULL));
+  g_assert_cmpstr(report_contents, ==, "(\"C Minor\" \"E Minor\" \"D\")");
+  g_free(report_contents);
+  g_free(scheme);
+  g_free(report);
+}
+
+/** test_import_midi
+ * Imports a MIDI file with a conductor track holding the time and key
+ * signatures and their changes and a track of notes, and lists the time and
+ * key signature and the objects of each measure of the notes' staff.
+ */
+static void
+test_import_midi(gpointer fixture, gconstpointer data)
+{
+  const gchar* input = (const gchar*) data;
+  gchar* report = g_build_filename(temp_dir, "midi.txt", NULL);
+  gchar* report_contents = NULL;
+  gchar* scheme = g_strdup_printf("(with-output-to-file \"%s\" (lambda () (display (d-GetStaffsInMovement)) (newline)"
+                                  " (let loop ((n 1)) (if (d-GoToPosition #f 2 n 1) (let* ((time (d-GetPrevailingTimesig)) (key (d-GetPrevailingKeysigName))"
+                                  " (objects (let next ((l '())) (let ((l (cons (or (d-GetNotes) (d-GetType)) l))) (if (d-NextObjectInMeasure) (next l) (reverse l))))))"
+                                  " (display (list n time key objects)) (newline) (loop (+ n 1)))))))(d-Quit)", report);
+  gchar* argv[] = {DENEMO, "-n", "-e", "-a", scheme, (gchar*) input, NULL};
+
+  spawn_denemo_at_home(NULL, argv);
+  g_assert(g_file_get_contents(report, &report_contents, NULL, NULL));
+  g_assert_cmpstr(report_contents, ==, "2\n"
+                                       "(1 4/4 G (c' d' e' fis'))\n"
+                                       "(2 4/4 G (g' a' b' c''))\n"
+                                       "(3 3/4 G (TIMESIG c'' b' a'))\n"
+                                       "(4 3/4 D Minor (KEYSIG bes' a' g'))\n");
+  g_free(report_contents);
+  g_free(scheme);
+  g_free(report);
+}
+
+/** test_standard_layout
+ * Opens a file and checks that the LilyPond generated from the score for the
+ * standard layout is the same as the LilyPond held by the widgets of the
+ * layout in the Score Layout window. The widgets need a display, so the test
+ * is skipped without one.
+ */
+static void
+test_standard_layout(gpointer fixture, gconstpointer data)
+{
+  gchar* input = (gchar*) data;
+  gchar* report = g_build_filename(temp_dir, "layout.txt", NULL);
+  gchar* scheme = g_strdup_printf("(with-output-to-file \"%s\" (lambda () (write (d-CheckStandardLayouts))))(d-Quit)", report);
+  gchar* argv[] = {DENEMO, "-e", "-a", scheme, input, NULL};
+  gchar* contents = NULL;
+
+  if(!g_getenv("DISPLAY") && !g_getenv("WAYLAND_DISPLAY")){
+    g_test_skip("No display to build the layout widgets on");
+    g_free(scheme);
+    g_free(report);
+    return;
+  }
+  g_test_print("Checking the standard layout of %s\n", input);
+  spawn_denemo_at_home(NULL, argv);
+
+  g_assert(g_file_get_contents(report, &contents, NULL, NULL));
+  g_assert_cmpstr(contents, ==, "\"\"");
+  g_free(contents);
+  g_free(scheme);
+  g_free(report);
+}
+
+/** test_undo_snapshot
+ * Deletes a staff, which snapshots the movement for undo, undoes it and checks
+ * the LilyPond exported afterwards is the same as before the deletion. The
+ * deletion is then redone from the movement the undo took out of the score,
+ * which is held for redo as the snapshot was, and undone again.
+ */
+static void
+test_undo_snapshot(gpointer fixture, gconstpointer data)
+{
+  const gchar* input = (const gchar*) data;
+  gchar* before = g_build_filename(temp_dir, "before.ly", NULL);
+  gchar* deleted = g_build_filename(temp_dir, "deleted.ly", NULL);
+  gchar* after = g_build_filename(temp_dir, "after.ly", NULL);
+  gchar* redone = g_build_filename(temp_dir, "redone.ly", NULL);
+  gchar* again = g_build_filename(temp_dir, "again.ly", NULL);
+  gchar* before_contents = NULL;
+  gchar* deleted_contents = NULL;
+  gchar* contents = NULL;
+
+  if (g_test_subprocess ())
+    {
+      gchar* scheme = g_strdup_printf("(d-ExportMUDELA \"%s\")(d-DeleteStaff)(d-ExportMUDELA \"%s\")(d-Undo)(d-ExportMUDELA \"%s\")"
+                                      "(d-Redo)(d-ExportMUDELA \"%s\")(d-Undo)(d-ExportMUDELA \"%s\")(d-Quit)",
+                                      before, deleted, after, redone, again);
+      execl(DENEMO, DENEMO, "-n", "-e", "-a", scheme, input, NULL);
+      g_warn_if_reached ();
+    }
+  g_test_trap_subprocess (NULL, 0, 0);
+  g_test_trap_assert_passed ();
+
+  g_assert(g_file_get_contents(before, &before_contents, NULL, NULL));
+  g_assert(g_file_get_contents(deleted, &deleted_contents, NULL, NULL));
+  g_assert_cmpstr(before_contents, !=, deleted_contents);
+  g_assert(g_file_get_contents(after, &contents, NULL, NULL));
+  g_assert_cmpstr(before_contents, ==, contents);
+  g_free(contents);
+  g_assert(g_file_get_contents(redone, &contents, NULL, NULL));
+  g_assert_cmpstr(deleted_contents, ==, contents);
+  g_free(contents);
+  g_assert(g_file_get_contents(again, &contents, NULL, NULL));
+  g_assert_cmpstr(before_contents, ==, contents);
+  g_free(contents);
+  g_free(before_contents);
+  g_free(deleted_contents);
+  g_free(again);
+  g_free(redone);
+  g_free(after);
+  g_free(deleted);
+  g_free(before);
+}
+
+/** test_measure_index
+ * Inserts and deletes measures in the middle of a staff after going to them,
+ * which builds the index of its measures, and lists the notes at the start of
+ * each measure going to it by number. The edited file is saved and reopened,
+ * with its index built afresh, and the list made again must be the same.
+ */
+static void
+test_measure_index(gpointer fixture, gconstpointer data)
+{
+  const gchar* input = (const gchar*) data;
+  const gchar* list = "(define (list-measures file) (with-output-to-file file (lambda () (let loop ((n 1)) (if (<= n (d-GetMeasuresInStaff)) (begin (display (if (d-GoToPosition #f #f n 1) (list (d-GetMeasureNumber) (d-GetNotes)) \"empty\")) (newline) (loop (+ n 1))))))))";
+  const gchar* edit = "(d-GoToPosition #f 1 3 1)(d-InsertMeasureBefore)(d-GoToPosition #f 1 5 1)(d-DeleteMeasure)(d-GoToPosition #f 1 2 1)(d-DeleteMeasure)(d-InsertMeasureAfter)(d-Undo)(d-GoToPosition #f 1 4 1)(d-InsertMeasureAfter)";
+  gchar* saved = g_build_filename(temp_dir, "edited.denemo", NULL);
+  gchar* edited = g_build_filename(temp_dir, "edited.txt", NULL);
+  gchar* reopened = g_build_filename(temp_dir, "reopened.txt", NULL);
+  gchar* edited_contents = NULL;
+  gchar* reopened_contents = NULL;
+  guint i;
+
+  for(i = 0; i < 2; i++){
+    gchar* scheme = i ? g_strdup_printf("%s(list-measures \"%s\")(d-Quit)", list, reopened)
+                      : g_strdup_printf("%s%s(list-measures \"%s\")(d-SaveAs \"%s\")(d-Quit)", list, edit, edited, saved);
+    gchar* argv[] = {DENEMO, "-n", "-e", "-a", scheme, i ? saved : (gchar*) input, NULL};
+    spawn_denemo_at_home(NULL, argv);
+    g_free(scheme);
+  }
+
+  g_assert(g_file_get_contents(edited, &edited_contents, NULL, NULL));
+  g_assert(g_file_get_contents(reopened, &reopened_contents, NULL, NULL));
+  g_assert_cmpstr(edited_contents, !=, "");
+  g_assert_cmpstr(edited_contents, ==, reopened_contents);
+  g_free(edited_contents);
+  g_free(reopened_contents);
+  g_free(saved);
+  g_free(edited);
+  g_free(reopened);
+}
+
+/** test_context_cache
+ * Inserts a change of clef and a change of key in the middle of a staff,
+ * which re-caches the context of the following measures only as far as
+ * needed, deletes the clef and inserts it again, and lists the clef, key and
+ * time signature cached for each object with the staff position of its note.
+ * The edited file is saved and reopened, with the context of every measure
+ * cached afresh, and the list made again must be the same.
+ */
+static void
+test_context_cache(gpointer fixture, gconstpointer data)
+{
+  const gchar* input = (const gchar*) data;
+  const gchar* list = "(define (list-contexts file) (with-output-to-file file (lambda () (let loop ((n 1)) (if (<= n (d-GetMeasuresInStaff)) (begin (if (d-GoToPosition #f #f n 1) (let next () (display (list n (d-GetPrevailingClef) (d-GetPrevailingKeysig) (d-GetPrevailingTimesig) (d-GetNoteStaffPosition))) (newline) (if (d-NextObjectInMeasure) (next)))) (loop (+ n 1))))))))";
+  const gchar* edit = "(d-GoToPosition #f 1 2 1)(d-InsertClef \"Bass\")(d-GoToPosition #f 1 3 1)(d-InsertKey \"D\")(d-GoToPosition #f 1 2 1)(d-DeleteObject)(d-Undo)";
+  gchar* saved = g_build_filename(temp_dir, "edited.denemo", NULL);
+  gchar* edited = g_build_filename(temp_dir, "edited.txt", NULL);
+  gchar* reopened = g_build_filename(temp_dir, "reopened.txt", NULL);
+  gchar* edited_contents = NULL;
+  gchar* reopened_contents = NULL;
+  guint i;
+
+  for(i = 0; i < 2; i++){
+    gchar* scheme = i ? g_strdup_printf("%s(d-GoToPosition #f 1 1 1)(list-contexts \"%s\")(d-Quit)", list, reopened)
+                      : g_strdup_printf("%s%s(d-GoToPosition #f 1 1 1)(list-contexts \"%s\")(d-SaveAs \"%s\")(d-Quit)", list, edit, edited, saved);
+    gchar* argv[] = {DENEMO, "-n", "-e", "-a", scheme, i ? saved : (gchar*) input, NULL};
+    spawn_denemo_at_home(NULL, argv);
+    g_free(scheme);
+  }
+
+  g_assert(g_file_get_contents(edited, &edited_contents, NULL, NULL));
+  g_assert(g_file_get_contents(reopened, &reopened_contents, NULL, NULL));
+  g_assert(strstr(edited_contents, "Bass"));
+  g_assert_cmpstr(edited_contents, ==, reopened_contents);
+  g_free(edited_contents);
+  g_free(reopened_contents);
+  g_free(saved);
+  g_free(edited);
+  g_free(reopened);
+}
+
+/** test_paste
+ * Copies a range of two staffs and pastes it further on, once with the Paste
+ * command and once with the Scheme DenemoPaste it replaced; the scores saved
+ * must be the same. The range is then cut, which must change the score, and
+ * the cut undone, which must give back the score as it was.
+ */
+static void
+test_paste(gpointer fixture, gconstpointer data)
+{
+  const gchar* input = (const gchar*) data;
+  const gchar* range = "(d-GoToPosition #f 1 1 1)(d-SetMark)(d-GoToPosition #f 2 2 1)(d-SetPoint)";
+  const gchar* home = "(d-GoToPosition 1 1 1 1)";
+  const gchar* pastes[] = {"(d-Paste)", "(DenemoPaste)"};
+  gchar* outputs[] = {g_build_filename(temp_dir, "native.denemo", NULL), g_build_filename(temp_dir, "scheme.denemo", NULL),
+                      g_build_filename(temp_dir, "original.denemo", NULL), g_build_filename(temp_dir, "cut.denemo", NULL), g_build_filename(temp_dir, "undone.denemo", NULL)};
+  gchar* contents[G_N_ELEMENTS(outputs)];
+  guint i;
+
+  for(i = 0; i < G_N_ELEMENTS(pastes) + 1; i++){
+    gchar* scheme;
+    if(i < G_N_ELEMENTS(pastes))
+      scheme = g_strdup_printf("%s(d-Copy)(d-UnsetMark)(d-GoToPosition #f 1 4 1)%s%s(d-SaveAs \"%s\")(d-Quit)", range, pastes[i], home, outputs[i]);
+    else
+      scheme = g_strdup_printf("%s(d-SaveAs \"%s\")%s(d-Cut)%s(d-SaveAs \"%s\")(d-Undo)%s(d-SaveAs \"%s\")(d-Quit)", home, outputs[2], range, home, outputs[3], home, outputs[4]);
+    gchar* argv[] = {DENEMO, "-n", "-e", "-a", scheme, (gchar*) input, NULL};
+    g_test_print("Running %s on %s\n", scheme, input);
+    spawn_denemo_at_home(NULL, argv);
+    g_free(scheme);
+  }
+  for(i = 0; i < G_N_ELEMENTS(outputs); i++)
+    g_assert(g_file_get_contents(outputs[i], &contents[i], NULL, NULL));
+  g_assert_cmpstr(contents[0], ==, contents[1]);
+  g_assert_cmpstr(contents[0], !=, contents[2]);
+  g_assert_cmpstr(contents[3], !=, contents[2]);
+  g_assert_cmpstr(contents[4], ==, contents[2]);
+  for(i = 0; i < G_N_ELEMENTS(outputs); i++){
+    g_free(contents[i]);
+    g_free(outputs[i]);
+  }
+}
+
+/** test_activate_directive
+ * Puts a staff and a voice directive and activates them, which must succeed
+ * although staff and voice directives no longer have a widget; activating a
+ * tag that was not put must fail.
+ */
+static void
+test_activate_directive(gpointer fixture, gconstpointer data)
+{
+  const gchar* input = (const gchar*) data;
+  gchar* report = g_build_filename(temp_dir, "activate.txt", NULL);
+  gchar* report_contents = NULL;
+  gchar* scheme = g_strdup_printf("(d-DirectivePut-staff-display "TestStaff" "staff")(d-DirectivePut-voice-display "TestVoice" "voice")"
+                                  "(with-output-to-file "%s" (lambda () (write (list (d-DirectiveActivate-staff "TestStaff") (d-DirectiveActivate-voice "TestVoice") (d-DirectiveActivate-staff "Missing")))))(d-Quit)",
+                                  report);
+  gchar* argv[] = {DENEMO, "-n", "-e", "-a", scheme, (gchar*) input, NULL};
+
+  spawn_denemo_at_home(NULL, argv);
+  g_assert(g_file_get_contents(report, &report_contents, NULL, NULL));
+  g_assert_cmpstr(report_contents, ==, "(#t #t #f)");
+  g_free(report_contents);
+  g_free(scheme);
+  g_free(report);
+}
+
+/** test_syllable_counts
+ * Lists the syllables before each measure of each staff, as used for placing
+ * the lyrics in the display, which keeps the counts. A range of two staffs is
+ * then pasted at the start with the cursor left on the first staff, a chord
+ * of the first measure is deleted and the deletion undone with the cursor
+ * moved on, and the counts listed again. The edited file is saved and
+ * reopened, with nothing kept from before, and the list made again must be the
+ * same.
+ */
+static void
+test_syllable_counts(gpointer fixture, gconstpointer data)
+{
+  const gchar* input = (const gchar*) data;
+  const gchar* list = "(define (list-counts file) (with-output-to-file file (lambda () (let staffs ((s 1)) (if (d-GoToPosition #f s 1 1) (begin (let loop ((n 1)) (if (<= n (+ 1 (d-GetMeasuresInStaff))) (begin (display (d-SyllablesBeforeMeasure n)) (display \" \") (loop (+ n 1))))) (newline) (staffs (+ s 1))))))))";
+  const gchar* edit = "(d-GoToPosition #f 1 1 1)(d-SetMark)(d-GoToPosition #f 2 2 1)(d-SetPoint)(d-Copy)(d-UnsetMark)(d-GoToPosition #f 1 1 1)(d-Paste)"
+                      "(d-GoToPosition #f 1 1 1)(d-DeleteObject)(d-GoToPosition #f 1 3 1)(d-Undo)(d-GoToPosition #f 1 4 1)";
+  gchar* saved = g_build_filename(temp_dir, "edited.denemo", NULL);
+  gchar* before = g_build_filename(temp_dir, "before.txt", NULL);
+  gchar* edited = g_build_filename(temp_dir, "edited.txt", NULL);
+  gchar* reopened = g_build_filename(temp_dir, "reopened.txt", NULL);
+  gchar* before_contents = NULL;
+  gchar* edited_contents = NULL;
+  gchar* reopened_contents = NULL;
+  guint i;
+
+  for(i = 0; i < 2; i++){
+    gchar* scheme = i ? g_strdup_printf("%s(list-counts \"%s\")(d-Quit)", list, reopened)
+                      : g_strdup_printf("%s(list-counts \"%s\")%s(list-counts \"%s\")(d-SaveAs \"%s\")(d-Quit)", list, before, edit, edited, saved);
+    gchar* argv[] = {DENEMO, "-n", "-e", "-a", scheme, i ? saved : (gchar*) input, NULL};
+    spawn_denemo_at_home(NULL, argv);
+    g_free(scheme);
+  }
+
+  g_assert(g_file_get_contents(before, &before_contents, NULL, NULL));
+  g_assert(g_file_get_contents(edited, &edited_contents, NULL, NULL));
+  g_assert(g_file_get_contents(reopened, &reopened_contents, NULL, NULL));
+  g_assert_cmpstr(before_contents, !=, edited_contents);
+  g_assert_cmpstr(edited_contents, ==, reopened_contents);
+  g_free(before_contents);
+  g_free(edited_contents);
+  g_free(reopened_contents);
+  g_free(saved);
+  g_free(before);
+  g_free(edited);
+  g_free(reopened);
+}
+
+/** test_deferred_verses
+ * Makes a score of ten movements, each with a verse, saves and reopens it,
+ * so that the verse views are only built when a movement's verses are asked
+ * for, and reads the verses of all the movements. The verse of the first
+ * movement is then changed, and reading the others builds the views of too
+ * many movements, so those of the first are evicted back to text; reading all
+ * the verses again must give the changed verse. The verse views need a
+ * display, so the test is skipped without one.
+ */
+static void
+test_deferred_verses(gpointer fixture, gconstpointer data)
+{
+  gchar* saved = g_build_filename(temp_dir, "movements.denemo", NULL);
+  gchar* report = g_build_filename(temp_dir, "verses.txt", NULL);
+  gchar* scheme = g_strdup_printf("(define (verses) (let loop ((m 1) (l '())) (if (> m 10) (reverse l) (begin (d-GoToPosition m 1 1 1) (loop (+ m 1) (cons (d-GetVerse) l))))))"
+                                  "(let loop ((m 1)) (if (<= m 10) (begin (if (> m 1) (d-InsertMovementAfter)) (d-GoToPosition m 1 1 1) (d-AddVerse) (d-PutVerse (string-append \"verse \" (number->string m))) (loop (+ m 1)))))"
+                                  "(d-SaveAs \"%s\")(d-Open \"%s\")"
+                                  "(with-output-to-file \"%s\" (lambda () (write (verses)) (d-GoToPosition 1 1 1 1) (d-PutVerse \"edited\") (verses) (write (verses))))(d-Quit)",
+                                  saved, saved, report);
+  gchar* argv[] = {DENEMO, "-e", "-a", scheme, NULL};
+  gchar* contents = NULL;
+
+  if(!g_getenv("DISPLAY") && !g_getenv("WAYLAND_DISPLAY")){
+    g_test_skip("No display to build the verse views on");
+    g_free(scheme);
+    g_free(report);
+    g_free(saved);
+    return;
+  }
+  spawn_denemo_at_home(NULL, argv);
+  g_assert(g_file_get_contents(report, &contents, NULL, NULL));
+  g_assert_cmpstr(contents, ==,
+                  "(\"verse 1\" \"verse 2\" \"verse 3\" \"verse 4\" \"verse 5\" \"verse 6\" \"verse 7\" \"verse 8\" \"verse 9\" \"verse 10\")"
+                  "(\"edited\" \"verse 2\" \"verse 3\" \"verse 4\" \"verse 5\" \"verse 6\" \"verse 7\" \"verse 8\" \"verse 9\" \"verse 10\")");
+  g_free(contents);
+  g_free(scheme);
+  g_free(report);
+  g_free(saved);
+}
+
+/** test_lilypond_cache
+ * Exports a file as LilyPond, edits it and exports it again, so the second
+ * export replays the LilyPond recorded for the chords the edit left alone.
+ * The file is then reopened and given the same edit, and exporting it now
+ * generates all the LilyPond afresh; the two must be the same.
+ */
+static void
+test_lilypond_cache(gpointer fixture, gconstpointer data)
+{
+  const gchar* input = (const gchar*) data;
+  const gchar* edit = "(d-MoveToBeginning)(d-CursorRight)(d-AddDot)(d-MoveToEnd)(d-CursorLeft)(d-ChangeToE)";
+  gchar* first = g_build_filename(temp_dir, "first.ly", NULL);
+  gchar* cached = g_build_filename(temp_dir, "cached.ly", NULL);
+  gchar* fresh = g_build_filename(temp_dir, "fresh.ly", NULL);
+  gchar* cached_contents = NULL;
+  gchar* fresh_contents = NULL;
+
+  if (g_test_subprocess ())
+    {
+      gchar* scheme = g_strdup_printf("(d-ExportMUDELA \"%s\")%s(d-ExportMUDELA \"%s\")(d-SetSaved #t)(d-Open \"%s\")%s(d-ExportMUDELA \"%s\")(d-Quit)", first, edit, cached, input, edit, fresh);
+      execl(DENEMO, DENEMO, "-n", "-e", "-a", scheme, input, NULL);
+      g_warn_if_reached ();
+    }
+  g_test_trap_subprocess (NULL, 0, 0);
+  g_test_trap_assert_passed ();
+
+  g_assert(g_file_get_contents(cached, &cached_contents, NULL, NULL));
+  g_assert(g_file_get_contents(fresh, &fresh_contents, NULL, NULL));
+  g_assert_cmpstr(cached_contents, ==, fresh_contents);
+  g_free(cached_contents);
+  g_free(fresh_contents);
+  g_free(first);
+  g_free(cached);
+  g_free(fresh);
+}
+
+/** test_script_procedure
+ * Runs a script command on two chords, so the second run calls the procedure
+ * compiled from the script by the first; both chords must get the marking.
+ */
+static void
+test_script_procedure(gpointer fixture, gconstpointer data)
+{
+  const gchar* input = (const gchar*) data;
+  gchar* output = g_build_filename(temp_dir, "turns.ly", NULL);
+  gchar* contents = NULL;
+  gchar** parts;
+
+  if (g_test_subprocess ())
+    {
+      gchar* scheme = g_strdup_printf("(d-MoveToBeginning)(d-NextChord)(d-ToggleTurn)(d-NextChord)(d-ToggleTurn)(d-ExportMUDELA \"%s\")(d-Quit)", output);
+      execl(DENEMO, DENEMO, "-n", "-e", "-a", scheme, input, NULL);
+      g_warn_if_reached ();
+    }
+  g_test_trap_subprocess (NULL, 0, 0);
+  g_test_trap_assert_passed ();
+
+  g_assert(g_file_get_contents(output, &contents, NULL, NULL));
+  parts = g_strsplit(contents, "\\turn", -1);
+  g_assert_cmpint(g_strv_length(parts), ==, 3);
+  g_strfreev(parts);
+  g_free(contents);
+  g_free(output);
+}
+
+/** run_batch
+ * Runs Denemo with argv, giving it the jobs on its standard input, and
+ * returns the records it writes once it has ended.
+ */
+static gchar*
+run_batch(gchar** argv, const gchar* jobs)
+{
+  GString* records = g_string_new("");
+  gchar buf[1024];
+  gint in, out, status;
+  gssize length;
+  GPid pid;
+
+  g_assert(g_spawn_async_with_pipes(NULL, argv, NULL, G_SPAWN_DO_NOT_REAP_CHILD | G_SPAWN_STDERR_TO_DEV_NULL, NULL, NULL, &pid, &in, &out, NULL, NULL));
+  g_assert_cmpint(write(in, jobs, strlen(jobs)), ==, strlen(jobs));
+  close(in);
+  while((length = read(out, buf, sizeof(buf))) > 0)
+    g_string_append_len(records, buf, length);
+  close(out);
+  g_assert_cmpint(waitpid(pid, &status, 0), ==, pid);
+  g_spawn_close_pid(pid);
+  g_assert(g_spawn_check_exit_status(status, NULL));
+  return g_string_free(records, FALSE);
+}
+
+/** check_batch
+ * Runs a batch of jobs through Denemo started with argv: the file is
+ * exported as LilyPond, then a blank score, then the file again, and a
+ * missing file is opened. The two exports of the file must be the same, and
+ * the records written for the jobs must report the missing file as an error.
+ */
+static void
+check_batch(const gchar* input, gchar** argv)
+{
+  gchar* blank = g_build_filename(fixtures_dir, "denemo", "blank.denemo", NULL);
+  gchar* missing = g_build_filename(temp_dir, "missing.denemo", NULL);
+  gchar* first = g_build_filename(temp_dir, "first.ly", NULL);
+  gchar* again = g_build_filename(temp_dir, "again.ly", NULL);
+  gchar* blank_output = g_build_filename(temp_dir, "blank.ly", NULL);
+  gchar* jobs = g_strdup_printf("%s\t(d-ExportMUDELA \"%s\")\n%s\t(d-ExportMUDELA \"%s\")\n%s\t(d-ExportMUDELA \"%s\")\n%s\n", input, first, blank, blank_output, input, again, missing);
+  gchar* records = run_batch(argv, jobs);
+  gchar* first_contents = NULL;
+  gchar* again_contents = NULL;
+
+  g_assert(strstr(records, "job 1\tok\t"));
+  g_assert(strstr(records, "job 2\tok\t"));
+  g_assert(strstr(records, "job 3\tok\t"));
+  g_assert(strstr(records, "job 4\terror\t"));
+  g_assert(g_file_test(blank_output, G_FILE_TEST_EXISTS));
+  g_assert(g_file_get_contents(first, &first_contents, NULL, NULL));
+  g_assert(g_file_get_contents(again, &again_contents, NULL, NULL));
+  g_assert_cmpstr(first_contents, ==, again_contents);
+  g_free(first_contents);
+  g_free(again_contents);
+  g_free(records);
+  g_free(jobs);
+  g_free(blank_output);
+  g_free(again);
+  g_free(first);
+  g_free(missing);
+  g_free(blank);
+}
+
+/** test_batch
+ * Runs the batch of jobs through one Denemo.
+ */
+static void
+test_batch(gpointer fixture, gconstpointer data)
+{
+  gchar* argv[] = {DENEMO, "--batch", NULL};
+  check_batch((const gchar*) data, argv);
+}
+
+/** test_batch_parallel
+ * Runs the batch of jobs through two worker processes, which must give the
+ * same results as one Denemo.
+ */
+static void
+test_batch_parallel(gpointer fixture, gconstpointer data)
+{
+  gchar* argv[] = {DENEMO, "--batch", "--jobs", "2", NULL};
+  check_batch((const gchar*) data, argv);
+}
+
+/** test_batch_benchmark
+ * Exports every example as LilyPond in one batch, first by a single Denemo
+ * and then shared among a worker process for each processor, and reports the
+ * time taken by each.
+ */
+static void
+test_batch_benchmark(gpointer fixture, gconstpointer data)
+{
+  const gchar* path = (const gchar*) data;
+  gchar* serial[] = {DENEMO, "--batch", "--jobs", "1", NULL};
+  gchar* parallel[] = {DENEMO, "--batch", "--jobs", "0", NULL};
+  GString* jobs = g_string_new("");
+  GDir* dir = g_dir_open(path, 0, NULL);
+  const gchar* name;
+  gchar* records;
+  gdouble elapsed;
+  guint count = 0;
+
+  g_assert(dir);
+  while((name = g_dir_read_name(dir))){
+    if(g_str_has_suffix(name, ".denemo")){
+      gchar* input = g_build_filename(path, name, NULL);
+      gchar* output = g_strdup_printf("%s%s%u.ly", temp_dir, G_DIR_SEPARATOR_S, ++count);
+      g_string_append_printf(jobs, "%s\t(d-ExportMUDELA \"%s\")\n", input, output);
+      g_free(output);
+      g_free(input);
+    }
+  }
+  g_dir_close(dir);
+
+  g_test_timer_start();
+  records = run_batch(serial, jobs->str);
+  elapsed = g_test_timer_elapsed();
+  g_assert(!strstr(records, "\terror\t"));
+  g_free(records);
+  g_test_minimized_result(elapsed, "Exporting %u examples serially took %.3f seconds", count, elapsed);
+
+  g_test_timer_start();
+  records = run_batch(parallel, jobs->str);
+  elapsed = g_test_timer_elapsed();
+  g_assert(!strstr(records, "\terror\t"));
+  g_free(records);
+  g_test_minimized_result(elapsed, "Exporting %u examples on %u processors took %.3f seconds", count, g_get_num_processors(), elapsed);
+
+  g_string_free(jobs, TRUE);
+}
+
+/** copy_to_temp_dir
+ * Copies a file into the temporary directory, so that files may be written
+ * beside it. Returns the path of the copy.
+ */
+static gchar*
+copy_to_temp_dir(const gchar* input)
+{
+  gchar* filename = g_path_get_basename(input);
+  gchar* copy = g_build_filename(temp_dir, filename, NULL);
+  gchar* contents = NULL;
+  gsize length;
+
+  g_assert(g_file_get_contents(input, &contents, &length, NULL));
+  g_assert(g_file_set_contents(copy, contents, length, NULL));
+  g_free(contents);
+  g_free(filename);
+  return copy;
+}
+
+/** test_project_cache
+ * Opens a copy of a file twice with the project cache turned on, the second
+ * time from the cache written beside it the first time, and checks the
+ * LilyPond exported each time is the same. A note of the copy is then changed
+ * without changing its size or modification time, which only the checksum
+ * can catch: opening it again must not use the cache.
+ */
+static void
+test_project_cache(gpointer fixture, gconstpointer data)
+{
+  gchar* input = copy_to_temp_dir((const gchar*) data);
+  gchar* dirname = g_path_get_dirname(input);
+  gchar* filename = g_path_get_basename(input);
+  gchar* cache_filename = g_strconcat(".", filename, ".cache", NULL);
+  gchar* cache = g_build_filename(dirname, cache_filename, NULL);
+  gchar* parsed = g_build_filename(temp_dir, "parsed.ly", NULL);
+  gchar* cached = g_build_filename(temp_dir, "cached.ly", NULL);
+  gchar* changed = g_build_filename(temp_dir, "changed.ly", NULL);
+  gchar* scheme = g_strdup_printf("(d-SetPrefs \"<project_cache>1</project_cache>\")(d-Open \"%s\")(d-ExportMUDELA \"%s\")(d-Open \"%s\")(d-ExportMUDELA \"%s\")(d-Quit)", input, parsed, input, cached);
+  gchar* argv[] = {DENEMO, "-n", "-e", "-a", scheme, NULL};
+  gchar* parsed_contents = NULL;
+  gchar* cached_contents = NULL;
+  gchar* contents = NULL;
+  gchar* note;
+  gsize length;
+  GStatBuf st;
+  struct utimbuf times;
+
+  spawn_denemo_at_home(NULL, argv);
+
+  g_assert(g_file_test(cache, G_FILE_TEST_EXISTS));
+  g_assert(g_file_get_contents(parsed, &parsed_contents, NULL, NULL));
+  g_assert(g_file_get_contents(cached, &cached_contents, NULL, NULL));
+  g_assert_cmpstr(parsed_contents, ==, cached_contents);
+
+  g_assert(g_stat(input, &st) == 0);
+  g_assert(g_file_get_contents(input, &contents, &length, NULL));
+  note = strstr(contents, "<middle-c-offset>9<");
+  g_assert(note != NULL);
+  note[strlen("<middle-c-offset>")] = '8';
+  g_assert(g_file_set_contents(input, contents, length, NULL));
+  times.actime = st.st_atime;
+  times.modtime = st.st_mtime;
+  g_assert(g_utime(input, &times) == 0);
+  g_free(contents);
+  g_free(scheme);
+  scheme = g_strdup_printf("(d-SetPrefs \"<project_cache>1</project_cache>\")(d-Open \"%s\")(d-ExportMUDELA \"%s\")(d-Quit)", input, changed);
+  argv[4] = scheme;
+  spawn_denemo_at_home(NULL, argv);
+
+  g_assert(g_file_get_contents(changed, &contents, NULL, NULL));
+  g_assert_cmpstr(parsed_contents, !=, contents);
+  g_free(contents);
+  g_free(parsed_contents);
+  g_free(cached_contents);
+  g_free(scheme);
+  g_free(changed);
+  g_free(parsed);
+  g_free(cached);
+  g_free(cache);
+  g_free(cache_filename);
+  g_free(filename);
+  g_free(dirname);
+  g_free(input);
+}
+
+/** thumbnail_mtime
+ * Returns the modification time a thumbnail was tagged with (its
+ * Thumb::MTime text chunk), or -1 if it has none.
+ */
+static gint64
+thumbnail_mtime(const gchar* thumbnail)
+{
+  const gchar key[] = "tEXtThumb::MTime";
+  guchar* contents = NULL;
+  gsize length;
+  gsize i;
+  gint64 mtime = -1;
+
+  if(!g_file_get_contents(thumbnail, (gchar**) &contents, &length, NULL))
+    return -1;
+  for(i = 4; i + sizeof(key) <= length; i++)
+    if(!memcmp(contents + i, key, sizeof(key))){
+      // the chunk's data is the keyword, a nul and the text, preceded by its length
+      guint32 size = (contents[i - 4] << 24) | (contents[i - 3] << 16) | (contents[i - 2] << 8) | contents[i - 1];
+      gsize text = sizeof(key) - strlen("tEXt");
+      if(size >= text && i + strlen("tEXt") + size <= length){
+        gchar* value = g_strndup((gchar*) contents + i + sizeof(key), size - text);
+        mtime = g_ascii_strtoll(value, NULL, 10);
+        g_free(value);
+      }
+      break;
+    }
+  g_free(contents);
+  return mtime;
+}
+
+/** test_thumbnail_pool
+ * Closes a copy of a file, which queues its thumbnail in the background pool,
+ * and at once replaces the copy with a different score and quits while the
+ * job is still running. The pool must hand the running job over to a
+ * thumbnailer of its own rather than abandon it, so a large thumbnail must
+ * turn up, tagged with the modification time of the score it was made from.
+ * This needs a display and LilyPond, so the test is skipped without them.
+ */
+static void
+test_thumbnail_pool(gpointer fixture, gconstpointer data)
+{
+  gchar* input = copy_to_temp_dir((const gchar*) data);
+  gchar* other = g_build_filename(fixtures_dir, "denemo", "grace-note-hints.denemo", NULL);
+  gchar* home = g_build_filename(temp_dir, "home", NULL);
+  gchar* uri = g_strdup_printf("file://%s", input);
+  gchar* md5 = g_compute_checksum_for_string(G_CHECKSUM_MD5, uri, -1);
+  gchar* thumbname = g_strconcat(md5, ".png", NULL);
+  gchar* thumbnail = g_build_filename(home, ".thumbnails", "large", thumbname, NULL);
+  gchar* scheme = g_strdup_printf("(d-Open \"%s\")(d-Close)(copy-file \"%s\" \"%s\")(d-Quit)", input, other, input);
+  gchar* argv[] = {DENEMO, "-e", "-a", scheme, NULL};
+  gchar* lilypond = g_find_program_in_path("lilypond");
+  GStatBuf st;
+  gint wait;
+
+  if(!g_getenv("DISPLAY") && !g_getenv("WAYLAND_DISPLAY"))
+    g_test_skip("No display for the thumbnail pool, which only runs in the GUI");
+  else if(!lilypond)
+    g_test_skip("No LilyPond to make the thumbnails with");
+  else {
+    mkdir_if_not_exists(home);
+    spawn_denemo_at_home(home, argv);
+    for(wait = 0; wait < 120 && !g_file_test(thumbnail, G_FILE_TEST_EXISTS); wait++)
+      g_usleep(G_USEC_PER_SEC);
+    g_usleep(G_USEC_PER_SEC);   // let the thumbnailer finish writing it
+    g_assert(g_file_test(thumbnail, G_FILE_TEST_EXISTS));
+    g_assert(g_stat(input, &st) == 0);
+    g_assert_cmpint(thumbnail_mtime(thumbnail), ==, st.st_mtime);
+  }
+  g_free(lilypond);
+  g_free(scheme);
+  g_free(thumbnail);
+  g_free(thumbname);
+  g_free(md5);
+  g_free(uri);
+  g_free(home);
+  g_free(other);
+  g_free(input);
+}
+
+/** test_project_cache_benchmark
+ * Opens a copy of a file twice with the project cache turned on, and reports
+ * how long the first (cold) open, which parses the file and writes the cache,
+ * and the second (warm) open, which reads the cache, took, startup included.
+ * Only run in performance mode (-m perf).
+ */
+static void
+test_project_cache_benchmark(gpointer fixture, gconstpointer data)
+{
+  gchar* input = copy_to_temp_dir((const gchar*) data);
+  gchar* filename = g_path_get_basename(input);
+  gchar* scheme = g_strdup_printf("(d-SetPrefs \"<project_cache>1</project_cache>\")(d-Open \"%s\")(d-Quit)", input);
+  gchar* argv[] = {DENEMO, "-n", "-e", "-a", scheme, NULL};
+  const gchar* runs[] = {"cold", "warm"};
+  gint status;
+  guint i;
+
+  for(i = 0; i < G_N_ELEMENTS(runs); i++){
+    g_test_timer_start();
+    g_assert(g_spawn_sync(NULL, argv, NULL, G_SPAWN_STDOUT_TO_DEV_NULL | G_SPAWN_STDERR_TO_DEV_NULL, NULL, NULL, NULL, NULL, &status, NULL));
+    g_assert(g_spawn_check_exit_status(status, NULL));
+    gdouble elapsed = g_test_timer_elapsed();
+    g_test_minimized_result(elapsed, "Opening %s %s took %.3f seconds", filename, runs[i], elapsed);
+  }
+  g_free(scheme);
+  g_free(filename);
+  g_free(input);
+}
+
+/** export_lilypond_to_temp_dir
+ * Exports a file as LilyPond into the temporary directory, returning the
+ * path of the export, so that it can be imported.
+ */
+static gchar*
+export_lilypond_to_temp_dir(const gchar* input)
+{
+  gchar* filename = g_path_get_basename(input);
+  gchar* base_name = get_basename(filename);
+  gchar* lilyname = g_strconcat(base_name, ".ly", NULL);
+  gchar* output = g_build_filename(temp_dir, lilyname, NULL);
+  gchar* scheme = g_strdup_printf("(d-ExportMUDELA \"%s\")(d-Quit)", output);
+  gchar* argv[] = {DENEMO, "-n", "-e", "-a", scheme, (gchar*) input, NULL};
+
+  spawn_denemo_at_home(NULL, argv);
+  g_free(scheme);
+  g_free(lilyname);
+  g_free(base_name);
+  g_free(filename);
+  return output;
+}
+
+/** test_lilypond_threads
+ * Exports a file with several voices as LilyPond twice, once generating the
+ * voices on a thread for each processor and once on a single thread
+ * (DENEMO_LILYPOND_THREADS=1). The two exports must be byte for byte the same,
+ * and the same as the export in references/lilypond made by Denemo before the
+ * voices were generated in parallel, if there is one.
+ */
+static void
+test_lilypond_threads(gpointer fixture, gconstpointer data)
+{
+  const gchar* input = (const gchar*) data;
+  gchar* filename = g_path_get_basename(input);
+  gchar* base_name = get_basename(filename);
+  gchar* reference_filename = g_strconcat(base_name, ".ly", NULL);
+  gchar* reference = g_build_filename(ref_dir, "lilypond", reference_filename, NULL);
+  gchar* outputs[] = {g_build_filename(temp_dir, "parallel.ly", NULL), g_build_filename(temp_dir, "serial.ly", NULL)};
+  gchar* contents[G_N_ELEMENTS(outputs)];
+  gsize lengths[G_N_ELEMENTS(outputs)];
+  gchar* reference_contents = NULL;
+  gsize reference_length;
+  guint i;
+
+  for(i = 0; i < G_N_ELEMENTS(outputs); i++){
+    gchar* scheme = g_strdup_printf("(d-ExportMUDELA \"%s\")(d-Quit)", outputs[i]);
+    gchar* argv[] = {DENEMO, "-n", "-e", "-a", scheme, (gchar*) input, NULL};
+    gchar** envp = g_get_environ();
+
+    if(i > 0)
+      envp = g_environ_setenv(envp, "DENEMO_LILYPOND_THREADS", "1", TRUE);
+    g_test_print("Exporting %s to %s\n", input, outputs[i]);
+    spawn_denemo_with_environment(envp, argv);
+    g_assert(g_file_get_contents(outputs[i], &contents[i], &lengths[i], NULL));
+    g_strfreev(envp);
+    g_free(scheme);
+  }
+  g_assert_cmpuint(lengths[0], ==, lengths[1]);
+  g_assert(memcmp(contents[0], contents[1], lengths[0]) == 0);
+  if(g_file_get_contents(reference, &reference_contents, &reference_length, NULL)){
+    g_test_print("Comparing with %s\n", reference);
+    g_assert_cmpuint(lengths[0], ==, reference_length);
+    g_assert(memcmp(contents[0], reference_contents, lengths[0]) == 0);
+    g_free(reference_contents);
+  }
+  else
+    g_test_message("No reference export %s to compare with", reference);
+  for(i = 0; i < G_N_ELEMENTS(outputs); i++){
+    g_remove(outputs[i]);
+    g_free(contents[i]);
+    g_free(outputs[i]);
+  }
+  g_free(reference);
+  g_free(reference_filename);
+  g_free(base_name);
+  g_free(filename);
+}
+
+/** test_midi_threads
+ * Makes a score of three staffs from a blank file, with a change of tempo in
+ * the second measure of the second staff only, and exports it as MIDI twice,
+ * once building the tracks on a thread for each processor and once on a
+ * single thread (DENEMO_MIDI_THREADS=1). The two exports must be byte for byte
+ * the same. The tempo change must also time the notes of the other staffs:
+ * the onset of each chord of each staff, in milliseconds, must be the same as
+ * in references/midi/tempo-change.txt, which was worked out by hand from the
+ * tempos (a quarter lasts 500ms at the score's 120 and 1000ms from the change
+ * to 60 at 2000ms).
+ */
+static void
+test_midi_threads(gpointer fixture, gconstpointer data)
+{
+  const gchar* input = (const gchar*) data;
+  gchar* reference = g_build_filename(ref_dir, "midi", "tempo-change.txt", NULL);
+  gchar* outputs[] = {g_build_filename(temp_dir, "parallel.mid", NULL), g_build_filename(temp_dir, "serial.mid", NULL)};
+  gchar* report = g_build_filename(temp_dir, "onsets.txt", NULL);
+  gchar* contents[G_N_ELEMENTS(outputs)];
+  gsize lengths[G_N_ELEMENTS(outputs)];
+  gchar* expected = NULL;
+  guint i;
+
+  g_assert(g_file_get_contents(reference, &expected, NULL, NULL));
+  g_strstrip(expected);
+  for(i = 0; i < G_N_ELEMENTS(outputs); i++){
+    gchar* scheme = g_strdup_printf("(d-AddAfter)(d-AddAfter)(d-AppendMeasureAllStaffs)"
+                                    "(d-GoToPosition 1 1 1 1)(d-Insert2)(d-Insert2)(d-Insert2)(d-Insert2)"
+                                    "(d-GoToPosition 1 1 2 1)(d-Insert2)(d-Insert2)(d-Insert2)(d-Insert2)"
+                                    "(d-GoToPosition 1 2 1 1)(d-Insert0)"
+                                    "(d-GoToPosition 1 2 2 1)(d-Insert0)(d-GoToPosition 1 2 2 1)"
+                                    "(d-Directive-standalone \"MidiTempo\")"
+                                    "(d-DirectivePut-standalone-override \"MidiTempo\" (logior DENEMO_OVERRIDE_TEMPO DENEMO_OVERRIDE_STEP))"
+                                    "(d-DirectivePut-standalone-midibytes \"MidiTempo\" \"60\")"
+                                    "(d-GoToPosition 1 3 1 1)(d-Insert1)(d-Insert1)"
+                                    "(d-GoToPosition 1 3 2 1)(d-Insert1)(d-Insert1)"
+                                    "(d-ExportMIDI \"%s\")"
+                                    "(define (onsets staff) (d-GoToPosition 1 staff 1 1)"
+                                    "  (let loop ((l (list (d-GetMidiOnTime)))) (if (d-NextChord) (loop (cons (d-GetMidiOnTime) l)) (reverse l))))"
+                                    "(define (milliseconds t) (inexact->exact (round (* 1000 t))))"
+                                    "(with-output-to-file \"%s\" (lambda () (write (map (lambda (staff) (map milliseconds (onsets staff))) '(1 2 3)))))"
+                                    "(d-SetSaved #t)(d-Quit)", outputs[i], report);
+    gchar* argv[] = {DENEMO, "-n", "-e", "-a", scheme, (gchar*) input, NULL};
+    gchar** envp = g_get_environ();
+    gchar* onsets = NULL;
+
+    if(i > 0)
+      envp = g_environ_setenv(envp, "DENEMO_MIDI_THREADS", "1", TRUE);
+    g_test_print("Exporting a tempo change to %s\n", outputs[i]);
+    spawn_denemo_with_environment(envp, argv);
+    g_assert(g_file_get_contents(outputs[i], &contents[i], &lengths[i], NULL));
+    g_assert(g_file_get_contents(report, &onsets, NULL, NULL));
+    g_assert_cmpstr(onsets, ==, expected);
+    g_remove(report);
+    g_free(onsets);
+    g_strfreev(envp);
+    g_free(scheme);
+  }
+  g_assert_cmpuint(lengths[0], ==, lengths[1]);
+  g_assert(memcmp(contents[0], contents[1], lengths[0]) == 0);
+  for(i = 0; i < G_N_ELEMENTS(outputs); i++){
+    g_remove(outputs[i]);
+    g_free(contents[i]);
+    g_free(outputs[i]);
+  }
+  g_free(expected);
+  g_free(report);
+  g_free(reference);
+}
+
+/** find_files
+ * Returns the paths of the files under dir, at any depth, whose names end
+ * with suffix, prepended to found.
+ */
+static GList*
+find_files(const gchar* dir, const gchar* suffix, GList* found)
+{
+  GDir* d = g_dir_open(dir, 0, NULL);
+  const gchar* name;
+
+  if(!d)
+    return found;
+  while((name = g_dir_read_name(d))){
+    gchar* path = g_build_filename(dir, name, NULL);
+    if(g_file_test(path, G_FILE_TEST_IS_DIR))
+      found = find_files(path, suffix, found);
+    else if(g_str_has_suffix(name, suffix))
+      found = g_list_prepend(found, g_strdup(path));
+    g_free(path);
+  }
+  g_dir_close(d);
+  return found;
+}
+
+/** test_compiled_scheme
+ * Imports a LilyPond file three times with a fresh home directory. The first
+ * run compiles denemo.scm and the LilyPond import parser into the user's
+ * .denemo directory, where Guile can compile, which must write the compiled
+ * files and beside each the dependencies it was compiled with, and the second
+ * loads the compiled code. The Guile version recorded as a dependency is then
+ * changed, as if Guile had been upgraded, and the third run must compile the
+ * code again, recording the dependencies as before. The scores imported must
+ * be the same each time.
+ */
+static void
+test_compiled_scheme(gpointer fixture, gconstpointer data)
+{
+  gchar* input = export_lilypond_to_temp_dir((const gchar*) data);
+  gchar* home = g_build_filename(temp_dir, "home", NULL);
+  gchar* outputs[] = {g_build_filename(temp_dir, "cold.denemo", NULL), g_build_filename(temp_dir, "warm.denemo", NULL), g_build_filename(temp_dir, "upgraded.denemo", NULL)};
+  gchar* contents[G_N_ELEMENTS(outputs)];
+  GList* compiled;
+  GList* deps = NULL;
+  GList* recorded = NULL;
+  GList* g;
+  GList* r;
+  guint i;
+
+  delete_if_exists(home);
+  mkdir_if_not_exists(home);
+  for(i = 0; i < G_N_ELEMENTS(outputs); i++){
+    gchar* scheme = g_strdup_printf("(d-SaveAs \"%s\")(d-Quit)", outputs[i]);
+    gchar* argv[] = {DENEMO, "-n", "-e", "-a", scheme, input, NULL};
+    spawn_denemo_at_home(home, argv);
+    g_assert(g_file_get_contents(outputs[i], &contents[i], NULL, NULL));
+    g_free(scheme);
+    g_free(outputs[i]);
+
+    if(i == 0){
+      compiled = find_files(home, ".go", NULL);
+      g_assert(compiled != NULL);
+      for(g = compiled; g; g = g->next){
+        gchar* depsfile = g_strconcat((gchar*) g->data, ".deps", NULL);
+        gchar* text = NULL;
+        g_assert(g_file_get_contents(depsfile, &text, NULL, NULL));
+        g_assert(g_str_has_prefix(text, "guile "));
+        deps = g_list_append(deps, depsfile);
+        recorded = g_list_append(recorded, text);
+      }
+      g_list_free_full(compiled, g_free);
+    }
+    else if(i == 1)
+      for(g = deps; g; g = g->next){
+        gchar* upgraded = g_strconcat("guile 0.0.0\n", strchr(g_list_nth_data(recorded, g_list_position(deps, g)), '\n') + 1, NULL);
+        g_assert(g_file_set_contents((gchar*) g->data, upgraded, -1, NULL));
+        g_free(upgraded);
+      }
+  }
+  for(g = deps, r = recorded; g; g = g->next, r = r->next){
+    gchar* text = NULL;
+    g_assert(g_file_get_contents((gchar*) g->data, &text, NULL, NULL));
+    g_assert_cmpstr(text, ==, (gchar*) r->data);
+    g_free(text);
+  }
+  g_assert_cmpstr(contents[0], ==, contents[1]);
+  g_assert_cmpstr(contents[0], ==, contents[2]);
+  for(i = 0; i < G_N_ELEMENTS(contents); i++)
+    g_free(contents[i]);
+  g_list_free_full(deps, g_free);
+  g_list_free_full(recorded, g_free);
+  g_free(home);
+  g_free(input);
+}
+
+/** test_profile
+ * Profiles a command and the exports as LilyPond and MIDI, writing a trace.
+ * The profile must name the command and the parts of Denemo the exports run
+ * through, and the trace must be a list of complete events.
+ */
+static void
+test_profile(gpointer fixture, gconstpointer data)
+{
+  const gchar* input = (const gchar*) data;
+  gchar* trace = g_build_filename(temp_dir, "trace.json", NULL);
+  gchar* dump = g_build_filename(temp_dir, "profile.txt", NULL);
+  gchar* output = g_build_filename(temp_dir, "profiled", NULL);
+  gchar* scheme = g_strdup_printf("(d-ProfileStart \"%s\")(d-MoveToBeginning)(d-NextChord)(d-ToggleTurn)(d-ExportMUDELA \"%s.ly\")(d-ExportMIDI \"%s.mid\")(d-ProfileStop)"
+                                  "(with-output-to-file \"%s\" (lambda () (display (d-ProfileDump))))(d-SetSaved #t)(d-Quit)", trace, output, output, dump);
+  gchar* argv[] = {DENEMO, "-n", "-e", "-a", scheme, (gchar*) input, NULL};
+  gchar* contents = NULL;
+
+  spawn_denemo_at_home(NULL, argv);
+
+  g_assert(g_file_get_contents(dump, &contents, NULL, NULL));
+  g_assert(strstr(contents, "ToggleTurn "));
+  g_assert(strstr(contents, "output_score_to_buffer "));
+  g_assert(strstr(contents, "exportmidi "));
+  g_assert(strstr(contents, "call_out_to_guile "));
+  g_free(contents);
+
+  g_assert(g_file_get_contents(trace, &contents, NULL, NULL));
+  g_assert(g_str_has_prefix(contents, "[\n"));
+  g_assert(g_str_has_suffix(contents, "\n]\n"));
+  g_assert(strstr(contents, "{\"name\":\"exportmidi\",\"cat\":\"denemo\",\"ph\":\"X\","));
+  g_free(contents);
+
+  g_free(scheme);
+  g_free(output);
+  g_free(dump);
+  g_free(trace);
+}
+
+/** test_audio_telemetry
+ * Records the audio telemetry while a file is open and reports it. Without
+ * audio there are no callbacks, but the report must name each driver and
+ * queue and the recording must be a file with its header line.
+ */
+static void
+test_audio_telemetry(gpointer fixture, gconstpointer data)
+{
+  const gchar* input = (const gchar*) data;
+  gchar* record = g_build_filename(temp_dir, "telemetry.tsv", NULL);
+  gchar* report = g_build_filename(temp_dir, "telemetry.txt", NULL);
+  gchar* scheme = g_strdup_printf("(d-AudioTelemetryReset)(d-AudioTelemetryRecord \"%s\")(d-MoveToBeginning)(d-AudioTelemetryRecord #f)"
+                                  "(with-output-to-file \"%s\" (lambda () (display (d-AudioTelemetry))))(d-SetSaved #t)(d-Quit)", record, report);
+  gchar* argv[] = {DENEMO, "-n", "-e", "-a", scheme, (gchar*) input, NULL};
+  gchar* contents = NULL;
+
+  spawn_denemo_at_home(NULL, argv);
+
+  g_assert(g_file_get_contents(report, &contents, NULL, NULL));
+  g_assert(g_str_has_prefix(contents, "Audio telemetry over "));
+  g_assert(strstr(contents, "jack: "));
+  g_assert(strstr(contents, "portaudio: "));
+  g_assert(strstr(contents, "audio queue: 0 immediate events dropped, 0 source audio underruns"));
+  g_assert(!strstr(contents, "Recording"));
+  g_free(contents);
+
+  g_assert(g_file_get_contents(record, &contents, NULL, NULL));
+  g_assert(g_str_has_prefix(contents, "# seconds\tdriver\tduration_us\t"));
+  g_free(contents);
+
+  g_free(scheme);
+  g_free(report);
+  g_free(record);
+}
+
+/** test_startup_benchmark
+ * Imports a LilyPond file twice with a fresh home directory, and reports how
+ * long the first (cold) run, which compiles denemo.scm and the LilyPond
+ * import parser, and the second (warm) run, which loads the compiled code,
+ * took. Only run in performance mode (-m perf).
+ */
+static void
+test_startup_benchmark(gpointer fixture, gconstpointer data)
+{
+  gchar* input = export_lilypond_to_temp_dir((const gchar*) data);
+  gchar* filename = g_path_get_basename(input);
+  gchar* home = g_build_filename(temp_dir, "home", NULL);
+  gchar* argv[] = {DENEMO, "-n", "-e", "-a", "(d-Quit)", input, NULL};
+  const gchar* runs[] = {"cold", "warm"};
+  guint i;
+
+  delete_if_exists(home);
+  mkdir_if_not_exists(home);
+  for(i = 0; i < G_N_ELEMENTS(runs); i++){
+    g_test_timer_start();
+    spawn_denemo_at_home(home, argv);
+    gdouble elapsed = g_test_timer_elapsed();
+    g_test_minimized_result(elapsed, "Starting and importing %s %s took %.3f seconds", filename, runs[i], elapsed);
+  }
+  g_free(home);
+  g_free(filename);
+  g_free(input);
+}
+
+/** test_import_benchmark
+ * Imports a file and reports how long it took, startup included.
+ * Only run in performance mode (-m perf).
+ */
+static void
+test_import_benchmark(gpointer fixture, gconstpointer data)
+{
+  const gchar* input = (const gchar*) data;
+  gchar* filename = g_path_get_basename(input);
+
+  g_test_timer_start();
+  if (g_test_subprocess ())
+    {
+      execl(DENEMO, DENEMO, "-n", "-e", input, NULL);
+      g_warn_if_reached ();
+    }
+  g_test_trap_subprocess (NULL, 0, 0);
+  g_test_trap_assert_passed ();
+  gdouble elapsed = g_test_timer_elapsed();
+  g_test_minimized_result(elapsed, "Importing %s took %.3f seconds", filename, elapsed);
+  g_free(filename);
+}
+
+/** test_export_benchmark
+ * Opens a file and exports it as LilyPond and as MIDI, reporting how long it
+ * took, startup and import included. Both exports walk every note of every
+ * chord. Only run in performance mode (-m perf).
+ */
+static void
+test_export_benchmark(gpointer fixture, gconstpointer data)
+{
+  const gchar* input = (const gchar*) data;
+  gchar* filename = g_path_get_basename(input);
+  gchar* base_name = get_basename(filename);
+  gchar* output = g_build_filename(temp_dir, base_name, NULL);
+
+  g_test_timer_start();
+  if (g_test_subprocess ())
+    {
+      gchar* scheme = g_strdup_printf("(d-ExportMUDELA \"%s.ly\")(d-ExportMIDI \"%s.mid\")(d-Quit)", output, output);
+      execl(DENEMO, DENEMO, "-n", "-e", "-a", scheme, input, NULL);
+      g_warn_if_reached ();
+    }
+  g_test_trap_subprocess (NULL, 0, 0);
+  g_test_trap_assert_passed ();
+  gdouble elapsed = g_test_timer_elapsed();
+  g_test_minimized_result(elapsed, "Exporting %s took %.3f seconds", filename, elapsed);
+  g_free(output);
+  g_free(base_name);
+  g_free(filename);
+}
+
 /*******************************************************************************
  * MAIN
  ******************************************************************************/
 
+static void
+add_import_benchmarks(gchar* path, const gchar* extension)
+{
+  GList* files = find_files_with_ext(path, extension);
+  while(files){
+    gchar* filename = g_build_filename(path, files->data, NULL);
+    gchar* test_case_path = g_strdup_printf("/integration/benchmark/import-%s", (gchar*) files->data);
+    g_test_add (test_case_path, gchar*, filename, setup, test_import_benchmark, teardown);
+    g_free(test_case_path);
+    files = g_list_next(files);
+  }
+}
+
+static void
+add_mxml_imports(gchar* path)
+{
+  GList* files = find_files_with_ext(path, ".mxml");
+  while(files){
+    gchar* filename = g_build_filename(path, files->data, NULL);
+    gchar* test_case_path = g_strdup_printf("/integration/import-%s", (gchar*) files->data);
+    g_test_add (test_case_path, gchar*, filename, setup, test_import_mxml, teardown);
+    g_free(test_case_path);
+    files = g_list_next(files);
+  }
+}
+
 static gchar*
 parse_dir_and_run_complex_test(gchar* path, const gchar* extension)
 {
@@ -278,11 +1625,48 @@ main (int argc, char *argv[])
 
   g_test_add ("/integration/open-blank-file", void, NULL, setup, test_open_blank_file, teardown);
   g_test_add ("/integration/open-and-save-blank-file", void, NULL, setup, test_open_save_blank_file, teardown);
+  g_test_add ("/integration/import-mxml-keys", gchar*, g_build_filename(fixtures_dir, "mxml", "minor-keys.mxml", NULL), setup, test_import_mxml_keys, teardown);
+  g_test_add ("/integration/import-midi-signatures", gchar*, g_build_filename(fixtures_dir, "midi", "signatures.mid", NULL), setup, test_import_midi, teardown);
+  g_test_add ("/integration/export-lilypond-hemiola", gchar*, g_build_filename(fixtures_dir, "denemo", "hemiola.denemo", NULL), setup, test_export_lilypond, teardown);
+  g_test_add ("/integration/standard-layout-hemiola", gchar*, g_build_filename(fixtures_dir, "denemo", "hemiola.denemo", NULL), setup, test_standard_layout, teardown);
+  g_test_add ("/integration/standard-layout-grace-note-hints", gchar*, g_build_filename(fixtures_dir, "denemo", "grace-note-hints.denemo", NULL), setup, test_standard_layout, teardown);
+  g_test_add ("/integration/standard-layout-AllFeaturesExplained", gchar*, g_build_filename(example_dir, "AllFeaturesExplained.denemo", NULL), setup, test_standard_layout, teardown);
+  g_test_add ("/integration/standard-layout-KeyboardPolyphony", gchar*, g_build_filename(example_dir, "KeyboardPolyphony.denemo", NULL), setup, test_standard_layout, teardown);
+  g_test_add ("/integration/undo-snapshot-hemiola", gchar*, g_build_filename(fixtures_dir, "denemo", "hemiola.denemo", NULL), setup, test_undo_snapshot, teardown);
+  g_test_add ("/integration/lilypond-threads-AllFeaturesExplained", gchar*, g_build_filename(example_dir, "AllFeaturesExplained.denemo", NULL), setup, test_lilypond_threads, teardown);
+  g_test_add ("/integration/lilypond-threads-KeyboardPolyphony", gchar*, g_build_filename(example_dir, "KeyboardPolyphony.denemo", NULL), setup, test_lilypond_threads, teardown);
+  g_test_add ("/integration/midi-threads-tempo-change", gchar*, g_build_filename(fixtures_dir, "denemo", "blank.denemo", NULL), setup, test_midi_threads, teardown);
+  g_test_add ("/integration/measure-index-hemiola", gchar*, g_build_filename(fixtures_dir, "denemo", "hemiola.denemo", NULL), setup, test_measure_index, teardown);
+  g_test_add ("/integration/context-cache-hemiola", gchar*, g_build_filename(fixtures_dir, "denemo", "hemiola.denemo", NULL), setup, test_context_cache, teardown);
+  g_test_add ("/integration/paste-hemiola", gchar*, g_build_filename(fixtures_dir, "denemo", "hemiola.denemo", NULL), setup, test_paste, teardown);
+  g_test_add ("/integration/syllable-counts-hemiola", gchar*, g_build_filename(fixtures_dir, "denemo", "hemiola.denemo", NULL), setup, test_syllable_counts, teardown);
+  g_test_add ("/integration/deferred-verses", void, NULL, setup, test_deferred_verses, teardown);
+  g_test_add ("/integration/activate-directive-hemiola", gchar*, g_build_filename(fixtures_dir, "denemo", "hemiola.denemo", NULL), setup, test_activate_directive, teardown);
+  g_test_add ("/integration/lilypond-cache-hemiola", gchar*, g_build_filename(fixtures_dir, "denemo", "hemiola.denemo", NULL), setup, test_lilypond_cache, teardown);
+  g_test_add ("/integration/project-cache-hemiola", gchar*, g_build_filename(fixtures_dir, "denemo", "hemiola.denemo", NULL), setup, test_project_cache, teardown);
+  g_test_add ("/integration/script-procedure-hemiola", gchar*, g_build_filename(fixtures_dir, "denemo", "hemiola.denemo", NULL), setup, test_script_procedure, teardown);
+  g_test_add ("/integration/compiled-scheme-hemiola", gchar*, g_build_filename(fixtures_dir, "denemo", "hemiola.denemo", NULL), setup, test_compiled_scheme, teardown);
+  g_test_add ("/integration/profile-hemiola", gchar*, g_build_filename(fixtures_dir, "denemo", "hemiola.denemo", NULL), setup, test_profile, teardown);
+  g_test_add ("/integration/audio-telemetry-hemiola", gchar*, g_build_filename(fixtures_dir, "denemo", "hemiola.denemo", NULL), setup, test_audio_telemetry, teardown);
+  g_test_add ("/integration/batch-hemiola", gchar*, g_build_filename(fixtures_dir, "denemo", "hemiola.denemo", NULL), setup, test_batch, teardown);
+  g_test_add ("/integration/batch-parallel-hemiola", gchar*, g_build_filename(fixtures_dir, "denemo", "hemiola.denemo", NULL), setup, test_batch_parallel, teardown);
+  g_test_add ("/integration/thumbnail-pool-hemiola", gchar*, g_build_filename(fixtures_dir, "denemo", "hemiola.denemo", NULL), setup, test_thumbnail_pool, teardown);
 
   parse_dir_and_run_complex_test(example_dir, ".denemo");
   parse_dir_and_run_complex_test(fixtures_dir, ".denemo");
   // parse_dir_and_run_complex_test(fixtures_dir, ".mxml");
+  add_mxml_imports(g_build_filename(fixtures_dir, "mxml", NULL));
   parse_dir_and_run_complex_test(fixtures_dir, ".scm");
 
+  if(g_test_perf ()){
+    g_test_add ("/integration/benchmark/import-blank.denemo", gchar*, g_build_filename(fixtures_dir, "denemo", "blank.denemo", NULL), setup, test_import_benchmark, teardown);
+    add_import_benchmarks(g_build_filename(fixtures_dir, "mxml", NULL), ".mxml");
+    g_test_add ("/integration/benchmark/export-AllFeaturesExplained.denemo", gchar*, g_build_filename(example_dir, "AllFeaturesExplained.denemo", NULL), setup, test_export_benchmark, teardown);
+    g_test_add ("/integration/benchmark/export-KeyboardPolyphony.denemo", gchar*, g_build_filename(example_dir, "KeyboardPolyphony.denemo", NULL), setup, test_export_benchmark, teardown);
+    g_test_add ("/integration/benchmark/project-cache-AllFeaturesExplained.denemo", gchar*, g_build_filename(example_dir, "AllFeaturesExplained.denemo", NULL), setup, test_project_cache_benchmark, teardown);
+    g_test_add ("/integration/benchmark/startup-hemiola.denemo", gchar*, g_build_filename(fixtures_dir, "denemo", "hemiola.denemo", NULL), setup, test_startup_benchmark, teardown);
+    g_test_add ("/integration/benchmark/batch-examples", gchar*, g_strdup(example_dir), setup, test_batch_benchmark, teardown);
+  }
+
   return g_test_run ();
 }
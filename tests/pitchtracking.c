@@ -0,0 +1,130 @@
+#include <glib.h>
+#include <math.h>
+#include "audio/pitchtracker.h"
+
+#define SAMPLE_RATE (44100)
+
+/* the window size determine_frequency() uses for a target pitch, see setTuningTarget() */
+static gint
+window_for_pitch (gint pitch)
+{
+  gint windowsize = 16384 >> ((pitch - 12) / 12);
+  return windowsize < 1024 ? 1024 : windowsize;
+}
+
+static gdouble
+pitch_to_freq (gdouble pitch)
+{
+  return 440.0 * pow (2, (pitch - 69.0) / 12.0);
+}
+
+/* a quarter of a second of a tone of freq with a few harmonics, as an instrument being tuned might give */
+static gfloat*
+synthetic_tone (gdouble freq, gint numsamples)
+{
+  gfloat* samples = g_new (gfloat, numsamples);
+  gint i;
+  for (i = 0; i < numsamples; i++)
+    {
+      gdouble t = 2 * G_PI * freq * i / SAMPLE_RATE;
+      samples[i] = 0.5 * sin (t) + 0.25 * sin (2 * t) + 0.1 * sin (3 * t);
+    }
+  return samples;
+}
+
+/* the frequency of the peak within a semitone of pitch, as determine_frequency() finds it */
+static gdouble
+measure_frequency (gfloat* samples, gint numsamples, gint pitch, gfloat* processed)
+{
+  gint lower = lround (SAMPLE_RATE / pitch_to_freq (pitch - 1));
+  gint upper = lround (SAMPLE_RATE / pitch_to_freq (pitch + 1));
+  if (!pitch_tracker_autocorrelation (samples, numsamples, window_for_pitch (pitch), processed))
+    return -1.0;
+  return SAMPLE_RATE / (upper + pitch_tracker_best_peak (&processed[upper], lower - upper));
+}
+
+/*******************************************************************************
+ * TEST FUNCTIONS
+ ******************************************************************************/
+
+/** test_tone_frequency
+ * Measures synthetic tones across the range of the tuning target and checks
+ * the frequency found is within 15 cents of the one generated (the peak
+ * interpolation is biased by up to about 10 cents).
+ */
+static void
+test_tone_frequency (void)
+{
+  gint numsamples = SAMPLE_RATE / 4;
+  gfloat* processed = g_new0 (gfloat, 16384);
+  gint pitch;
+  for (pitch = 40; pitch <= 84; pitch += 11)
+    {
+      gdouble freq = pitch_to_freq (pitch + 0.1);
+      gfloat* samples = synthetic_tone (freq, numsamples);
+      gdouble found = measure_frequency (samples, numsamples, pitch, processed);
+      g_test_message ("Tone of %.2f Hz measured as %.2f Hz", freq, found);
+      g_assert_cmpfloat (fabs (1200 * log2 (found / freq)), <, 15.0);
+      g_free (samples);
+    }
+  g_free (processed);
+}
+
+/** test_too_little_data
+ * Checks nothing is measured from less than one window of samples.
+ */
+static void
+test_too_little_data (void)
+{
+  gfloat* samples = synthetic_tone (440.0, 1000);
+  gfloat* processed = g_new0 (gfloat, 16384);
+  g_assert (!pitch_tracker_autocorrelation (samples, 1000, window_for_pitch (69), processed));
+  g_free (processed);
+  g_free (samples);
+}
+
+/** test_tracking_benchmark
+ * Reports the time taken to measure a quarter of a second of sound, which is
+ * how much determine_frequency() analyses on each call while tuning.
+ * Only run in performance mode (-m perf).
+ */
+static void
+test_tracking_benchmark (gconstpointer data)
+{
+  gint pitch = GPOINTER_TO_INT (data);
+  gint numsamples = SAMPLE_RATE / 4;
+  gint repeats = 200, i;
+  gfloat* samples = synthetic_tone (pitch_to_freq (pitch), numsamples);
+  gfloat* processed = g_new0 (gfloat, 16384);
+  gdouble elapsed;
+
+  (void) measure_frequency (samples, numsamples, pitch, processed);     // prepare the plan for this window size
+  g_test_timer_start ();
+  for (i = 0; i < repeats; i++)
+    (void) measure_frequency (samples, numsamples, pitch, processed);
+  elapsed = g_test_timer_elapsed () / repeats;
+  g_test_minimized_result (elapsed, "Tracking pitch %d (window %d) took %.3f ms per quarter second", pitch, window_for_pitch (pitch), elapsed * 1000);
+  g_free (processed);
+  g_free (samples);
+}
+
+/*******************************************************************************
+ * MAIN
+ ******************************************************************************/
+
+int
+main (int argc, char *argv[])
+{
+  g_test_init (&argc, &argv, NULL);
+
+  g_test_add_func ("/pitchtracking/tone-frequency", test_tone_frequency);
+  g_test_add_func ("/pitchtracking/too-little-data", test_too_little_data);
+
+  if(g_test_perf ()){
+    g_test_add_data_func ("/pitchtracking/benchmark/low", GINT_TO_POINTER (36), test_tracking_benchmark);
+    g_test_add_data_func ("/pitchtracking/benchmark/middle", GINT_TO_POINTER (60), test_tracking_benchmark);
+    g_test_add_data_func ("/pitchtracking/benchmark/high", GINT_TO_POINTER (84), test_tracking_benchmark);
+  }
+
+  return g_test_run ();
+}